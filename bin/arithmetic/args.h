@@ -168,6 +168,38 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_SET
     },
 
+
+
+
+
+    /* Operating mode options. */
+    {
+      "fuse",
+      UI_KEY_FUSE,
+      0,
+      0,
+      "Evaluate element-wise operators tile by tile.",
+      GAL_OPTIONS_GROUP_OPERATING_MODE,
+      &p->fuse,
+      GAL_OPTIONS_NO_ARG_TYPE,
+      GAL_OPTIONS_RANGE_0_OR_1,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
+    {
+      "streamrows",
+      UI_KEY_STREAMROWS,
+      "INT",
+      0,
+      "Read/write images in blocks of this many rows.",
+      GAL_OPTIONS_GROUP_OPERATING_MODE,
+      &p->streamrows,
+      GAL_TYPE_SIZE_T,
+      GAL_OPTIONS_RANGE_GE_0,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
+
     {0}
   };
 
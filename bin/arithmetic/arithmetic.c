@@ -44,6 +44,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include "main.h"
 
+#include "fuse.h"
 #include "operands.h"
 #include "arithmetic.h"
 
@@ -610,8 +611,10 @@ arithmetic_erode_dilate(struct arithmeticparams *p, char *token, int op)
   /* Do the operation. */
   switch(op)
     {
-    case ARITHMETIC_OP_ERODE:  gal_binary_erode(in,  1, conn_int, 1); break;
-    case ARITHMETIC_OP_DILATE: gal_binary_dilate(in, 1, conn_int, 1); break;
+    case ARITHMETIC_OP_ERODE:  gal_binary_erode(in,  1, conn_int, 1,
+                                                 p->cp.numthreads); break;
+    case ARITHMETIC_OP_DILATE: gal_binary_dilate(in, 1, conn_int, 1,
+                                                 p->cp.numthreads); break;
     default:
       error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix the "
             "problem. The operator code %d not recognized", __func__,
@@ -661,7 +664,7 @@ arithmetic_connected_components(struct arithmeticparams *p, char *token)
   conn_int=arithmetic_binary_sanity_checks(in, conn, token);
 
   /* Do the connected components labeling. */
-  gal_binary_connected_components(in, &out, conn_int);
+  gal_binary_connected_components(in, &out, conn_int, p->cp.numthreads);
 
   /* Push the result onto the stack. */
   operands_add(p, NULL, out);
@@ -816,7 +819,8 @@ arithmetic_interpolate_region(struct arithmeticparams *p,
   /* Build a binary image with the blank regions masked and label them,
      then free the flagged array. */
   flag=gal_blank_flag(in);
-  numlabs=gal_binary_connected_components(flag, &lab, con[0]);
+  numlabs=gal_binary_connected_components(flag, &lab, con[0],
+                                          p->cp.numthreads);
   gal_data_free(flag);
 
   /* Allocate array to keep maximum values for each region. Just note that
@@ -1446,8 +1450,13 @@ arithmetic_operator_run(struct arithmeticparams *p, int operator,
   if(p->cp.quiet) flags |= GAL_ARITHMETIC_FLAG_QUIET;
   if(p->envseed)  flags |= GAL_ARITHMETIC_FLAG_ENVSEED;
 
+  /* If fusion is requested and this is an element-wise operator, it will
+     not be evaluated here (see 'fuse.c'). */
+  if(p->fuse && inlib && fuse_is_elementwise(operator, num_operands))
+    fuse_operator(p, operator, operator_string, num_operands, flags);
+
   /* If this operator is in the library, we should pop everything here.  */
-  if(inlib)
+  else if(inlib)
     {
       /* Pop the necessary number of operators. Note that the
          operators are poped from a linked list (which is
@@ -1685,19 +1694,17 @@ arithmetic_final_data(struct arithmeticparams *p)
 
 
 
-/* This function implements the reverse polish algorithm as explained
-   in the Wikipedia page.
+/* Parse all the tokens and do the requested operations (the results will
+   be on the operands stack).
 
    NOTE that in ui.c, the input linked list of tokens was ordered to
    have the same order as what the user provided. */
-void
-reversepolish(struct arithmeticparams *p)
+static void
+reversepolish_tokens(struct arithmeticparams *p)
 {
-  char *printnum;
-  struct operand *otmp;
   size_t num_operands=0;
   gal_list_str_t *token;
-  gal_data_t *tmp, *data, *col;
+  gal_data_t *data, *col;
   struct gal_options_common_params *cp=&p->cp;
   int inlib, operator=GAL_ARITHMETIC_OP_INVALID;
 
@@ -1757,6 +1764,286 @@ reversepolish(struct arithmeticparams *p)
       /* Increment the token counter. */
       ++p->setprm.tokencounter;
     }
+}
+
+
+
+
+
+/* Number of parameters of multi-operand operators that can be streamed
+   (where each output pixel only depends on the same pixel of all the
+   inputs, like 'mean' or 'sigclip-median'). For other operators, this
+   function will return -1. */
+static int
+arithmetic_stream_multioperand(int operator)
+{
+  switch(operator)
+    {
+    case GAL_ARITHMETIC_OP_MIN:
+    case GAL_ARITHMETIC_OP_MAX:
+    case GAL_ARITHMETIC_OP_NUMBER:
+    case GAL_ARITHMETIC_OP_SUM:
+    case GAL_ARITHMETIC_OP_MEAN:
+    case GAL_ARITHMETIC_OP_STD:
+    case GAL_ARITHMETIC_OP_MEDIAN:
+      return 0;
+
+    case GAL_ARITHMETIC_OP_QUANTILE:
+      return 1;
+
+    case GAL_ARITHMETIC_OP_SIGCLIP_STD:
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:
+    case GAL_ARITHMETIC_OP_SIGCLIP_NUMBER:
+      return 2;
+
+    default:
+      return -1;
+    }
+}
+
+
+
+
+
+/* When all the inputs are FITS images (or numbers) and all the operators
+   are element-wise (including 'where', with three operands), each row of
+   the output only depends on the same row of the inputs. This is also the
+   case for the multi-operand operators that are used for stacking (like
+   'mean' or 'sigclip-median'). In this case (with '--streamrows'), the
+   inputs can be read and the output written in blocks of rows, so the
+   full images are never in memory. This function checks if this is
+   possible and if so, returns the size of the images (that should be the
+   same) and their dimensions in 'ndim'. Otherwise, it will return NULL.
+
+   To know the number of operands of the multi-operand operators, the
+   stack of operands is emulated with a list of values: numbers keep their
+   value, other operands (images or results of operators) are NaN. */
+static size_t *
+arithmetic_stream_dsize(struct arithmeticparams *p, size_t *ndim)
+{
+  double value;
+  int inlib, operator, numparams, stream=1;
+  gal_list_str_t *token;
+  gal_data_t *number;
+  gal_list_f64_t *stack=NULL;
+  gal_list_str_t *hdus=p->hdus;
+  char *hdu, *loadcol=GAL_ARITHMETIC_OPSTR_LOADCOL_PREFIX;
+  size_t i, nd, *dsize, *out=NULL, num_operands;
+
+  /* When all the operands should be written, don't stream. */
+  if(p->writeall) return NULL;
+
+  /* Go over the tokens (similar to 'reversepolish_tokens'). */
+  for(token=p->tokens; token!=NULL && stream; token=token->next)
+    {
+      /* Writing to a file, setting names or loading columns. */
+      if( !strncmp(OPERATOR_PREFIX_TOFILE, token->v,
+                   OPERATOR_PREFIX_LENGTH_TOFILE)
+          || !strncmp(OPERATOR_PREFIX_TOFILEFREE, token->v,
+                      OPERATOR_PREFIX_LENGTH_TOFILEFREE)
+          || !strncmp(token->v, GAL_ARITHMETIC_SET_PREFIX,
+                      GAL_ARITHMETIC_SET_PREFIX_LENGTH)
+          || !strncmp(token->v, loadcol, strlen(loadcol)) )
+        stream=0;
+
+      /* FITS file: it should be an image with the same size as the other
+         images (the HDUs are taken in the same order as 'operands_add'). */
+      else if( gal_fits_file_recognized(token->v) )
+        {
+          /* Set the HDU. */
+          hdu = p->globalhdu ? p->globalhdu : (hdus ? hdus->v : NULL);
+          if(p->globalhdu==NULL && hdus) hdus=hdus->next;
+          if(hdu==NULL || gal_fits_hdu_format(token->v, hdu)!=IMAGE_HDU)
+            { stream=0; continue; }
+
+          /* Read the size. Since the inputs are read in blocks of rows
+             (along the slowest dimension), dimensions with a length of
+             1 are not acceptable. */
+          dsize=gal_fits_img_info_dim(token->v, hdu, &nd);
+          if( nd<2 || gal_dimension_remove_extra(nd, dsize, NULL)!=nd )
+            { free(dsize); stream=0; continue; }
+
+          /* Compare with the previous image(s). */
+          if(out)
+            {
+              if(nd!=*ndim) stream=0;
+              else
+                for(i=0;i<nd;++i)
+                  if(dsize[i]!=out[i]) stream=0;
+              free(dsize);
+            }
+          else { out=dsize; *ndim=nd; }
+          gal_list_f64_add(&stack, NAN);
+        }
+
+      /* Other file formats. */
+      else if( gal_array_file_recognized(token->v) )
+        stream=0;
+
+      /* Numbers. */
+      else if( (number=gal_data_copy_string_to_number(token->v)) )
+        {
+          number=gal_data_copy_to_new_type_free(number, GAL_TYPE_FLOAT64);
+          gal_list_f64_add(&stack, *(double *)(number->array));
+          gal_data_free(number);
+        }
+
+      /* Operators: only element-wise operators can be used. */
+      else
+        {
+          operator=arithmetic_set_operator(token->v, &num_operands, &inlib);
+          if(inlib==0) { stream=0; continue; }
+
+          /* Multi-operand operators: the parameters (if any) and the
+             number of operands should be numbers on the stack. */
+          if(num_operands==(size_t)(-1))
+            {
+              numparams=arithmetic_stream_multioperand(operator);
+              if( numparams<0
+                  || gal_list_f64_number(stack) < (size_t)numparams+1 )
+                { stream=0; continue; }
+              for(i=0;i<(size_t)numparams;++i) gal_list_f64_pop(&stack);
+              value=gal_list_f64_pop(&stack);
+              if( isnan(value) || value<1 || value!=(size_t)value )
+                { stream=0; continue; }
+              num_operands=value;
+            }
+          else if( operator!=GAL_ARITHMETIC_OP_WHERE
+                   && fuse_is_elementwise(operator, num_operands)==0 )
+            { stream=0; continue; }
+
+          /* Pop the operands and put the result on the stack. */
+          if( gal_list_f64_number(stack) < num_operands )
+            { stream=0; continue; }
+          for(i=0;i<num_operands;++i) gal_list_f64_pop(&stack);
+          gal_list_f64_add(&stack, NAN);
+        }
+    }
+
+  /* There should only be a single output (with the size of the
+     images). */
+  if( stream==0 || gal_list_f64_number(stack)!=1 ) { free(out); out=NULL; }
+  gal_list_f64_free(stack);
+  return out;
+}
+
+
+
+
+
+/* Make a copy of the list of HDUs (they are popped from the list and freed
+   when each operand is read, but they are necessary for all blocks). */
+static gal_list_str_t *
+arithmetic_stream_hdus(gal_list_str_t *hdus)
+{
+  gal_list_str_t *tmp, *out=NULL;
+  for(tmp=hdus; tmp!=NULL; tmp=tmp->next)
+    gal_list_str_add(&out, tmp->v, 1);
+  gal_list_str_reverse(&out);
+  return out;
+}
+
+
+
+
+
+/* Do the operation on blocks of rows and write each block of the output
+   into the output file (see 'arithmetic_stream_dsize'). */
+static void
+arithmetic_stream(struct arithmeticparams *p, size_t ndim, size_t *dsize)
+{
+  int hasblank=0;
+  gal_data_t *block, meta;
+  fitsfile *fptr=NULL;
+  gal_list_str_t *hdus=p->hdus;
+  size_t first, numblocks=(dsize[0]-1)/p->streamrows+1;
+
+  /* Let the user know. */
+  if(!p->cp.quiet)
+    printf(" - Streaming: %zu block(s) of %zu row(s).\n", numblocks,
+           p->streamrows);
+
+  /* Go over the blocks. */
+  for(first=0; first<dsize[0]; first+=p->streamrows)
+    {
+      /* Set the rows that should be read from the inputs. */
+      p->streamfirst=first;
+      p->streamnumber = ( first + p->streamrows > dsize[0]
+                          ? dsize[0] - first
+                          : p->streamrows );
+
+      /* Parse the tokens and do the operations on this block. */
+      p->hdus=arithmetic_stream_hdus(hdus);
+      reversepolish_tokens(p);
+      block=operands_pop(p, "output");
+      gal_list_str_free(p->hdus, 1);
+
+      /* Create the output on the first block (when the output type is
+         known). For the metadata of the output, see 'reversepolish'. */
+      if(fptr==NULL)
+        {
+          memset(&meta, 0, sizeof meta);
+          meta.ndim=ndim;
+          meta.dsize=dsize;
+          meta.type=block->type;
+          meta.name=p->metaname;
+          meta.unit=p->metaunit;
+          meta.wcs=p->refdata.wcs;
+          meta.comment=p->metacomment;
+          fptr=gal_fits_img_write_rows_start(&meta, p->cp.output);
+        }
+      else if(block->type!=meta.type)
+        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to "
+              "fix the problem. The type of the block starting at row "
+              "%zu is different from the first block", __func__,
+              PACKAGE_BUGREPORT, first);
+
+      /* Write this block into the output. */
+      if(hasblank==0) hasblank=gal_blank_present(block, 0);
+      gal_fits_img_write_rows(fptr, block, first);
+      gal_data_free(block);
+    }
+
+  /* Finish the output file. */
+  gal_fits_img_write_rows_end(fptr, &meta, hasblank, NULL, PROGRAM_NAME);
+  if(!p->cp.quiet)
+    printf(" - Write (final): %s\n", p->cp.output);
+
+  /* Clean up (similar to 'reversepolish'). */
+  p->hdus=NULL;
+  p->streamnumber=0;
+  gal_list_str_free(hdus, 1);
+  free(p->refdata.dsize);
+  gal_wcs_free(p->refdata.wcs);
+  gal_list_data_free(p->setprm.named);
+  gal_list_str_free(p->tokens, 0);
+}
+
+
+
+
+
+/* This function implements the reverse polish algorithm as explained
+   in the Wikipedia page. */
+void
+reversepolish(struct arithmeticparams *p)
+{
+  char *printnum;
+  size_t ndim, *dsize;
+  struct operand *otmp;
+  gal_data_t *tmp, *data;
+
+  /* If the operation can be done on blocks of rows, do it and return. */
+  if( p->streamrows && (dsize=arithmetic_stream_dsize(p, &ndim)) )
+    {
+      arithmetic_stream(p, ndim, dsize);
+      free(dsize);
+      return;
+    }
+
+  /* Parse the tokens and do the operations. */
+  reversepolish_tokens(p);
 
 
   /* If there aren't any more operands (a variable has been set but not
@@ -1776,9 +2063,15 @@ reversepolish(struct arithmeticparams *p)
      read the contents of the file and put the resulting dataset into the
      operands 'data' element. This can happen for example if no operators
      are called and there is only one filename as an argument (which can
-     happen in scripts).*/
+     happen in scripts). Similarly, when the final operand is a fused
+     expression (with '--fuse'), it hasn't been evaluated yet.*/
   for(otmp=p->operands; otmp!=NULL; otmp=otmp->next)
-    if(otmp->data==NULL && otmp->filename)
+    if(otmp->fused)
+      {
+        otmp->data=fuse_materialize(p, otmp->fused);
+        otmp->fused=NULL;
+      }
+    else if(otmp->data==NULL && otmp->filename)
       arithmetic_final_read_file(p, otmp);
 
 
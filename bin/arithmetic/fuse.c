@@ -0,0 +1,482 @@
+/*********************************************************************
+Arithmetic - Do arithmetic operations on images.
+Arithmetic is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2015-2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <config.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <error.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <gnuastro/blank.h>
+#include <gnuastro/threads.h>
+#include <gnuastro/pointer.h>
+#include <gnuastro/dimension.h>
+#include <gnuastro/arithmetic.h>
+
+#include "main.h"
+
+#include "fuse.h"
+#include "operands.h"
+
+
+
+
+/* Tiled evaluation of element-wise operators
+   ==========================================
+
+   By default, every operator is applied on the full dataset(s) as soon
+   as it is read, so each intermediate result is a full-sized dataset
+   (that has to be allocated, possibly on an mmap'd file) and the whole
+   dataset has to pass through the CPU once for every operator.
+
+   With '--fuse', element-wise operators (where each output element only
+   depends on the same element of the input(s)) are not applied
+   immediately. Instead, a small tree is built and kept on the stack (in
+   the 'fused' element of the operand). When an operator that is not
+   element-wise (or anything else that needs the actual values) pops this
+   operand, the tree is "materialized": the output is broken into tiles
+   of 'FUSE_TILE_SIZE' elements and the whole tree is evaluated on one
+   tile after another (on multiple threads). Only the final output is
+   allocated at full size and each tile's data are re-used by the next
+   operator while they are still in the CPU's cache.
+
+   Note that this is not a single fused kernel: on each tile, every
+   operator is still a separate call to the same 'gal_arithmetic'
+   function that is used without '--fuse' (on a "view" into the full
+   datasets), which allocates a tile-sized dataset for its output. This
+   keeps the types and blank values identical to the non-tiled
+   evaluation. */
+
+
+
+
+/**********************************************************************/
+/****************            Building the tree          ***************/
+/**********************************************************************/
+/* Return 1 if the operator is element-wise (and can thus be fused). */
+int
+fuse_is_elementwise(int operator, size_t num_operands)
+{
+  /* Only operators with one or two operands are fused. */
+  if(num_operands!=1 && num_operands!=2) return 0;
+
+  /* Check the operator. */
+  switch(operator)
+    {
+    case GAL_ARITHMETIC_OP_PLUS:
+    case GAL_ARITHMETIC_OP_MINUS:
+    case GAL_ARITHMETIC_OP_MULTIPLY:
+    case GAL_ARITHMETIC_OP_DIVIDE:
+    case GAL_ARITHMETIC_OP_MODULO:
+    case GAL_ARITHMETIC_OP_LT:
+    case GAL_ARITHMETIC_OP_LE:
+    case GAL_ARITHMETIC_OP_GT:
+    case GAL_ARITHMETIC_OP_GE:
+    case GAL_ARITHMETIC_OP_EQ:
+    case GAL_ARITHMETIC_OP_NE:
+    case GAL_ARITHMETIC_OP_AND:
+    case GAL_ARITHMETIC_OP_OR:
+    case GAL_ARITHMETIC_OP_NOT:
+    case GAL_ARITHMETIC_OP_BITAND:
+    case GAL_ARITHMETIC_OP_BITOR:
+    case GAL_ARITHMETIC_OP_BITXOR:
+    case GAL_ARITHMETIC_OP_BITLSH:
+    case GAL_ARITHMETIC_OP_BITRSH:
+    case GAL_ARITHMETIC_OP_BITNOT:
+    case GAL_ARITHMETIC_OP_ABS:
+    case GAL_ARITHMETIC_OP_POW:
+    case GAL_ARITHMETIC_OP_SQRT:
+    case GAL_ARITHMETIC_OP_LOG:
+    case GAL_ARITHMETIC_OP_LOG10:
+    case GAL_ARITHMETIC_OP_SIN:
+    case GAL_ARITHMETIC_OP_COS:
+    case GAL_ARITHMETIC_OP_TAN:
+    case GAL_ARITHMETIC_OP_ASIN:
+    case GAL_ARITHMETIC_OP_ACOS:
+    case GAL_ARITHMETIC_OP_ATAN:
+    case GAL_ARITHMETIC_OP_ATAN2:
+    case GAL_ARITHMETIC_OP_SINH:
+    case GAL_ARITHMETIC_OP_COSH:
+    case GAL_ARITHMETIC_OP_TANH:
+    case GAL_ARITHMETIC_OP_ASINH:
+    case GAL_ARITHMETIC_OP_ACOSH:
+    case GAL_ARITHMETIC_OP_ATANH:
+    case GAL_ARITHMETIC_OP_TO_UINT8:
+    case GAL_ARITHMETIC_OP_TO_INT8:
+    case GAL_ARITHMETIC_OP_TO_UINT16:
+    case GAL_ARITHMETIC_OP_TO_INT16:
+    case GAL_ARITHMETIC_OP_TO_UINT32:
+    case GAL_ARITHMETIC_OP_TO_INT32:
+    case GAL_ARITHMETIC_OP_TO_UINT64:
+    case GAL_ARITHMETIC_OP_TO_INT64:
+    case GAL_ARITHMETIC_OP_TO_FLOAT32:
+    case GAL_ARITHMETIC_OP_TO_FLOAT64:
+      return 1;
+
+    default:
+      return 0;
+    }
+
+  /* Control should not reach here. */
+  return 0;
+}
+
+
+
+
+
+static struct fuse_node *
+fuse_node_alloc()
+{
+  struct fuse_node *node;
+
+  /* Allocate the node and initialize it. */
+  errno=0;
+  node=malloc(sizeof *node);
+  if(node==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'node'",
+          __func__, sizeof *node);
+  node->flags=0;
+  node->numop=0;
+  node->ref=NULL;
+  node->data=NULL;
+  node->left=NULL;
+  node->right=NULL;
+  node->operator=GAL_ARITHMETIC_OP_INVALID;
+  return node;
+}
+
+
+
+
+
+/* Put an already evaluated dataset into a leaf of the tree. */
+struct fuse_node *
+fuse_leaf(gal_data_t *data)
+{
+  struct fuse_node *node=fuse_node_alloc();
+  node->data=data;
+  node->ref=data;
+  return node;
+}
+
+
+
+
+
+/* Free the tree and all the datasets in its leaves. */
+static void
+fuse_free(struct fuse_node *node)
+{
+  if(node->left)  fuse_free(node->left);
+  if(node->right) fuse_free(node->right);
+  if(node->data)  gal_data_free(node->data);
+  free(node);
+}
+
+
+
+
+
+/* Add an element-wise operator to the top operand(s) of the stack
+   without evaluating it. */
+void
+fuse_operator(struct arithmeticparams *p, int operator, char *token,
+              size_t num_operands, int flags)
+{
+  struct fuse_node *node, *l, *r=NULL;
+
+  /* Pop the operand(s). Recall that the stack is last-in-first-out, so
+     the second operand is popped first. */
+  if(num_operands==2) r=operands_pop_fused(p, token);
+  l=operands_pop_fused(p, token);
+
+  /* If the non-number operands don't have the same size, they can't be
+     fused. In this case, we'll evaluate them and call the library like
+     the non-fused operators (so it reports the problem). */
+  if( r && l->ref->size>1 && r->ref->size>1
+      && gal_dimension_is_different(l->ref, r->ref) )
+    {
+      operands_add(p, NULL, gal_arithmetic(operator, p->cp.numthreads,
+                                           flags, fuse_materialize(p, l),
+                                           fuse_materialize(p, r)));
+      return;
+    }
+
+  /* Put the new operator on top of the operand(s). */
+  node=fuse_node_alloc();
+  node->left=l;
+  node->right=r;
+  node->flags=flags;
+  node->operator=operator;
+  node->numop = 1 + l->numop + (r ? r->numop : 0);
+  node->ref = (r && l->ref->size==1) ? r->ref : l->ref;
+
+  /* Put the tree back on the stack. */
+  operands_add_fused(p, node);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/**********************************************************************/
+/****************          Evaluating the tree          ***************/
+/**********************************************************************/
+struct fuse_params
+{
+  int                 flags;  /* Flags for the operators on each tile.  */
+  gal_data_t           *out;  /* Full-sized output dataset.             */
+  struct fuse_node    *root;  /* Top node of the tree.                  */
+};
+
+
+
+
+
+/* Evaluate the tree without tiles (each operator on the full datasets):
+   this is used when tiling will not help (for example when there is
+   only one operator). */
+static gal_data_t *
+fuse_direct(struct arithmeticparams *p, struct fuse_node *node)
+{
+  gal_data_t *l, *r=NULL, *out;
+
+  /* Evaluate this node. Note that the 'flags' of each node contain the
+     'GAL_ARITHMETIC_FLAG_FREE' flag (like the non-fused operators), so
+     the datasets of the operands will be freed within the library. */
+  if(node->operator==GAL_ARITHMETIC_OP_INVALID)
+    out=node->data;
+  else
+    {
+      l=fuse_direct(p, node->left);
+      if(node->right) r=fuse_direct(p, node->right);
+      out=gal_arithmetic(node->operator, p->cp.numthreads, node->flags,
+                         l, r, NULL, NULL);
+    }
+
+  /* Clean up and return. */
+  free(node);
+  return out;
+}
+
+
+
+
+
+/* Set the blank flags of the single-valued leaves (that are directly
+   used by all the threads). Without this, they would be set within each
+   thread by the library. */
+static void
+fuse_check_numbers(struct fuse_node *node)
+{
+  if(node->left)  fuse_check_numbers(node->left);
+  if(node->right) fuse_check_numbers(node->right);
+  if(node->data && node->data->size==1) gal_blank_present(node->data, 1);
+}
+
+
+
+
+
+/* Put a "view" into 'size' elements of 'in' (starting from 'start') into
+   'view'. The view doesn't own its array, so it must not be freed. */
+static void
+fuse_view(gal_data_t *in, gal_data_t *view, size_t start, size_t *size)
+{
+  memset(view, 0, sizeof *view);
+  view->ndim=1;
+  view->dsize=size;
+  view->size=*size;
+  view->type=in->type;
+  view->flag=in->flag;
+  view->minmapsize=-1;
+  view->quietmmap=in->quietmmap;
+  view->array=gal_pointer_increment(in->array, start, in->type);
+}
+
+
+
+
+
+static gal_data_t *
+fuse_tile(struct fuse_node *node, size_t start, size_t *size, int flags);
+
+/* Return the dataset to use for an operand of a tile: single values are
+   used directly, other leaves are viewed and operators are evaluated. */
+static gal_data_t *
+fuse_tile_operand(struct fuse_node *node, size_t start, size_t *size,
+                  int flags, gal_data_t *view)
+{
+  if(node->operator!=GAL_ARITHMETIC_OP_INVALID)
+    return fuse_tile(node, start, size, flags);
+  if(node->data->size==1)
+    return node->data;
+  fuse_view(node->data, view, start, size);
+  return view;
+}
+
+
+
+
+
+/* Evaluate the tree on 'size' elements starting from 'start'. */
+static gal_data_t *
+fuse_tile(struct fuse_node *node, size_t start, size_t *size, int flags)
+{
+  int lown, rown;
+  gal_data_t lv, rv, *l, *r=NULL, *out;
+
+  /* Prepare the operand(s) and apply the operator. */
+  l=fuse_tile_operand(node->left, start, size, flags, &lv);
+  if(node->right)
+    r=fuse_tile_operand(node->right, start, size, flags, &rv);
+  out=gal_arithmetic(node->operator, 1, flags, l, r, NULL, NULL);
+
+  /* Only the operands that were evaluated here (not leaves) belong to
+     this function. Some operators may return their input (when there is
+     nothing to do), in this case, if the input is not ours, we'll need a
+     copy. */
+  lown = node->left->operator!=GAL_ARITHMETIC_OP_INVALID;
+  rown = r && node->right->operator!=GAL_ARITHMETIC_OP_INVALID;
+  if( (out==l && !lown) || (r && out==r && !rown) )
+    out=gal_data_copy(out);
+  if(lown && l!=out) gal_data_free(l);
+  if(rown && r!=out) gal_data_free(r);
+  return out;
+}
+
+
+
+
+
+/* Evaluate the tiles that are assigned to this thread and put them in
+   the output. */
+static void *
+fuse_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct fuse_params *fp=(struct fuse_params *)(tprm->params);
+
+  size_t i, start, size;
+  gal_data_t *tile, *out=fp->out;
+
+  /* Go over all the tiles that are assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Set the range of this tile (the last one may be smaller). Note
+         that the first tile has already been evaluated in
+         'fuse_materialize'. */
+      start = (tprm->indexs[i]+1) * FUSE_TILE_SIZE;
+      size  = ( start + FUSE_TILE_SIZE > out->size
+                ? out->size - start
+                : FUSE_TILE_SIZE );
+
+      /* Evaluate the tree on this tile and copy it into the output. */
+      tile=fuse_tile(fp->root, start, &size, fp->flags);
+      if(tile->type!=out->type)
+        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to "
+              "fix the problem. The type of a tile (%s) is different "
+              "from the output (%s)", __func__, PACKAGE_BUGREPORT,
+              gal_type_name(tile->type, 1), gal_type_name(out->type, 1));
+      memcpy(gal_pointer_increment(out->array, start, out->type),
+             tile->array, size*gal_type_sizeof(out->type));
+      gal_data_free(tile);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Evaluate the tree and return the final dataset. */
+gal_data_t *
+fuse_materialize(struct arithmeticparams *p, struct fuse_node *node)
+{
+  size_t size, numtiles;
+  gal_data_t *tile, *out;
+  struct fuse_params fp;
+
+  /* A leaf is already evaluated. */
+  if(node->operator==GAL_ARITHMETIC_OP_INVALID)
+    {
+      out=node->data;
+      free(node);
+      return out;
+    }
+
+  /* When there is only one operator or the dataset is too small for more
+     than one tile, tiling will not help. */
+  if(node->numop==1 || node->ref->size < 2*FUSE_TILE_SIZE)
+    return fuse_direct(p, node);
+
+  /* On each tile, the inputs should not be freed or modified and the
+     datasets are only views. */
+  fp.root=node;
+  fp.flags = node->flags & ~( GAL_ARITHMETIC_FLAG_FREE
+                              | GAL_ARITHMETIC_FLAG_INPLACE );
+  fuse_check_numbers(node);
+
+  /* Evaluate the first tile on this thread: its type is the type of the
+     output (any warnings of the operators are also printed here, the
+     other tiles are evaluated quietly). */
+  size=FUSE_TILE_SIZE;
+  tile=fuse_tile(node, 0, &size, fp.flags);
+  out=gal_data_alloc(NULL, tile->type, node->ref->ndim, node->ref->dsize,
+                     node->ref->wcs, 0, p->cp.minmapsize, p->cp.quietmmap,
+                     NULL, NULL, NULL);
+  memcpy(out->array, tile->array, size*gal_type_sizeof(out->type));
+  gal_data_free(tile);
+
+  /* Evaluate the remaining tiles on multiple threads (the size of the
+     input is at least two tiles, see above). */
+  fp.out=out;
+  fp.flags |= GAL_ARITHMETIC_FLAG_QUIET;
+  numtiles = out->size/FUSE_TILE_SIZE + (out->size%FUSE_TILE_SIZE ? 1 : 0);
+  gal_threads_spin_off(fuse_on_thread, &fp, numtiles-1, p->cp.numthreads,
+                       p->cp.minmapsize, p->cp.quietmmap);
+
+  /* Clean up and return. */
+  fuse_free(node);
+  return out;
+}
@@ -0,0 +1,57 @@
+/*********************************************************************
+Arithmetic - Do arithmetic operations on images.
+Arithmetic is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2015-2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#ifndef FUSE_H
+#define FUSE_H
+
+/* Number of elements in each tile of a fused expression. All the
+   intermediate values of one tile should fit in the CPU's cache. */
+#define FUSE_TILE_SIZE 16384
+
+/* Each node of a fused (not yet evaluated) expression. Leaves only have
+   a dataset ('data'), other nodes have an operator and one or two
+   operands (the 'left' operand is the first one that was given). */
+struct fuse_node
+{
+  int              operator;  /* Operator (=0 for leaves).              */
+  int                 flags;  /* Flags to pass to 'gal_arithmetic'.     */
+  gal_data_t          *data;  /* Dataset of a leaf (NULL otherwise).    */
+  gal_data_t           *ref;  /* Largest leaf (for output dimensions).  */
+  size_t              numop;  /* Number of operators in this tree.      */
+  struct fuse_node    *left;  /* First operand.                         */
+  struct fuse_node   *right;  /* Second operand (NULL when unary).      */
+};
+
+int
+fuse_is_elementwise(int operator, size_t num_operands);
+
+struct fuse_node *
+fuse_leaf(gal_data_t *data);
+
+void
+fuse_operator(struct arithmeticparams *p, int operator, char *token,
+              size_t num_operands, int flags);
+
+gal_data_t *
+fuse_materialize(struct arithmeticparams *p, struct fuse_node *node);
+
+#endif
@@ -50,14 +50,15 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 
-/* In every node of the operand linked list, only one of the 'filename' or
-   'data' should be non-NULL. Otherwise it will be a bug and will cause
-   problems. All the operands operate on this premise. */
+/* In every node of the operand linked list, only one of the 'filename',
+   'data' or 'fused' should be non-NULL. Otherwise it will be a bug and
+   will cause problems. All the operands operate on this premise. */
 struct operand
 {
   char       *filename;    /* !=NULL if the operand is a filename. */
   char            *hdu;    /* !=NULL if the operand is a filename. */
   gal_data_t     *data;    /* !=NULL if the operand is a dataset.  */
+  struct fuse_node *fused; /* !=NULL if not yet evaluated (fused). */
   struct operand *next;    /* Pointer to next operand.             */
 };
 
@@ -86,6 +87,8 @@ struct arithmeticparams
   char           *metaunit;  /* FITS name (BUNIT keyword) of output.    */
   char        *metacomment;  /* FITS comment of output.                 */
   uint8_t         writeall;  /* Write all outputs.                      */
+  uint8_t             fuse;  /* Fuse element-wise operators.            */
+  size_t        streamrows;  /* Number of rows in each streamed block.  */
 
   /* Operating mode: */
   int        wcs_collapsed;  /* If the internal WCS is already collapsed.*/
@@ -95,6 +98,8 @@ struct arithmeticparams
   struct operand *operands;  /* The operands linked list.               */
   int     outnamerequested;  /* ==1 if the user has given '--otuput'.   */
   time_t           rawtime;  /* Starting time of the program.           */
+  size_t       streamfirst;  /* First row of the current streamed block.*/
+  size_t      streamnumber;  /* Number of rows in current block (or 0). */
 };
 
 
@@ -38,6 +38,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include "main.h"
 
+#include "fuse.h"
 #include "operands.h"
 
 
@@ -108,6 +109,7 @@ operands_add_list(struct arithmeticparams *p, gal_data_t *data)
       /* Set the basic parameters. */
       newnode->data=tmp;
       newnode->hdu=NULL;
+      newnode->fused=NULL;
       newnode->filename=NULL;
       newnode->data->next=NULL;
 
@@ -147,6 +149,7 @@ operands_add(struct arithmeticparams *p, char *filename, gal_data_t *data)
       if(newnode==NULL)
         error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'newnode'",
               __func__, sizeof *newnode);
+      newnode->fused=NULL;
 
       /* If the 'filename' is the name of a dataset, then use a copy of it.
          otherwise, do the basic analysis. */
@@ -240,10 +243,20 @@ operands_pop(struct arithmeticparams *p, char *operator)
       hdu=operands->hdu;
       filename=operands->filename;
 
-      /* Read the dataset and remove possibly extra dimensions. */
-      data=gal_array_read_one_ch(filename, hdu, NULL, p->cp.minmapsize,
-                                 p->cp.quietmmap);
-      data->ndim=gal_dimension_remove_extra(data->ndim, data->dsize, NULL);
+      /* Read the dataset and remove possibly extra dimensions. When
+         streaming (see 'arithmetic_stream'), only the rows of the
+         current block are read (the inputs have no extra dimensions). */
+      if(p->streamnumber)
+        data=gal_fits_img_read_rows(filename, hdu, p->streamfirst,
+                                    p->streamnumber, p->cp.minmapsize,
+                                    p->cp.quietmmap);
+      else
+        {
+          data=gal_array_read_one_ch(filename, hdu, NULL,
+                                     p->cp.minmapsize, p->cp.quietmmap);
+          data->ndim=gal_dimension_remove_extra(data->ndim, data->dsize,
+                                                NULL);
+        }
 
       /* When the reference data structure's dimensionality is non-zero, it
          means that this is not the first image read. So, write its basic
@@ -268,8 +281,10 @@ operands_pop(struct arithmeticparams *p, char *operator)
             p->refdata.dsize[i]=data->dsize[i];
         }
 
-      /* Report the read image if desired: */
-      if(!p->cp.quiet) printf(" - Read: %s (hdu %s).\n", filename, hdu);
+      /* Report the read image if desired (only for the first block when
+         streaming): */
+      if(!p->cp.quiet && p->streamfirst==0)
+        printf(" - Read: %s (hdu %s).\n", filename, hdu);
 
       /* Free the HDU string: */
       if(hdu) free(hdu);
@@ -277,6 +292,8 @@ operands_pop(struct arithmeticparams *p, char *operator)
       /* Add to the number of popped FITS images: */
       ++p->popcounter;
     }
+  else if(operands->fused)
+    data=fuse_materialize(p, operands->fused);
   else
     data=operands->data;
 
@@ -297,6 +314,56 @@ operands_pop(struct arithmeticparams *p, char *operator)
 
 
 
+/* Add an expression that hasn't been evaluated yet (see 'fuse.c') to the
+   top of the stack. */
+void
+operands_add_fused(struct arithmeticparams *p, struct fuse_node *node)
+{
+  struct operand *newnode;
+
+  /* Allocate space for the new operand. */
+  errno=0;
+  newnode=malloc(sizeof *newnode);
+  if(newnode==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'newnode'",
+          __func__, sizeof *newnode);
+
+  /* Set the basic parameters and add it to the top of the stack. */
+  newnode->hdu=NULL;
+  newnode->data=NULL;
+  newnode->fused=node;
+  newnode->filename=NULL;
+  newnode->next=p->operands;
+  p->operands=newnode;
+}
+
+
+
+
+
+/* Pop the top operand without evaluating it: if it is not already an
+   expression that hasn't been evaluated, it will be put in a leaf. */
+struct fuse_node *
+operands_pop_fused(struct arithmeticparams *p, char *operator)
+{
+  struct operand *operands=p->operands;
+  struct fuse_node *out;
+
+  /* If the top operand isn't fused, pop it like a normal dataset. */
+  if(operands==NULL || operands->fused==NULL)
+    return fuse_leaf(operands_pop(p, operator));
+
+  /* Remove this node from the stack and return the expression. */
+  out=operands->fused;
+  p->operands=operands->next;
+  free(operands);
+  return out;
+}
+
+
+
+
+
 /* Wrapper to use the 'operands_pop' function with the 'set-' operator. */
 gal_data_t *
 operands_pop_wrapper_set(void *in)
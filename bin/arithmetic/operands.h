@@ -35,6 +35,12 @@ operands_pop(struct arithmeticparams *p, char *operator);
 gal_data_t *
 operands_pop_wrapper_set(void *in);
 
+void
+operands_add_fused(struct arithmeticparams *p, struct fuse_node *node);
+
+struct fuse_node *
+operands_pop_fused(struct arithmeticparams *p, char *operator);
+
 void
 operands_set_name(struct arithmeticparams *p, char *token);
 
@@ -174,6 +174,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "convmethod",
+      UI_KEY_CONVMETHOD,
+      "STR",
+      0,
+      "Spatial: 'direct', 'separable', 'fft', 'auto'.",
+      GAL_OPTIONS_GROUP_OPERATING_MODE,
+      &p->convmethodstr,
+      GAL_TYPE_STRING,
+      GAL_OPTIONS_RANGE_ANY,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
     {
       "makekernel",
       UI_KEY_MAKEKERNEL,
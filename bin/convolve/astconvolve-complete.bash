@@ -124,6 +124,11 @@ _gnuastro_autocomplete_astconvolve_option_value(){
                 "spatial frequency" "$current"
             ;;
 
+        --convmethod)
+            _gnuastro_autocomplete_compreply_from_string \
+                "direct separable fft auto" "$current"
+            ;;
+
         --numthreads)
             _gnuastro_autocomplete_compreply_numthreads "$current"
             ;;
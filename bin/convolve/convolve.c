@@ -797,10 +797,11 @@ convolve(struct convolveparams *p)
          want to do spatial domain convolution with this Convolve program
          is edge correction. So by default we assume it and will only
          ignore it if the user asks.*/
-      out=gal_convolve_spatial(multidim ? cp->tl.tiles : p->input, p->kernel,
-                               cp->numthreads,
-                               multidim ? !p->noedgecorrection : 1,
-                               multidim ? cp->tl.workoverch : 1 );
+      out=gal_convolve_spatial_method(multidim ? cp->tl.tiles : p->input,
+                                      p->kernel, cp->numthreads,
+                                      multidim ? !p->noedgecorrection : 1,
+                                      multidim ? cp->tl.workoverch : 1,
+                                      p->convmethod);
 
       /* Clean up: free the actual input and replace it's pointer with the
          convolved dataset to save as output. */
@@ -81,6 +81,7 @@ struct convolveparams
   double        minsharpspec;  /* Deconvolution: min spect. of sharp img. */
   uint8_t     checkfreqsteps;  /* View the frequency domain steps.        */
   char            *domainstr;  /* String value specifying domain.         */
+  char        *convmethodstr;  /* Method of spatial convolution.          */
   size_t          makekernel;  /* Make a kernel to create input.          */
   uint8_t   noedgecorrection;  /* Do not correct spatial edge effects.    */
 
@@ -88,6 +89,7 @@ struct convolveparams
   int                 isfits;  /* Input is a FITS file.                   */
   int               hdu_type;  /* Type of HDU (image or table).           */
   int                 domain;  /* Frequency or spatial domain conv.       */
+  int             convmethod;  /* Code of spatial convolution method.     */
   gal_data_t          *input;  /* Input image array.                      */
   gal_data_t         *kernel;  /* Input Kernel array.                     */
   double               *pimg;  /* Padded image array.                     */
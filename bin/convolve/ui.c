@@ -35,6 +35,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/table.h>
 #include <gnuastro/array.h>
 #include <gnuastro/threads.h>
+#include <gnuastro/convolve.h>
 #include <gnuastro/arithmetic.h>
 #include <gnuastro/statistics.h>
 
@@ -223,6 +224,14 @@ ui_read_check_only_options(struct convolveparams *p)
           "either 'spatial' or 'frequency'", p->domainstr);
 
 
+  /* Read the spatial convolution method (by default, every pixel is
+     convolved directly). */
+  if(p->convmethodstr)
+    p->convmethod=gal_convolve_spatial_method_from_string(p->convmethodstr);
+  else
+    p->convmethod=GAL_CONVOLVE_SPATIAL_DIRECT;
+
+
   /* If we are in the spatial domain, make sure that the necessary
      parameters are set. */
   if( p->domain==CONVOLVE_DOMAIN_SPATIAL )
@@ -51,6 +51,7 @@ enum kdtree_modes
   MATCH_KDTREE_INTERNAL,
   MATCH_KDTREE_DISABLE,
   MATCH_KDTREE_FILE,
+  MATCH_KDTREE_SKY,
 };
 
 
@@ -571,7 +571,7 @@ match_catalog_kdtree_build(struct matchparams *p)
   /* Construct a k-d tree from 'p->cols1': the index of root is stored in
      'root'. */
   if(!p->cp.quiet) gettimeofday(&t1, NULL);
-  kdtree = gal_kdtree_create(p->cols1, &root);
+  kdtree = gal_kdtree_create(p->cols1, &root, p->cp.numthreads, 0);
   if(!p->cp.quiet)
     {
       if( asprintf(&msg, "k-d tree constructed (%zu rows).",
@@ -628,7 +628,8 @@ match_catalog_kdtree(struct matchparams *p, size_t *nummatched)
       if(p->kdtreemode==MATCH_KDTREE_INTERNAL)
         {
           if(!p->cp.quiet) gettimeofday(&t1, NULL);
-          p->kdtreedata = gal_kdtree_create(p->cols1, &p->kdtreeroot);
+          p->kdtreedata = gal_kdtree_create(p->cols1, &p->kdtreeroot,
+                                            p->cp.numthreads, 0);
           if(!p->cp.quiet)
             gal_timing_report(&t1, "Internal k-d tree constructed.", 1);
         }
@@ -654,6 +655,26 @@ match_catalog_kdtree(struct matchparams *p, size_t *nummatched)
       gal_list_data_free(p->kdtreedata);
       break;
 
+    /* Match on the sphere with a separate k-d tree in each sky cell. */
+    case MATCH_KDTREE_SKY:
+      if(!p->cp.quiet)
+        {
+          gettimeofday(&t1, NULL);
+          printf("  - Match using sky cells ...\n");
+        }
+      out = gal_match_sky_cells(p->cols1, p->cols2, p->aperture->array,
+                                p->cp.numthreads, p->cp.minmapsize,
+                                p->cp.quietmmap, nummatched);
+      if(!p->cp.quiet)
+        {
+          if( asprintf(&msg, "... %zu matches found, done!",
+                       *nummatched)<0 )
+            error(EXIT_FAILURE, errno, "asprintf allocation");
+          gal_timing_report(&t1, msg, 1);
+          free(msg);
+        }
+      break;
+
     /* Abort if the mode isn't recognized (its a bug!). */
     default:
       error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
@@ -225,14 +225,16 @@ ui_read_check_only_options(struct matchparams *p)
     if(      !strcmp(p->kdtree,"build")    ) p->kdtreemode=MATCH_KDTREE_BUILD;
     else if( !strcmp(p->kdtree,"internal") ) p->kdtreemode=MATCH_KDTREE_INTERNAL;
     else if( !strcmp(p->kdtree,"disable")  ) p->kdtreemode=MATCH_KDTREE_DISABLE;
+    else if( !strcmp(p->kdtree,"sky")      ) p->kdtreemode=MATCH_KDTREE_SKY;
     else if( gal_fits_name_is_fits(p->kdtree) ) p->kdtreemode=MATCH_KDTREE_FILE;
     else
       error(EXIT_FAILURE, 0, "'%s' is not valid for '--kdtree'. The "
             "following values are accepted: 'build' (to build the k-d tree in "
             "the file given to '--output'), 'internal' (to force internal "
             "usage of a k-d tree for the matching), 'disable' (to not use a "
-            "k-d tree at all), a FITS file name (the file to read a created "
-            "k-d tree from)", p->kdtree);
+            "k-d tree at all), 'sky' (to match RA and Dec on the sphere "
+            "with a separate k-d tree in each cell of the sky), a FITS file "
+            "name (the file to read a created k-d tree from)", p->kdtree);
 
     /* Make sure that the k-d tree build mode is not called with
        '--outcols'. */
@@ -681,6 +683,20 @@ ui_set_columns_sanity_check_read_aperture(struct matchparams *p)
           "dimension). Please run the following command for more "
           "information.\n\n    $ info %s\n", PROGRAM_EXEC);
 
+  /* The sky-cell matching is only for RA and Dec with a circular
+     aperture. */
+  if( p->kdtreemode==MATCH_KDTREE_SKY )
+    {
+      if(ccol1n!=2)
+        error(EXIT_FAILURE, 0, "'--kdtree=sky' needs two coordinate "
+              "columns (RA and Dec, in degrees), but %zu are given",
+              ccol1n);
+      if( ((double *)(p->aperture->array))[1]!=1.0 )
+        error(EXIT_FAILURE, 0, "'--kdtree=sky' only accepts a circular "
+              "aperture (with a single value given to '--aperture': its "
+              "radius in degrees)");
+    }
+
   /* Return the number of dimensions. */
   return ccol1n;
 }
@@ -893,6 +909,7 @@ ui_read_columns(struct matchparams *p)
   if( !p->cp.quiet
       && p->kdtreemode!=MATCH_KDTREE_BUILD
       && p->kdtreemode!=MATCH_KDTREE_DISABLE
+      && p->kdtreemode!=MATCH_KDTREE_SKY
       && p->cols1->size > (2*p->cols2->size) )
     error(EXIT_SUCCESS, 0, "TIP: the matching speed will GREATLY IMPROVE "
           "if you swap the two inputs. Currently the second input has "
@@ -1233,7 +1250,9 @@ ui_read_check_inputs_setup(int argc, char *argv[], struct matchparams *p)
              ( p->kdtreemode==MATCH_KDTREE_DISABLE
                ? " (sort-based match only uses a single thread)" : ""));
       printf("  - Match algorithm: %s\n",
-             p->kdtree ? "k-d tree" : "sort-based");
+             ( p->kdtreemode==MATCH_KDTREE_SKY
+               ? "sky cells (k-d tree in each cell)"
+               : p->kdtree ? "k-d tree" : "sort-based" ));
       printf("  - Input-1: %s; %zu rows\n",
              gal_fits_name_save_as_string(p->input1name, p->cp.hdu),
              p->cols1->size);
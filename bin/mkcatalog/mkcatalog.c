@@ -793,14 +793,25 @@ mkcatalog_write_outputs(struct mkcatalogparams *p)
 void
 mkcatalog(struct mkcatalogparams *p)
 {
+  size_t i, *costs;
+
   /* When more than one thread is to be used, initialize the mutex: we need
      it to assign a column to the clumps in the final catalog. */
   if( p->cp.numthreads > 1 ) pthread_mutex_init(&p->mutex, NULL);
 
+  /* The time to measure each object is roughly proportional to the
+     number of pixels in its tile, and this can differ by orders of
+     magnitude between objects (for example a large galaxy and a faint
+     source). So the objects are distributed between the threads
+     dynamically, with the largest objects starting first. */
+  costs=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numobjects, 0, __func__,
+                             "costs");
+  for(i=0;i<p->numobjects;++i) costs[i]=p->tiles[i].size;
+
   /* Do the processing on each thread. */
-  gal_threads_spin_off(mkcatalog_single_object, p, p->numobjects,
-                       p->cp.numthreads, p->cp.minmapsize,
-                       p->cp.quietmmap);
+  gal_threads_spin_off_dynamic(mkcatalog_single_object, p, p->numobjects,
+                               p->cp.numthreads, costs);
+  free(costs);
 
   /* Post-thread processing, for example to convert image coordinates to RA
      and Dec. */
@@ -230,6 +230,20 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_SET,
       ui_parse_coordinate_mode
     },
+    {
+      "integration",
+      UI_KEY_INTEGRATION,
+      "STR",
+      0,
+      "Integ. in central pixels: 'random', 'cubature'.",
+      UI_GROUP_PROFILES,
+      &p->integration,
+      GAL_TYPE_STRING,
+      GAL_OPTIONS_RANGE_ANY,
+      GAL_OPTIONS_MANDATORY,
+      GAL_OPTIONS_NOT_SET,
+      ui_parse_integration
+    },
     {
       "numrandom",
       UI_KEY_NUMRANDOM,
@@ -269,6 +283,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "cubtolerance",
+      UI_KEY_CUBTOLERANCE,
+      "FLT",
+      0,
+      "Relative accuracy of cubature in each pixel.",
+      UI_GROUP_PROFILES,
+      &p->cubtolerance,
+      GAL_TYPE_FLOAT32,
+      GAL_OPTIONS_RANGE_GT_0_LT_1,
+      GAL_OPTIONS_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
     {
       "tunitinp",
       UI_KEY_TUNITINP,
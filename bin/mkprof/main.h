@@ -56,6 +56,17 @@ enum coord_modes
 
 
 
+/* Methods to integrate the profile over the central pixels. */
+enum integration_methods
+{
+  MKPROF_INTEG_INVALID,         /* For sanity checks.                */
+
+  MKPROF_INTEG_RANDOM,          /* Monte Carlo integration.          */
+  MKPROF_INTEG_CUBATURE,        /* Deterministic adaptive cubature.  */
+};
+
+
+
 /* Types of profiles. */
 enum profile_types
 {
@@ -104,8 +115,6 @@ struct builtqueue
   int        indivcreated;    /* ==1: an individual file is created. */
   size_t          numaccu;    /* Number of accurate pixels.          */
   double         accufrac;    /* Difference of accurate values.      */
-
-  struct builtqueue *next;    /* Pointer to next element.            */
 };
 
 
@@ -133,6 +142,8 @@ struct mkprofparams
   char             *typestr;  /* Type of finally merged output image.     */
   size_t          numrandom;  /* Number of radom points for integration.  */
   float           tolerance;  /* Accuracy to stop integration.            */
+  uint8_t       integration;  /* Integration method (random or cubature). */
+  float        cubtolerance;  /* Relative accuracy of cubature in a pixel.*/
   uint8_t          tunitinp;  /* ==1: Truncation is in pixels, not radial.*/
   size_t             *shift;  /* Shift along axeses position of profiles. */
   uint8_t       prepforconv;  /* Shift and expand by size of first psf.   */
@@ -192,9 +203,10 @@ struct mkprofparams
   time_t            rawtime;  /* Starting time of the program.            */
   double               *cat;  /* Input catalog.                           */
   gal_data_t           *log;  /* Log data to be printed.                  */
-  struct builtqueue     *bq;  /* Top (last) elem of build queue.          */
-  pthread_cond_t     qready;  /* bq is ready to be written.               */
-  pthread_mutex_t     qlock;  /* Mutex lock to change builtq.             */
+  pthread_mutex_t *bandlocks;  /* One lock for each band of output rows.  */
+  size_t           numbands;  /* Number of bands in output (for locks).   */
+  pthread_mutex_t  donelock;  /* Lock to increment 'numdone'.             */
+  size_t            numdone;  /* Number of profiles that are complete.    */
   double          halfpixel;  /* Half pixel in oversampled image.         */
   char              *wcsstr;  /* The WCS keywords derived from main img.  */
   int            wcsnkeyrec;  /* The number of keywords in the WCS header.*/
@@ -67,36 +67,23 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 /**************************************************************/
-/************        builtqueue linked list       *************/
+/************            Built profile            *************/
 /**************************************************************/
-/* Add an empty element to the existing builtqueue. */
-void
-builtqueue_addempty(struct builtqueue **bq)
+/* Initialize the information of a profile that is to be built. */
+static void
+builtqueue_init(struct builtqueue *bq)
 {
-  struct builtqueue *tbq;
-
-  /* Allocate the element. */
-  errno=0;
-  tbq=malloc(sizeof *tbq);
-  if(tbq==NULL)
-    error(EXIT_FAILURE, 0, "%s: allocating %zu bytes for 'tbq'",
-          __func__, sizeof *tbq);
-
   /* Initialize the values (same order as in structure definition). */
-  tbq->id           = GAL_BLANK_SIZE_T;
-  tbq->ispsf        = 0;
-  tbq->overlaps     = 0;
-  tbq->image        = NULL;
-  tbq->overlap_i    = NULL;
-  tbq->overlap_m    = NULL;
-  tbq->func         = PROFILE_MAXIMUM_CODE;
-  tbq->indivcreated = 0;
-  tbq->numaccu      = 0;
-  tbq->accufrac     = 0.0f;
-
-  /* Set its next element to the input bq and re-set the input bq. */
-  tbq->next=*bq;
-  *bq=tbq;
+  bq->id           = GAL_BLANK_SIZE_T;
+  bq->ispsf        = 0;
+  bq->overlaps     = 0;
+  bq->image        = NULL;
+  bq->overlap_i    = NULL;
+  bq->overlap_m    = NULL;
+  bq->func         = PROFILE_MAXIMUM_CODE;
+  bq->indivcreated = 0;
+  bq->numaccu      = 0;
+  bq->accufrac     = 0.0f;
 }
 
 
@@ -117,7 +104,6 @@ builtqueue_addempty(struct builtqueue **bq)
 
 
 
-
 /**************************************************************/
 /************           Save individual           *************/
 /**************************************************************/
@@ -237,6 +223,16 @@ saveindividual(struct mkonthread *mkp)
                         &p->tolerance, 0,
                         "Tolerance level to stop random integration",
                         0, NULL, 0);
+  gal_fits_key_list_add(&keys, GAL_TYPE_STRING, "INTEGRATION", 0,
+                        ( p->integration==MKPROF_INTEG_CUBATURE
+                          ? "cubature" : "random" ), 0,
+                        "Integration method in central pixels", 0,
+                        NULL, 0);
+  if(p->integration==MKPROF_INTEG_CUBATURE)
+    gal_fits_key_list_add(&keys, GAL_TYPE_FLOAT32, "CUBTOLERANCE", 0,
+                          &p->cubtolerance, 0,
+                          "Relative accuracy of cubature in a pixel",
+                          0, NULL, 0);
   gal_fits_key_list_add(&keys, GAL_TYPE_STRING, "MODE", 0,
                         p->mode==MKPROF_MODE_IMG?"img":"wcs", 0,
                         "Coordinates in image or WCS units", 0, NULL, 0);
@@ -392,60 +388,131 @@ mkprof_build_single(struct mkonthread *mkp, long *fpixel_i, long *lpixel_i,
 
 
 
-/* The profile has been built, now add it to the queue of profiles that
-   must be written into the final merged image. */
+/* Add the built profile into the merged image. The merged image is
+   divided into bands of 'MKPROF_BAND_ROWS' rows (along the slowest
+   dimension), each with its own lock. So the building threads can
+   directly add their profiles into the merged image in parallel and will
+   only have to wait for each other when their profiles touch the same
+   band. The pixels are parsed in the same order as the full overlap
+   tile, so the returned sum of the profile's pixels in the merged image
+   (used for the log) doesn't depend on the number of threads. */
+static double
+mkprof_merge(struct mkonthread *mkp)
+{
+  struct mkprofparams *p=mkp->p;
+  gal_data_t *oi=mkp->ibq->overlap_i, *om=mkp->ibq->overlap_m;
+
+  double sum=0.0f;
+  float *iarray=oi->array, *marray=om->array;
+  size_t b, r0, r1, first, last, rows=om->dsize[0], rowsize=om->size/rows;
+  size_t istride=oi->block->size/oi->block->dsize[0];
+  size_t mstride=om->block->size/om->block->dsize[0];
+
+  /* Rows of the merged image that this profile overlaps with. */
+  first = ( marray - (float *)(p->out->array) ) / mstride;
+  last  = first + rows;
+
+  /* Go over the bands and add the overlapping rows of each. For the
+     duration of each band, the two overlap tiles are shrunk to only
+     cover the rows of that band. */
+  for(b=first/MKPROF_BAND_ROWS; b*MKPROF_BAND_ROWS<last; ++b)
+    {
+      /* Set the overlap tiles to only cover this band. */
+      r0 = b*MKPROF_BAND_ROWS>first ? b*MKPROF_BAND_ROWS : first;
+      r1 = (b+1)*MKPROF_BAND_ROWS<last ? (b+1)*MKPROF_BAND_ROWS : last;
+      oi->array = iarray + (r0-first)*istride;
+      om->array = marray + (r0-first)*mstride;
+      oi->dsize[0] = om->dsize[0] = r1-r0;
+      oi->size     = om->size     = (r1-r0)*rowsize;
+
+      /* Add the pixels. */
+      if(p->bandlocks) pthread_mutex_lock(&p->bandlocks[b]);
+      GAL_TILE_PO_OISET(float, float, oi, om, 1, 0, {
+          *o  = p->replace ? ( *i>*o ? *i : *o ) :  (*i + *o);
+          sum += *i;
+        });
+      if(p->bandlocks) pthread_mutex_unlock(&p->bandlocks[b]);
+    }
+
+  /* Reset the overlap tiles. */
+  oi->array=iarray;
+  om->array=marray;
+  oi->dsize[0] = om->dsize[0] = rows;
+  oi->size     = om->size     = rows*rowsize;
+  return sum;
+}
+
+
+
+
+
+/* Put the profile into the merged image (if necessary), fill its row in
+   the log, report the progress and free the built arrays. */
 static void
-mkprof_add_built_to_write_queue(struct mkonthread *mkp,
-                                struct builtqueue *ibq,
-                                struct builtqueue **fbq, size_t counter)
+mkprof_finish_single(struct mkonthread *mkp)
 {
-  struct mkprofparams *p = mkp->p;
+  struct mkprofparams *p=mkp->p;
+  struct builtqueue *ibq=mkp->ibq;
 
-  int lockresult;
-  pthread_mutex_t *qlock=&p->qlock;
-  pthread_cond_t *qready=&p->qready;
-
-  /* Try locking the mutex so no thread can change the value of p->bq. If
-     you can lock it, then put the internal builtqueue on top of the
-     general builtqueue. If you can't, continue adding to the internal
-     builtqueue (make the next profiles) until you find a chance to lock
-     the mutex. */
-  lockresult=pthread_mutex_trylock(qlock);
-  if(lockresult==0)     /* Mutex was successfully locked. */
+  double sum=0.0f;
+  char *jobname;
+  gal_data_t *log;
+  size_t clog, numdone;
+
+  /* During the build process, we also defined the overlap tiles of both
+     the individual array and the final merged array, here we will use
+     those to put the required profile pixels into the final array. */
+  if(ibq->overlaps && p->out)
+    sum=mkprof_merge(mkp);
+
+
+  /* Fill the log array (each profile has its own row, so there is no
+     need for a lock). */
+  if(p->cp.log)
     {
-      /* Add this internal queue to system queue. */
-      (*fbq)->next=p->bq;
-      p->bq=ibq;
-
-      /* If the list was empty when you locked the mutex, then either
-         'mkprof_write' is waiting behind a condition variable for you to
-         fill it up or not (either it hasn't got to setting the condition
-         variable yet (this function locked the mutex before
-         'mkprof_write') or it just got the list to be made and is busy
-         writing the arrays in the output). In either case,
-         pthread_cond_signal will work. */
-      if((*fbq)->next==NULL)
-        pthread_cond_signal(qready);
-      pthread_mutex_unlock(qlock);
-
-      /* Finally set both the internal queue and the first internal queue
-         element to NULL.*/
-      (*fbq)=NULL;
-      mkp->ibq=NULL;
+      clog=0;
+      for(log=p->log; log!=NULL; log=log->next)
+        switch(++clog)
+          {
+          case 5:
+            ((unsigned char *)(log->array))[ibq->id] = ibq->indivcreated;
+            break;
+          case 4:
+            ((float *)(log->array))[ibq->id] = ibq->accufrac;
+            break;
+          case 3:
+            ((unsigned long *)(log->array))[ibq->id]=ibq->numaccu;
+            break;
+          case 2:
+            ((float *)(log->array))[ibq->id] =
+              gal_units_counts_to_mag(sum, p->zeropoint);
+            break;
+          case 1:
+            ((unsigned long *)(log->array))[ibq->id]=ibq->id+1;
+            break;
+          }
     }
 
-  /* The mutex couldn't be locked and there are no more objects for this
-     thread to build (giving a chance for this thread to add up its built
-     profiles). So we have to lock the mutex to pass on this built
-     structure to the builtqueue. */
-  else if (mkp->indexs[counter+1]==GAL_BLANK_SIZE_T)
+
+  /* Report if in verbose mode. */
+  if(!p->cp.quiet && p->num>1)
     {
-      pthread_mutex_lock(qlock);
-      (*fbq)->next=p->bq;
-      p->bq=ibq;
-      pthread_cond_signal(qready);
-      pthread_mutex_unlock(qlock);
+      if(p->cp.numthreads>1) pthread_mutex_lock(&p->donelock);
+      numdone=++p->numdone;
+      if( asprintf(&jobname, "row %zu complete, %zu left to go",
+                   ibq->id+1, p->num-numdone)<0 )
+        error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+      gal_timing_report(NULL, jobname, 2);
+      if(p->cp.numthreads>1) pthread_mutex_unlock(&p->donelock);
+      free(jobname);
     }
+
+
+  /* Free the arrays. Note that there is no problem to free a NULL
+     pointer (when the built array didn't overlap). */
+  gal_data_free(ibq->overlap_i);
+  gal_data_free(ibq->overlap_m);
+  gal_data_free(ibq->image);
 }
 
 
@@ -486,7 +553,7 @@ mkprof_build(void *inparam)
   struct mkonthread *mkp=(struct mkonthread *)inparam;
   struct mkprofparams *p=mkp->p;
   size_t i, id, ndim=p->ndim;
-  struct builtqueue *ibq, *fbq=NULL;
+  struct builtqueue bq, *ibq=&bq;
   double center[3], semiaxes[3], euler_deg[3];
   long fpixel_i[3], lpixel_i[3], fpixel_o[3], lpixel_o[3];
 
@@ -494,16 +561,10 @@ mkprof_build(void *inparam)
   /* Make each profile that was specified for this thread. */
   for(i=0; mkp->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
     {
-      /* Create a new builtqueue element with all the information. 'fbq'
-         will be used when we want to add 'ibq' to 'p->bq'. It is defined
-         so we don't have to waste time traversing the 'ibq'. Its
-         characteristic compared to the other elements of 'ibq' is that
-         'fbq->next==NULL'. So to add ibq to p->bq, we just have to set
-         'fbq->next=p->bq' and then set 'p->bq' to 'ibq'.*/
-      builtqueue_addempty(&mkp->ibq);
-      ibq=mkp->ibq;
+      /* Initialize the information of this profile. */
+      builtqueue_init(ibq);
+      mkp->ibq=ibq;
       id=ibq->id=mkp->indexs[i];
-      if(fbq==NULL) fbq=ibq;
 
 
       /* Write the necessary parameters for this profile into 'mkp'.*/
@@ -563,18 +624,15 @@ mkprof_build(void *inparam)
         mkprof_build_single(mkp, fpixel_i, lpixel_i, fpixel_o);
 
 
-      /* Add this profile to the list of profiles that must be written onto
-         the final merged image with another thread. */
-      if(p->cp.numthreads>1)
-        mkprof_add_built_to_write_queue(mkp, ibq, &fbq, i);
+      /* Add this profile to the merged image and the log. */
+      mkprof_finish_single(mkp);
     }
 
   /* Free the allocated space for this thread and wait until all other
      threads finish. */
   gsl_rng_free(mkp->rng);
-  if(p->cp.numthreads==1)
-    p->bq=mkp->ibq;
-  else
+  mkp->ibq=NULL;
+  if(p->cp.numthreads>1)
     pthread_barrier_wait(mkp->b);
 
   return NULL;
@@ -602,98 +660,14 @@ mkprof_build(void *inparam)
 /**************************************************************/
 /************              The writer             *************/
 /**************************************************************/
+/* Write the merged image (that the building threads have filled) into
+   the output file. */
 static void
 mkprof_write(struct mkprofparams *p)
 {
-  double sum;
   char *jobname;
   struct timeval t1;
-  gal_data_t *out=p->out, *log;
-  struct builtqueue *ibq=NULL, *tbq;
-  size_t complete=0, num=p->num, clog;
-
-  /* Write each image into the output array. */
-  while(complete<p->num)
-    {
-      /* Set ibq. */
-      if(ibq==NULL)
-        {
-          if(p->cp.numthreads==1)
-            ibq=p->bq;
-          else
-            {
-              pthread_mutex_lock(&p->qlock);
-              while(p->bq==NULL)
-                pthread_cond_wait(&p->qready, &p->qlock);
-              ibq=p->bq;
-              p->bq=NULL;
-              pthread_mutex_unlock(&p->qlock);
-            }
-        }
-      sum=0.0f;
-
-
-      /* During the build process, we also defined the overlap tiles of
-         both the individual array and the final merged array, here we will
-         use those to put the required profile pixels into the final
-         array. */
-      if(ibq->overlaps && out)
-        GAL_TILE_PO_OISET(float,float,ibq->overlap_i,ibq->overlap_m,1,0, {
-            *o  = p->replace ? ( *i>*o ? *i : *o ) :  (*i + *o);
-            sum += *i;
-          });
-
-
-      /* Fill the log array. */
-      if(p->cp.log)
-        {
-          clog=0;
-          for(log=p->log; log!=NULL; log=log->next)
-            switch(++clog)
-              {
-              case 5:
-                ((unsigned char *)(log->array))[ibq->id] = ibq->indivcreated;
-                break;
-              case 4:
-                ((float *)(log->array))[ibq->id] = ibq->accufrac;
-                break;
-              case 3:
-                ((unsigned long *)(log->array))[ibq->id]=ibq->numaccu;
-                break;
-              case 2:
-                ((float *)(log->array))[ibq->id] =
-                  gal_units_counts_to_mag(sum, p->zeropoint);
-                break;
-              case 1:
-                ((unsigned long *)(log->array))[ibq->id]=ibq->id+1;
-                break;
-              }
-        }
-
-
-      /* Report if in verbose mode. */
-      ++complete;
-      if(!p->cp.quiet && p->num>1)
-        {
-          if( asprintf(&jobname, "row %zu complete, %zu left to go",
-                       ibq->id+1, num-complete)<0 )
-            error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
-          gal_timing_report(NULL, jobname, 2);
-          free(jobname);
-        }
-
-
-      /* Free the array and the queue element and change it to the next one
-         and increment complete. Note that there is no problem to free a
-         NULL pointer (when the built array didn't overlap). */
-      gal_data_free(ibq->overlap_i);
-      gal_data_free(ibq->overlap_m);
-      gal_data_free(ibq->image);
-      tbq=ibq->next;
-      free(ibq);
-      ibq=tbq;
-    }
-
+  gal_data_t *out=p->out;
 
   /* Write the final array to the output FITS image if a merged image is to
      be created. */
@@ -768,18 +742,16 @@ mkprof(struct mkprofparams *p)
   size_t nb, ndim=p->ndim, nt=p->cp.numthreads;
 
   /* Allocate the arrays to keep the thread and parameters for each
-     thread. Note that we only want nt-1 threads to do the
-     building. */
+     thread. */
   errno=0;
   mkp=calloc(nt, sizeof *mkp);
   if(mkp==NULL)
     error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'mkp'",
-          __func__, (nt-1)*sizeof *mkp);
+          __func__, nt*sizeof *mkp);
 
 
-  /* Distribute the different profiles for different threads. Note
-     that one thread is left out for writing, while nt-1 are left
-     for building. */
+  /* Distribute the different profiles for different threads. Each
+     thread will also add its built profiles into the merged image. */
   mmapname=gal_threads_dist_in_threads(p->num, nt,
                                        p->cp.minmapsize, p->cp.quietmmap,
                                        &indexs, &thrdcols);
@@ -800,6 +772,21 @@ mkprof(struct mkprofparams *p)
     }
 
 
+  /* If there are too many profiles, don't print the fact that a profile
+     has been built. This has to be done before the building starts
+     because the building threads also do the reporting. */
+  p->numdone=0;
+  if(p->num>numforprint)
+    {
+      /* Let the user know that building is ongoing. */
+      if(p->cp.quiet==0)
+        printf("  ---- Building %zu profiles... ", p->num);
+
+      /* Disable the quiet flag.*/
+      p->cp.quiet=1;
+    }
+
+
   /* Build the profiles: */
   if(nt==1)
     {
@@ -818,12 +805,27 @@ mkprof(struct mkprofparams *p)
       else nb=nt+1;
       gal_threads_attr_barrier_init(&attr, &b, nb);
 
-      /* Initialize the condition variable and mutex. */
-      err=pthread_mutex_init(&p->qlock, NULL);
+      /* Initialize the mutexes: one for the counter of built profiles and
+         one for each band of rows in the merged image. */
+      err=pthread_mutex_init(&p->donelock, NULL);
       if(err) error(EXIT_FAILURE, 0, "%s: mutex not initialized", __func__);
-      err=pthread_cond_init(&p->qready, NULL);
-      if(err) error(EXIT_FAILURE, 0, "%s: condition variable not initialized",
-                    __func__);
+      if(p->out)
+        {
+          p->numbands = ( p->out->dsize[0] + MKPROF_BAND_ROWS - 1 )
+                        / MKPROF_BAND_ROWS;
+          errno=0;
+          p->bandlocks=malloc(p->numbands * sizeof *p->bandlocks);
+          if(p->bandlocks==NULL)
+            error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
+                  "'p->bandlocks'", __func__,
+                  p->numbands * sizeof *p->bandlocks);
+          for(i=0;i<p->numbands;++i)
+            {
+              err=pthread_mutex_init(&p->bandlocks[i], NULL);
+              if(err) error(EXIT_FAILURE, 0, "%s: mutex %zu not "
+                            "initialized", __func__, i);
+            }
+        }
 
       /* Spin off the threads: */
       for(i=0;i<nt;++i)
@@ -843,27 +845,32 @@ mkprof(struct mkprofparams *p)
     }
 
 
-  /* If there are too many profiles, don't print the fact that a profile
-     has been built. */
-  if(p->num>numforprint)
+  /* If numthreads>1, then wait for all the jobs to finish and destroy
+     the attribute, barrier and mutexes. */
+  if(nt>1)
     {
-      /* Let the user know that building is ongoing. */
-      if(p->cp.quiet==0)
-        printf("  ---- Building %zu profiles... ", p->num);
-
-      /* Disable the quiet flag.*/
-      p->cp.quiet=1;
+      pthread_barrier_wait(&b);
+      pthread_attr_destroy(&attr);
+      pthread_barrier_destroy(&b);
+      pthread_mutex_destroy(&p->donelock);
+      if(p->bandlocks)
+        {
+          for(i=0;i<p->numbands;++i)
+            pthread_mutex_destroy(&p->bandlocks[i]);
+          free(p->bandlocks);
+          p->bandlocks=NULL;
+        }
     }
 
 
-  /* Write the created arrays into the image. Set the original quiet flag
-     and let the user know that its done. */
-  mkprof_write(p);
+  /* All the profiles are now in the merged image: set the original quiet
+     flag, let the user know that its done and write the merged image. */
   if(p->num>numforprint)
     {
       p->cp.quiet=origquiet;
       if(p->cp.quiet==0) printf("done.\n");
     }
+  mkprof_write(p);
 
 
   /* Write the log file. */
@@ -878,18 +885,6 @@ mkprof(struct mkprofparams *p)
       gal_list_str_free(comments, 1);
     }
 
-
-  /* If numthreads>1, then wait for all the jobs to finish and destroy
-     the attribute and barrier. */
-  if(nt>1)
-    {
-      pthread_barrier_wait(&b);
-      pthread_attr_destroy(&attr);
-      pthread_barrier_destroy(&b);
-      pthread_cond_destroy(&p->qready);
-      pthread_mutex_destroy(&p->qlock);
-    }
-
   /* If a merged image was created, let the user know.... */
   if(p->mergedimgname && p->cp.quiet==0)
     printf("  -- Output: %s\n", p->mergedimgname);
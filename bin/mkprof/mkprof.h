@@ -27,6 +27,11 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include "main.h"
 
+/* Number of rows (along the slowest dimension, in the oversampled merged
+   image) that share one lock while profiles are added into the merged
+   image. */
+#define MKPROF_BAND_ROWS 32
+
 struct mkonthread
 {
   /* General parameters: */
@@ -39,6 +44,7 @@ struct mkonthread
   double             q[2];   /* Axis ratio(s).                        */
   double        center[3];   /* Center (in FITS) in oversampled image.*/
   double (*profile)(struct mkonthread *); /* Function to use.         */
+  void (*profile_array)(struct mkonthread *, double *, size_t); /* Many.*/
   double           truncr;   /* Truncation radius in pixels.          */
   double         intruncr;   /* Inner truncation radius in pixels.    */
   long           width[3];   /* Enclosing box in FITS axes, not C.    */
@@ -70,7 +76,7 @@ struct mkonthread
   struct mkprofparams  *p;   /* Pointer to the main.h structure.      */
   size_t          *indexs;   /* Indexs to build on this thread.       */
   pthread_barrier_t    *b;   /* Pthread barrier pointer.              */
-  struct builtqueue  *ibq;   /* Internally built queue.               */
+  struct builtqueue  *ibq;   /* Profile that is being built.          */
 };
 
 
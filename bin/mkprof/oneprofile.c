@@ -143,6 +143,56 @@ oneprofile_r_el(struct mkonthread *mkp)
 
 
 
+/* Same as 'oneprofile_r_el', but for 'n' points: the coordinates of the
+   points along each dimension are in 'co[0]', 'co[1]' (and 'co[2]' in
+   3D) and their elliptical radii will be written in 'r'. */
+static void
+oneprofile_r_el_array(struct mkonthread *mkp, double *co[3], double *r,
+                      size_t n)
+{
+  size_t i;
+  double Xr, Yr, Zr;                   /* Rotated x, y, z. */
+  double q1=mkp->q[0],   q2=mkp->q[1];
+  double c1=mkp->c[0],   s1=mkp->s[0];
+  double c2=mkp->c[1],   s2=mkp->s[1];
+  double c3=mkp->c[2],   s3=mkp->s[2];
+  double *x=co[0], *y=co[1], *z=co[2];
+
+  switch(mkp->p->ndim)
+    {
+    case 2:
+      for(i=0;i<n;++i)
+        {
+          Xr = x[i] * ( c1       )     +   y[i] * ( s1 );
+          Yr = x[i] * ( -1.0f*s1 )     +   y[i] * ( c1 );
+          r[i] = sqrt( Xr*Xr + Yr*Yr/q1/q1 );
+        }
+      break;
+
+    case 3:
+      for(i=0;i<n;++i)
+        {
+          Xr = ( x[i]*(  c3*c1   - s3*c2*s1 ) + y[i]*( c3*s1   + s3*c2*c1)
+                 + z[i]*( s3*s2 ) );
+          Yr = ( x[i]*( -1*s3*c1 - c3*c2*s1 ) + y[i]*(-1*s3*s1 + c3*c2*c1)
+                 + z[i]*( c3*s2 ) );
+          Zr = ( x[i]*(  s1*s2              ) + y[i]*(-1*s2*c1           )
+                 + z[i]*( c2    ) );
+          r[i] = sqrt( Xr*Xr + Yr*Yr/q1/q1 + Zr*Zr/q2/q2 );
+        }
+      break;
+
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
+            "the problem. The value %zu is not recognized for "
+            "'mkp->p->ndim'", __func__, PACKAGE_BUGREPORT, mkp->p->ndim);
+    }
+}
+
+
+
+
+
 /* Calculate the circular/spherical distance of a pixel to the profile
    center. This is just used to add pixels in the stack. Later, when the
    pixels are popped from the stack, the elliptical radius will be used to
@@ -191,38 +241,36 @@ oneprofile_r_circle(size_t index, struct mkonthread *mkp)
 /****************************************************************
  **************          Random points         ******************
  ****************************************************************/
-/* Fill pixel with random values */
+/* Fill pixel with random values. The random points are given to the
+   profile function in batches of 'ONEPROFILE_BATCH' (in the same order
+   that they are generated), so the result is identical to evaluating
+   them one by one. */
 float
 oneprofile_randompoints(struct mkonthread *mkp)
 {
-  double r_before=mkp->r;
-  double range[3], sum=0.0f;
-  size_t i, j, numrandom=mkp->p->numrandom, ndim=mkp->p->ndim;
-  double coord_before[3]={mkp->coord[0], mkp->coord[1], mkp->coord[2]};
+  double sum=0.0f;
+  double range[3], *co[3], r[ONEPROFILE_BATCH];
+  double cox[ONEPROFILE_BATCH], coy[ONEPROFILE_BATCH], coz[ONEPROFILE_BATCH];
+  size_t i, j, k, n, numrandom=mkp->p->numrandom, ndim=mkp->p->ndim;
 
   /* Set the range in each dimension. */
+  co[0]=cox; co[1]=coy; co[2]=coz;
   for(i=0;i<ndim;++i)
     range[i] = mkp->higher[i] - mkp->lower[i];
 
   /* Find the sum of the profile on the random positions. */
-  for(i=0;i<numrandom;++i)
+  for(i=0;i<numrandom;i+=n)
     {
-      for(j=0;j<ndim;++j)
-        mkp->coord[j] = mkp->lower[j] + gsl_rng_uniform(mkp->rng) * range[j];
-      oneprofile_r_el(mkp);
-      sum+=mkp->profile(mkp);
+      n = numrandom-i < ONEPROFILE_BATCH ? numrandom-i : ONEPROFILE_BATCH;
+      for(k=0;k<n;++k)
+        for(j=0;j<ndim;++j)
+          co[j][k] = mkp->lower[j] + gsl_rng_uniform(mkp->rng) * range[j];
+      oneprofile_r_el_array(mkp, co, r, n);
+      mkp->profile_array(mkp, r, n);
+      for(k=0;k<n;++k) sum+=r[k];
     }
 
-  /* Reset the original distance and coordinate of the pixel and return the
-     average random value. The resetting is mostly redundant (only useful
-     in checks), but since it has a very negligible cost (compared to the
-     random checks above) cost, its good to reset it to help in debugging
-     when necessary (avoid confusion when un-commenting the checks in
-     'oneprofile_pix_by_pix'). */
-  mkp->r=r_before;
-  mkp->coord[0]=coord_before[0];
-  mkp->coord[1]=coord_before[1];
-  mkp->coord[2]=coord_before[2];
+  /* Return the average random value. */
   return sum/numrandom;
 }
 
@@ -245,6 +293,180 @@ oneprofile_randompoints(struct mkonthread *mkp)
 
 
 
+/****************************************************************
+ *****************      Adaptive cubature      ******************
+ ****************************************************************/
+/* Nodes (over [-1,1]) of the 7-point Gauss-Kronrod rule with the weights
+   of the 7-point Kronrod rule and the nested 3-point Gauss rule (which
+   only uses the three non-zero weights). */
+static const double oneprofile_gk_x[7]={ -0.960491268708020283423507092629,
+                                         -0.774596669241483377035853079956,
+                                         -0.434243749346802558002071502845,
+                                          0.0,
+                                          0.434243749346802558002071502845,
+                                          0.774596669241483377035853079956,
+                                          0.960491268708020283423507092629 };
+static const double oneprofile_gk_wk[7]={ 0.104656226026467265193823857192,
+                                          0.268488089868333440728569280667,
+                                          0.401397414775962222905051818618,
+                                          0.450916538658474142345110087046,
+                                          0.401397414775962222905051818618,
+                                          0.268488089868333440728569280667,
+                                          0.104656226026467265193823857192 };
+static const double oneprofile_gk_wg[7]={ 0.0,
+                                          0.555555555555555555555555555556,
+                                          0.0,
+                                          0.888888888888888888888888888889,
+                                          0.0,
+                                          0.555555555555555555555555555556,
+                                          0.0 };
+
+
+
+
+
+/* A region within a pixel and its integral/error. */
+struct oneprofile_region
+{
+  double lower[3];              /* Lower coordinate along each dimension. */
+  double higher[3];             /* Higher coordinate along each dimension.*/
+  double integral;              /* Integral (Kronrod rule) over region.   */
+  double error;                 /* Difference of Kronrod and Gauss rules. */
+};
+
+
+
+
+
+/* Apply the tensor product of the Gauss-Kronrod rule (7 points along each
+   dimension) on the given region. All the points are evaluated with one
+   call to the profile's array function. */
+static void
+oneprofile_cubature_rule(struct mkonthread *mkp,
+                         struct oneprofile_region *reg)
+{
+  size_t i, j, ind, n=1, ndim=mkp->p->ndim;
+  double kronrod=0.0f, gauss=0.0f, vol=1.0f, wk, wg, *co[3];
+  double mid[3], half[3], r[ONEPROFILE_CUBATURE_NODES];
+  double cox[ONEPROFILE_CUBATURE_NODES], coy[ONEPROFILE_CUBATURE_NODES];
+  double coz[ONEPROFILE_CUBATURE_NODES];
+
+  /* Set the center and half-width of the region along each dimension. */
+  co[0]=cox; co[1]=coy; co[2]=coz;
+  for(j=0;j<ndim;++j)
+    {
+      mid[j]  = ( reg->higher[j] + reg->lower[j] ) / 2;
+      half[j] = ( reg->higher[j] - reg->lower[j] ) / 2;
+      vol    *= half[j];
+      n      *= 7;
+    }
+
+  /* Set the coordinates of all the nodes and evaluate the profile on
+     them. */
+  for(i=0;i<n;++i)
+    for(ind=i, j=0; j<ndim; ++j, ind/=7)
+      co[j][i] = mid[j] + half[j] * oneprofile_gk_x[ind%7];
+  oneprofile_r_el_array(mkp, co, r, n);
+  mkp->profile_array(mkp, r, n);
+
+  /* Apply the weights. */
+  for(i=0;i<n;++i)
+    {
+      wk=wg=1.0f;
+      for(ind=i, j=0; j<ndim; ++j, ind/=7)
+        {
+          wk *= oneprofile_gk_wk[ind%7];
+          wg *= oneprofile_gk_wg[ind%7];
+        }
+      kronrod += wk * r[i];
+      gauss   += wg * r[i];
+    }
+
+  /* Write the integral and error of this region. */
+  reg->integral = kronrod * vol;
+  reg->error    = fabs(kronrod-gauss) * vol;
+}
+
+
+
+
+
+/* Deterministic (globally adaptive) cubature over the pixel: the region
+   with the largest error is divided into 2^ndim sub-regions until the sum
+   of the errors is less than '--cubtolerance' times the integral (or
+   'ONEPROFILE_CUBATURE_MAXREG' regions are defined). Like
+   'oneprofile_randompoints', the average value over the pixel is
+   returned. */
+static float
+oneprofile_cubature(struct mkonthread *mkp)
+{
+  struct oneprofile_region reg[ONEPROFILE_CUBATURE_MAXREG], parent;
+  double mid, vol=1.0f, integral, error, tolerance=mkp->p->cubtolerance;
+  size_t i, j, c, worst, nreg=1, ndim=mkp->p->ndim, nchild=1<<mkp->p->ndim;
+
+  /* Initialize the first region (the full pixel). */
+  for(j=0;j<ndim;++j)
+    {
+      reg[0].lower[j]  = mkp->lower[j];
+      reg[0].higher[j] = mkp->higher[j];
+      vol *= mkp->higher[j] - mkp->lower[j];
+    }
+  oneprofile_cubature_rule(mkp, reg);
+  integral=reg[0].integral;
+  error=reg[0].error;
+
+  /* Divide the worst region until the tolerance is reached. */
+  while( error > tolerance * fabs(integral)
+         && nreg + nchild - 1 <= ONEPROFILE_CUBATURE_MAXREG )
+    {
+      /* Find the region with the largest error. */
+      worst=0;
+      for(i=1;i<nreg;++i) if(reg[i].error>reg[worst].error) worst=i;
+
+      /* Divide it into 'nchild' sub-regions: the first one replaces the
+         parent, the rest are added to the end. */
+      parent=reg[worst];
+      for(c=0;c<nchild;++c)
+        {
+          i = c ? nreg++ : worst;
+          for(j=0;j<ndim;++j)
+            {
+              mid = ( parent.lower[j] + parent.higher[j] ) / 2;
+              reg[i].lower[j]  = (c>>j) & 1 ? mid : parent.lower[j];
+              reg[i].higher[j] = (c>>j) & 1 ? parent.higher[j] : mid;
+            }
+          oneprofile_cubature_rule(mkp, &reg[i]);
+        }
+
+      /* Sum the integrals and errors of all the regions. */
+      integral=error=0.0f;
+      for(i=0;i<nreg;++i)
+        { integral+=reg[i].integral; error+=reg[i].error; }
+    }
+
+  /* Return the average value over the pixel. */
+  return integral/vol;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /****************************************************************
  *****************      2D integration       ********************
  ****************************************************************/
@@ -360,7 +582,7 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
 
   uint8_t *byt;
   gal_list_sizet_t *Q=NULL;
-  int use_rand_points=1, ispeak=1;
+  int integrate=1, ispeak=1;
   double tolerance=mkp->p->tolerance;
   float circ_r, *array=mkp->ibq->image->array;
   double (*profile)(struct mkonthread *)=mkp->profile;
@@ -389,7 +611,7 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
   byt[p]=1;
   gal_list_dosizet_add( &lQ, &sQ, p, oneprofile_r_circle(p, mkp) );
 
-  /* If random points are necessary, then do it: */
+  /* Integrate the central pixels (where necessary): */
   switch(mkp->func)
     {
     case PROFILE_SERSIC:
@@ -418,11 +640,14 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
               mkp->higher[i] = mkp->coord[i] + hp;
             }
 
-          /* Find the random points and profile center. */
-          array[p]=oneprofile_randompoints(mkp);
+          /* Integrate the profile over the pixel and find the value at
+             the profile center. */
+          array[p] = ( mkp->p->integration==MKPROF_INTEG_CUBATURE
+                       ? oneprofile_cubature(mkp)
+                       : oneprofile_randompoints(mkp) );
           approx=profile(mkp);
           if (fabs(array[p]-approx)/array[p] < tolerance)
-            use_rand_points=0;
+            integrate=0;
 
           /* For a check:
           printf("coord: %g, %g\n", mkp->coord[0], mkp->coord[1]);
@@ -449,7 +674,7 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
                 }
             } );
 
-          if(use_rand_points==0) break;
+          if(integrate==0) break;
         }
     }
 
@@ -640,12 +865,15 @@ oneprofile_set_prof_params(struct mkonthread *mkp)
     }
 
 
-  /* Fill the profile-dependent parameters. */
+  /* Fill the profile-dependent parameters. Only the profiles that may be
+     integrated over a pixel need 'profile_array'. */
+  mkp->profile_array=NULL;
   switch (mkp->func)
     {
     case PROFILE_SERSIC:
       mkp->correction       = 1;
       mkp->profile          = &profiles_sersic;
+      mkp->profile_array    = &profiles_sersic_array;
       mkp->sersic_re        = p->r[id];
       mkp->sersic_inv_n     = 1.0f/p->n[id];
       mkp->sersic_nb        = -1.0f*profiles_sersic_b(p->n[id]);
@@ -657,6 +885,7 @@ oneprofile_set_prof_params(struct mkonthread *mkp)
     case PROFILE_MOFFAT:
       mkp->correction       = 1;
       mkp->profile          = &profiles_moffat;
+      mkp->profile_array    = &profiles_moffat_array;
       mkp->moffat_nb        = -1.0f*p->n[id];
       mkp->moffat_alphasq   = profiles_moffat_alpha(p->r[id], p->n[id]);
       mkp->moffat_alphasq  *= mkp->moffat_alphasq;
@@ -676,6 +905,7 @@ oneprofile_set_prof_params(struct mkonthread *mkp)
     case PROFILE_GAUSSIAN:
       mkp->correction       = 1;
       mkp->profile          = &profiles_gaussian;
+      mkp->profile_array    = &profiles_gaussian_array;
       sigma                 = p->r[id]/2.35482f;
       mkp->gaussian_c       = -1.0f/(2.0f*sigma*sigma);
       mkp->truncr           = tp ? p->t[id] : p->t[id]*p->r[id]/2;
@@ -25,6 +25,18 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include "mkprof.h"
 
+/* Number of points within a pixel that are given to the profile function
+   in one call (see 'profile_array' in 'struct mkonthread'). */
+#define ONEPROFILE_BATCH 64
+
+/* Maximum number of sub-regions that a pixel may be divided into during
+   the adaptive cubature. */
+#define ONEPROFILE_CUBATURE_MAXREG 128
+
+/* Number of nodes in the cubature rule of one region (7 along each
+   dimension, in 3D). */
+#define ONEPROFILE_CUBATURE_NODES 343
+
 int
 oneprofile_ispsf(uint8_t fcolvalue);
 
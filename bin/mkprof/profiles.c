@@ -170,6 +170,20 @@ profiles_gaussian(struct mkonthread *mkp)
 
 
 
+/* Same as 'profiles_gaussian', but on 'n' radii in the 'r' array (the
+   radii will be replaced by the profile values). */
+void
+profiles_gaussian_array(struct mkonthread *mkp, double *r, size_t n)
+{
+  size_t i;
+  double c=mkp->gaussian_c;
+  for(i=0;i<n;++i) r[i]=exp( c * r[i] * r[i] );
+}
+
+
+
+
+
 /* This function will find the moffat function alpha value based on
    the explantions here:
 
@@ -215,6 +229,20 @@ profiles_moffat(struct mkonthread *mkp)
 
 
 
+/* Same as 'profiles_moffat', but on an array of radii (see
+   'profiles_gaussian_array'). */
+void
+profiles_moffat_array(struct mkonthread *mkp, double *r, size_t n)
+{
+  size_t i;
+  double alphasq=mkp->moffat_alphasq, nb=mkp->moffat_nb;
+  for(i=0;i<n;++i) r[i]=pow(1+r[i]*r[i]/alphasq, nb);
+}
+
+
+
+
+
 /* This approximation of b(n) for n>0.35 is taken from McArthur,
    Courteau and Holtzman 2003:
    http://adsabs.harvard.edu/abs/2003ApJ...582..689 */
@@ -259,6 +287,20 @@ profiles_sersic(struct mkonthread *mkp)
 
 
 
+/* Same as 'profiles_sersic', but on an array of radii (see
+   'profiles_gaussian_array'). */
+void
+profiles_sersic_array(struct mkonthread *mkp, double *r, size_t n)
+{
+  size_t i;
+  double nb=mkp->sersic_nb, re=mkp->sersic_re, inv_n=mkp->sersic_inv_n;
+  for(i=0;i<n;++i) r[i]=exp( nb * ( pow(r[i]/re, inv_n) -1 ) );
+}
+
+
+
+
+
 /* Make a circumference (inner to the radius). */
 double
 profiles_circumference(struct mkonthread *mkp)
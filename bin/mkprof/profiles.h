@@ -41,6 +41,9 @@ profiles_gaussian_total(double q);
 double
 profiles_gaussian(struct mkonthread *mkp);
 
+void
+profiles_gaussian_array(struct mkonthread *mkp, double *r, size_t n);
+
 double
 profiles_moffat_alpha(double fwhm, double beta);
 
@@ -50,6 +53,9 @@ profiles_moffat_total(double alpha, double beta, double q);
 double
 profiles_moffat(struct mkonthread *mkp);
 
+void
+profiles_moffat_array(struct mkonthread *mkp, double *r, size_t n);
+
 double
 profiles_sersic_b(double n);
 
@@ -59,6 +65,9 @@ profiles_sersic_total(double n, double re, double b, double q);
 double
 profiles_sersic(struct mkonthread *mkp);
 
+void
+profiles_sersic_array(struct mkonthread *mkp, double *r, size_t n);
+
 double
 profiles_circumference(struct mkonthread *mkp);
 
@@ -71,9 +71,9 @@ const char
 doc[] = GAL_STRINGS_TOP_HELP_INFO PROGRAM_NAME" will create a FITS "
   "image containing any number of mock astronomical profiles based on "
   "an input catalog. All the profiles will be built from the center "
-  "outwards. First by Monte Carlo integration, then using the central "
-  "pixel position. The tolerance level specifies when the switch will "
-  "occur.\n"
+  "outwards. First by Monte Carlo integration (or adaptive cubature), "
+  "then using the central pixel position. The tolerance level specifies "
+  "when the switch will occur.\n"
   GAL_STRINGS_MORE_HELP_INFO
   /* After the list of options: */
   "\v"
@@ -469,6 +469,41 @@ ui_parse_kernel(struct argp_option *option, char *arg,
 
 
 
+/* Parse the method to integrate the central pixels. */
+void *
+ui_parse_integration(struct argp_option *option, char *arg,
+                     char *filename, size_t lineno, void *junk)
+{
+  char *outstr;
+
+  /* We want to print the stored values. */
+  if(lineno==-1)
+    {
+      gal_checkset_allocate_copy( ( *(uint8_t *)(option->value)
+                                    ==MKPROF_INTEG_CUBATURE
+                                    ? "cubature" : "random" ), &outstr );
+      return outstr;
+    }
+  else
+    {
+      if(!strcmp(arg, "random"))
+        *(uint8_t *)(option->value)=MKPROF_INTEG_RANDOM;
+      else if (!strcmp(arg, "cubature"))
+        *(uint8_t *)(option->value)=MKPROF_INTEG_CUBATURE;
+      else
+        error_at_line(EXIT_FAILURE, 0, filename, lineno, "'%s' (value to "
+                      "'--integration') not recognized as an integration "
+                      "method. Recognized values are 'random' (Monte Carlo "
+                      "integration) and 'cubature' (deterministic adaptive "
+                      "cubature)", arg);
+      return NULL;
+    }
+}
+
+
+
+
+
 /* Parse the mode to interpret the given coordinates. */
 void *
 ui_parse_coordinate_mode(struct argp_option *option, char *arg,
@@ -59,6 +59,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "convmethod",
+      UI_KEY_CONVMETHOD,
+      "STR",
+      0,
+      "Convolution: 'direct', 'separable', 'fft', 'auto'.",
+      GAL_OPTIONS_GROUP_INPUT,
+      &p->convmethodstr,
+      GAL_TYPE_STRING,
+      GAL_OPTIONS_RANGE_ANY,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
     {
       "convolved",
       UI_KEY_CONVOLVED,
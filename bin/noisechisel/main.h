@@ -48,6 +48,7 @@ struct noisechiselparams
   char                  *khdu;  /* Kernel HDU.                            */
   char         *convolvedname;  /* Convolved image (to avoid convolution).*/
   char                  *chdu;  /* HDU of convolved image.                */
+  char         *convmethodstr;  /* Method of spatial convolution.         */
   char        *widekernelname;  /* Name of wider kernel to be used.       */
   char                  *whdu;  /* Wide kernel HDU.                       */
 
@@ -101,6 +102,7 @@ struct noisechiselparams
   gal_data_t           *input;  /* Input image.                           */
   gal_data_t          *kernel;  /* Sharper kernel.                        */
   gal_data_t      *widekernel;  /* Wider kernel.                          */
+  int              convmethod;  /* Code of spatial convolution method.    */
   gal_data_t            *conv;  /* Convolved wth sharper kernel.          */
   gal_data_t           *wconv;  /* Convolved with wider kernel.           */
   gal_data_t          *binary;  /* For binary operations.                 */
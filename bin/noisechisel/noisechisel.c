@@ -67,8 +67,10 @@ noisechisel_convolve(struct noisechiselparams *p)
         {
           /* Make the convolved image. */
           if(!p->cp.quiet) gettimeofday(&t1, NULL);
-          p->conv = gal_convolve_spatial(tl->tiles, p->kernel,
-                                         p->cp.numthreads, 1, tl->workoverch);
+          p->conv = gal_convolve_spatial_method(tl->tiles, p->kernel,
+                                                p->cp.numthreads, 1,
+                                                tl->workoverch,
+                                                p->convmethod);
 
           /* Report and write check images if necessary. */
           if(!p->cp.quiet)
@@ -105,8 +107,9 @@ noisechisel_convolve(struct noisechiselparams *p)
   if(p->widekernel)
     {
       if(!p->cp.quiet) gettimeofday(&t1, NULL);
-      p->wconv=gal_convolve_spatial(tl->tiles, p->widekernel,
-                                    p->cp.numthreads, 1, tl->workoverch);
+      p->wconv=gal_convolve_spatial_method(tl->tiles, p->widekernel,
+                                           p->cp.numthreads, 1,
+                                           tl->workoverch, p->convmethod);
       gal_checkset_allocate_copy("CONVOLVED-WIDER", &p->wconv->name);
 
       if(!p->cp.quiet)
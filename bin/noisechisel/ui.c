@@ -33,6 +33,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/array.h>
 #include <gnuastro/blank.h>
 #include <gnuastro/threads.h>
+#include <gnuastro/convolve.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/dimension.h>
 
@@ -232,6 +233,13 @@ ui_read_check_only_options(struct noisechiselparams *p)
           "and avoid convolution) it is mandatory to also specify a HDU "
           "for it");
 
+  /* Read the spatial convolution method (by default, every pixel is
+     convolved directly). */
+  if(p->convmethodstr)
+    p->convmethod=gal_convolve_spatial_method_from_string(p->convmethodstr);
+  else
+    p->convmethod=GAL_CONVOLVE_SPATIAL_DIRECT;
+
   /* Make sure that the no-erode-quantile is not smaller or equal to
      qthresh. */
   if( p->noerodequant <= p->qthresh)
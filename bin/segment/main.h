@@ -53,6 +53,7 @@ struct segmentparams
   char                  *khdu;  /* Kernel HDU.                            */
   char         *convolvedname;  /* Convolved image (to avoid convolution).*/
   char                  *chdu;  /* HDU of convolved image.                */
+  char         *convmethodstr;  /* Method of spatial convolution.         */
   char         *detectionname;  /* Detection image file name.             */
   char                  *dhdu;  /* Detection image file name.             */
   char               *skyname;  /* Filename of Sky image.                 */
@@ -85,6 +86,7 @@ struct segmentparams
 
   gal_data_t           *input;  /* Input dataset.                         */
   gal_data_t          *kernel;  /* Given kernel for convolution.          */
+  int              convmethod;  /* Code of spatial convolution method.    */
   gal_data_t            *conv;  /* Convolved dataset.                     */
   gal_data_t          *binary;  /* For binary operations.                 */
   gal_data_t          *olabel;  /* Object labels.                         */
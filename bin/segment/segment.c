@@ -74,8 +74,10 @@ segment_convolve(struct segmentparams *p)
         {
           /* Make the convolved image. */
           if(!p->cp.quiet) gettimeofday(&t1, NULL);
-          p->conv = gal_convolve_spatial(tl->tiles, p->kernel,
-                                         p->cp.numthreads, 1, tl->workoverch);
+          p->conv = gal_convolve_spatial_method(tl->tiles, p->kernel,
+                                                p->cp.numthreads, 1,
+                                                tl->workoverch,
+                                                p->convmethod);
 
           /* Report and write check images if necessary. */
           if(!p->cp.quiet)
@@ -1140,6 +1142,7 @@ static void
 segment_detections(struct segmentparams *p)
 {
   char *msg;
+  size_t i, *costs;
   struct clumps_params clprm;
   gal_data_t *labindexs, *claborig, *demo=NULL;
 
@@ -1149,6 +1152,15 @@ segment_detections(struct segmentparams *p)
                              p->cp.quietmmap);
 
 
+  /* The processing time of each detection is roughly proportional to its
+     number of pixels (and can differ by orders of magnitude between
+     detections). So the detections are distributed between the threads
+     dynamically, with the largest detections starting first. */
+  costs=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numdetections, 0,
+                             __func__, "costs");
+  for(i=0;i<p->numdetections;++i) costs[i]=labindexs[i+1].size;
+
+
   /* Initialize the necessary thread parameters. Note that since the object
      labels begin from one, the 'sn' array will have one extra element.*/
   clprm.p=p;
@@ -1196,9 +1208,9 @@ segment_detections(struct segmentparams *p)
                    claborig->size*gal_type_sizeof(claborig->type));
 
           /* (Re-)do everything until this step. */
-          gal_threads_spin_off(segment_on_threads, &clprm,
-                               p->numdetections, p->cp.numthreads,
-                               p->cp.minmapsize, p->cp.quietmmap);
+          gal_threads_spin_off_dynamic(segment_on_threads, &clprm,
+                                       p->numdetections, p->cp.numthreads,
+                                       costs);
 
           /* Set the extension name. */
           switch(clprm.step)
@@ -1324,9 +1336,9 @@ segment_detections(struct segmentparams *p)
   else
     {
       clprm.step=0;
-      gal_threads_spin_off(segment_on_threads, &clprm, p->numdetections,
-                           p->cp.numthreads, p->cp.minmapsize,
-                           p->cp.quietmmap);
+      gal_threads_spin_off_dynamic(segment_on_threads, &clprm,
+                                   p->numdetections, p->cp.numthreads,
+                                   costs);
     }
 
 
@@ -1352,6 +1364,7 @@ segment_detections(struct segmentparams *p)
   gal_data_array_free(clprm.sn, p->numdetections+1, 1);
   gal_data_array_free(labindexs, p->numdetections+1, 1);
   if( p->cp.numthreads>1 ) pthread_mutex_destroy(&clprm.labmutex);
+  free(costs);
 }
 
 
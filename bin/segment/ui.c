@@ -33,6 +33,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/array.h>
 #include <gnuastro/binary.h>
 #include <gnuastro/threads.h>
+#include <gnuastro/convolve.h>
 #include <gnuastro/dimension.h>
 #include <gnuastro/statistics.h>
 
@@ -250,6 +251,13 @@ ui_read_check_only_options(struct segmentparams *p)
           "and avoid convolution) it is mandatory to also specify a HDU "
           "for it");
 
+  /* Read the spatial convolution method (by default, every pixel is
+     convolved directly). */
+  if(p->convmethodstr)
+    p->convmethod=gal_convolve_spatial_method_from_string(p->convmethodstr);
+  else
+    p->convmethod=GAL_CONVOLVE_SPATIAL_DIRECT;
+
   /* For the options that make tables, the table format option is
      mandatory. */
   if( p->checksn && p->cp.tableformat==0 )
@@ -510,7 +518,8 @@ ui_prepare_inputs(struct segmentparams *p)
         {
           ccin=gal_data_copy_to_new_type_free(p->olabel, GAL_TYPE_UINT8);
           p->numdetections=gal_binary_connected_components(ccin, &ccout,
-                                                           ccin->ndim);
+                                                           ccin->ndim,
+                                                           p->cp.numthreads);
           gal_data_free(ccin);
           p->olabel=ccout;
         }
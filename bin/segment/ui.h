@@ -86,6 +86,7 @@ enum option_keys_enum
   UI_KEY_GROWNCLUMPS,
   UI_KEY_CHECKSN,
   UI_KEY_CHECKSEGMENTATION,
+  UI_KEY_CONVMETHOD,
 };
 
 
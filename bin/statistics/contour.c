@@ -57,7 +57,7 @@ contour_pixels(gal_data_t *input, double level, size_t minmapsize,
   thresh=gal_arithmetic(GAL_ARITHMETIC_OP_GT, 1, flags, input, number);
 
   /* Erode the thresholded image by one. */
-  eroded=gal_binary_erode(thresh, 1, 1, 0);
+  eroded=gal_binary_erode(thresh, 1, 1, 0, 1);
 
   /* Only keep the outer pixels. */
   b=eroded->array;
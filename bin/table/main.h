@@ -145,6 +145,7 @@ struct tableparams
   uint8_t            freesort;  /* If the sort column should be freed.  */
   uint8_t         *freeselect;  /* If selection columns should be freed.*/
   uint8_t              sortin;  /* If the sort column is in the output. */
+  uint8_t        selectonread;  /* Rows were selected while reading.    */
   time_t              rawtime;  /* Starting time of the program.        */
   gal_data_t       **colarray;  /* Array of columns, with arithmetic.   */
   size_t          numcolarray;  /* Number of elements in 'colarray'.    */
@@ -37,7 +37,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/fits.h>
 #include <gnuastro/list.h>
 #include <gnuastro/table.h>
-#include <gnuastro/qsort.h>
+#include <gnuastro/sort.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/polygon.h>
 #include <gnuastro/arithmetic.h>
@@ -49,6 +49,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include "main.h"
 
 #include "ui.h"
+#include "table.h"
 #include "arithmetic.h"
 
 
@@ -167,18 +168,18 @@ table_bring_to_top(gal_data_t *table, gal_data_t *rowids)
 
 
 static gal_data_t *
-table_selection_range(struct tableparams *p, gal_data_t *col)
+table_selection_range(gal_data_t *range, gal_data_t *col)
 {
   size_t one=1;
   double *darr;
   int numok=GAL_ARITHMETIC_FLAG_NUMOK;
   int inplace=GAL_ARITHMETIC_FLAG_INPLACE;
-  gal_data_t *min=NULL, *max=NULL, *tmp, *ltmin, *gemax=NULL;
+  gal_data_t *min=NULL, *max=NULL, *ltmin, *gemax=NULL;
 
   /* First, make sure everything is OK. */
-  if(p->range==NULL)
+  if(range==NULL)
     error(EXIT_FAILURE, 0, "%s: a bug! Please contact us to fix the "
-          "problem at %s. 'p->range' should not be NULL at this point",
+          "problem at %s. 'range' should not be NULL at this point",
           __func__, PACKAGE_BUGREPORT);
 
   /* Allocations. */
@@ -188,16 +189,10 @@ table_selection_range(struct tableparams *p, gal_data_t *col)
                      NULL, NULL, NULL);
 
   /* Read the range of values for this column. */
-  darr=p->range->array;
+  darr=range->array;
   ((double *)(min->array))[0] = darr[0];
   ((double *)(max->array))[0] = darr[1];
 
-  /* Move 'p->range' to the next element in the list and free the current
-     one (we have already read its values and don't need it any more). */
-  tmp=p->range;
-  p->range=p->range->next;
-  gal_data_free(tmp);
-
   /* Find all the elements outside this range (smaller than the minimum,
      larger than the maximum or blank) as separate binary flags.. */
   ltmin=gal_arithmetic(GAL_ARITHMETIC_OP_LT, 1, numok, col, min);
@@ -336,16 +331,15 @@ table_selection_string_eq_ne(gal_data_t *column, char *reference, int e0n1)
 
 
 static gal_data_t *
-table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
+table_selection_equal_or_notequal(gal_data_t *arg, gal_data_t *col,
                                   int e0n1)
 {
   void *varr;
   char **strarr;
   size_t i, one=1;
+  gal_data_t *eq, *out=NULL, *value;
   int numok=GAL_ARITHMETIC_FLAG_NUMOK;
   int inplace=GAL_ARITHMETIC_FLAG_INPLACE;
-  gal_data_t *eq, *out=NULL, *value=NULL;
-  gal_data_t *arg = e0n1 ? p->notequal : p->equal;
 
   /* Note that this operator is used to make the "masked" array, so when
      'e0n1==0' the operator should be 'GAL_ARITHMETIC_OP_NE' and
@@ -359,7 +353,7 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
   /* First, make sure everything is OK. */
   if(arg==NULL)
     error(EXIT_FAILURE, 0, "%s: a bug! Please contact us to fix the "
-          "problem at %s. 'p->range' should not be NULL at this point",
+          "problem at %s. 'arg' should not be NULL at this point",
           __func__, PACKAGE_BUGREPORT);
 
   /* To easily parse the given values. */
@@ -389,6 +383,7 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
           /* Mark the rows that are equal (irrespective of the column's
              original numerical datatype). */
           eq=gal_arithmetic(operator, 1, numok, col, value);
+          gal_data_free(value);
         }
 
       /* Merge the results with (possible) previous results. */
@@ -410,15 +405,7 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
   */
 
 
-  /* Move the main pointer to the next possible call of the given
-     option. Note that 'arg' already points to 'p->equal' or 'p->notequal',
-     so it will automatically be freed with the next step.*/
-  if(e0n1) p->notequal=p->notequal->next;
-  else     p->equal=p->equal->next;
-
-  /* Clean up and return. */
-  gal_data_free(value);
-  gal_data_free(arg);
+  /* Return the flags. */
   return out;
 }
 
@@ -426,15 +413,157 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
 
 
 
+/* Flag the rows that should be removed with one selection criteria
+   ('col2' is only used for the polygon selections). 'args' keeps the
+   values of the next '--range', '--equal' or '--notequal' options (in
+   the same order as 'enum select_types'), it is moved forward here. */
+static gal_data_t *
+table_select_mask(struct tableparams *p, gal_data_t **args, int type,
+                  gal_data_t *col, gal_data_t *col2)
+{
+  gal_data_t *addmask, *blmask;
+  int inplace=GAL_ARITHMETIC_FLAG_INPLACE;
+
+  /* Make sure the input isn't a vector column. */
+  if(col->ndim!=1)
+    error(EXIT_FAILURE, 0, "row selection by value (for example with "
+          "'--range', '--inpolygon', '--equal' or '--noblank') is "
+          "currently not available for vector columns. If you need "
+          "this feature, please get in touch with us at '%s' to add "
+          "it", PACKAGE_BUGREPORT);
+
+  /* Do the specific type of selection. */
+  switch(type)
+    {
+    case SELECT_TYPE_RANGE:
+      addmask=table_selection_range(args[type], col);
+      args[type]=args[type]->next;
+      break;
+
+    /* '--inpolygon' and '--outpolygon' need two columns (blank values
+       are checked in the second). */
+    case SELECT_TYPE_INPOLYGON:
+    case SELECT_TYPE_OUTPOLYGON:
+      addmask=table_selection_polygon(p, col, col2,
+                                      type==SELECT_TYPE_INPOLYGON);
+      col=col2;
+      break;
+
+    case SELECT_TYPE_EQUAL:
+    case SELECT_TYPE_NOTEQUAL:
+      addmask=table_selection_equal_or_notequal(args[type], col,
+                                                type==SELECT_TYPE_NOTEQUAL);
+      args[type]=args[type]->next;
+      break;
+
+    case SELECT_TYPE_NOBLANK:
+      addmask = gal_arithmetic(GAL_ARITHMETIC_OP_ISBLANK, 1, 0, col);
+      break;
+
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s "
+            "to fix the problem. The code %d is not a recognized "
+            "range identifier", __func__, PACKAGE_BUGREPORT, type);
+      addmask=NULL;
+    }
+
+  /* Remove any blank elements (incase we are on a noblank column. */
+  if(type!=SELECT_TYPE_NOBLANK && gal_blank_present(col, 1))
+    {
+      blmask = gal_arithmetic(GAL_ARITHMETIC_OP_ISBLANK, 1, 0, col);
+      addmask=gal_arithmetic(GAL_ARITHMETIC_OP_OR, 1, inplace,
+                             addmask, blmask);
+      gal_data_free(blmask);
+    }
+
+  /* Return the flags. */
+  return addmask;
+}
+
+
+
+
+
+/* Select rows while the table is being read: 'cols' are the columns
+   that are read (for a block of rows) and the rows to remove should be
+   flagged in 'flag'. This function is called on several threads, so it
+   should not modify the parameters. */
+void
+table_select_on_read(gal_data_t *cols, gal_data_t *flag, void *in_prm)
+{
+  struct table_select_onread *sp=(struct table_select_onread *)in_prm;
+  struct tableparams *p=sp->p;
+
+  int type;
+  size_t i, j;
+  uint8_t *f, *a;
+  gal_data_t *col, *col2, *addmask;
+  gal_data_t *args[SELECT_TYPE_NUMBER]={p->range, NULL, NULL,
+                                        p->equal, p->notequal, NULL};
+
+  /* Go over each selection criteria (in the same order as
+     'table_select_by_value'). */
+  for(i=0;i<sp->nselect;++i)
+    {
+      /* Find the column(s) of this criteria. */
+      type=sp->selecttypeout[i];
+      col=cols; for(j=0;j<sp->selectindout[i];++j) col=col->next;
+      col2=NULL;
+      if(type==SELECT_TYPE_INPOLYGON || type==SELECT_TYPE_OUTPOLYGON)
+        {
+          col2=cols; for(j=0;j<sp->selectindout[i+1];++j) col2=col2->next;
+          ++i;
+        }
+
+      /* Flag the rows and add them to the output flags. */
+      addmask=table_select_mask(p, args, type, col, col2);
+      f=flag->array;
+      a=addmask->array;
+      for(j=0;j<flag->size;++j) f[j] |= a[j];
+      gal_data_free(addmask);
+    }
+}
+
+
+
+
+
+/* Free the selection columns and values. */
+static void
+table_select_free(struct tableparams *p)
+{
+  size_t i=0;
+  struct list_select *tmp;
+
+  for(tmp=p->selectcol;tmp!=NULL;tmp=tmp->next)
+    { if(p->freeselect[i]) {gal_data_free(tmp->col); tmp->col=NULL;} ++i; }
+  ui_list_select_free(p->selectcol, 0);
+  gal_list_data_free(p->notequal);
+  gal_list_data_free(p->equal);
+  gal_list_data_free(p->range);
+  p->range=p->equal=p->notequal=NULL;
+  free(p->freeselect);
+}
+
+
+
+
+
 static void
 table_select_by_value(struct tableparams *p)
 {
   gal_data_t *rowids;
   struct list_select *tmp;
   uint8_t *u, *uf, *ustart;
-  size_t i, *s, ngood=0;
+  size_t *s, ngood=0;
+  gal_data_t *mask, *addmask, *col2;
   int inplace=GAL_ARITHMETIC_FLAG_INPLACE;
-  gal_data_t *mask, *blmask, *addmask=NULL;
+  gal_data_t *args[SELECT_TYPE_NUMBER]={p->range, NULL, NULL,
+                                        p->equal, p->notequal, NULL};
+
+  /* If the rows were selected while reading the table, we just need to
+     clean up (even if no row was selected). */
+  if(p->selectonread) { table_select_free(p); return; }
 
   /* It may happen that the input table is empty! In such cases, just
      return and don't bother with this step. */
@@ -448,77 +577,18 @@ table_select_by_value(struct tableparams *p)
   /* Go over each selection criteria and remove the necessary elements. */
   for(tmp=p->selectcol;tmp!=NULL;tmp=tmp->next)
     {
-      /* Make sure the input isn't a vector column. */
-      if(tmp->col->ndim!=1)
-        error(EXIT_FAILURE, 0, "row selection by value (for example with "
-              "'--range', '--inpolygon', '--equal' or '--noblank') is "
-              "currently not available for vector columns. If you need "
-              "this feature, please get in touch with us at '%s' to add "
-              "it", PACKAGE_BUGREPORT);
-
-      /* Do the specific type of selection. */
-      switch(tmp->type)
-        {
-        case SELECT_TYPE_RANGE:
-          addmask=table_selection_range(p, tmp->col);
-          break;
-
-        /* '--inpolygon' and '--outpolygon' need two columns. */
-        case SELECT_TYPE_INPOLYGON:
-        case SELECT_TYPE_OUTPOLYGON:
-          addmask=table_selection_polygon(p, tmp->col, tmp->next->col,
-                                          tmp->type==SELECT_TYPE_INPOLYGON);
-          tmp=tmp->next;
-          break;
-
-        case SELECT_TYPE_EQUAL:
-          addmask=table_selection_equal_or_notequal(p, tmp->col, 0);
-          break;
-
-        case SELECT_TYPE_NOTEQUAL:
-          addmask=table_selection_equal_or_notequal(p, tmp->col, 1);
-          break;
-
-        case SELECT_TYPE_NOBLANK:
-          addmask = gal_arithmetic(GAL_ARITHMETIC_OP_ISBLANK, 1, 0,
-                                   tmp->col);
-          break;
-
-        default:
-          error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s "
-                "to fix the problem. The code %d is not a recognized "
-                "range identifier", __func__, PACKAGE_BUGREPORT,
-                tmp->type);
-        }
-
-      /* Remove any blank elements (incase we are on a noblank column. */
-      if(tmp->type!=SELECT_TYPE_NOBLANK && gal_blank_present(tmp->col, 1))
-        {
-          blmask = gal_arithmetic(GAL_ARITHMETIC_OP_ISBLANK, 1, 0,
-                                  tmp->col);
-          addmask=gal_arithmetic(GAL_ARITHMETIC_OP_OR, 1, inplace,
-                                 addmask, blmask);
-          gal_data_free(blmask);
-        }
+      /* Do the specific type of selection ('--inpolygon' and
+         '--outpolygon' need two columns). */
+      col2 = ( ( tmp->type==SELECT_TYPE_INPOLYGON
+                 || tmp->type==SELECT_TYPE_OUTPOLYGON )
+               ? tmp->next->col : NULL );
+      addmask=table_select_mask(p, args, tmp->type, tmp->col, col2);
+      if(col2) tmp=tmp->next;
 
       /* Add this mask array to the cumulative mask array (of all
          selections). */
       mask=gal_arithmetic(GAL_ARITHMETIC_OP_OR, 1, inplace, mask, addmask);
 
-      /* For a check.
-         {
-           float *f=ref->array;
-           uint8_t *m=mask->array;
-           uint8_t *u=addmask->array, *uf=u+addmask->size;
-           printf("\n\nInput column: %s\n", ref->name?ref->name:"No Name");
-           printf("Range: %g, %g\n", rarr[0], rarr[1]);
-           printf("%-20s%-20s%-20s\n", "Value", "This mask",
-           "Including previous");
-           do printf("%-20f%-20u%-20u\n", *f++, *u++, *m++); while(u<uf);
-           exit(0);
-           }
-        */
-
       /* Final clean up. */
       gal_data_free(addmask);
     }
@@ -547,11 +617,7 @@ table_select_by_value(struct tableparams *p)
   if(p->sortcol && p->sortin==0) table_bring_to_top(p->sortcol, rowids);
 
   /* Clean up. */
-  i=0;
-  for(tmp=p->selectcol;tmp!=NULL;tmp=tmp->next)
-    { if(p->freeselect[i]) {gal_data_free(tmp->col); tmp->col=NULL;} ++i; }
-  ui_list_select_free(p->selectcol, 0);
-  free(p->freeselect);
+  table_select_free(p);
   gal_data_free(mask);
   gal_data_free(rowids);
 }
@@ -565,7 +631,6 @@ table_sort(struct tableparams *p)
 {
   gal_data_t *perm;
   size_t c=0, *s, *sf, dsize0=p->table->dsize[0];
-  int (*qsortfn)(const void *, const void *)=NULL;
 
   /* In case there are no columns to sort, skip this function. */
   if(p->table->size==0 || p->table->array==NULL || p->table->dsize==NULL)
@@ -593,47 +658,9 @@ table_sort(struct tableparams *p)
           "section of the book/manual):\n\n"
           "    $ info gnuastro \"gnuastro text table format\"");
 
-  /* Set the proper qsort function. */
-  if(p->descending)
-    switch(p->sortcol->type)
-      {
-      case GAL_TYPE_UINT8:   qsortfn=gal_qsort_index_single_uint8_d;   break;
-      case GAL_TYPE_INT8:    qsortfn=gal_qsort_index_single_int8_d;    break;
-      case GAL_TYPE_UINT16:  qsortfn=gal_qsort_index_single_uint16_d;  break;
-      case GAL_TYPE_INT16:   qsortfn=gal_qsort_index_single_int16_d;   break;
-      case GAL_TYPE_UINT32:  qsortfn=gal_qsort_index_single_uint32_d;  break;
-      case GAL_TYPE_INT32:   qsortfn=gal_qsort_index_single_int32_d;   break;
-      case GAL_TYPE_UINT64:  qsortfn=gal_qsort_index_single_uint64_d;  break;
-      case GAL_TYPE_INT64:   qsortfn=gal_qsort_index_single_int64_d;   break;
-      case GAL_TYPE_FLOAT32: qsortfn=gal_qsort_index_single_float32_d; break;
-      case GAL_TYPE_FLOAT64: qsortfn=gal_qsort_index_single_float64_d; break;
-      default:
-        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
-              "the problem. The code '%u' wasn't recognized as a data type",
-              __func__, PACKAGE_BUGREPORT, p->sortcol->type);
-      }
-  else
-    switch(p->sortcol->type)
-      {
-      case GAL_TYPE_UINT8:   qsortfn=gal_qsort_index_single_uint8_i;   break;
-      case GAL_TYPE_INT8:    qsortfn=gal_qsort_index_single_int8_i;    break;
-      case GAL_TYPE_UINT16:  qsortfn=gal_qsort_index_single_uint16_i;  break;
-      case GAL_TYPE_INT16:   qsortfn=gal_qsort_index_single_int16_i;   break;
-      case GAL_TYPE_UINT32:  qsortfn=gal_qsort_index_single_uint32_i;  break;
-      case GAL_TYPE_INT32:   qsortfn=gal_qsort_index_single_int32_i;   break;
-      case GAL_TYPE_UINT64:  qsortfn=gal_qsort_index_single_uint64_i;  break;
-      case GAL_TYPE_INT64:   qsortfn=gal_qsort_index_single_int64_i;   break;
-      case GAL_TYPE_FLOAT32: qsortfn=gal_qsort_index_single_float32_i; break;
-      case GAL_TYPE_FLOAT64: qsortfn=gal_qsort_index_single_float64_i; break;
-      default:
-        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
-              "the problem. The code '%u' wasn't recognized as a data type",
-              __func__, PACKAGE_BUGREPORT, p->sortcol->type);
-      }
-
   /* Sort the indexs from the values. */
-  gal_qsort_index_single=p->sortcol->array;
-  qsort(perm->array, perm->size, sizeof *s, qsortfn);
+  gal_sort_index(perm->array, perm->size, p->sortcol->array,
+                 p->sortcol->type, p->descending, p->cp.numthreads);
 
   /* For a check (only on float32 type 'sortcol'):
   {
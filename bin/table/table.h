@@ -23,6 +23,18 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #ifndef TABLE_H
 #define TABLE_H
 
+/* Parameters to select rows while reading the table. */
+struct table_select_onread
+{
+  struct tableparams   *p;  /* Main program parameters.                */
+  size_t          nselect;  /* Number of selection columns.            */
+  size_t    *selectindout;  /* Index of each selection column in read. */
+  size_t   *selecttypeout;  /* Type of each selection column.          */
+};
+
+void
+table_select_on_read(gal_data_t *cols, gal_data_t *flag, void *in_prm);
+
 void
 table(struct tableparams *p);
 
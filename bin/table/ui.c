@@ -43,6 +43,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include "main.h"
 
 #include "ui.h"
+#include "table.h"
 #include "arithmetic.h"
 #include "authors-cite.h"
 
@@ -1234,6 +1235,7 @@ static void
 ui_preparations(struct tableparams *p)
 {
   gal_list_str_t *lines;
+  struct table_select_onread sp;
   size_t nselect=0, origoutncols=0;
   size_t sortindout=GAL_BLANK_SIZE_T;
   struct gal_options_common_params *cp=&p->cp;
@@ -1274,10 +1276,27 @@ ui_preparations(struct tableparams *p)
                   : NULL);
 
 
-  /* Read the necessary columns. */
-  p->table=gal_table_read(p->filename, cp->hdu, lines, p->columns,
-                          cp->searchin, cp->ignorecase, cp->numthreads,
-                          cp->minmapsize, p->cp.quietmmap, p->colmatch);
+  /* Read the necessary columns. When no other operation is necessary
+     before the row selection (see 'table'), the rows are selected while
+     the table is read (so the full columns are never in memory). */
+  p->selectonread = ( p->selection && p->catcolumnfile==NULL
+                      && p->fromvector==NULL && p->catrowfile==NULL );
+  if(p->selectonread)
+    {
+      sp.p=p;
+      sp.nselect=nselect;
+      sp.selectindout=selectindout;
+      sp.selecttypeout=selecttypeout;
+      p->table=gal_table_read_select(p->filename, cp->hdu, lines,
+                                     p->columns, cp->searchin,
+                                     cp->ignorecase, table_select_on_read,
+                                     &sp, cp->numthreads, cp->minmapsize,
+                                     p->cp.quietmmap, p->colmatch);
+    }
+  else
+    p->table=gal_table_read(p->filename, cp->hdu, lines, p->columns,
+                            cp->searchin, cp->ignorecase, cp->numthreads,
+                            cp->minmapsize, p->cp.quietmmap, p->colmatch);
   if(p->filename==NULL) p->filename="stdin";
   gal_list_str_free(lines, 1);
 
@@ -650,6 +650,61 @@ ui_check_options_and_arguments_wcsalign(struct warpparams *p)
 
 
 
+/* Read the input image. In WCS-align mode, single and double precision
+   inputs are used natively (other types are converted to double
+   precision), but the linear warpings need double precision. When a 2D
+   FITS image is to be aligned, only its metadata are read here: its
+   pixels will be read in bands during the warping (only the rows that are
+   necessary for each band of output rows), so it doesn't have to fit in
+   memory. */
+static void
+ui_read_input(struct warpparams *p)
+{
+  fitsfile *fptr;
+  size_t ndim, *dsize;
+  int type, status=0;
+  char *name=NULL, *unit=NULL;
+
+  /* Only read the metadata of a 2D FITS image in WCS-align mode. */
+  if( p->wcsalign && gal_fits_file_recognized(p->inputname) )
+    {
+      fptr=gal_fits_hdu_open_format(p->inputname, p->cp.hdu, 0);
+      gal_fits_img_info(fptr, &type, &ndim, &dsize, &name, &unit);
+      fits_close_file(fptr, &status);
+      gal_fits_io_error(status, NULL);
+      if(ndim==2)
+        {
+          /* Allocate an empty dataset and set its size (its 'array' will
+             remain NULL). */
+          p->input=gal_data_alloc(NULL, ( type==GAL_TYPE_FLOAT32
+                                          ? GAL_TYPE_FLOAT32
+                                          : GAL_TYPE_FLOAT64 ),
+                                  0, NULL, NULL, 0, p->cp.minmapsize,
+                                  p->cp.quietmmap, name, unit, NULL);
+          p->input->ndim=ndim;
+          p->input->dsize=dsize;
+          p->input->size=dsize[0]*dsize[1];
+        }
+      else free(dsize);
+      if(name) free(name);
+      if(unit) free(unit);
+    }
+
+  /* Read the full input in other cases. */
+  if(p->input==NULL)
+    {
+      p->input=gal_array_read_one_ch(p->inputname, p->cp.hdu, NULL,
+                                     p->cp.minmapsize, p->cp.quietmmap);
+      if( p->wcsalign==0 || p->input->type!=GAL_TYPE_FLOAT32 )
+        p->input=gal_data_copy_to_new_type_free(p->input,
+                                                GAL_TYPE_FLOAT64);
+    }
+}
+
+
+
+
+
 static void
 ui_check_options_and_arguments(struct warpparams *p)
 {
@@ -672,11 +727,8 @@ ui_check_options_and_arguments(struct warpparams *p)
         error(EXIT_FAILURE, 0, "no '--edgesampling' provided");
     }
 
-  /* Read the input image as double type and its WCS structure. */
-  p->input=gal_array_read_one_ch_to_type(p->inputname, p->cp.hdu,
-                                         NULL, GAL_TYPE_FLOAT64,
-                                         p->cp.minmapsize,
-                                         p->cp.quietmmap);
+  /* Read the input image (or its metadata) and its WCS structure. */
+  ui_read_input(p);
 
   /* Read the WCS and remove one-element wide dimension(s). */
   p->input->wcs=gal_wcs_read(p->inputname, p->cp.hdu,
@@ -519,6 +519,64 @@ warp_write_wcs_linear(struct warpparams *p)
 
 
 
+
+
+
+
+
+/***************************************************************/
+/**************         WCS-align mode        ******************/
+/***************************************************************/
+/* Warp the input in bands of output rows: for each band, only the input
+   rows that overlap with it are read from the file. Therefore, warping a
+   very large image onto a small target only needs the overlapping strip
+   of the input in memory. */
+static void
+warp_wcsalign_bands(struct warpparams *p)
+{
+  gal_data_t *rows;
+  gal_warp_wcsalign_t *wa=&p->wa;
+  size_t first, number, infirst, innumber, os0=wa->output->dsize[0];
+
+  for(first=0; first<os0; first+=WARP_BAND_ROWS)
+    {
+      /* Find the input rows that are necessary for this band. When the
+         band doesn't overlap with the input, we'll just read the first
+         row (none of the band's pixels overlap with it, so they will be
+         blank). */
+      number = first+WARP_BAND_ROWS<os0 ? WARP_BAND_ROWS : os0-first;
+      gal_warp_wcsalign_inrows(wa, first, number, &infirst, &innumber);
+      if(innumber==0) innumber=1;
+
+      /* Read the rows (in the same type as the input) and warp them. */
+      rows=gal_fits_img_read_rows(p->inputname, p->cp.hdu, infirst,
+                                  innumber, p->cp.minmapsize,
+                                  p->cp.quietmmap);
+      rows=gal_data_copy_to_new_type_free(rows, wa->input->type);
+      wa->inrows=rows;
+      wa->inrowstart=infirst;
+      gal_warp_wcsalign_rows(wa, first, number);
+
+      /* Clean up. */
+      gal_data_free(rows);
+      wa->inrows=NULL;
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 
 
 
@@ -551,9 +609,10 @@ warp(struct warpparams *p)
           gal_timing_report(NULL, "Warping the input image...", 1);
           gettimeofday(&t0, NULL);
         }
-      gal_threads_spin_off(gal_warp_wcsalign_onthread, wa,
-                           wa->output->size, wa->numthreads,
-                           wa->input->minmapsize, wa->input->quietmmap);
+      if(p->input->array)
+        gal_warp_wcsalign_rows(wa, 0, wa->output->dsize[0]);
+      else
+        warp_wcsalign_bands(p);
       if(!p->cp.quiet) gal_timing_report(&t0, "Done", 2);
       p->output=wa->output;
       wa->output=NULL; /* must be here! */
@@ -31,6 +31,11 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #define RELATIVEFLTERROR 1e-6
 
 
+/* Number of output rows to warp in each band when the input is read in
+   bands (only the input rows necessary for each band are in memory). */
+#define WARP_BAND_ROWS 64
+
+
 /* Internal structure. */
 struct iwpparams
 {
@@ -41,7 +41,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/list.h>
 #include <gnuastro/blank.h>
 #include <gnuastro/units.h>
-#include <gnuastro/qsort.h>
+#include <gnuastro/sort.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
@@ -1422,13 +1422,20 @@ arithmetic_where(int flags, gal_data_t *out, gal_data_t *cond,
 /***********************************************************************/
 /***************        Multiple operand operators        **************/
 /***********************************************************************/
+/* Number of values (from all the inputs) in the block of pixels that is
+   processed by each action, and the minimum number of pixels in each
+   block (when there are many inputs). */
+#define MULTIOPERAND_BLOCK_ELEMENTS 16384
+#define MULTIOPERAND_BLOCK_MIN      16
+
 struct multioperandparams
 {
   gal_data_t      *list;        /* List of input datasets.           */
   gal_data_t       *out;        /* Output dataset.                   */
   size_t           dnum;        /* Number of input dataset.          */
   int          operator;        /* Operator to use.                  */
-  uint8_t     *hasblank;        /* Array of 0s or 1s for each input. */
+  uint8_t      anyblank;        /* If any input has blank values.    */
+  size_t      blocksize;        /* Number of pixels in each block.   */
   float              p1;        /* Sigma-cliping parameter 1.        */
   float              p2;        /* Sigma-cliping parameter 2.        */
 };
@@ -1437,421 +1444,196 @@ struct multioperandparams
 
 
 
-#define MULTIOPERAND_MIN(TYPE) {                                        \
-    size_t n, j=0;                                                      \
-    TYPE t, max, *o=p->out->array;                                      \
-    gal_type_max(p->list->type, &max);                                  \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
-      {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        t=max;                                                          \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        for(i=0;i<p->dnum;++i)  /* Loop over each array. */             \
-          {   /* Only for integer types, b==b. */                       \
-            if( p->hasblank[i] && b==b)                                 \
-              {                                                         \
-                if( a[i][j] != b )                                      \
-                  { t = a[i][j] < t ? a[i][j] : t; ++n; }               \
-              }                                                         \
-            else { t = a[i][j] < t ? a[i][j] : t; ++n; }                \
-          }                                                             \
-        o[j] = n ? t : b;  /* No usable elements: set to blank. */      \
-      }                                                                 \
+/* The operators below are called on every pixel: 'v' contains the 'n'
+   usable (non-blank) values of the pixel from all the inputs and 'j' is
+   the index of the pixel in the output. */
+#define MULTIOPERAND_MIN {                                              \
+    t=max;                                                              \
+    for(i=0;i<n;++i) t = v[i] < t ? v[i] : t;                           \
+    ot[j] = n ? t : b;  /* No usable elements: set to blank. */         \
   }
 
-
-
-
-
-#define MULTIOPERAND_MAX(TYPE) {                                        \
-    size_t n, j=0;                                                      \
-    TYPE t, min, *o=p->out->array;                                      \
-    gal_type_min(p->list->type, &min);                                  \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
-      {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        t=min;                                                          \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        for(i=0;i<p->dnum;++i)  /* Loop over each array. */             \
-          {   /* Only for integer types, b==b. */                       \
-            if( p->hasblank[i] && b==b)                                 \
-              {                                                         \
-                if( a[i][j] != b )                                      \
-                  { t = a[i][j] > t ? a[i][j] : t; ++n; }               \
-              }                                                         \
-            else { t = a[i][j] > t ? a[i][j] : t; ++n; }                \
-          }                                                             \
-        o[j] = n ? t : b;  /* No usable elements: set to blank. */      \
-      }                                                                 \
+#define MULTIOPERAND_MAX {                                              \
+    t=min;                                                              \
+    for(i=0;i<n;++i) t = v[i] > t ? v[i] : t;                           \
+    ot[j] = n ? t : b;  /* No usable elements: set to blank. */         \
   }
 
-
-
-
-
-#define MULTIOPERAND_NUM {                                              \
-    int use;                                                            \
-    size_t n, j;                                                        \
-    uint32_t *o=p->out->array;                                          \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
-      {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        for(i=0;i<p->dnum;++i)  /* Loop over each array. */             \
-          {                                                             \
-            /* Only integers and non-NaN floats: v==v is 1. */          \
-            if(p->hasblank[i])                                          \
-              use = ( b==b                                              \
-                      ? ( a[i][j]!=b       ? 1 : 0 )      /* Integer */ \
-                      : ( a[i][j]==a[i][j] ? 1 : 0 ) );   /* Float   */ \
-            else use=1;                                                 \
-                                                                        \
-            /* Increment counter if necessary. */                       \
-            if(use) ++n;                                                \
-          }                                                             \
-        o[j] = n;                                                       \
-      }                                                                 \
-  }
-
-
-
-
-
 #define MULTIOPERAND_SUM {                                              \
-    int use;                                                            \
-    double sum;                                                         \
-    size_t n, j;                                                        \
-    float *o=p->out->array;                                             \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
-      {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        sum=0.0f;                                                       \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        for(i=0;i<p->dnum;++i)  /* Loop over each array. */             \
-          {                                                             \
-            /* Only integers and non-NaN floats: v==v is 1. */          \
-            if(p->hasblank[i])                                          \
-              use = ( b==b                                              \
-                      ? ( a[i][j]!=b       ? 1 : 0 )     /* Integer */  \
-                      : ( a[i][j]==a[i][j] ? 1 : 0 ) );  /* Float   */  \
-            else use=1;                                                 \
-                                                                        \
-            /* Use in sum if necessary. */                              \
-            if(use) { sum += a[i][j]; ++n; }                            \
-          }                                                             \
-        o[j] = n ? sum : NAN; /* Not using 'b', because input type */   \
-      }           /* may be integer, while output is always float. */   \
-  }
-
-
-
-
+    sum=0.0f;                                                           \
+    for(i=0;i<n;++i) sum += v[i];                                       \
+    of[j] = n ? sum : NAN; /* Not using 'b', because input type */      \
+  }                 /* may be integer, while output is always float. */
 
 #define MULTIOPERAND_MEAN {                                             \
-    int use;                                                            \
-    double sum;                                                         \
-    size_t n, j;                                                        \
-    float *o=p->out->array;                                             \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
-      {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        sum=0.0f;                                                       \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        for(i=0;i<p->dnum;++i)  /* Loop over each array. */             \
-          {                                                             \
-            /* Only integers and non-NaN floats: v==v is 1. */          \
-            if(p->hasblank[i])                                          \
-              use = ( b==b                                              \
-                      ? ( a[i][j]!=b       ? 1 : 0 )     /* Integer */  \
-                      : ( a[i][j]==a[i][j] ? 1 : 0 ) );  /* Float   */  \
-            else use=1;                                                 \
-                                                                        \
-            /* Calculate the mean if necessary. */                      \
-            if(use) { sum += a[i][j]; ++n; }                            \
-          }                                                             \
-        o[j] = n ? sum/n : NAN; /* Not using 'b', because input type */ \
-      }             /* may be integer, while output is always float. */ \
+    sum=0.0f;                                                           \
+    for(i=0;i<n;++i) sum += v[i];                                       \
+    of[j] = n ? sum/n : NAN;                                            \
   }
 
-
-
-
-
 #define MULTIOPERAND_STD {                                              \
-    int use;                                                            \
-    size_t n, j;                                                        \
-    double sum, sum2;                                                   \
-    float *o=p->out->array;                                             \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
-      {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        sum=sum2=0.0f;                                                  \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        for(i=0;i<p->dnum;++i)  /* Loop over each array. */             \
-          {                                                             \
-            /* Only integers and non-NaN floats: v==v is 1. */          \
-            if(p->hasblank[i])                                          \
-              use = ( b==b                                              \
-                      ? ( a[i][j]!=b       ? 1 : 0 )     /* Integer */  \
-                      : ( a[i][j]==a[i][j] ? 1 : 0 ) );  /* Float   */  \
-            else use=1;                                                 \
-                                                                        \
-            /* Calculate the necessary parameters if necessary. */      \
-            if(use)                                                     \
-              {                                                         \
-                sum2 += a[i][j] * a[i][j];                              \
-                sum  += a[i][j];                                        \
-                ++n;                                                    \
-              }                                                         \
-          }                                                             \
-        o[j] = n ? sqrt( (sum2-sum*sum/n)/n ) : NAN; /* Not using 'b' */ \
-      } /* because input may be integer, but output is always float. */ \
+    sum=sum2=0.0f;                                                      \
+    for(i=0;i<n;++i) { sum2 += v[i] * v[i]; sum += v[i]; }              \
+    of[j] = n ? sqrt( (sum2-sum*sum/n)/n ) : NAN;                       \
   }
 
-
-
-
-
-#define MULTIOPERAND_MEDIAN(TYPE, QSORT_F) {                            \
-    int use;                                                            \
-    size_t n, j;                                                        \
-    float *o=p->out->array;                                             \
-    TYPE *pixs=gal_pointer_allocate(p->list->type, p->dnum, 0,          \
-                                    __func__, "pixs");                  \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
+#define MULTIOPERAND_MEDIAN {                                           \
+    if(n)                                                               \
       {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        /* Loop over each array: 'i' is input dataset's index. */       \
-        for(i=0;i<p->dnum;++i)                                          \
-          {                                                             \
-            /* Only integers and non-NaN floats: v==v is 1. */          \
-            if(p->hasblank[i])                                          \
-              use = ( b==b                                              \
-                      ? ( a[i][j]!=b       ? 1 : 0 )     /* Integer */  \
-                      : ( a[i][j]==a[i][j] ? 1 : 0 ) );  /* Float   */  \
-            else use=1;                                                 \
-                                                                        \
-            /* Put the value into the array of values. */               \
-            if(use) pixs[n++]=a[i][j];                                  \
-          }                                                             \
-                                                                        \
-        /* Sort all the values for this pixel and return the median. */ \
-        if(n)                                                           \
-          {                                                             \
-            qsort(pixs, n, sizeof *pixs, QSORT_F);                      \
-            o[j] = n%2 ? pixs[n/2] : (pixs[n/2] + pixs[n/2-1])/2 ;      \
-          }                                                             \
-        else                                                            \
-          o[j]=NAN; /* Not using 'b' because input may be integer */    \
-      }                             /* but output is always float.*/    \
-                                                                        \
-    /* Clean up. */                                                     \
-    free(pixs);                                                         \
+        gal_sort_array(v, p->list->type, n, 0, 1);                      \
+        of[j] = n%2 ? v[n/2] : (v[n/2] + v[n/2-1])/2 ;                  \
+      }                                                                 \
+    else of[j]=NAN;                                                     \
   }
 
-
-
-
-
-#define MULTIOPERAND_QUANTILE(TYPE) {                                   \
-    size_t n, j;                                                        \
-    gal_data_t *quantile;                                               \
-    TYPE *o=p->out->array;                                              \
-    TYPE *pixs=gal_pointer_allocate(p->list->type, p->dnum, 0,          \
-                                    __func__, "pixs");                  \
-    gal_data_t *cont=gal_data_alloc(pixs, p->list->type, 1, &p->dnum,   \
-                                    NULL, 0, -1, 1, NULL, NULL, NULL);  \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
+#define MULTIOPERAND_QUANTILE {                                         \
+    if(n)                                                               \
       {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        /* Read the necessay values from each input. */                 \
-        for(i=0;i<p->dnum;++i) pixs[n++]=a[i][j];                       \
-                                                                        \
-        /* If there are any elements, measure the  */                   \
-        if(n)                                                           \
-          {                                                             \
-            /* Calculate the quantile and put it in the output. */      \
-            quantile=gal_statistics_quantile(cont, p->p1, 1);           \
-            memcpy(&o[j], quantile->array,                              \
-                   gal_type_sizeof(p->list->type));                     \
-            gal_data_free(quantile);                                    \
-                                                                        \
-            /* Since we are doing sigma-clipping in place, the size, */ \
-            /* and flags need to be reset. */                           \
-            cont->flag=0;                                               \
-            cont->size=cont->dsize[0]=p->dnum;                          \
-          }                                                             \
-        else                                                            \
-          o[j]=b;                                                       \
+        /* The blank values have already been removed. */              \
+        cont->array=v;                                                  \
+        cont->size=cont->dsize[0]=n;                                    \
+        cont->flag=GAL_DATA_FLAG_BLANK_CH;                              \
+        quantile=gal_statistics_quantile(cont, p->p1, 1);               \
+        memcpy(&ot[j], quantile->array, gal_type_sizeof(p->list->type)); \
+        gal_data_free(quantile);                                        \
       }                                                                 \
-                                                                        \
-    /* Clean up (note that 'pixs' is inside of 'cont'). */              \
-    gal_data_free(cont);                                                \
+    else ot[j]=b;                                                       \
   }
 
-
-
-
-
-#define MULTIOPERAND_SIGCLIP(TYPE) {                                    \
-    size_t n, j;                                                        \
-    gal_data_t *sclip;                                                  \
-    uint32_t *N=p->out->array;                                          \
-    float *sarr, *o=p->out->array;                                      \
-    TYPE *pixs=gal_pointer_allocate(p->list->type, p->dnum, 0,          \
-                                    __func__, "pixs");                  \
-    gal_data_t *cont=gal_data_alloc(pixs, p->list->type, 1, &p->dnum,   \
-                                    NULL, 0, -1, 1, NULL, NULL, NULL);  \
-                                                                        \
-    /* Go over all the pixels assigned to this thread. */               \
-    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
+#define MULTIOPERAND_SIGCLIP {                                          \
+    if(n)                                                               \
       {                                                                 \
-        /* Initialize, 'j' is desired pixel's index. */                 \
-        n=0;                                                            \
-        j=tprm->indexs[tind];                                           \
-                                                                        \
-        /* Read the necessay values from each input. */                 \
-        for(i=0;i<p->dnum;++i) pixs[n++]=a[i][j];                       \
-                                                                        \
-        /* If there are any usable elements, measure the  */            \
-        if(n)                                                           \
+        /* Calculate the sigma-clip (in place) and write it in. */     \
+        cont->array=v;                                                  \
+        cont->size=cont->dsize[0]=n;                                    \
+        cont->flag=GAL_DATA_FLAG_BLANK_CH;                              \
+        sclip=gal_statistics_sigma_clip(cont, p->p1, p->p2, 1, 1);      \
+        sarr=sclip->array;                                              \
+        switch(p->operator)                                             \
           {                                                             \
-            /* Calculate the sigma-clip and write it in. */             \
-            sclip=gal_statistics_sigma_clip(cont, p->p1, p->p2, 1, 1);  \
-            sarr=sclip->array;                                          \
-            switch(p->operator)                                         \
-              {                                                         \
-              case GAL_ARITHMETIC_OP_SIGCLIP_STD:    o[j]=sarr[3]; break;\
-              case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:   o[j]=sarr[2]; break;\
-              case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN: o[j]=sarr[1]; break;\
-              case GAL_ARITHMETIC_OP_SIGCLIP_NUMBER: N[j]=sarr[0]; break;\
-              default:                                                  \
-                error(EXIT_FAILURE, 0, "%s: a bug! the code %d is not " \
-                      "valid for sigma-clipping results", __func__,     \
-                      p->operator);                                     \
-              }                                                         \
-            gal_data_free(sclip);                                       \
-                                                                        \
-            /* Since we are doing sigma-clipping in place, the size, */ \
-            /* and flags need to be reset. */                           \
-            cont->flag=0;                                               \
-            cont->size=cont->dsize[0]=p->dnum;                          \
+          case GAL_ARITHMETIC_OP_SIGCLIP_STD:    of[j]=sarr[3]; break;  \
+          case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:   of[j]=sarr[2]; break;  \
+          case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN: of[j]=sarr[1]; break;  \
+          case GAL_ARITHMETIC_OP_SIGCLIP_NUMBER: ou[j]=sarr[0]; break;  \
+          default:                                                      \
+            error(EXIT_FAILURE, 0, "%s: a bug! the code %d is not "     \
+                  "valid for sigma-clipping results", __func__,         \
+                  p->operator);                                         \
           }                                                             \
-        else                                                            \
-          o[j] = ( p->operator==GAL_ARITHMETIC_OP_SIGCLIP_NUMBER        \
-                   ? 0.0    /* Not using 'b' because input can be an */ \
-                   : NAN );   /* integer but output is always float. */ \
+        gal_data_free(sclip);                                           \
       }                                                                 \
-                                                                        \
-    /* Clean up (note that 'pixs' is inside of 'cont'). */              \
-    gal_data_free(cont);                                                \
-  }
+    else if(p->operator==GAL_ARITHMETIC_OP_SIGCLIP_NUMBER) ou[j]=0;     \
+    else of[j]=NAN;      /* Not using 'b' because input can be an */    \
+  }                      /* integer but output is always float.   */
 
 
 
 
 
-#define MULTIOPERAND_TYPE_SET(TYPE, QSORT_F) {                          \
-    TYPE b, **a;                                                        \
-    gal_data_t *tmp;                                                    \
-    size_t i=0, tind;                                                   \
+/* Each action is a block of 'p->blocksize' contiguous pixels. The values
+   of the block's pixels in all the inputs are first copied into a
+   pixel-major buffer (where the values of each pixel from all the inputs
+   are contiguous). This "transposition" only reads contiguous parts of
+   the inputs and the operators on each pixel only read contiguous memory.
+   It also allows the removal of blank values (and in-place operations
+   like sorting) without touching the inputs. */
+#define MULTIOPERAND_TYPE_SET(TYPE) {                                   \
+    float *sarr, *of=p->out->array;                                     \
+    double sum, sum2;                                                   \
+    uint32_t *ou=p->out->array;                                         \
+    gal_data_t *tmp, *cont=NULL, *quantile, *sclip;                     \
+    size_t i, j, k, n, tind, first, number, dnum=p->dnum;               \
+    TYPE b, t, min, max, *v, *buf, **a, *ot=p->out->array;              \
                                                                         \
-    /* Allocate space to keep the pointers to the arrays of each. */    \
-    /* Input data structure. The operators will increment these */      \
-    /* pointers while parsing them. */                                  \
+    /* Allocate space to keep the pointers to the arrays of each */     \
+    /* input data structure, and the buffer of the block. */            \
     errno=0;                                                            \
-    a=malloc(p->dnum*sizeof *a);                                        \
+    a=malloc(dnum*sizeof *a);                                           \
     if(a==NULL)                                                         \
       error(EXIT_FAILURE, 0, "%s: %zu bytes for 'a'",                   \
-            "MULTIOPERAND_TYPE_SET", p->dnum*sizeof *a);                \
+            "MULTIOPERAND_TYPE_SET", dnum*sizeof *a);                   \
+    buf=gal_pointer_allocate(p->list->type, p->blocksize*dnum, 0,       \
+                             __func__, "buf");                          \
                                                                         \
-    /* Fill in the array pointers and the blank value for this type. */ \
+    /* Fill in the array pointers and the necessary constants. */       \
+    i=0;                                                                \
     gal_blank_write(&b, p->list->type);                                 \
+    gal_type_min(p->list->type, &min);                                  \
+    gal_type_max(p->list->type, &max);                                  \
     for(tmp=p->list;tmp!=NULL;tmp=tmp->next)                            \
       a[i++]=tmp->array;                                                \
                                                                         \
-    /* Do the operation. */                                             \
+    /* The quantile and sigma-clipping operators need a container for */ \
+    /* the values of each pixel ('array' will be set for each pixel). */ \
     switch(p->operator)                                                 \
       {                                                                 \
-      case GAL_ARITHMETIC_OP_MIN:                                       \
-        MULTIOPERAND_MIN(TYPE);                                         \
-        break;                                                          \
-                                                                        \
-      case GAL_ARITHMETIC_OP_MAX:                                       \
-        MULTIOPERAND_MAX(TYPE);                                         \
-        break;                                                          \
-                                                                        \
-      case GAL_ARITHMETIC_OP_NUMBER:                                    \
-        MULTIOPERAND_NUM;                                               \
-        break;                                                          \
-                                                                        \
-      case GAL_ARITHMETIC_OP_SUM:                                       \
-        MULTIOPERAND_SUM;                                               \
-        break;                                                          \
-                                                                        \
-      case GAL_ARITHMETIC_OP_MEAN:                                      \
-        MULTIOPERAND_MEAN;                                              \
-        break;                                                          \
-                                                                        \
-      case GAL_ARITHMETIC_OP_STD:                                       \
-        MULTIOPERAND_STD;                                               \
-        break;                                                          \
-                                                                        \
-      case GAL_ARITHMETIC_OP_MEDIAN:                                    \
-        MULTIOPERAND_MEDIAN(TYPE, QSORT_F);                             \
-        break;                                                          \
-                                                                        \
       case GAL_ARITHMETIC_OP_QUANTILE:                                  \
-        MULTIOPERAND_QUANTILE(TYPE);                                    \
-        break;                                                          \
-                                                                        \
       case GAL_ARITHMETIC_OP_SIGCLIP_STD:                               \
       case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:                              \
       case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:                            \
       case GAL_ARITHMETIC_OP_SIGCLIP_NUMBER:                            \
-        MULTIOPERAND_SIGCLIP(TYPE);                                     \
-        break;                                                          \
+        cont=gal_data_alloc(buf, p->list->type, 1, &dnum, NULL, 0, -1,  \
+                            1, NULL, NULL, NULL);                       \
+      }                                                                 \
                                                                         \
-      default:                                                          \
-        error(EXIT_FAILURE, 0, "%s: operator code %d not recognized",   \
-              "MULTIOPERAND_TYPE_SET", p->operator);                    \
+    /* Go over all the blocks assigned to this thread. */               \
+    for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)         \
+      {                                                                 \
+        /* Pixels of this block. */                                     \
+        first=tprm->indexs[tind]*p->blocksize;                          \
+        number = ( first+p->blocksize > p->out->size                    \
+                   ? p->out->size-first : p->blocksize );               \
+                                                                        \
+        /* Copy the values of each input into the buffer. */            \
+        for(i=0;i<dnum;++i)                                             \
+          for(k=0;k<number;++k)                                         \
+            buf[k*dnum+i]=a[i][first+k];                                \
+                                                                        \
+        /* Go over the pixels ('j' is the pixel's index in output). */  \
+        for(k=0;k<number;++k)                                           \
+          {                                                             \
+            /* Put the usable values (integers that are not blank */    \
+            /* and non-NaN floats) at the start of this pixel's */      \
+            /* values. Note that for floats, b!=b. */                   \
+            j=first+k;                                                  \
+            v=buf+k*dnum;                                               \
+            if(p->anyblank)                                             \
+              {                                                         \
+                for(i=n=0;i<dnum;++i)                                   \
+                  if( b==b ? v[i]!=b : v[i]==v[i] ) v[n++]=v[i];        \
+              }                                                         \
+            else n=dnum;                                                \
+                                                                        \
+            /* Do the operation. */                                     \
+            switch(p->operator)                                         \
+              {                                                         \
+              case GAL_ARITHMETIC_OP_MIN:    MULTIOPERAND_MIN;    break; \
+              case GAL_ARITHMETIC_OP_MAX:    MULTIOPERAND_MAX;    break; \
+              case GAL_ARITHMETIC_OP_NUMBER: ou[j]=n;             break; \
+              case GAL_ARITHMETIC_OP_SUM:    MULTIOPERAND_SUM;    break; \
+              case GAL_ARITHMETIC_OP_MEAN:   MULTIOPERAND_MEAN;   break; \
+              case GAL_ARITHMETIC_OP_STD:    MULTIOPERAND_STD;    break; \
+              case GAL_ARITHMETIC_OP_MEDIAN: MULTIOPERAND_MEDIAN; break; \
+              case GAL_ARITHMETIC_OP_QUANTILE:                          \
+                MULTIOPERAND_QUANTILE;                                  \
+                break;                                                  \
+              case GAL_ARITHMETIC_OP_SIGCLIP_STD:                       \
+              case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:                      \
+              case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:                    \
+              case GAL_ARITHMETIC_OP_SIGCLIP_NUMBER:                    \
+                MULTIOPERAND_SIGCLIP;                                   \
+                break;                                                  \
+              default:                                                  \
+                error(EXIT_FAILURE, 0, "%s: operator code %d not "      \
+                      "recognized", "MULTIOPERAND_TYPE_SET",            \
+                      p->operator);                                     \
+              }                                                         \
+          }                                                             \
       }                                                                 \
                                                                         \
-    /* Clean up. */                                                     \
+    /* Clean up (the container's array is inside 'buf'). */             \
+    if(cont) { cont->array=NULL; gal_data_free(cont); }                 \
+    free(buf);                                                          \
     free(a);                                                            \
   }
 
@@ -1870,36 +1652,16 @@ multioperand_on_thread(void *in_prm)
   /* Do the operation on each thread. */
   switch(p->list->type)
     {
-    case GAL_TYPE_UINT8:
-      MULTIOPERAND_TYPE_SET(uint8_t,   gal_qsort_uint8_i);
-      break;
-    case GAL_TYPE_INT8:
-      MULTIOPERAND_TYPE_SET(int8_t,    gal_qsort_int8_i);
-      break;
-    case GAL_TYPE_UINT16:
-      MULTIOPERAND_TYPE_SET(uint16_t,  gal_qsort_uint16_i);
-      break;
-    case GAL_TYPE_INT16:
-      MULTIOPERAND_TYPE_SET(int16_t,   gal_qsort_int16_i);
-      break;
-    case GAL_TYPE_UINT32:
-      MULTIOPERAND_TYPE_SET(uint32_t,  gal_qsort_uint32_i);
-      break;
-    case GAL_TYPE_INT32:
-      MULTIOPERAND_TYPE_SET(int32_t,   gal_qsort_int32_i);
-      break;
-    case GAL_TYPE_UINT64:
-      MULTIOPERAND_TYPE_SET(uint64_t,  gal_qsort_uint64_i);
-      break;
-    case GAL_TYPE_INT64:
-      MULTIOPERAND_TYPE_SET(int64_t,   gal_qsort_int64_i);
-      break;
-    case GAL_TYPE_FLOAT32:
-      MULTIOPERAND_TYPE_SET(float,     gal_qsort_float32_i);
-      break;
-    case GAL_TYPE_FLOAT64:
-      MULTIOPERAND_TYPE_SET(double,    gal_qsort_float64_i);
-      break;
+    case GAL_TYPE_UINT8:   MULTIOPERAND_TYPE_SET(uint8_t);   break;
+    case GAL_TYPE_INT8:    MULTIOPERAND_TYPE_SET(int8_t);    break;
+    case GAL_TYPE_UINT16:  MULTIOPERAND_TYPE_SET(uint16_t);  break;
+    case GAL_TYPE_INT16:   MULTIOPERAND_TYPE_SET(int16_t);   break;
+    case GAL_TYPE_UINT32:  MULTIOPERAND_TYPE_SET(uint32_t);  break;
+    case GAL_TYPE_INT32:   MULTIOPERAND_TYPE_SET(int32_t);   break;
+    case GAL_TYPE_UINT64:  MULTIOPERAND_TYPE_SET(uint64_t);  break;
+    case GAL_TYPE_INT64:   MULTIOPERAND_TYPE_SET(int64_t);   break;
+    case GAL_TYPE_FLOAT32: MULTIOPERAND_TYPE_SET(float);     break;
+    case GAL_TYPE_FLOAT64: MULTIOPERAND_TYPE_SET(double);    break;
     default:
       error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
             __func__, p->list->type);
@@ -1921,11 +1683,11 @@ static gal_data_t *
 arithmetic_multioperand(int operator, int flags, gal_data_t *list,
                         gal_data_t *params, size_t numthreads)
 {
-  size_t i=0, dnum=1;
   float p1=NAN, p2=NAN;
   struct multioperandparams p;
+  size_t dnum=1, blocksize, numblocks;
   gal_data_t *out, *tmp, *ttmp;
-  uint8_t *hasblank, otype=GAL_TYPE_INVALID;
+  uint8_t anyblank=0, otype=GAL_TYPE_INVALID;
 
 
   /* For generality, 'list' can be a NULL pointer, in that case, this
@@ -2017,12 +1779,19 @@ arithmetic_multioperand(int operator, int flags, gal_data_t *list,
                          NULL, NULL, NULL);
 
 
-  /* hasblank is used to see if a blank value should be checked for each
-     list element or not. */
-  hasblank=gal_pointer_allocate(GAL_TYPE_UINT8, dnum, 0, __func__,
-                                "hasblank");
+  /* 'anyblank' is used to see if blank values should be removed from the
+     values of each pixel or not. */
   for(tmp=list;tmp!=NULL;tmp=tmp->next)
-    hasblank[i++]=gal_blank_present(tmp, 0);
+    if( gal_blank_present(tmp, 0) ) { anyblank=1; break; }
+
+
+  /* Each thread will work on blocks of contiguous pixels, the size of the
+     blocks is set such that the values of all the pixels of the block
+     (from all the inputs) fit in the cache (see 'MULTIOPERAND_TYPE_SET'). */
+  blocksize = ( dnum*MULTIOPERAND_BLOCK_MIN > MULTIOPERAND_BLOCK_ELEMENTS
+                ? MULTIOPERAND_BLOCK_MIN
+                : MULTIOPERAND_BLOCK_ELEMENTS/dnum );
+  numblocks = out->size ? (out->size-1)/blocksize+1 : 0;
 
 
   /* Set the parameters necessary for multithreaded operation and spin them
@@ -2033,8 +1802,9 @@ arithmetic_multioperand(int operator, int flags, gal_data_t *list,
   p.list=list;
   p.dnum=dnum;
   p.operator=operator;
-  p.hasblank=hasblank;
-  gal_threads_spin_off(multioperand_on_thread, &p, out->size, numthreads,
+  p.anyblank=anyblank;
+  p.blocksize=blocksize;
+  gal_threads_spin_off(multioperand_on_thread, &p, numblocks, numthreads,
                        list->minmapsize, list->quietmmap);
 
 
@@ -2054,7 +1824,6 @@ arithmetic_multioperand(int operator, int flags, gal_data_t *list,
         }
       if(params) gal_list_data_free(params);
     }
-  free(hasblank);
   return out;
 }
 
@@ -2084,7 +1853,9 @@ arithmetic_multioperand(int operator, int flags, gal_data_t *list,
    don't need to be checked (the floating point standard will do the job
    for us). It is also not necessary to check blanks in bitwise operators,
    but bitwise operators have their own macro
-   ('BINARY_OP_INCR_OT_RT_LT_SET') which doesn' use 'checkblanks'.*/
+   ('BINARY_INT_OP_OT_RT_LT_SET') which doesn't use 'checkblanks'. When
+   the operator is run on multiple threads, this is called only once (on
+   the full inputs) and the result is used by all threads.*/
 int
 gal_arithmetic_binary_checkblank(gal_data_t *l, gal_data_t *r)
 {
@@ -2185,15 +1956,132 @@ arithmetic_binary_int_sanity_check(gal_data_t *l, gal_data_t *r,
 
 
 
+/* Call the proper function for the operator. Since they heavily involve
+   macros, their compilation can be very large if they are in a single
+   function and file. So there is a separate C source and header file for
+   each of these functions. */
+static void
+arithmetic_binary_run(int operator, gal_data_t *l, gal_data_t *r,
+                      gal_data_t *o)
+{
+  switch(operator)
+    {
+    case GAL_ARITHMETIC_OP_PLUS:     arithmetic_plus(l, r, o);     break;
+    case GAL_ARITHMETIC_OP_MINUS:    arithmetic_minus(l, r, o);    break;
+    case GAL_ARITHMETIC_OP_MULTIPLY: arithmetic_multiply(l, r, o); break;
+    case GAL_ARITHMETIC_OP_DIVIDE:   arithmetic_divide(l, r, o);   break;
+    case GAL_ARITHMETIC_OP_LT:       arithmetic_lt(l, r, o);       break;
+    case GAL_ARITHMETIC_OP_LE:       arithmetic_le(l, r, o);       break;
+    case GAL_ARITHMETIC_OP_GT:       arithmetic_gt(l, r, o);       break;
+    case GAL_ARITHMETIC_OP_GE:       arithmetic_ge(l, r, o);       break;
+    case GAL_ARITHMETIC_OP_EQ:       arithmetic_eq(l, r, o);       break;
+    case GAL_ARITHMETIC_OP_NE:       arithmetic_ne(l, r, o);       break;
+    case GAL_ARITHMETIC_OP_AND:      arithmetic_and(l, r, o);      break;
+    case GAL_ARITHMETIC_OP_OR:       arithmetic_or(l, r, o);       break;
+    case GAL_ARITHMETIC_OP_BITAND:   arithmetic_bitand(l, r, o);   break;
+    case GAL_ARITHMETIC_OP_BITOR:    arithmetic_bitor(l, r, o);    break;
+    case GAL_ARITHMETIC_OP_BITXOR:   arithmetic_bitxor(l, r, o);   break;
+    case GAL_ARITHMETIC_OP_BITLSH:   arithmetic_bitlsh(l, r, o);   break;
+    case GAL_ARITHMETIC_OP_BITRSH:   arithmetic_bitrsh(l, r, o);   break;
+    case GAL_ARITHMETIC_OP_MODULO:   arithmetic_modulo(l, r, o);   break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! please contact us at %s to address "
+            "the problem. %d is not a valid operator code", __func__,
+            PACKAGE_BUGREPORT, operator);
+    }
+}
+
+
+
+
+
+/* Parameters for multi-threaded binary operators. */
+struct arithmetic_binary_params
+{
+  int        operator;  /* The operator to apply.                        */
+  size_t    chunksize;  /* Number of elements in each chunk.             */
+  gal_data_t       *l;  /* Left operand.                                 */
+  gal_data_t       *r;  /* Right operand.                                */
+  gal_data_t       *o;  /* Output.                                       */
+};
+
+
+
+
+
+/* Put a light-weight "view" into the elements of 'in' (starting from
+   'start' and with 'size' elements) in 'view' (that is already
+   allocated). The view doesn't own its array, so it must not be freed. */
+static void
+arithmetic_binary_chunk(gal_data_t *in, gal_data_t *view, size_t start,
+                        size_t *size)
+{
+  memset(view, 0, sizeof *view);
+  view->ndim=1;
+  view->dsize=size;
+  view->size=*size;
+  view->type=in->type;
+  view->flag=in->flag;
+  view->quietmmap=in->quietmmap;
+  view->minmapsize=in->minmapsize;
+  view->array=gal_pointer_increment(in->array, start, in->type);
+}
+
+
+
+
+
+/* Apply the operator on the chunks that are given to this thread. When
+   an operand is a single number, it is used directly (not chunked). */
+static void *
+arithmetic_binary_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct arithmetic_binary_params *p=tprm->params;
+
+  size_t i, start, size;
+  gal_data_t lv, rv, ov, *l, *r;
+
+  /* Go over all the chunks that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Set the range of this chunk (the last chunk may be smaller). */
+      start = tprm->indexs[i] * p->chunksize;
+      size  = ( start + p->chunksize > p->o->size
+                ? p->o->size - start
+                : p->chunksize );
+
+      /* Set the views and do the operation. */
+      arithmetic_binary_chunk(p->o, &ov, start, &size);
+      if(p->l->size>1) { arithmetic_binary_chunk(p->l, &lv, start, &size);
+                         l=&lv; }
+      else               l=p->l;
+      if(p->r->size>1) { arithmetic_binary_chunk(p->r, &rv, start, &size);
+                         r=&rv; }
+      else               r=p->r;
+      arithmetic_binary_run(p->operator, l, r, &ov);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
 static gal_data_t *
-arithmetic_binary(int operator, int flags, gal_data_t *l, gal_data_t *r)
+arithmetic_binary(int operator, int flags, gal_data_t *l, gal_data_t *r,
+                  size_t numthreads)
 {
   /* Read the variable arguments. 'lo' and 'ro' keep the original data, in
      case their type isn't built (based on configure options are configure
      time). */
   int32_t otype;
   gal_data_t *o=NULL;
-  size_t out_size, minmapsize;
+  size_t nt, out_size, minmapsize;
+  struct arithmetic_binary_params bprm;
   int quietmmap=l->quietmmap && r->quietmmap;
 
 
@@ -2260,35 +2148,30 @@ arithmetic_binary(int operator, int flags, gal_data_t *l, gal_data_t *r)
                        0, minmapsize, quietmmap, NULL, NULL, NULL );
 
 
-  /* Call the proper function for the operator. Since they heavily involve
-     macros, their compilation can be very large if they are in a single
-     function and file. So there is a separate C source and header file for
-     each of these functions. */
-  switch(operator)
+  /* Apply the operator. When the output is large enough (and more than
+     one thread is requested), it is broken into contiguous chunks (one
+     for each thread) and each chunk is done on a separate thread. The
+     check for blank values is done once on the full inputs here (the
+     result is kept in their flags and copied to each chunk's view), not
+     separately for each chunk. */
+  if( numthreads>1 && out_size >= 2*ARITHMETIC_BINARY_MIN_PER_THREAD )
     {
-    case GAL_ARITHMETIC_OP_PLUS:     arithmetic_plus(l, r, o);     break;
-    case GAL_ARITHMETIC_OP_MINUS:    arithmetic_minus(l, r, o);    break;
-    case GAL_ARITHMETIC_OP_MULTIPLY: arithmetic_multiply(l, r, o); break;
-    case GAL_ARITHMETIC_OP_DIVIDE:   arithmetic_divide(l, r, o);   break;
-    case GAL_ARITHMETIC_OP_LT:       arithmetic_lt(l, r, o);       break;
-    case GAL_ARITHMETIC_OP_LE:       arithmetic_le(l, r, o);       break;
-    case GAL_ARITHMETIC_OP_GT:       arithmetic_gt(l, r, o);       break;
-    case GAL_ARITHMETIC_OP_GE:       arithmetic_ge(l, r, o);       break;
-    case GAL_ARITHMETIC_OP_EQ:       arithmetic_eq(l, r, o);       break;
-    case GAL_ARITHMETIC_OP_NE:       arithmetic_ne(l, r, o);       break;
-    case GAL_ARITHMETIC_OP_AND:      arithmetic_and(l, r, o);      break;
-    case GAL_ARITHMETIC_OP_OR:       arithmetic_or(l, r, o);       break;
-    case GAL_ARITHMETIC_OP_BITAND:   arithmetic_bitand(l, r, o);   break;
-    case GAL_ARITHMETIC_OP_BITOR:    arithmetic_bitor(l, r, o);    break;
-    case GAL_ARITHMETIC_OP_BITXOR:   arithmetic_bitxor(l, r, o);   break;
-    case GAL_ARITHMETIC_OP_BITLSH:   arithmetic_bitlsh(l, r, o);   break;
-    case GAL_ARITHMETIC_OP_BITRSH:   arithmetic_bitrsh(l, r, o);   break;
-    case GAL_ARITHMETIC_OP_MODULO:   arithmetic_modulo(l, r, o);   break;
-    default:
-      error(EXIT_FAILURE, 0, "%s: a bug! please contact us at %s to address "
-            "the problem. %d is not a valid operator code", __func__,
-            PACKAGE_BUGREPORT, operator);
+      /* Set the number of elements in each chunk. */
+      nt = out_size/ARITHMETIC_BINARY_MIN_PER_THREAD;
+      if(nt>numthreads) nt=numthreads;
+      bprm.chunksize = out_size/nt + (out_size%nt ? 1 : 0);
+
+      /* Do the operation on multiple threads. */
+      gal_arithmetic_binary_checkblank(l, r);
+      bprm.l=l;
+      bprm.r=r;
+      bprm.o=o;
+      bprm.operator=operator;
+      gal_threads_spin_off(arithmetic_binary_on_thread, &bprm, nt, nt,
+                           minmapsize, quietmmap);
     }
+  else
+    arithmetic_binary_run(operator, l, r, o);
 
 
   /* Clean up if necessary. Note that if the operation was requested to be
@@ -3529,7 +3412,7 @@ gal_arithmetic(int operator, size_t numthreads, int flags, ...)
     case GAL_ARITHMETIC_OP_OR:
       d1 = va_arg(va, gal_data_t *);
       d2 = va_arg(va, gal_data_t *);
-      out=arithmetic_binary(operator, flags, d1, d2);
+      out=arithmetic_binary(operator, flags, d1, d2, numthreads);
       break;
 
     case GAL_ARITHMETIC_OP_NOT:
@@ -3664,7 +3547,7 @@ gal_arithmetic(int operator, size_t numthreads, int flags, ...)
     case GAL_ARITHMETIC_OP_MODULO:
       d1 = va_arg(va, gal_data_t *);
       d2 = va_arg(va, gal_data_t *);
-      out=arithmetic_binary(operator, flags, d1, d2);
+      out=arithmetic_binary(operator, flags, d1, d2, numthreads);
       break;
     case GAL_ARITHMETIC_OP_BITNOT:
       d1 = va_arg(va, gal_data_t *);
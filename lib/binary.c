@@ -33,6 +33,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/blank.h>
 #include <gnuastro/binary.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
 
 
@@ -44,220 +45,433 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 /*********************************************************************/
-/*****************      Erosion and dilation      ********************/
+/*****************        Bit-packed images       ********************/
 /*********************************************************************/
-static void
-binary_erode_dilate_1d(gal_data_t *input, int dilate0_erode1)
+/* Number of rows in each band of a bit-packed image: the bands are the
+   units of work that are given to each thread. */
+#define BINARY_PACKED_BAND_ROWS 128
+
+/* Maximum number of erosions/dilations that are done on one band before
+   writing it back. Each band needs this many extra rows on each side to
+   be independent of its neighbors. */
+#define BINARY_PACKED_MAX_FUSE 8
+
+/* Parameters for the bit-packed erosion/dilation threads. */
+struct binary_packed_params
 {
-  size_t i, nr=input->dsize[0];
-  uint8_t f, b, *pt, *fpt, *byt=input->array;
+  gal_binary_packed_t *packed;  /* Input planes of this pass.             */
+  uint64_t               *ofg;  /* Output foreground plane.               */
+  uint64_t               *obg;  /* Output background plane.               */
+  uint8_t              *steps;  /* Each step's 'dilate0_erode1' value.    */
+  size_t            numsteps;   /* Number of steps in this pass.          */
+  int           connectivity;   /* Connectivity of the neighbors.         */
+};
 
-  /* Do a sanity check: */
-  if(dilate0_erode1!=1 && dilate0_erode1!=0)
-    error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s so we can "
-          "fix this problem. The value to 'dilate0_erode1' is %u while it "
-          "should be 0 or 1", __func__, PACKAGE_BUGREPORT, dilate0_erode1);
 
-  /* Set the foreground and background values. */
-  if(dilate0_erode1==0) {f=1; b=0;}
-  else                  {f=0; b=1;}
 
-  /* Check the two extremes. */
-  if(byt[0]==b && byt[1]==f ) byt[0]=GAL_BINARY_TMP_VALUE;
-  if(nr>2)
-    if(byt[nr-1]==b && byt[nr-2]==f) byt[nr-1] = GAL_BINARY_TMP_VALUE;
 
-  /* Go over the full array. */
-  for(i=1;i<nr;++i)
-    if( byt[i]==b && ( byt[i-1]==f || byt[i+1]==f ) )
-      byt[i]=GAL_BINARY_TMP_VALUE;
 
-  /* Set all the changed pixels to the proper values: */
-  fpt=(pt=byt)+nr;
-  do *pt = *pt==GAL_BINARY_TMP_VALUE ? f : *pt; while(++pt<fpt);
+/* Return the eight bytes starting at 'in' as one word (the first byte in
+   the lowest bits, independent of the host's byte order). */
+static uint64_t
+binary_pack_bytes(uint8_t *in)
+{
+  return ( (uint64_t)in[0]       | (uint64_t)in[1] << 8
+           | (uint64_t)in[2] << 16 | (uint64_t)in[3] << 24
+           | (uint64_t)in[4] << 32 | (uint64_t)in[5] << 40
+           | (uint64_t)in[6] << 48 | (uint64_t)in[7] << 56 );
 }
 
 
 
 
 
-static void
-binary_erode_dilate_2d_4con(gal_data_t *input, int dilate0_erode1)
+/* Bit 'i' of the output is set when byte 'i' of 'x' is zero. The
+   high-bit of each zero byte is found without carries between bytes,
+   then the multiplication gathers the eight high-bits into the top
+   byte. */
+static uint64_t
+binary_pack_zero_bytes(uint64_t x)
 {
-  uint8_t f, b, *pt, *fpt, *byt=input->array;
-  size_t i, j, ind, nr=input->dsize[0], nc=input->dsize[1];
+  uint64_t low7=0x7f7f7f7f7f7f7f7fULL;
+  uint64_t y = ~( ((x & low7) + low7) | x | low7 );
+  return ( (y>>7) * 0x0102040810204080ULL ) >> 56;
+}
 
-  /* Do a sanity check: */
-  if(dilate0_erode1!=1 && dilate0_erode1!=0)
-    error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s so we can "
-          "fix this problem. The value to 'dilate0_erode1' is %u while it "
-          "should be 0 or 1", __func__, PACKAGE_BUGREPORT, dilate0_erode1);
 
-  /* Set the foreground and background values. */
-  if(dilate0_erode1==0) {f=1; b=0;}
-  else                  {f=0; b=1;}
 
-  /* Check the 4 corners: */
-  if(byt[0]==b && (byt[1]==f || byt[nc]==f) )
-    byt[0]=GAL_BINARY_TMP_VALUE;
 
-  if(byt[nc-1]==b && (byt[nc-2]==f || byt[2*nc-1]==f))
-    byt[nc-1]=GAL_BINARY_TMP_VALUE;
 
-  if(byt[(nr-1)*nc]==b
-     && (byt[(nr-2)*nc]==f || byt[(nr-1)*nc+1]==f) )
-    byt[(nr-1)*nc]=GAL_BINARY_TMP_VALUE;
+/* Convert a 1D or 2D 'uint8_t' dataset into bit-packed form. A 1D
+   dataset is treated as a single row. */
+gal_binary_packed_t *
+gal_binary_pack(gal_data_t *input)
+{
+  uint64_t f, b, x;
+  gal_binary_packed_t *out;
+  size_t i, j, k, w, nr, nc, nw, end;
+  uint8_t *row, *byt=input->array;
+
+  /* Sanity checks. */
+  if(input->type!=GAL_TYPE_UINT8)
+    error(EXIT_FAILURE, 0, "%s: the input must have an unsigned 8-bit "
+          "integer type, but it has a type of '%s'", __func__,
+          gal_type_name(input->type, 1));
+  if(input->ndim>2)
+    error(EXIT_FAILURE, 0, "%s: currently only works on 1D or 2D "
+          "datasets, but the input has %zu dimensions", __func__,
+          input->ndim);
+  if(input->block)
+    error(EXIT_FAILURE, 0, "%s: currently only works on a fully "
+          "allocated block of memory, but the input is a tile (its 'block' "
+          "element is not NULL)", __func__);
+
+  /* Allocate the output. */
+  errno=0;
+  out=malloc(sizeof *out);
+  if(out==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'out'", __func__,
+          sizeof *out);
+  nr = out->dsize[0] = input->ndim==1 ? 1 : input->dsize[0];
+  nc = out->dsize[1] = input->ndim==1 ? input->dsize[0] : input->dsize[1];
+  nw = out->nwords = (nc+GAL_BINARY_PACKED_WORD_BITS-1)
+                     / GAL_BINARY_PACKED_WORD_BITS;
+  out->fg=gal_pointer_allocate(GAL_TYPE_UINT64, 2*nr*nw, 0, __func__,
+                               "out->fg");
+  out->bg=out->fg+nr*nw;
+
+  /* Set the bits of each word. */
+  for(i=0;i<nr;++i)
+    for(w=0;w<nw;++w)
+      {
+        f=b=0;
+        row=byt+i*nc+w*GAL_BINARY_PACKED_WORD_BITS;
+        end = ( (w+1)*GAL_BINARY_PACKED_WORD_BITS<nc
+                ? GAL_BINARY_PACKED_WORD_BITS
+                : nc-w*GAL_BINARY_PACKED_WORD_BITS );
+        if(end==GAL_BINARY_PACKED_WORD_BITS)
+          for(k=0;k<GAL_BINARY_PACKED_WORD_BITS;k+=8)
+            {
+              x=binary_pack_bytes(row+k);
+              f |= binary_pack_zero_bytes(x ^ 0x0101010101010101ULL) << k;
+              b |= binary_pack_zero_bytes(x) << k;
+            }
+        else
+          for(j=0;j<end;++j)
+            {
+              f |= (uint64_t)(row[j]==1) << j;
+              b |= (uint64_t)(row[j]==0) << j;
+            }
+        out->fg[i*nw+w]=f;
+        out->bg[i*nw+w]=b;
+      }
+
+  /* Return the bit-packed image. */
+  return out;
+}
 
-  if(byt[nr*nc-1]==b
-     && (byt[nr*nc-2]==f || byt[nr*nc-1-nc]==f) )
-    byt[nr*nc-1]=GAL_BINARY_TMP_VALUE;
 
-  /* Check the 4 sides: */
-  for(j=1;j<nc-1;++j)
-    if(byt[j]==b
-       && (byt[j+1]==f || byt[j-1]==f || byt[j+nc]==f) )
-      byt[j]=GAL_BINARY_TMP_VALUE;
 
-  for(j=1;j<nc-1;++j)
-    {
-      ind=(nr-1)*nc+j;
-      if(byt[ind]==b
-         && (byt[ind+1]==f || byt[ind-1]==f || byt[ind-nc]==f) )
-        byt[ind]=GAL_BINARY_TMP_VALUE;
-    }
 
-  for(i=1;i<nr-1;++i)
+
+/* Write the bit-packed image into a 'uint8_t' dataset. If 'out' is NULL,
+   a new dataset will be allocated and the pixels that were neither 0 nor
+   1 will be blank. Otherwise, only the pixels that are 0 or 1 in the
+   bit-packed image will be written into 'out'. */
+gal_data_t *
+gal_binary_unpack(gal_binary_packed_t *packed, gal_data_t *out)
+{
+  uint64_t f, b;
+  uint8_t *row, *byt;
+  size_t i, j, w, end, nr=packed->dsize[0], nc=packed->dsize[1];
+  size_t nw=packed->nwords;
+
+  /* Allocate the output or check the given one. */
+  if(out)
     {
-      ind=i*nc;
-      if(byt[ind]==b
-         && (byt[ind+1]==f || byt[ind+nc]==f || byt[ind-nc]==f) )
-        byt[ind]=GAL_BINARY_TMP_VALUE;
+      if(out->type!=GAL_TYPE_UINT8)
+        error(EXIT_FAILURE, 0, "%s: the output must have an unsigned "
+              "8-bit integer type, but it has a type of '%s'", __func__,
+              gal_type_name(out->type, 1));
+      if(out->size!=nr*nc || out->block)
+        error(EXIT_FAILURE, 0, "%s: the output must be a fully allocated "
+              "block of memory with %zu elements", __func__, nr*nc);
     }
-
-  for(i=1;i<nr-1;++i)
+  else
     {
-      ind=(i+1)*nc-1;
-      if(byt[ind]==b
-         && (byt[ind-1]==f || byt[ind+nc]==f || byt[ind-nc]==f) )
-        byt[ind]=GAL_BINARY_TMP_VALUE;
+      out=gal_data_alloc(NULL, GAL_TYPE_UINT8, nr==1 ? 1 : 2,
+                         nr==1 ? &packed->dsize[1] : packed->dsize, NULL,
+                         0, -1, 1, NULL, NULL, NULL);
+      gal_blank_initialize(out);
     }
 
-  /* Check the body: */
-  for(i=1;i<nr-1;++i)
-    for(j=1;j<nc-1;++j)
+  /* Write the pixels that are 0 or 1. */
+  byt=out->array;
+  for(i=0;i<nr;++i)
+    for(w=0;w<nw;++w)
       {
-        ind=i*nc+j;
-        if(byt[ind]==b
-           && (byt[ind-1]==f     || byt[ind+1]==f
-               || byt[ind+nc]==f || byt[ind-nc]==f) )
-          byt[ind]=GAL_BINARY_TMP_VALUE;
+        f=packed->fg[i*nw+w];
+        b=packed->bg[i*nw+w];
+        if( (f|b)==0 ) continue;
+        row=byt+i*nc+w*GAL_BINARY_PACKED_WORD_BITS;
+        end = ( (w+1)*GAL_BINARY_PACKED_WORD_BITS<nc
+                ? GAL_BINARY_PACKED_WORD_BITS
+                : nc-w*GAL_BINARY_PACKED_WORD_BITS );
+        if( end==GAL_BINARY_PACKED_WORD_BITS && (f|b)==(uint64_t)-1 )
+          for(j=0;j<GAL_BINARY_PACKED_WORD_BITS;++j)
+            row[j] = (f>>j) & 1;
+        else
+          for(j=0;j<end;++j)
+            if( (f|b) & ((uint64_t)1<<j) )
+              row[j] = (f>>j) & 1;
       }
 
-  /* Set all the changed pixels to the proper values: */
-  fpt=(pt=byt)+nr*nc;
-  do *pt = *pt==GAL_BINARY_TMP_VALUE ? f : *pt; while(++pt<fpt);
+  /* Return the output. */
+  return out;
 }
 
 
 
 
 
-/* 8 connected dilation and erosion. b0_f1==0: Dilate the
-   foreground. b0_f1==1: Erode the foreground. */
-static void
-binary_erode_dilate_2d_8con(gal_data_t *input, unsigned char dilate0_erode1)
+void
+gal_binary_packed_free(gal_binary_packed_t *packed)
 {
-  uint8_t f, b, *pt, *fpt, *byt=input->array;
-  size_t i, j, ind, nr=input->dsize[0], nc=input->dsize[1];
+  if(packed==NULL) return;
+  free(packed->fg);       /* The 'bg' plane is in the same allocation. */
+  free(packed);
+}
+
+
 
-  /* Do a sanity check: */
-  if(dilate0_erode1!=1 && dilate0_erode1!=0)
-    error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s so we can fix "
-          "this problem. The value to dilate0_erode1 is %u while it should "
-          "be 0 or 1", __func__, PACKAGE_BUGREPORT, dilate0_erode1);
 
-  /* Set the foreground and background values: */
-  if(dilate0_erode1==0) {f=1; b=0;}
-  else                  {f=0; b=1;}
 
-  /* Check the 4 corners: */
-  if(byt[0]==b && (byt[1]==f
-                   || byt[nc]==f || byt[nc+1]==f) )
-    byt[0]=GAL_BINARY_TMP_VALUE;
-
-  if(byt[nc-1]==b && (byt[nc-2]==f
-                      || byt[2*nc-1]==f
-                      || byt[2*nc-2]==f) )
-    byt[nc-1]=GAL_BINARY_TMP_VALUE;
-
-  if(byt[(nr-1)*nc]==b
-     && ( byt[(nr-2)*nc]==f || byt[(nr-1)*nc+1]==f
-          || byt[(nr-2)*nc+1]==f) )
-    byt[(nr-1)*nc]=GAL_BINARY_TMP_VALUE;
-
-  if(byt[nr*nc-1]==b
-     && ( byt[nr*nc-2]==f || byt[nr*nc-1-nc]==f
-          || byt[nr*nc-2-nc]==f) )
-    byt[nr*nc-1]=GAL_BINARY_TMP_VALUE;
-
-  /* Check the 4 sides: */
-  for(j=1;j<nc-1;++j)
-    if(byt[j]==b
-       && ( byt[j+1]==f || byt[j-1]==f || byt[j+nc]==f
-            || byt[j-1+nc]==f || byt[j+1+nc]==f) )
-      byt[j]=GAL_BINARY_TMP_VALUE;
-
-  for(j=1;j<nc-1;++j)
+/* One erosion or dilation step on one row of words: the 'spread' plane
+   (foreground in dilation, background in erosion) is spread into the
+   'target' plane. 'su', 'sc' and 'sd' are the spreading rows above, on
+   and below the row, 'tc' is the target row, 'so' and 'to' are the
+   outputs. Bit 'j' of each word is column 'j' of that word, so the
+   left/right neighbors are found by shifting the words (and taking the
+   edge bit from the neighboring word). */
+static void
+binary_packed_row(uint64_t *su, uint64_t *sc, uint64_t *sd, uint64_t *tc,
+                  uint64_t *so, uint64_t *to, size_t nw, int connectivity)
+{
+  size_t w;
+  uint64_t prev=0, cur, next, ngb, change;
+
+  /* With 8-connectivity, the diagonal neighbors are the horizontal
+     neighbors of the rows above and below, so the three rows are merged
+     before shifting. */
+  cur = connectivity==1 ? sc[0] : su[0]|sc[0]|sd[0];
+  for(w=0;w<nw;++w)
     {
-      ind=(nr-1)*nc+j;
-      if(byt[ind]==b
-         && ( byt[ind+1]==f || byt[ind-1]==f || byt[ind-nc]==f
-              || byt[ind-1-nc]==f || byt[ind+1-nc]==f) )
-        byt[ind]=GAL_BINARY_TMP_VALUE;
+      next = ( w+1<nw
+               ? ( connectivity==1 ? sc[w+1] : su[w+1]|sc[w+1]|sd[w+1] )
+               : 0 );
+      ngb = (cur<<1) | (prev>>63) | (cur>>1) | (next<<63);
+      ngb |= connectivity==1 ? su[w]|sd[w] : cur;
+      change = tc[w] & ngb;
+      so[w]  = sc[w] | change;
+      to[w]  = tc[w] & ~change;
+      prev=cur;
+      cur=next;
     }
+}
 
-  for(i=1;i<nr-1;++i)
+
+
+
+
+/* Do all the steps of one pass on the bands that are assigned to this
+   thread. Each band is copied into the thread's buffers along with
+   'numsteps' rows on each side (that are needed for the band's final
+   value), so all the steps are done on a small (cache-friendly) region
+   before going to the next band. */
+static void *
+binary_packed_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct binary_packed_params *p=(struct binary_packed_params *)tprm->params;
+
+  gal_binary_packed_t *pk=p->packed;
+  size_t nr=pk->dsize[0], nw=pk->nwords, rowbytes=nw*sizeof *pk->fg;
+  size_t i, r, s, r0, r1, e0, e1, lo, hi, grow, numrows;
+  size_t maxrows=BINARY_PACKED_BAND_ROWS+2*p->numsteps;
+  uint64_t *buf, *zero, *cf, *cb, *nf, *nb, *sa, *ta, *sb, *tb, *tmp;
+
+  /* Allocate the buffers: the two planes of the current and next steps,
+     and one row of zeros for the rows outside the image. */
+  buf=gal_pointer_allocate(GAL_TYPE_UINT64, (4*maxrows+1)*nw, 0,
+                           __func__, "buf");
+  zero=buf+4*maxrows*nw;
+  memset(zero, 0, rowbytes);
+
+  /* Go over all the bands of this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
     {
-      ind=i*nc;
-      if(byt[ind]==b
-         && ( byt[ind+1]==f || byt[ind+nc]==f || byt[ind-nc]==f
-              || byt[ind+1-nc]==f || byt[ind+1+nc]==f) )
-        byt[ind]=GAL_BINARY_TMP_VALUE;
+      /* Rows of this band ('r0' to 'r1') and the rows that its final
+         value depends on ('e0' to 'e1'). */
+      r0=tprm->indexs[i]*BINARY_PACKED_BAND_ROWS;
+      r1 = r0+BINARY_PACKED_BAND_ROWS<nr ? r0+BINARY_PACKED_BAND_ROWS : nr;
+      e0 = r0>p->numsteps ? r0-p->numsteps : 0;
+      e1 = r1+p->numsteps<nr ? r1+p->numsteps : nr;
+      numrows=e1-e0;
+
+      /* Copy the rows into the buffer. */
+      cf=buf; cb=cf+maxrows*nw; nf=cb+maxrows*nw; nb=nf+maxrows*nw;
+      memcpy(cf, pk->fg+e0*nw, numrows*rowbytes);
+      memcpy(cb, pk->bg+e0*nw, numrows*rowbytes);
+
+      /* Do the steps. After each step, the rows that are closer than the
+         number of remaining steps to the band's edge are no longer
+         needed. */
+      for(s=0;s<p->numsteps;++s)
+        {
+          grow=p->numsteps-1-s;
+          lo = r0-e0>grow ? r0-e0-grow : 0;
+          hi = r1-e0+grow<numrows ? r1-e0+grow : numrows;
+          if(p->steps[s]) {sa=cb; ta=cf; sb=nb; tb=nf;}
+          else            {sa=cf; ta=cb; sb=nf; tb=nb;}
+          for(r=lo;r<hi;++r)
+            binary_packed_row(r ? sa+(r-1)*nw : zero, sa+r*nw,
+                              r+1<numrows ? sa+(r+1)*nw : zero,
+                              ta+r*nw, sb+r*nw, tb+r*nw, nw,
+                              p->connectivity);
+          tmp=cf; cf=nf; nf=tmp;
+          tmp=cb; cb=nb; nb=tmp;
+        }
+
+      /* Write the band's rows into the output. */
+      memcpy(p->ofg+r0*nw, cf+(r0-e0)*nw, (r1-r0)*rowbytes);
+      memcpy(p->obg+r0*nw, cb+(r0-e0)*nw, (r1-r0)*rowbytes);
     }
 
-  for(i=1;i<nr-1;++i)
+  /* Clean up, wait until all other threads finish, then return. */
+  free(buf);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Do 'numerode' erosions, followed by 'numdilate' dilations on the
+   bit-packed image. */
+static void
+binary_packed_erode_dilate(gal_binary_packed_t *packed, size_t numerode,
+                           size_t numdilate, int connectivity,
+                           size_t numthreads)
+{
+  uint8_t *steps;
+  struct binary_packed_params p;
+  size_t done, nbands, numsteps=numerode+numdilate;
+  size_t planesize=packed->dsize[0]*packed->nwords;
+  uint64_t *out, *tmp;
+
+  /* Sanity check. */
+  if(connectivity!=1 && connectivity!=2)
+    error(EXIT_FAILURE, 0, "%s: %d not acceptable for connectivity "
+          "in a 2D dataset", __func__, connectivity);
+  if( packed->dsize[0]==1 && connectivity!=1 )
+    error(EXIT_FAILURE, 0, "%s: %d not acceptable for connectivity "
+          "in a 1D dataset", __func__, connectivity);
+  if(numsteps==0) return;
+
+  /* Set the steps. */
+  steps=gal_pointer_allocate(GAL_TYPE_UINT8, numsteps, 0, __func__,
+                             "steps");
+  memset(steps, 1, numerode);
+  memset(steps+numerode, 0, numdilate);
+
+  /* Do the passes: the output of each pass is the input of the next. */
+  if(numthreads==0) numthreads=gal_threads_number();
+  nbands = ( packed->dsize[0]+BINARY_PACKED_BAND_ROWS-1 )
+           / BINARY_PACKED_BAND_ROWS;
+  out=gal_pointer_allocate(GAL_TYPE_UINT64, 2*planesize, 0, __func__,
+                           "out");
+  p.packed=packed;
+  p.connectivity=connectivity;
+  for(done=0; done<numsteps; done+=p.numsteps)
     {
-      ind=(i+1)*nc-1;
-      if(byt[ind]==b
-         && (byt[ind-1]==f || byt[ind+nc]==f || byt[ind-nc]==f
-             || byt[ind-1-nc]==f || byt[ind-1+nc]==f) )
-        byt[ind]=GAL_BINARY_TMP_VALUE;
+      p.steps=steps+done;
+      p.numsteps = ( numsteps-done<BINARY_PACKED_MAX_FUSE
+                     ? numsteps-done
+                     : BINARY_PACKED_MAX_FUSE );
+      p.ofg=out;
+      p.obg=out+planesize;
+      gal_threads_spin_off(binary_packed_on_thread, &p, nbands,
+                           numthreads, -1, 1);
+      tmp=packed->fg;
+      packed->fg=out;
+      packed->bg=out+planesize;
+      out=tmp;
     }
 
-  /* Check the body: */
-  for(i=1;i<nr-1;++i)
-    for(j=1;j<nc-1;++j)
-      {
-        ind=i*nc+j;
-        if(byt[ind]==b
-           && (byt[ind-1]==f        || byt[ind+1]==f
-               || byt[ind+nc]==f    || byt[ind-nc]==f
-               || byt[ind-1-nc]==f  || byt[ind+1+nc]==f
-               || byt[ind-1+nc]==f  || byt[ind+1-nc]==f) )
-          byt[ind]=GAL_BINARY_TMP_VALUE;
-      }
+  /* Clean up. */
+  free(out);
+  free(steps);
+}
 
-  /* Set all the changed pixels to the proper values: */
-  fpt=(pt=byt)+nr*nc;
-  do *pt = *pt==GAL_BINARY_TMP_VALUE ? f : *pt; while(++pt<fpt);
+
+
+
+
+void
+gal_binary_packed_erode(gal_binary_packed_t *packed, size_t num,
+                        int connectivity, size_t numthreads)
+{
+  binary_packed_erode_dilate(packed, num, 0, connectivity, numthreads);
+}
+
+
+
+
+
+void
+gal_binary_packed_dilate(gal_binary_packed_t *packed, size_t num,
+                         int connectivity, size_t numthreads)
+{
+  binary_packed_erode_dilate(packed, 0, num, connectivity, numthreads);
 }
 
 
 
 
 
+void
+gal_binary_packed_open(gal_binary_packed_t *packed, size_t num,
+                       int connectivity, size_t numthreads)
+{
+  binary_packed_erode_dilate(packed, num, num, connectivity, numthreads);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/*****************      Erosion and dilation      ********************/
+/*********************************************************************/
 /* This is a general erosion and dilation function. It is less efficient
-   than the more specialized cases above. */
+   than the bit-packed implementation above (which is used for 1D and 2D
+   datasets). */
 static void
 binary_erode_dilate_general(gal_data_t *input, unsigned char dilate0_erode1,
                             int connectivity)
@@ -288,15 +502,19 @@ binary_erode_dilate_general(gal_data_t *input, unsigned char dilate0_erode1,
   /* Set all the changed pixels to the proper values: */
   fpt=(pt=byt)+input->size;
   do *pt = *pt==GAL_BINARY_TMP_VALUE ? f : *pt; while(++pt<fpt);
+
+  /* Clean up. */
+  free(dinc);
 }
 
 
 
 
 
-/* Erode a binary dataset any number of times. If 'inplace' is given a
-   value of '1', then do the erosion within the already allocated space,
-   otherwise, allocate a new array and save the result into that.
+/* Erode a binary dataset 'numerode' times, then dilate it 'numdilate'
+   times. If 'inplace' is given a value of '1', then do the erosion within
+   the already allocated space, otherwise, allocate a new array and save
+   the result into that.
 
    This function will only work on the elements with a value of 1 or 0. It
    will leave all the rest unchanged. Also note that it only works on
@@ -304,12 +522,12 @@ binary_erode_dilate_general(gal_data_t *input, unsigned char dilate0_erode1,
    going to copy it this type and return the newlyallocated dataset. So
    when the input's type isn't 'uint8_t', 'inplace' is irrelevant. */
 static gal_data_t *
-binary_erode_dilate(gal_data_t *input, size_t num, int connectivity,
-                    int inplace, int d0e1)
+binary_erode_dilate(gal_data_t *input, size_t numerode, size_t numdilate,
+                    int connectivity, int inplace, size_t numthreads)
 {
   size_t counter;
   gal_data_t *binary;
-  size_t *dinc=gal_dimension_increment(input->ndim, input->dsize);
+  gal_binary_packed_t *packed;
 
   /* Currently this only works on blocks. */
   if(input->block)
@@ -325,25 +543,22 @@ binary_erode_dilate(gal_data_t *input, size_t num, int connectivity,
   /* Go over every element and do the erosion. */
   switch(binary->ndim)
     {
+    /* In 1D and 2D, all the iterations are done on the bit-packed
+       image. */
     case 1:
-      binary_erode_dilate_1d(binary, d0e1);
-      break;
-
     case 2:
-      for(counter=0;counter<num;++counter)
-        switch(connectivity)
-          {
-          case 1: binary_erode_dilate_2d_4con(binary, d0e1); break;
-          case 2: binary_erode_dilate_2d_8con(binary, d0e1); break;
-          default:
-            error(EXIT_FAILURE, 0, "%s: %d not acceptable for connectivity "
-                  "in a 2D dataset", __func__, connectivity);
-          }
+      packed=gal_binary_pack(binary);
+      binary_packed_erode_dilate(packed, numerode, numdilate, connectivity,
+                                 numthreads);
+      gal_binary_unpack(packed, binary);
+      gal_binary_packed_free(packed);
       break;
 
     case 3:
-      for(counter=0;counter<num;++counter)
-        binary_erode_dilate_general(binary, d0e1, connectivity);
+      for(counter=0;counter<numerode;++counter)
+        binary_erode_dilate_general(binary, 1, connectivity);
+      for(counter=0;counter<numdilate;++counter)
+        binary_erode_dilate_general(binary, 0, connectivity);
       break;
 
     default:
@@ -351,8 +566,7 @@ binary_erode_dilate(gal_data_t *input, size_t num, int connectivity,
             "dimensional datasets", __func__, binary->ndim);
     }
 
-  /* Clean up and return. */
-  free(dinc);
+  /* Return the output. */
   return binary;
 }
 
@@ -362,9 +576,10 @@ binary_erode_dilate(gal_data_t *input, size_t num, int connectivity,
 
 gal_data_t *
 gal_binary_erode(gal_data_t *input, size_t num, int connectivity,
-                 int inplace)
+                 int inplace, size_t numthreads)
 {
-  return binary_erode_dilate(input, num, connectivity, inplace, 1);
+  return binary_erode_dilate(input, num, 0, connectivity, inplace,
+                             numthreads);
 }
 
 
@@ -373,31 +588,24 @@ gal_binary_erode(gal_data_t *input, size_t num, int connectivity,
 
 gal_data_t *
 gal_binary_dilate(gal_data_t *input, size_t num, int connectivity,
-                  int inplace)
+                  int inplace, size_t numthreads)
 {
-  return binary_erode_dilate(input, num, connectivity, inplace, 0);
+  return binary_erode_dilate(input, 0, num, connectivity, inplace,
+                             numthreads);
 }
 
 
 
 
 
+/* Opening is 'num' erosions followed by 'num' dilations (all in the same
+   allocated space). */
 gal_data_t *
 gal_binary_open(gal_data_t *input, size_t num, int connectivity,
-                int inplace)
+                int inplace, size_t numthreads)
 {
-  gal_data_t *out;
-
-  /* First do the necessary number of erosions. */
-  out=gal_binary_erode(input, num, connectivity, inplace);
-
-  /* If 'inplace' was called, then 'out' is the same as 'input', if it
-     wasn't, then 'out' is a newly allocated array. In any case, we should
-     dilate in the same allocated space. */
-  gal_binary_dilate(input, num, connectivity, 1);
-
-  /* Return the output dataset. */
-  return out;
+  return binary_erode_dilate(input, num, num, connectivity, inplace,
+                             numthreads);
 }
 
 
@@ -485,16 +693,206 @@ gal_binary_number_neighbors(gal_data_t *input, int connectivity, int inplace)
 /*********************************************************************/
 /*****************      Connected components      ********************/
 /*********************************************************************/
+/* For a parallel labeling, the dataset is divided into "slabs" along the
+   slowest dimension (each slab is a contiguous range of rows in 2D, or
+   slices in 3D) and the slabs are labeled independently. The components
+   that cross the border of two slabs are then merged with a union-find
+   structure over the labels of all the slabs. */
+#define BINARY_CC_PARALLEL_MIN 1048576
+
+struct binary_cc_params
+{
+  gal_data_t     *binary;  /* Input binary dataset.                     */
+  gal_data_t        *lab;  /* Output labeled dataset.                   */
+  int       connectivity;  /* Connectivity of the neighbors.            */
+  size_t           *dinc;  /* Increments along each dimension.          */
+  size_t          *first;  /* First index of each slab (and the end).   */
+  size_t         *numlab;  /* Number of labels in each slab.            */
+  size_t         *offset;  /* Offset of the labels of each slab.        */
+  int32_t        *newlab;  /* Final label of each slab label.           */
+};
+
+
+
+
+
+/* Find the root of a label in the union-find structure (with path
+   halving). */
+static int32_t
+binary_cc_find(int32_t *parent, int32_t a)
+{
+  while(parent[a]!=a) a = parent[a] = parent[parent[a]];
+  return a;
+}
+
+
+
+
+
+/* Merge the sets of two labels: the smaller root becomes the root of the
+   merged set, so the root of each set is always its first label. */
+static void
+binary_cc_union(int32_t *parent, int32_t a, int32_t b)
+{
+  a=binary_cc_find(parent, a);
+  b=binary_cc_find(parent, b);
+  if(a<b) parent[b]=a; else parent[a]=b;
+}
+
+
+
+
+
+/* Add a new label to the union-find structure of a slab. */
+#define BINARY_CC_NEW_LABEL {                                           \
+    if(++numprov==size)                                                 \
+      {                                                                 \
+        size*=2;                                                        \
+        errno=0;                                                        \
+        parent=realloc(parent, size*sizeof *parent);                    \
+        if(parent==NULL)                                                \
+          error(EXIT_FAILURE, errno, "%s: reallocating %zu bytes for "  \
+                "'parent'", __func__, size*sizeof *parent);             \
+      }                                                                 \
+    parent[numprov]=numprov;                                            \
+    l[i]=numprov;                                                       \
+  }
+
+/* Check a neighbor that has already been visited: if it is labeled, it
+   should have the same label as the current pixel. */
+#define BINARY_CC_BACKWARD(NIND) {                                      \
+    if( l[NIND]>0 )                                                     \
+      {                                                                 \
+        if(l[i]) binary_cc_union(parent, l[i], l[NIND]);                \
+        else     l[i]=l[NIND];                                          \
+      }                                                                 \
+  }
+
+/* Label the components within one slab (labels start from 1 in each
+   slab). The pixels are parsed in order and the label of each pixel is
+   taken from its neighbors that have already been visited (if they
+   disagree, their labels are merged with a union-find structure), or a
+   new label is defined. At the end, the labels are in the same order as
+   the first pixel of each component. */
+static size_t
+binary_connected_components_slab(struct binary_cc_params *p, size_t s)
+{
+  gal_data_t *binary=p->binary;
+  int32_t *l=p->lab->array, *parent, *final;
+  size_t *dinc=p->dinc, *dsize=binary->dsize;
+  uint8_t *b=binary->array, con=p->connectivity;
+  size_t i, r, c, nc, numprov=0, numlab=0, size=1024;
+  size_t start=p->first[s], end=p->first[s+1];
+
+  /* Allocate the union-find structure. */
+  errno=0;
+  parent=malloc(size*sizeof *parent);
+  if(parent==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'parent'",
+          __func__, size*sizeof *parent);
+
+  /* In 2D (the most common case), the neighbors are found directly, for
+     other dimensions, use the general macro. Note that blank pixels have
+     a negative label, so they are not labeled or used. */
+  if(binary->ndim==2)
+    {
+      nc=dsize[1];
+      for(i=start;i<end;++i)
+        if( b[i] && l[i]==0 )
+          {
+            r=i/nc;
+            c=i%nc;
+            if(c)                 BINARY_CC_BACKWARD(i-1);
+            if(r*nc>start)
+              {
+                BINARY_CC_BACKWARD(i-nc);
+                if(con==2)
+                  {
+                    if(c)         BINARY_CC_BACKWARD(i-nc-1);
+                    if(c<nc-1)    BINARY_CC_BACKWARD(i-nc+1);
+                  }
+              }
+            if(l[i]==0) BINARY_CC_NEW_LABEL;
+          }
+    }
+  else
+    for(i=start;i<end;++i)
+      if( b[i] && l[i]==0 )
+        {
+          GAL_DIMENSION_NEIGHBOR_OP(i, binary->ndim, dsize, con, dinc,
+            {
+              if(nind<i && nind>=start) BINARY_CC_BACKWARD(nind);
+            } );
+          if(l[i]==0) BINARY_CC_NEW_LABEL;
+        }
+
+  /* The root of each set is its first (smallest) label, so the final
+     labels can be found in one pass over the labels. */
+  final=gal_pointer_allocate(GAL_TYPE_INT32, numprov+1, 0, __func__,
+                             "final");
+  for(i=1;i<=numprov;++i)
+    {
+      parent[i]=parent[ parent[i] ];
+      final[i] = parent[i]==(int32_t)i ? ++numlab : final[ parent[i] ];
+    }
+
+  /* Set the final labels. */
+  for(i=start;i<end;++i)
+    if(l[i]>0) l[i]=final[ l[i] ];
+
+  /* Clean up and return the number of labels. */
+  free(final);
+  free(parent);
+  return numlab;
+}
+
+
+
+
+
+/* Worker function: label each slab (when 'newlab' is not yet defined),
+   or give each pixel its final label. */
+static void *
+binary_connected_components_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct binary_cc_params *p=(struct binary_cc_params *)tprm->params;
+
+  size_t i, s, j;
+  int32_t *l=p->lab->array;
+
+  /* Go over all the slabs assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      s=tprm->indexs[i];
+      if(p->newlab)
+        {
+          for(j=p->first[s]; j<p->first[s+1]; ++j)
+            if(l[j]>0) l[j]=p->newlab[ p->offset[s] + l[j] ];
+        }
+      else
+        p->numlab[s]=binary_connected_components_slab(p, s);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
 /* Find connected components in an intput dataset. */
 size_t
 gal_binary_connected_components(gal_data_t *binary, gal_data_t **out,
-                                int connectivity)
+                                int connectivity, size_t numthreads)
 {
-  int32_t *l;
+  int32_t *l, *parent;
   uint8_t *b, *bf;
   gal_data_t *lab;
-  size_t p, i, curlab=1;
-  gal_list_sizet_t *Q=NULL;
+  struct binary_cc_params p;
+  size_t i, s, numslabs, plane, total, out_num=0;
   size_t *dinc=gal_dimension_increment(binary->ndim, binary->dsize);
 
   /* Two small sanity checks. */
@@ -504,6 +902,10 @@ gal_binary_connected_components(gal_data_t *binary, gal_data_t **out,
   if(binary->block)
     error(EXIT_FAILURE, 0, "%s: currently, the input data structure to "
           "must not be a tile", __func__);
+  if((size_t)connectivity>binary->ndim)
+    error(EXIT_FAILURE, 0, "%s: connectivity value (%d) is larger than "
+          "the number of dimensions (%zu)", __func__, connectivity,
+          binary->ndim);
 
 
   /* Prepare the dataset for the labels. */
@@ -542,51 +944,89 @@ gal_binary_connected_components(gal_data_t *binary, gal_data_t **out,
     do *l++ = *b==GAL_BLANK_UINT8 ? GAL_BLANK_INT32 : 0; while(++b<bf);
 
 
-  /* Go over all the pixels and do a breadth-first: any pixel that is not
-     labeled is used to label the full object by checking neighbors before
-     going onto the next pixels. */
-  l=lab->array;
-  b=binary->array;
-  for(i=0;i<binary->size;++i)
-    /* Check if this pixel is already labeled. */
-    if( b[i] && l[i]==0 )
-      {
-        /* This is the first pixel of this connected region that we have
-           got to. */
-        l[i]=curlab;
-
-        /* Add this pixel to the queue of pixels to work with. */
-        gal_list_sizet_add(&Q, i);
-
-        /* While a pixel remains in the queue, continue labelling and
-           searching for neighbors. */
-        while(Q!=NULL)
-          {
-            /* Pop an element from the queue. */
-            p=gal_list_sizet_pop(&Q);
-
-            /* Go over all its neighbors and add them to the list if they
-               haven't already been labeled. */
-            GAL_DIMENSION_NEIGHBOR_OP(p, binary->ndim, binary->dsize,
+  /* Set the slabs: one slab for each thread (if there are enough
+     elements along the slowest dimension). Small datasets are labeled in
+     one slab. */
+  if(numthreads==0) numthreads=gal_threads_number();
+  numslabs = ( binary->size<BINARY_CC_PARALLEL_MIN
+               ? 1
+               : ( numthreads<binary->dsize[0]
+                   ? numthreads
+                   : binary->dsize[0] ) );
+  plane=binary->size/binary->dsize[0];
+  p.first=gal_pointer_allocate(GAL_TYPE_SIZE_T, 3*numslabs+1, 0, __func__,
+                               "p.first");
+  p.numlab=p.first+numslabs+1;
+  p.offset=p.numlab+numslabs;
+  for(s=0;s<=numslabs;++s)
+    p.first[s]=(s*binary->dsize[0]/numslabs)*plane;
+
+
+  /* Label each slab. */
+  p.lab=lab;
+  p.dinc=dinc;
+  p.newlab=NULL;
+  p.binary=binary;
+  p.connectivity=connectivity;
+  gal_threads_spin_off(binary_connected_components_on_thread, &p,
+                       numslabs, numthreads, binary->minmapsize,
+                       binary->quietmmap);
+
+
+  /* When there are multiple slabs, merge the labels. */
+  if(numslabs>1)
+    {
+      /* The labels of each slab start after those of the previous
+         slabs, so the labels of all the slabs are in the same order as
+         the first pixel of each component. */
+      total=0;
+      for(s=0;s<numslabs;++s) { p.offset[s]=total; total+=p.numlab[s]; }
+
+      /* Initialize the union-find structure. */
+      parent=gal_pointer_allocate(GAL_TYPE_INT32, total+1, 0, __func__,
+                                  "parent");
+      for(i=0;i<=total;++i) parent[i]=i;
+
+      /* Merge the labels of the components that touch each other on the
+         border of two slabs: only the first plane of each slab needs to
+         be checked (the neighbors in the previous plane are in the
+         previous slab). */
+      l=lab->array;
+      for(s=1;s<numslabs;++s)
+        for(i=p.first[s]; i<p.first[s]+plane; ++i)
+          if(l[i]>0)
+            GAL_DIMENSION_NEIGHBOR_OP(i, binary->ndim, binary->dsize,
                                       connectivity, dinc,
               {
-                if( b[ nind ] && l[ nind ]==0 )
-                  {
-                    l[ nind ] = curlab;
-                    gal_list_sizet_add(&Q, nind);
-                  }
+                if( nind<p.first[s] && l[nind]>0 )
+                  binary_cc_union(parent, p.offset[s]+l[i],
+                                  p.offset[s-1]+l[nind]);
               } );
-          }
 
-        /* This object has been fully labeled, so increment the current
-           label. */
-        ++curlab;
-      }
+      /* Set the final labels: the root of each set is its smallest
+         label, so the final labels are also in the order of the first
+         pixel of each component (identical to a single slab). */
+      p.newlab=gal_pointer_allocate(GAL_TYPE_INT32, total+1, 0, __func__,
+                                    "p.newlab");
+      for(i=1;i<=total;++i)
+        p.newlab[i] = ( binary_cc_find(parent, i)==(int32_t)i
+                        ? ++out_num
+                        : p.newlab[ binary_cc_find(parent, i) ] );
+
+      /* Relabel all the slabs. */
+      gal_threads_spin_off(binary_connected_components_on_thread, &p,
+                           numslabs, numthreads, binary->minmapsize,
+                           binary->quietmmap);
+      free(p.newlab);
+      free(parent);
+    }
+  else out_num=p.numlab[0];
 
 
   /* Clean up and return the total number. */
   free(dinc);
-  return curlab-1;
+  free(p.first);
+  return out_num;
 }
 
 
@@ -602,8 +1042,8 @@ gal_binary_connected_indexs(gal_data_t *binary, int connectivity)
 {
   uint8_t *b, *bf;
   gal_data_t *lines=NULL;
+  gal_list_qsizet_t Q, onelab;
   size_t p, i, onelabnum, *onelabarr;
-  gal_list_sizet_t *Q=NULL, *onelab=NULL;
   size_t *dinc=gal_dimension_increment(binary->ndim, binary->dsize);
 
   /* Small sanity checks. */
@@ -614,6 +1054,10 @@ gal_binary_connected_indexs(gal_data_t *binary, int connectivity)
     error(EXIT_FAILURE, 0, "%s: currently, the input data structure to "
           "must not be a tile", __func__);
 
+  /* Allocate the queues (they are re-used for all the components). */
+  gal_list_qsizet_init(&Q, 0);
+  gal_list_qsizet_init(&onelab, 0);
+
   /* Go over all the pixels and do a breadth-first search. */
   b=binary->array;
   for(i=0;i<binary->size;++i)
@@ -623,15 +1067,15 @@ gal_binary_connected_indexs(gal_data_t *binary, int connectivity)
       {
         /* Add this pixel to the queue of pixels to work with. */
 	b[i]=BINARY_CONINDEX_VAL;
-        gal_list_sizet_add(&Q, i);
-        gal_list_sizet_add(&onelab, i);
+        gal_list_qsizet_add(&Q, i);
+        gal_list_qsizet_add(&onelab, i);
 
         /* While a pixel remains in the queue, continue labelling and
            searching for neighbors. */
-        while(Q!=NULL)
+        while(Q.number)
           {
             /* Pop an element from the queue. */
-            p=gal_list_sizet_pop(&Q);
+            p=gal_list_qsizet_pop_last(&Q);
 
             /* Go over all its neighbors and add them to the list if they
                haven't already been labeled. */
@@ -641,20 +1085,20 @@ gal_binary_connected_indexs(gal_data_t *binary, int connectivity)
                 if( b[nind]==1 )
                   {
 		    b[nind]=BINARY_CONINDEX_VAL;
-                    gal_list_sizet_add(&Q, nind);
-		    gal_list_sizet_add(&onelab, nind);
+                    gal_list_qsizet_add(&Q, nind);
+		    gal_list_qsizet_add(&onelab, nind);
                   }
               } );
           }
 
-	/* Parsing has finished, put all the indexs into an array. */
-	onelabarr=gal_list_sizet_to_array(onelab, 1, &onelabnum);
+	/* Parsing has finished, put all the indexs into an array (in
+	   the order they were found). */
+	onelabarr=gal_list_qsizet_to_array(&onelab, &onelabnum);
 	gal_list_data_add_alloc(&lines, onelabarr, GAL_TYPE_SIZE_T, 1,
 				&onelabnum, NULL, 0, -1, 1, NULL, NULL, NULL);
 
-	/* Clean up. */
-	gal_list_sizet_free(onelab);
-	onelab=NULL;
+	/* Empty the queue for the next component. */
+	onelab.first=onelab.number=0;
       }
 
   /* Reverse the order. */
@@ -677,6 +1121,8 @@ gal_binary_connected_indexs(gal_data_t *binary, int connectivity)
 
   /* Clean up and return the total number. */
   free(dinc);
+  gal_list_qsizet_free(&Q);
+  gal_list_qsizet_free(&onelab);
   return lines;
 }
 
@@ -691,8 +1137,8 @@ gal_data_t *
 gal_binary_connected_adjacency_matrix(gal_data_t *adjacency,
                                       size_t *numconnected)
 {
+  gal_list_qsizet_t Q;
   gal_data_t *newlabs_d;
-  gal_list_sizet_t *Q=NULL;
   int32_t *newlabs, curlab=1;
   uint8_t *adj=adjacency->array;
   size_t i, j, p, num=adjacency->dsize[0];
@@ -724,17 +1170,18 @@ gal_binary_connected_adjacency_matrix(gal_data_t *adjacency,
   /* Go over the input matrix and apply the same principle as we used to
      identify connected components in an image: through a queue, find those
      elements that are connected. */
+  gal_list_qsizet_init(&Q, 0);
   for(i=1;i<num;++i)
     if(newlabs[i]==0)
       {
         /* Add this old label to the list that must be corrected. */
-        gal_list_sizet_add(&Q, i);
+        gal_list_qsizet_add(&Q, i);
 
         /* Continue while the list has elements. */
-        while(Q!=NULL)
+        while(Q.number)
           {
             /* Pop the top old-label from the list. */
-            p=gal_list_sizet_pop(&Q);
+            p=gal_list_qsizet_pop_last(&Q);
 
             /* If it has already been labeled then ignore it. */
             if( newlabs[p]!=curlab )
@@ -747,7 +1194,7 @@ gal_binary_connected_adjacency_matrix(gal_data_t *adjacency,
                    that are touching it. */
                 for(j=1;j<num;++j)
                   if( adj[ p*num+j ] && newlabs[j]==0 )
-                    gal_list_sizet_add(&Q, j);
+                    gal_list_qsizet_add(&Q, j);
               }
           }
 
@@ -760,7 +1207,8 @@ gal_binary_connected_adjacency_matrix(gal_data_t *adjacency,
   for(i=1;i<num;++i) printf("%zu: %u\n", i, newlabs[i]);
   */
 
-  /* Return the output. */
+  /* Clean up and return the output. */
+  gal_list_qsizet_free(&Q);
   *numconnected = curlab-1;
   return newlabs_d;
 }
@@ -790,9 +1238,9 @@ gal_binary_connected_adjacency_list(gal_list_sizet_t **listarr,
                                     int quietmmap, size_t *numconnected)
 {
   size_t i, p;
+  gal_list_qsizet_t Q;
   gal_list_sizet_t *tmp;
   gal_data_t *newlabs_d;
-  gal_list_sizet_t *Q=NULL;
   int32_t *newlabs, curlab=1;
 
   /* Allocate (and clear) the output datastructure. */
@@ -803,17 +1251,18 @@ gal_binary_connected_adjacency_list(gal_list_sizet_t **listarr,
   /* Go over the input matrix and apply the same principle as we used to
      identify connected components in an image: through a queue, find those
      elements that are connected. */
+  gal_list_qsizet_init(&Q, 0);
   for(i=1;i<number;++i)
     if(newlabs[i]==0)
       {
         /* Add this old label to the list that must be corrected. */
-        gal_list_sizet_add(&Q, i);
+        gal_list_qsizet_add(&Q, i);
 
         /* Continue while the list has elements. */
-        while(Q!=NULL)
+        while(Q.number)
           {
             /* Pop the top old-label from the list. */
-            p=gal_list_sizet_pop(&Q);
+            p=gal_list_qsizet_pop_last(&Q);
 
             /* If it has already been labeled then ignore it. */
             if( newlabs[p]!=curlab )
@@ -826,7 +1275,7 @@ gal_binary_connected_adjacency_list(gal_list_sizet_t **listarr,
                    touching it. */
                 for(tmp=listarr[p]; tmp!=NULL; tmp=tmp->next)
                   if( newlabs[tmp->v]==0 )
-                    gal_list_sizet_add(&Q, tmp->v);
+                    gal_list_qsizet_add(&Q, tmp->v);
               }
           }
 
@@ -839,7 +1288,8 @@ gal_binary_connected_adjacency_list(gal_list_sizet_t **listarr,
   for(i=1;i<number;++i) printf("%zu: %u\n", i, newlabs[i]);
   */
 
-  /* Return the output. */
+  /* Clean up and return the output. */
+  gal_list_qsizet_free(&Q);
   *numconnected = curlab-1;
   return newlabs_d;
 }
@@ -956,7 +1406,8 @@ gal_binary_holes_label(gal_data_t *input, int connectivity,
 
   /* Label the holes. Recall that the first label is just the undetected
      regions, so we should subtract that from the total number.*/
-  *numholes=gal_binary_connected_components(inv, &holelabs, connectivity);
+  *numholes=gal_binary_connected_components(inv, &holelabs, connectivity,
+                                            1);
   *numholes -= 1;
 
 
@@ -1057,7 +1508,7 @@ gal_binary_holes_fill(gal_data_t *input, int connectivity, size_t maxsize)
 
 
   /* Label the holes */
-  numholes=gal_binary_connected_components(inv, &holelabs, connectivity);
+  numholes=gal_binary_connected_components(inv, &holelabs, connectivity, 1);
 
 
   /* Any pixel with a label larger than 1 is a hole in the input image and
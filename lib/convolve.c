@@ -22,14 +22,18 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 **********************************************************************/
 #include <config.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include <gsl/gsl_fft_complex.h>
+
 #include <gnuastro/list.h>
 #include <gnuastro/tile.h>
+#include <gnuastro/blank.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/convolve.h>
@@ -85,6 +89,688 @@ convolve_tile_is_on_edge(size_t *h, size_t *start_end_coord, size_t *k,
 
 
 
+/*********************************************************************/
+/********************       Host boundaries       ********************/
+/*********************************************************************/
+/* The separable and FFT methods don't parse the image tile by tile: they
+   process the whole block in one step. So for every pixel, they need the
+   boundaries of its host (the channel, or the full block in 'convoverch'
+   mode). Channels are a regular grid over the block, so it is enough to
+   keep the first and last (not inclusive) coordinate of the host along
+   each dimension, for every coordinate along that dimension. */
+struct convolve_fast_params
+{
+  /* Common to both methods. */
+  float               *in;  /* Input array (the allocated block).       */
+  float              *out;  /* Output array.                            */
+  size_t             ndim;  /* Number of dimensions.                    */
+  size_t           *dsize;  /* Size of block along each dimension.      */
+  size_t          *kdsize;  /* Size of kernel along each dimension.     */
+  size_t             **lo;  /* Host's first coordinate (per dimension). */
+  size_t             **hi;  /* Host's end coordinate (per dimension).   */
+  int      edgecorrection;  /* Correct convolution's edge effects.      */
+  size_t       minmapsize;  /* Minimum size to use memory-mapping.      */
+  int           quietmmap;  /* Don't print memory-mapping info.         */
+
+  /* Separable method. */
+  double         **factor;  /* 1D factors of the kernel (per dimension).*/
+  size_t              dim;  /* Dimension of the current pass.           */
+  double            *snum;  /* Numerator to read (NULL: read 'in').     */
+  double            *sden;  /* Denominator to read.                     */
+  double            *dnum;  /* Numerator to write (NULL: write 'out').  */
+  double            *dden;  /* Denominator to write.                    */
+
+  /* FFT method. */
+  size_t        fsize[2];   /* Size of the FFT along each dimension.    */
+  size_t       fvalid[2];   /* Number of valid outputs in each FFT.     */
+  size_t          *tstart;  /* Starting coordinates of output tiles.    */
+  double            *kfft;  /* FFT of the (zero-padded) kernel.         */
+  double          fftzero;  /* Denominators smaller than this are zero. */
+  gsl_fft_complex_wavetable *wave[2]; /* Wavetables of each dimension.  */
+};
+
+
+
+
+
+static void
+convolve_hosts_free(struct convolve_fast_params *fp)
+{
+  free(fp->lo[0]);
+  free(fp->lo);
+}
+
+
+
+
+
+/* Set the boundaries of the host of every coordinate. If the hosts of the
+   tiles are not a regular grid over the block, this function will return
+   0 (and the tile-based convolution should be used). */
+static int
+convolve_hosts(struct convolve_fast_params *fp, gal_data_t *tiles,
+               gal_data_t *block, int convoverch)
+{
+  size_t *start;
+  gal_data_t *tile, *host, *prevhost=NULL;
+  size_t c, d, total=0, ndim=block->ndim, *dsize=block->dsize;
+
+  /* Allocate the pointers for each dimension and the space for all the
+     dimensions (in one array). */
+  errno=0;
+  fp->lo=malloc(2 * ndim * sizeof *fp->lo);
+  if(fp->lo==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'fp->lo'",
+          __func__, 2 * ndim * sizeof *fp->lo);
+  fp->hi=fp->lo+ndim;
+  for(d=0;d<ndim;++d) total+=dsize[d];
+  fp->lo[0]=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2*total, 0, __func__,
+                                 "fp->lo[0]");
+  for(d=0;d<ndim;++d)
+    {
+      if(d) fp->lo[d]=fp->hi[d-1]+dsize[d-1];
+      fp->hi[d]=fp->lo[d]+dsize[d];
+      for(c=0;c<dsize[d];++c) fp->lo[d][c]=GAL_BLANK_SIZE_T;
+    }
+
+  /* Go over the hosts of all the tiles. Tiles of the same channel are
+     contiguous in the list, so each channel is only checked once. When
+     convolution is done over the channels, the full block is the host of
+     all the pixels. */
+  if(convoverch==0)
+    {
+      start=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
+                                 "start");
+      for(tile=tiles; tile!=NULL; tile=tile->next)
+        {
+          host = tile->block ? tile->block : block;
+          if(host==prevhost) continue;
+          prevhost=host;
+          gal_tile_start_coord(host, start);
+          for(d=0;d<ndim;++d)
+            for(c=start[d]; c<start[d]+host->dsize[d]; ++c)
+              {
+                if(fp->lo[d][c]==GAL_BLANK_SIZE_T)
+                  {
+                    fp->lo[d][c]=start[d];
+                    fp->hi[d][c]=start[d]+host->dsize[d];
+                  }
+                else if( fp->lo[d][c]!=start[d]
+                         || fp->hi[d][c]!=start[d]+host->dsize[d] )
+                  {
+                    free(start);
+                    convolve_hosts_free(fp);
+                    return 0;
+                  }
+              }
+        }
+      free(start);
+    }
+
+  /* Coordinates that are not covered by any host (only possible when the
+     tiles don't cover the full block) will be given the full block. */
+  for(d=0;d<ndim;++d)
+    for(c=0;c<dsize[d];++c)
+      if(fp->lo[d][c]==GAL_BLANK_SIZE_T)
+        { fp->lo[d][c]=0; fp->hi[d][c]=dsize[d]; }
+  return 1;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/********************      Separable kernels      ********************/
+/*********************************************************************/
+/* When the kernel is separable (it is the outer product of one 1D kernel
+   along each dimension, like a circular Gaussian), convolution can be
+   done as one 1D convolution along each dimension. For a 2D kernel of
+   width 'k', this needs '2k' (instead of 'k^2') operations per pixel.
+
+   To have the same NaN and edge correction results as the tile-based
+   convolution, every pass keeps two values for each pixel: the weighted
+   sum of the usable (not blank, and within the host) input pixels and
+   the sum of the weights that were used (only necessary for edge
+   correction). Since the host is a box, both sums are separable, so
+   after the last pass they are exactly the 'sum' and 'ksum' of
+   'convolve_spatial_tile'. */
+static double **
+convolve_separable_factors(gal_data_t *kernel)
+{
+  double **factor, prod;
+  float kmax, *k=kernel->array;
+  size_t d, i, j, total=0, imax=0, ndim=kernel->ndim, *ks=kernel->dsize;
+  size_t *cmax=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2*ndim, 0, __func__,
+                                    "cmax");
+  size_t *coord=cmax+ndim;
+
+  /* Find the kernel element with the largest absolute value. */
+  for(i=1;i<kernel->size;++i) if( fabs(k[i]) > fabs(k[imax]) ) imax=i;
+  kmax=k[imax];
+  if(kmax==0.0f || isnan(kmax)) { free(cmax); return NULL; }
+  gal_dimension_index_to_coord(imax, ndim, ks, cmax);
+
+  /* Allocate the factors (all in one array). */
+  errno=0;
+  factor=malloc(ndim * sizeof *factor);
+  if(factor==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'factor'",
+          __func__, ndim * sizeof *factor);
+  for(d=0;d<ndim;++d) total+=ks[d];
+  factor[0]=gal_pointer_allocate(GAL_TYPE_FLOAT64, total, 0, __func__,
+                                 "factor[0]");
+  for(d=1;d<ndim;++d) factor[d]=factor[d-1]+ks[d-1];
+
+  /* The factor of each dimension is the line of the kernel (along that
+     dimension) that passes through the maximum. Except for the first,
+     they are divided by the maximum, so their product is the kernel. */
+  for(d=0;d<ndim;++d)
+    {
+      memcpy(coord, cmax, ndim*sizeof *coord);
+      for(j=0;j<ks[d];++j)
+        {
+          coord[d]=j;
+          factor[d][j]=k[ gal_dimension_coord_to_index(ndim, ks, coord) ];
+          if(d) factor[d][j]/=kmax;
+        }
+    }
+
+  /* Check if the product of the factors is the kernel. */
+  for(i=0;i<kernel->size;++i)
+    {
+      prod=1.0f;
+      gal_dimension_index_to_coord(i, ndim, ks, coord);
+      for(d=0;d<ndim;++d) prod*=factor[d][coord[d]];
+      if( !( fabs(k[i]-prod)
+             <= GAL_CONVOLVE_SEPARABLE_TOLERANCE * fabs(kmax) ) )
+        {
+          free(cmax);
+          free(factor[0]);
+          free(factor);
+          return NULL;
+        }
+    }
+
+  /* Clean up and return. */
+  free(cmax);
+  return factor;
+}
+
+
+
+
+
+/* Convolve the 'inner' contiguous elements at position 'a' (counting in
+   units of 'inner') with the factor of this pass. 'anum' and 'aden' are
+   the thread's accumulators. */
+static void
+convolve_separable_position(struct convolve_fast_params *fp, size_t a,
+                            size_t inner, double *anum, double *aden)
+{
+  float *in=fp->in, *sn;
+  double *snum, *sd;
+  size_t e, j, jmin, jmax, q, start=a*inner;
+  double wj, *w=fp->factor[fp->dim];
+  size_t len=fp->dsize[fp->dim], kd=fp->kdsize[fp->dim], h=kd/2;
+  size_t p=a%len, lo=fp->lo[fp->dim][p], hi=fp->hi[fp->dim][p];
+
+  /* The range of the kernel that overlaps with the host (the same as
+     'convolve_spatial_overlap' along this dimension). */
+  jmin = lo+h > p ? lo+h-p : 0;
+  jmax = hi+h-p < kd ? hi+h-p : kd;
+
+  /* Add the contribution of each kernel element. */
+  memset(anum, 0, inner*sizeof *anum);
+  if(aden) memset(aden, 0, inner*sizeof *aden);
+  for(j=jmin;j<jmax;++j)
+    {
+      wj=w[j];
+      q=(a+j-h)*inner;
+      if(fp->snum)
+        {
+          snum=fp->snum+q;
+          for(e=0;e<inner;++e) anum[e] += wj * snum[e];
+          if(aden)
+            { sd=fp->sden+q; for(e=0;e<inner;++e) aden[e] += wj * sd[e]; }
+        }
+      else
+        {
+          /* First pass: blank input pixels are not used. */
+          sn=in+q;
+          for(e=0;e<inner;++e)
+            if( !isnan(sn[e]) )
+              {
+                anum[e] += wj * sn[e];
+                if(aden) aden[e] += wj;
+              }
+        }
+    }
+
+  /* Write the results. On the last pass, this is the output. */
+  if(fp->dnum)
+    {
+      for(e=0;e<inner;++e) fp->dnum[start+e]=anum[e];
+      if(aden) for(e=0;e<inner;++e) fp->dden[start+e]=aden[e];
+    }
+  else
+    for(e=0;e<inner;++e)
+      fp->out[start+e] = ( isnan(in[start+e])
+                           ? NAN
+                           : ( aden
+                               ? (aden[e]==0.0f ? NAN : anum[e]/aden[e])
+                               : anum[e] ) );
+}
+
+
+
+
+
+/* Along the last (contiguous) dimension, each action is one full line of
+   the block. Along the other dimensions, each action is one position
+   along that dimension (so all the faster dimensions are processed
+   together in contiguous memory). */
+static void *
+convolve_separable_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct convolve_fast_params *fp=(struct convolve_fast_params *)
+    (tprm->params);
+
+  double *anum, *aden=NULL;
+  size_t a, d, i, first, last, inner=1, len=fp->dsize[fp->dim];
+
+  /* Allocate the accumulators. */
+  for(d=fp->dim+1;d<fp->ndim;++d) inner*=fp->dsize[d];
+  anum=gal_pointer_allocate(GAL_TYPE_FLOAT64, inner, 0, __func__, "anum");
+  if(fp->edgecorrection)
+    aden=gal_pointer_allocate(GAL_TYPE_FLOAT64, inner, 0, __func__,
+                              "aden");
+
+  /* Go over all the actions of this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      if(inner==1) { first=tprm->indexs[i]*len; last=first+len; }
+      else         { first=tprm->indexs[i];     last=first+1;   }
+      for(a=first; a<last; ++a)
+        convolve_separable_position(fp, a, inner, anum, aden);
+    }
+
+  /* Clean up, wait for other threads to finish and return. */
+  free(anum);
+  if(aden) free(aden);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Do one pass along each dimension (starting from the last/contiguous
+   one). The first pass reads the input and the last one writes the
+   output, the intermediate sums are kept in 64-bit floating points (like
+   the sums of the tile-based convolution). */
+static void
+convolve_separable(struct convolve_fast_params *fp, size_t numthreads)
+{
+  gal_data_t *num[2]={NULL, NULL}, *den[2]={NULL, NULL};
+  size_t d, n, inner, ndim=fp->ndim, size=1, *dsize=fp->dsize;
+
+  /* Allocate the intermediate arrays (the passes alternate between two
+     sets of arrays, so the second is only necessary in 3D and higher). */
+  for(d=0;d<ndim;++d) size*=dsize[d];
+  for(n=0; n<ndim-1 && n<2; ++n)
+    {
+      num[n]=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, ndim, dsize, NULL, 0,
+                            fp->minmapsize, fp->quietmmap, NULL, NULL,
+                            NULL);
+      if(fp->edgecorrection)
+        den[n]=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, ndim, dsize, NULL,
+                              0, fp->minmapsize, fp->quietmmap, NULL,
+                              NULL, NULL);
+    }
+
+  /* Do the passes. */
+  for(n=0;n<ndim;++n)
+    {
+      /* Set the source and destination of this pass. */
+      fp->dim=ndim-1-n;
+      fp->snum = n ? num[(n-1)%2]->array : NULL;
+      fp->sden = n && den[(n-1)%2] ? den[(n-1)%2]->array : NULL;
+      fp->dnum = n<ndim-1 ? num[n%2]->array : NULL;
+      fp->dden = n<ndim-1 && den[n%2] ? den[n%2]->array : NULL;
+
+      /* Do the pass on multiple threads. */
+      inner=1;
+      for(d=fp->dim+1;d<ndim;++d) inner*=dsize[d];
+      gal_threads_spin_off(convolve_separable_on_thread, fp,
+                           inner==1 ? size/dsize[fp->dim] : size/inner,
+                           numthreads, fp->minmapsize, fp->quietmmap);
+    }
+
+  /* Clean up. */
+  for(n=0;n<2;++n)
+    {
+      if(num[n]) gal_data_free(num[n]);
+      if(den[n]) gal_data_free(den[n]);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/********************      FFT-based (2D only)    ********************/
+/*********************************************************************/
+/* For large kernels that are not separable, the output is broken into
+   tiles and each tile is convolved in the frequency domain with the
+   overlap-save method: an FFT of 'fsize' pixels (along each dimension)
+   gives 'fvalid=fsize-k+1' correct output pixels (the rest are polluted
+   by the periodic boundaries and are discarded).
+
+   Like the separable method, the numerator (usable pixel values) and
+   denominator (one for usable pixels) are convolved together: the first
+   is put in the real part of the FFT and the second in the imaginary
+   part. Since the kernel is real, the two don't mix. Pixels outside the
+   host are set to zero in both, so the edges are treated like the
+   tile-based convolution. */
+static void *
+convolve_fft_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct convolve_fast_params *fp=(struct convolve_fast_params *)
+    (tprm->params);
+
+  float v, *in=fp->in;
+  double a, b, *z, *zz, *kf=fp->kfft;
+  gsl_fft_complex_workspace *work0, *work1;
+  size_t s0, s1, e0, e1, lo0, lo1, hi0, hi1, i, m, m0, m1, ind, inrow;
+  size_t n0=fp->fsize[0], n1=fp->fsize[1], w1=fp->dsize[1];
+  size_t h0=fp->kdsize[0]/2, h1=fp->kdsize[1]/2;
+
+  /* Allocate the thread's buffer and workspaces. */
+  z=gal_pointer_allocate(GAL_TYPE_FLOAT64, 2*n0*n1, 0, __func__, "z");
+  work0=gsl_fft_complex_workspace_alloc(n0);
+  work1=gsl_fft_complex_workspace_alloc(n1);
+
+  /* Go over all the tiles of this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Starting and ending coordinates of this tile's output and the
+         boundaries of its host. */
+      s0=fp->tstart[ 2*tprm->indexs[i]   ];
+      s1=fp->tstart[ 2*tprm->indexs[i]+1 ];
+      lo0=fp->lo[0][s0]; hi0=fp->hi[0][s0];
+      lo1=fp->lo[1][s1]; hi1=fp->hi[1][s1];
+      e0 = s0+fp->fvalid[0] < hi0 ? s0+fp->fvalid[0] : hi0;
+      e1 = s1+fp->fvalid[1] < hi1 ? s1+fp->fvalid[1] : hi1;
+
+      /* Fill the buffer: element 'm' corresponds to input pixel
+         's+m-h' (where the kernel's first pixel is for output 's'). */
+      for(m0=0;m0<n0;++m0)
+        {
+          inrow = s0+m0 >= lo0+h0 && s0+m0 < hi0+h0;
+          for(m1=0;m1<n1;++m1)
+            {
+              zz=z+2*(m0*n1+m1);
+              if( inrow && s1+m1 >= lo1+h1 && s1+m1 < hi1+h1
+                  && !isnan( v=in[ (s0+m0-h0)*w1 + s1+m1-h1 ] ) )
+                { zz[0]=v; zz[1]=1.0f; }
+              else
+                zz[0]=zz[1]=0.0f;
+            }
+        }
+
+      /* Forward transform: first the rows, then the columns. */
+      for(m0=0;m0<n0;++m0)
+        gsl_fft_complex_forward(z+2*m0*n1, 1, n1, fp->wave[1], work1);
+      for(m1=0;m1<n1;++m1)
+        gsl_fft_complex_forward(z+2*m1, n1, n0, fp->wave[0], work0);
+
+      /* Multiply with the complex conjugate of the kernel's transform
+         (the spatial convolution doesn't flip the kernel). */
+      for(m=0;m<n0*n1;++m)
+        {
+          a=z[2*m]; b=z[2*m+1];
+          z[2*m]   = a*kf[2*m] + b*kf[2*m+1];
+          z[2*m+1] = b*kf[2*m] - a*kf[2*m+1];
+        }
+
+      /* Inverse transform (normalized by GSL). */
+      for(m0=0;m0<n0;++m0)
+        gsl_fft_complex_inverse(z+2*m0*n1, 1, n1, fp->wave[1], work1);
+      for(m1=0;m1<n1;++m1)
+        gsl_fft_complex_inverse(z+2*m1, n1, n0, fp->wave[0], work0);
+
+      /* Write the valid part into the output. */
+      for(m0=0; s0+m0<e0; ++m0)
+        for(m1=0; s1+m1<e1; ++m1)
+          {
+            zz=z+2*(m0*n1+m1);
+            ind=(s0+m0)*w1 + s1+m1;
+            fp->out[ind] = ( isnan(in[ind])
+                             ? NAN
+                             : ( fp->edgecorrection
+                                 ? ( fabs(zz[1])<=fp->fftzero
+                                     ? NAN
+                                     : zz[0]/zz[1] )
+                                 : zz[0] ) );
+          }
+    }
+
+  /* Clean up, wait for other threads to finish and return. */
+  free(z);
+  gsl_fft_complex_workspace_free(work0);
+  gsl_fft_complex_workspace_free(work1);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+static void
+convolve_fft(struct convolve_fast_params *fp, gal_data_t *kernel,
+             size_t numthreads)
+{
+  float *k=kernel->array;
+  gsl_fft_complex_workspace *work;
+  size_t c, d, i, j, n, hmax, numtiles, nt[2];
+  size_t *tstart[2], *ks=kernel->dsize, *dsize=fp->dsize;
+
+  /* Set the FFT size along each dimension: a power of two that is larger
+     than four times the kernel (so most of each FFT is useful), unless
+     the largest host is already covered by a smaller one. */
+  for(d=0;d<2;++d)
+    {
+      hmax=0;
+      for(c=0;c<dsize[d];++c)
+        if(fp->hi[d][c]-fp->lo[d][c] > hmax) hmax=fp->hi[d][c]-fp->lo[d][c];
+      n=8; while( n<4*ks[d] && n<hmax+ks[d]-1 ) n*=2;
+      fp->fsize[d]=n;
+      fp->fvalid[d]=n-ks[d]+1;
+    }
+
+  /* Starting coordinate of the tiles along each dimension: tiles don't
+     cross the boundaries of the hosts. */
+  for(d=0;d<2;++d)
+    {
+      tstart[d]=gal_pointer_allocate(GAL_TYPE_SIZE_T, dsize[d], 0,
+                                     __func__, "tstart[d]");
+      nt[d]=0;
+      for(c=0; c<dsize[d];
+          c = c+fp->fvalid[d] < fp->hi[d][c] ? c+fp->fvalid[d] : fp->hi[d][c])
+        tstart[d][ nt[d]++ ]=c;
+    }
+  numtiles=nt[0]*nt[1];
+  fp->tstart=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2*numtiles, 0, __func__,
+                                  "fp->tstart");
+  for(i=0;i<nt[0];++i)
+    for(j=0;j<nt[1];++j)
+      {
+        fp->tstart[ 2*(i*nt[1]+j)   ] = tstart[0][i];
+        fp->tstart[ 2*(i*nt[1]+j)+1 ] = tstart[1][j];
+      }
+
+  /* Prepare the wavetables (that are only read by the threads) and the
+     transform of the zero-padded kernel. */
+  fp->wave[0]=gsl_fft_complex_wavetable_alloc(fp->fsize[0]);
+  fp->wave[1]=gsl_fft_complex_wavetable_alloc(fp->fsize[1]);
+  fp->kfft=gal_pointer_allocate(GAL_TYPE_FLOAT64,
+                                2*fp->fsize[0]*fp->fsize[1], 1, __func__,
+                                "fp->kfft");
+  fp->fftzero=0.0f;
+  for(i=0;i<ks[0];++i)
+    for(j=0;j<ks[1];++j)
+      {
+        fp->kfft[ 2*(i*fp->fsize[1]+j) ] = k[i*ks[1]+j];
+        fp->fftzero += fabs(k[i*ks[1]+j]);
+      }
+  fp->fftzero *= GAL_CONVOLVE_FFT_ZERO;
+  work=gsl_fft_complex_workspace_alloc(fp->fsize[1]);
+  for(i=0;i<fp->fsize[0];++i)
+    gsl_fft_complex_forward(fp->kfft+2*i*fp->fsize[1], 1, fp->fsize[1],
+                            fp->wave[1], work);
+  gsl_fft_complex_workspace_free(work);
+  work=gsl_fft_complex_workspace_alloc(fp->fsize[0]);
+  for(j=0;j<fp->fsize[1];++j)
+    gsl_fft_complex_forward(fp->kfft+2*j, fp->fsize[1], fp->fsize[0],
+                            fp->wave[0], work);
+  gsl_fft_complex_workspace_free(work);
+
+  /* Convolve the tiles on multiple threads. */
+  gal_threads_spin_off(convolve_fft_on_thread, fp, numtiles, numthreads,
+                       fp->minmapsize, fp->quietmmap);
+
+  /* Clean up. */
+  free(fp->kfft);
+  free(tstart[0]);
+  free(tstart[1]);
+  free(fp->tstart);
+  gsl_fft_complex_wavetable_free(fp->wave[0]);
+  gsl_fft_complex_wavetable_free(fp->wave[1]);
+}
+
+
+
+
+
+/* Convolve the full block with the separable or FFT methods if they are
+   requested (or suitable for the kernel with 'GAL_CONVOLVE_SPATIAL_AUTO').
+   If neither can be used, 0 is returned and the tile-based convolution
+   should be used. */
+static int
+convolve_fast(gal_data_t *tiles, gal_data_t *block, gal_data_t *kernel,
+              gal_data_t *out, size_t numthreads, int edgecorrection,
+              int convoverch, int method)
+{
+  struct convolve_fast_params fp;
+  double **factor=NULL;
+  int usefft=0;
+
+  /* Select the method. */
+  switch(method)
+    {
+    case GAL_CONVOLVE_SPATIAL_DIRECT:
+      return 0;
+
+    case GAL_CONVOLVE_SPATIAL_AUTO:
+    case GAL_CONVOLVE_SPATIAL_SEPARABLE:
+    case GAL_CONVOLVE_SPATIAL_FFT:
+      if(method!=GAL_CONVOLVE_SPATIAL_FFT)
+        factor=convolve_separable_factors(kernel);
+      if(factor==NULL)
+        usefft = ( block->ndim==2
+                   && gal_blank_present(kernel, 0)==0
+                   && ( method==GAL_CONVOLVE_SPATIAL_FFT
+                        || ( method==GAL_CONVOLVE_SPATIAL_AUTO
+                             && kernel->size>=GAL_CONVOLVE_FFT_MIN_SIZE ) ) );
+      if(factor==NULL && usefft==0) return 0;
+      break;
+
+    default:
+      error(EXIT_FAILURE, 0, "%s: method code %d not recognized",
+            __func__, method);
+    }
+
+  /* Set the host boundaries. */
+  if( convolve_hosts(&fp, tiles, block, convoverch)==0 )
+    {
+      if(factor) { free(factor[0]); free(factor); }
+      return 0;
+    }
+
+  /* Set the common parameters and do the convolution. */
+  fp.in=block->array;
+  fp.out=out->array;
+  fp.factor=factor;
+  fp.ndim=block->ndim;
+  fp.dsize=block->dsize;
+  fp.kdsize=kernel->dsize;
+  fp.quietmmap=block->quietmmap;
+  fp.minmapsize=block->minmapsize;
+  fp.edgecorrection=edgecorrection;
+  if(factor) convolve_separable(&fp, numthreads);
+  else       convolve_fft(&fp, kernel, numthreads);
+
+  /* Clean up and return. */
+  if(factor) { free(factor[0]); free(factor); }
+  convolve_hosts_free(&fp);
+  return 1;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*********************************************************************/
 /********************     Spatial convolution     ********************/
 /*********************************************************************/
@@ -102,6 +788,8 @@ struct per_thread_spatial_prm
   size_t           *pix;     /* 2*ndim: starting and ending of tile,
                                 Later, just the pixel being convolved.   */
   int           on_edge;     /* If the tile is on the edge or not.       */
+  double           *num;     /* Interior: sum of each pixel in a row.    */
+  double           *den;     /* Interior: sum of kernel for each pixel.  */
   gal_data_t      *host;     /* Size of host (channel or block).         */
   struct spatial_params *cprm; /* Link to main structure for all threads.*/
 };
@@ -120,6 +808,8 @@ struct spatial_params
   gal_data_t *tocorrect;     /* (possible) convolved image to correct.   */
   int        convoverch;     /* Ignore channel edges in convolution.     */
   int    edgecorrection;     /* Correct convolution's edge effects.      */
+  int          hasblank;     /* If the input has blank values.           */
+  double           ksum;     /* Sum of all kernel elements.              */
   struct per_thread_spatial_prm *pprm; /* Array of per-thread parameters.*/
 };
 
@@ -291,6 +981,145 @@ convolve_spatial_overlap(struct per_thread_spatial_prm *pprm, int tocorrect)
 
 
 
+/* Tiles that are not on the edge of their host (in 2D)
+   ==================================================
+
+   All the pixels of these tiles fully overlap with the kernel, so there
+   is no need to find the overlap of every pixel. Instead, each row of the
+   kernel is added to all the pixels of a row of the tile in one loop
+   (that can be vectorized by the compiler). For the most common kernel
+   widths, the loop over the kernel's row is unrolled. When the input has
+   no blank values, the checks for blank pixels and the sum of the kernel
+   (for edge correction) are also not necessary.
+
+   The sums are done in the same order (and with the same types) as
+   'convolve_spatial_tile', so the results are identical. */
+#define CONVOLVE_INTERIOR_ROW_FIXED(K)                                  \
+  static void                                                           \
+  convolve_spatial_interior_row_##K(float *s, float *kr, size_t n,      \
+                                    double *num, double *den)           \
+  {                                                                     \
+    double a, b;                                                        \
+    size_t j, x;                                                        \
+    if(den)                                                             \
+      for(x=0;x<n;++x)                                                  \
+        {                                                               \
+          a=num[x];                                                     \
+          b=den[x];                                                     \
+          for(j=0;j<K;++j)                                              \
+            if( !isnan(s[x+j]) ) { a += kr[j] * s[x+j]; b += kr[j]; }   \
+          num[x]=a;                                                     \
+          den[x]=b;                                                     \
+        }                                                               \
+    else                                                                \
+      for(x=0;x<n;++x)                                                  \
+        {                                                               \
+          a=num[x];                                                     \
+          for(j=0;j<K;++j) a += kr[j] * s[x+j];                         \
+          num[x]=a;                                                     \
+        }                                                               \
+  }
+
+CONVOLVE_INTERIOR_ROW_FIXED(3)
+CONVOLVE_INTERIOR_ROW_FIXED(5)
+CONVOLVE_INTERIOR_ROW_FIXED(7)
+CONVOLVE_INTERIOR_ROW_FIXED(9)
+CONVOLVE_INTERIOR_ROW_FIXED(11)
+CONVOLVE_INTERIOR_ROW_FIXED(13)
+CONVOLVE_INTERIOR_ROW_FIXED(15)
+
+
+
+
+
+/* Add one row of the kernel ('kr', with 'k' elements) to the sums of 'n'
+   contiguous pixels. 's' is the input pixel under the first element of
+   the kernel's row for the first of the 'n' pixels. When 'den==NULL',
+   the input has no blank values. */
+static void
+convolve_spatial_interior_row(float *s, float *kr, size_t k, size_t n,
+                              double *num, double *den)
+{
+  float w, *sj;
+  size_t j, x;
+
+  switch(k)
+    {
+    case 3:  convolve_spatial_interior_row_3 (s, kr, n, num, den); break;
+    case 5:  convolve_spatial_interior_row_5 (s, kr, n, num, den); break;
+    case 7:  convolve_spatial_interior_row_7 (s, kr, n, num, den); break;
+    case 9:  convolve_spatial_interior_row_9 (s, kr, n, num, den); break;
+    case 11: convolve_spatial_interior_row_11(s, kr, n, num, den); break;
+    case 13: convolve_spatial_interior_row_13(s, kr, n, num, den); break;
+    case 15: convolve_spatial_interior_row_15(s, kr, n, num, den); break;
+
+    /* Other widths: one kernel element on all the pixels at a time. */
+    default:
+      for(j=0;j<k;++j)
+        {
+          w=kr[j];
+          sj=s+j;
+          if(den)
+            for(x=0;x<n;++x)
+              {
+                num[x] += isnan(sj[x]) ? 0.0f : w * sj[x];
+                den[x] += isnan(sj[x]) ? 0.0f : w;
+              }
+          else
+            for(x=0;x<n;++x) num[x] += w * sj[x];
+        }
+    }
+}
+
+
+
+
+
+/* Convolve a 2D tile that is not on the edge of its host. */
+static void
+convolve_spatial_interior(struct per_thread_spatial_prm *pprm)
+{
+  struct spatial_params *cprm=pprm->cprm;
+  gal_data_t *tile=pprm->tile, *block=cprm->block, *kernel=cprm->kernel;
+
+  double ksum=cprm->ksum;
+  double *num=pprm->num, *den=cprm->hasblank ? pprm->den : NULL;
+  float *s, *in=block->array, *out=cprm->out->array, *k=kernel->array;
+  size_t i, x, y, first, nx=tile->dsize[1], w=block->dsize[1];
+  size_t k0=kernel->dsize[0], k1=kernel->dsize[1];
+  size_t start=gal_pointer_num_between(block->array, tile->array,
+                                       block->type);
+
+  /* Go over the rows of the tile. */
+  for(y=0;y<tile->dsize[0];++y)
+    {
+      /* Index of the first pixel of this row and the input pixel under
+         the first kernel element for it. */
+      first = start + y*w;
+      s = in + first - (k0/2)*w - k1/2;
+
+      /* Add all the rows of the kernel. */
+      memset(num, 0, nx*sizeof *num);
+      if(den) memset(den, 0, nx*sizeof *den);
+      for(i=0;i<k0;++i)
+        convolve_spatial_interior_row(s+i*w, k+i*k1, k1, nx, num, den);
+
+      /* Write the output. */
+      for(x=0;x<nx;++x)
+        if( isnan(in[first+x]) ) out[first+x]=NAN;
+        else if(cprm->edgecorrection)
+          {
+            if(den) ksum=den[x];
+            out[first+x] = ksum==0.0f ? NAN : num[x]/ksum;
+          }
+        else out[first+x] = num[x];
+    }
+}
+
+
+
+
+
 /* Convolve over one tile that is not touching the edge. */
 static void
 convolve_spatial_tile(struct per_thread_spatial_prm *pprm)
@@ -340,6 +1169,11 @@ convolve_spatial_tile(struct per_thread_spatial_prm *pprm)
   if(cprm->tocorrect && pprm->on_edge==0) return;
 
 
+  /* Tiles that are not on the edge in a 2D input have a faster path. */
+  if(pprm->on_edge==0 && ndim==2)
+    { convolve_spatial_interior(pprm); return; }
+
+
   /* Parse over all the tile elements. */
   i_inc=0; i_ninc=1;
   i_start=gal_tile_start_end_ind_inclusive(tile, block, i_st_en);
@@ -452,6 +1286,15 @@ convolve_spatial_on_thread(void *inparam)
   free(pprm->k_overlap->array);
   pprm->i_overlap->block = cprm->block;
   pprm->k_overlap->block = cprm->kernel;
+  pprm->num = pprm->den = NULL;
+  if(ndim==2)
+    {
+      pprm->num = gal_pointer_allocate(GAL_TYPE_FLOAT64, block->dsize[1], 0,
+                                       __func__, "pprm->num");
+      if(cprm->hasblank)
+        pprm->den = gal_pointer_allocate(GAL_TYPE_FLOAT64, block->dsize[1],
+                                         0, __func__, "pprm->den");
+    }
 
 
   /* Go over all the tiles given to this thread. */
@@ -474,6 +1317,8 @@ convolve_spatial_on_thread(void *inparam)
   free(pprm->overlap_start);
   gal_data_free(pprm->i_overlap);
   gal_data_free(pprm->k_overlap);
+  if(pprm->num) free(pprm->num);
+  if(pprm->den) free(pprm->den);
   if(tprm->b) pthread_barrier_wait(tprm->b);
   return NULL;
 }
@@ -487,8 +1332,10 @@ convolve_spatial_on_thread(void *inparam)
 static gal_data_t *
 gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
                              size_t numthreads, int edgecorrection,
-                             int convoverch, gal_data_t *tocorrect)
+                             int convoverch, gal_data_t *tocorrect,
+                             int method)
 {
+  float *k, *kf;
   struct spatial_params params;
   gal_data_t *out, *block=gal_tile_block(tiles);
 
@@ -529,6 +1376,15 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
     }
 
 
+  /* If possible, convolve the whole block with the separable or FFT
+     methods (they aren't used for correcting the channel edges, because
+     only a small fraction of the image needs to be convolved there). */
+  if( tocorrect==NULL
+      && convolve_fast(tiles, block, kernel, out, numthreads,
+                       edgecorrection, convoverch, method) )
+    return out;
+
+
   /* Set the pointers in the parameters structure. */
   params.out=out;
   params.tiles=tiles;
@@ -537,6 +1393,13 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
   params.tocorrect=tocorrect;
   params.convoverch=convoverch;
   params.edgecorrection=edgecorrection;
+  params.hasblank=gal_blank_present(block, 0);
+
+
+  /* Sum of the kernel (for edge correction on the tiles that are not on
+     the edge when there are no blank pixels). */
+  params.ksum=0.0f;
+  kf=(k=kernel->array)+kernel->size; do params.ksum+=*k; while(++k<kf);
 
 
   /* Allocate the per-thread parameters. */
@@ -566,10 +1429,28 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
    convolution can be greatly sped up if it is done on separate tiles over
    the image (on multiple threads). So as input, you can either give tile
    values or one full array. Just note that if you give a single array as
-   input, the 'next' element has to be 'NULL'.*/
+   input, the 'next' element has to be 'NULL'. Every pixel is convolved
+   directly (to use the separable or FFT methods, see
+   'gal_convolve_spatial_method'). */
 gal_data_t *
 gal_convolve_spatial(gal_data_t *tiles, gal_data_t *kernel,
                      size_t numthreads, int edgecorrection, int convoverch)
+{
+  return gal_convolve_spatial_method(tiles, kernel, numthreads,
+                                     edgecorrection, convoverch,
+                                     GAL_CONVOLVE_SPATIAL_DIRECT);
+}
+
+
+
+
+
+/* Similar to 'gal_convolve_spatial', but with the method of convolution
+   given by the caller (see the 'GAL_CONVOLVE_SPATIAL_*' macros). */
+gal_data_t *
+gal_convolve_spatial_method(gal_data_t *tiles, gal_data_t *kernel,
+                            size_t numthreads, int edgecorrection,
+                            int convoverch, int method)
 {
   /* When there isn't any tile structure, 'convoverch' must be set to
      one. Recall that the input can be a single full dataset also. */
@@ -577,7 +1458,34 @@ gal_convolve_spatial(gal_data_t *tiles, gal_data_t *kernel,
 
   /* Call the general function. */
   return gal_convolve_spatial_general(tiles, kernel, numthreads,
-                                      edgecorrection, convoverch, NULL);
+                                      edgecorrection, convoverch, NULL,
+                                      method);
+}
+
+
+
+
+
+/* Return the code of a spatial convolution method from its name (for
+   example given by the user on the command-line). */
+int
+gal_convolve_spatial_method_from_string(char *method)
+{
+  if(      !strcmp(method,"auto")      ) return GAL_CONVOLVE_SPATIAL_AUTO;
+  else if( !strcmp(method,"direct")    ) return GAL_CONVOLVE_SPATIAL_DIRECT;
+  else if( !strcmp(method,"separable") )
+    return GAL_CONVOLVE_SPATIAL_SEPARABLE;
+  else if( !strcmp(method,"fft")       ) return GAL_CONVOLVE_SPATIAL_FFT;
+  else
+    error(EXIT_FAILURE, 0, "spatial convolution method '%s' not "
+          "recognized, currently recognized names are 'direct', "
+          "'separable', 'fft' and 'auto'", method);
+
+  /* Control should not reach here. */
+  error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix the "
+        "problem. Control should not reach the end of this function",
+        __func__, PACKAGE_BUGREPORT);
+  return GAL_CONVOLVE_SPATIAL_INVALID;
 }
 
 
@@ -609,5 +1517,6 @@ gal_convolve_spatial_correct_ch_edge(gal_data_t *tiles, gal_data_t *kernel,
 
   /* Call the general function, which will do the correction. */
   gal_convolve_spatial_general(tiles, kernel, numthreads,
-                               edgecorrection, 0, tocorrect);
+                               edgecorrection, 0, tocorrect,
+                               GAL_CONVOLVE_SPATIAL_DIRECT);
 }
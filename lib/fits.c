@@ -44,6 +44,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/pointer.h>
 
 #include <gnuastro-internal/checkset.h>
+#include <gnuastro-internal/fits-internal.h>
 #include <gnuastro-internal/tableintern.h>
 #include <gnuastro-internal/fixedstringmacros.h>
 
@@ -2607,6 +2608,70 @@ gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
 
 
 
+/* Read 'number' rows of a FITS image HDU, starting from row 'first'
+   (counting from zero). A "row" is one element along the slowest
+   dimension (the last FITS axis, or first C axis). For example in a 2D
+   image, it is one line of the image and in a 3D cube, it is one 2D
+   slice. The rows are contiguous in the file, so they can be read
+   directly without reading the whole HDU. */
+gal_data_t *
+gal_fits_img_read_rows(char *filename, char *hdu, size_t first,
+                       size_t number, size_t minmapsize, int quietmmap)
+{
+  void *blank;
+  fitsfile *fptr;
+  gal_data_t *img;
+  char *name=NULL, *unit=NULL;
+  int status=0, type, anyblank;
+  size_t i, ndim, *dsize, rowsize=1;
+
+
+  /* Open the HDU and read the basic information. */
+  fptr=gal_fits_hdu_open_format(filename, hdu, 0);
+  gal_fits_img_info(fptr, &type, &ndim, &dsize, &name, &unit);
+
+
+  /* Sanity checks. */
+  if(ndim==0)
+    error(EXIT_FAILURE, 0, "%s (hdu: %s) has 0 dimensions! The most "
+          "common cause for this is a wrongly specified HDU (the data "
+          "may be in a subsequent extension)", filename, hdu);
+  if(number==0 || first+number > dsize[0])
+    error(EXIT_FAILURE, 0, "%s: %s (hdu: %s) has %zu rows, but %zu rows "
+          "starting from row %zu (counting from 0) were requested",
+          __func__, filename, hdu, dsize[0], number, first);
+
+
+  /* Allocate the output (that only has the requested rows). */
+  for(i=1;i<ndim;++i) rowsize*=dsize[i];
+  dsize[0]=number;
+  img=gal_data_alloc(NULL, type, ndim, dsize, NULL, 0, minmapsize,
+                     quietmmap, name, unit, NULL);
+  blank=gal_blank_alloc_write(type);
+  if(name) free(name);
+  if(unit) free(unit);
+  free(dsize);
+
+
+  /* Read the rows into the allocated array. Note that the first element
+     in CFITSIO is 1, not 0. */
+  fits_read_img(fptr, gal_fits_type_to_datatype(type),
+                (LONGLONG)(first*rowsize+1), img->size, blank, img->array,
+                &anyblank, &status);
+  if(status) gal_fits_io_error(status, NULL);
+  free(blank);
+
+
+  /* Close the input FITS file and return the rows. */
+  fits_close_file(fptr, &status);
+  gal_fits_io_error(status, NULL);
+  return img;
+}
+
+
+
+
+
 /* The user has specified an input file + extension, and your program needs
    this input to be a special type. For such cases, this function can be
    used to convert the input file to the desired type. */
@@ -2692,17 +2757,137 @@ gal_fits_img_read_kernel(char *filename, char *hdu, size_t minmapsize,
 
 
 
+/* CFITSIO doesn't have a macro for UINT64, TLONGLONG is only for (signed)
+   INT64. So if the dataset has that type, we'll have to convert it to
+   'INT64' and in the mean-time shift its zero, we will then have to write
+   the BZERO and BSCALE keywords accordingly. */
+static gal_data_t *
+fits_img_u64_to_i64(gal_data_t *in, int hasblank)
+{
+  int64_t *i64;
+  gal_data_t *out;
+  uint64_t *u64, *u64f;
+
+  /* Allocate the necessary space. */
+  out=gal_data_alloc(NULL, GAL_TYPE_INT64, in->ndim, in->dsize, NULL, 0,
+                     in->minmapsize, in->quietmmap, NULL, NULL, NULL);
+
+  /* Copy the values while making the conversion. */
+  i64=out->array;
+  u64f=(u64=in->array)+in->size;
+  if(hasblank)
+    {
+      do *i64++ = ( *u64==GAL_BLANK_UINT64
+                    ? GAL_BLANK_INT64
+                    : (*u64 + INT64_MIN) );
+      while(++u64<u64f);
+    }
+  else
+    do *i64++ = (*u64 + INT64_MIN); while(++u64<u64f);
+
+  /* Return the converted dataset. */
+  return out;
+}
+
+
+
+
+
+/* Write the keywords that describe the data (that is already written in
+   the HDU): the type and blank value, name, units, comments and WCS of
+   'meta'. */
+static void
+fits_img_write_meta(fitsfile *fptr, gal_data_t *meta, int hasblank)
+{
+  void *blank;
+  char *u64key;
+  int status=0, datatype;
+
+  /* Set the CFITSIO datatype of the array (see 'fits_img_u64_to_i64'). */
+  datatype = ( meta->type==GAL_TYPE_UINT64
+               ? TLONGLONG
+               : gal_fits_type_to_datatype(meta->type) );
+
+  /* We need to write the BZERO and BSCALE keywords manually for unsigned
+     64-bit integers. VERY IMPORTANT: this has to be done after writing the
+     array. We cannot write this huge integer as a variable, so we'll
+     simply write the full record/card. It is just important that the
+     string be larger than 80 characters, CFITSIO will trim the rest of
+     the string. */
+  if(meta->type==GAL_TYPE_UINT64)
+    {
+      u64key="BZERO   =  9223372036854775808 / Offset of data                                         ";
+      fits_write_record(fptr, u64key, &status);
+      u64key="BSCALE  =                    1 / Default scaling factor                                 ";
+      fits_write_record(fptr, u64key, &status);
+      gal_fits_io_error(status, NULL);
+    }
+
+
+  /* Remove the two comment lines put by CFITSIO. Note that in some cases,
+     it might not exist. When this happens, the status value will be
+     non-zero. We don't care about this error, so to be safe, we will just
+     reset the status variable after these calls. */
+  fits_delete_key(fptr, "COMMENT", &status);
+  fits_delete_key(fptr, "COMMENT", &status);
+  status=0;
+
+
+  /* If we have blank pixels, we need to define a BLANK keyword when we are
+     dealing with integer types. */
+  if(hasblank)
+    switch(meta->type)
+      {
+      case GAL_TYPE_FLOAT32:
+      case GAL_TYPE_FLOAT64:
+        /* Do nothing! Since there are much fewer floating point types
+           (that don't need any BLANK keyword), we are checking them.*/
+        break;
+
+      default:
+        blank=gal_fits_key_img_blank(meta->type);
+        if(fits_write_key(fptr, datatype, "BLANK", blank,
+                          "Pixels with no data.", &status) )
+          gal_fits_io_error(status, "adding the BLANK keyword");
+        free(blank);
+      }
+
+
+  /* Write the extension name to the header. */
+  if(meta->name)
+    fits_write_key(fptr, TSTRING, "EXTNAME", meta->name, "", &status);
+
+
+  /* Write the units to the header. */
+  if(meta->unit)
+    fits_write_key(fptr, TSTRING, "BUNIT", meta->unit, "", &status);
+
+
+  /* Write comments if they exist. */
+  if(meta->comment)
+    fits_write_comment(fptr, meta->comment, &status);
+
+
+  /* If a WCS structure is present, write it in */
+  if(meta->wcs)
+    gal_wcs_write_in_fitsptr(fptr, meta->wcs);
+
+
+  /* Report any errors if we had any */
+  gal_fits_io_error(status, NULL);
+}
+
+
+
+
+
 /* This function will write all the data array information (including its
    WCS information) into a FITS file, but will not close it. Instead it
    will pass along the FITS pointer for further modification. */
 fitsfile *
 gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
 {
-  void *blank;
-  int64_t *i64;
-  char *u64key;
   fitsfile *fptr;
-  uint64_t *u64, *u64f;
   long fpixel=1, *naxes;
   size_t i, ndim=input->ndim;
   int hasblank, status=0, datatype=0;
@@ -2734,30 +2919,12 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
   for(i=0;i<ndim;++i) naxes[ndim-1-i]=towrite->dsize[i];
 
 
-  /* Create the FITS file. Unfortunately CFITSIO doesn't have a macro for
-     UINT64, TLONGLONG is only for (signed) INT64. So if the dataset has
-     that type, we'll have to convert it to 'INT64' and in the mean-time
-     shift its zero, we will then have to write the BZERO and BSCALE
-     keywords accordingly. */
+  /* Create the FITS file. For unsigned 64-bit integers, see the comments
+     of 'fits_img_u64_to_i64'. */
   if(block->type==GAL_TYPE_UINT64)
     {
-      /* Allocate the necessary space. */
-      i64data=gal_data_alloc(NULL, GAL_TYPE_INT64, ndim, towrite->dsize,
-                             NULL, 0, block->minmapsize, block->quietmmap,
-                             NULL, NULL, NULL);
-
-      /* Copy the values while making the conversion. */
-      i64=i64data->array;
-      u64f=(u64=towrite->array)+towrite->size;
-      if(hasblank)
-        {
-          do *i64++ = ( *u64==GAL_BLANK_UINT64
-                        ? GAL_BLANK_INT64
-                        : (*u64 + INT64_MIN) );
-          while(++u64<u64f);
-        }
-      else
-        do *i64++ = (*u64 + INT64_MIN); while(++u64<u64f);
+      /* Convert the values. */
+      i64data=fits_img_u64_to_i64(towrite, hasblank);
 
       /* We can now use CFITSIO's signed-int64 type macros. */
       datatype=TLONGLONG;
@@ -2768,18 +2935,7 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
       fits_write_img(fptr, datatype, fpixel, i64data->size, i64data->array,
                      &status);
       gal_fits_io_error(status, NULL);
-
-
-      /* We need to write the BZERO and BSCALE keywords manually. VERY
-         IMPORTANT: this has to be done after writing the array. We cannot
-         write this huge integer as a variable, so we'll simply write the
-         full record/card. It is just important that the string be larger
-         than 80 characters, CFITSIO will trim the rest of the string. */
-      u64key="BZERO   =  9223372036854775808 / Offset of data                                         ";
-      fits_write_record(fptr, u64key, &status);
-      u64key="BSCALE  =                    1 / Default scaling factor                                 ";
-      fits_write_record(fptr, u64key, &status);
-      gal_fits_io_error(status, NULL);
+      gal_data_free(i64data);
     }
   else
     {
@@ -2798,58 +2954,12 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename)
     }
 
 
-  /* Remove the two comment lines put by CFITSIO. Note that in some cases,
-     it might not exist. When this happens, the status value will be
-     non-zero. We don't care about this error, so to be safe, we will just
-     reset the status variable after these calls. */
-  fits_delete_key(fptr, "COMMENT", &status);
-  fits_delete_key(fptr, "COMMENT", &status);
-  status=0;
-
-
-  /* If we have blank pixels, we need to define a BLANK keyword when we are
-     dealing with integer types. */
-  if(hasblank)
-    switch(towrite->type)
-      {
-      case GAL_TYPE_FLOAT32:
-      case GAL_TYPE_FLOAT64:
-        /* Do nothing! Since there are much fewer floating point types
-           (that don't need any BLANK keyword), we are checking them.*/
-        break;
-
-      default:
-        blank=gal_fits_key_img_blank(towrite->type);
-        if(fits_write_key(fptr, datatype, "BLANK", blank,
-                          "Pixels with no data.", &status) )
-          gal_fits_io_error(status, "adding the BLANK keyword");
-        free(blank);
-      }
-
-
-  /* Write the extension name to the header. */
-  if(towrite->name)
-    fits_write_key(fptr, TSTRING, "EXTNAME", towrite->name, "", &status);
-
-
-  /* Write the units to the header. */
-  if(towrite->unit)
-    fits_write_key(fptr, TSTRING, "BUNIT", towrite->unit, "", &status);
-
-
-  /* Write comments if they exist. */
-  if(towrite->comment)
-    fits_write_comment(fptr, towrite->comment, &status);
-
-
-  /* If a WCS structure is present, write it in */
-  if(towrite->wcs)
-    gal_wcs_write_in_fitsptr(fptr, towrite->wcs);
+  /* Write the keywords describing the data. */
+  fits_img_write_meta(fptr, towrite, hasblank);
 
 
-  /* Report any errors if we had any */
+  /* Clean up and return. */
   free(naxes);
-  gal_fits_io_error(status, NULL);
   if(towrite!=input) gal_data_free(towrite);
   return fptr;
 }
@@ -2902,6 +3012,117 @@ gal_fits_img_write_to_type(gal_data_t *data, char *filename,
 
 
 
+/* Writing an image in multiple steps (for example when the full image is
+   larger than the RAM): 'gal_fits_img_write_rows_start' will create the
+   image HDU (with the type and dimensions of 'meta', its array is not
+   used). The rows can then be written (in any order) with
+   'gal_fits_img_write_rows' and finally 'gal_fits_img_write_rows_end'
+   will write the keywords and close the file. See the description of
+   'gal_fits_img_read_rows' for the definition of a "row". */
+fitsfile *
+gal_fits_img_write_rows_start(gal_data_t *meta, char *filename)
+{
+  long *naxes;
+  fitsfile *fptr;
+  int status=0;
+  size_t i, ndim=meta->ndim;
+
+  /* Small sanity check. */
+  if( gal_fits_name_is_fits(filename)==0 )
+    error(EXIT_FAILURE, 0, "%s: not a FITS suffix", filename);
+
+  /* Allocate and fill the 'naxes' array (in opposite order, and 'long'
+     type). */
+  naxes=gal_pointer_allocate( ( sizeof(long)==8
+                                ? GAL_TYPE_INT64
+                                : GAL_TYPE_INT32 ), ndim, 0, __func__,
+                              "naxes");
+  for(i=0;i<ndim;++i) naxes[ndim-1-i]=meta->dsize[i];
+
+  /* Open the file and create the image HDU. For unsigned 64-bit
+     integers, see the comments of 'fits_img_u64_to_i64'. */
+  fptr=gal_fits_open_to_write(filename);
+  fits_create_img(fptr, ( meta->type==GAL_TYPE_UINT64
+                          ? LONGLONG_IMG
+                          : gal_fits_type_to_bitpix(meta->type) ),
+                  ndim, naxes, &status);
+  gal_fits_io_error(status, NULL);
+
+  /* The keywords are written after the data. To avoid shifting the
+     (possibly very large) data when they are written, we'll reserve
+     space for them in the header now. */
+  fits_set_hdrsize(fptr, GAL_FITSINTERNAL_IMG_ROWS_NUMKEYS, &status);
+  gal_fits_io_error(status, NULL);
+
+  /* Clean up and return. */
+  free(naxes);
+  return fptr;
+}
+
+
+
+
+
+/* Write the rows in 'rows' into the image HDU that was created with
+   'gal_fits_img_write_rows_start'. 'first' is the row (counting from
+   zero) in the full image that corresponds to the first row of
+   'rows'. */
+void
+gal_fits_img_write_rows(fitsfile *fptr, gal_data_t *rows, size_t first)
+{
+  int status=0;
+  gal_data_t *i64data;
+  size_t rowsize=rows->size/rows->dsize[0];
+  LONGLONG firstelem=first*rowsize+1; /* CFITSIO counts from 1. */
+
+  /* Small sanity check. */
+  if(gal_tile_block(rows)!=rows)
+    error(EXIT_FAILURE, 0, "%s: the input must not be a tile", __func__);
+
+  /* Write the rows. For unsigned 64-bit integers, see the comments of
+     'fits_img_u64_to_i64'. */
+  if(rows->type==GAL_TYPE_UINT64)
+    {
+      i64data=fits_img_u64_to_i64(rows, gal_blank_present(rows, 0));
+      fits_write_img(fptr, TLONGLONG, firstelem, i64data->size,
+                     i64data->array, &status);
+      gal_data_free(i64data);
+    }
+  else
+    fits_write_img(fptr, gal_fits_type_to_datatype(rows->type), firstelem,
+                   rows->size, rows->array, &status);
+  gal_fits_io_error(status, NULL);
+}
+
+
+
+
+
+/* Write the keywords describing the image (from 'meta') and the version
+   information, then close the file. Since the rows are written
+   separately, the caller should say if any of the rows had blank values
+   with 'hasblank'. */
+void
+gal_fits_img_write_rows_end(fitsfile *fptr, gal_data_t *meta, int hasblank,
+                            gal_fits_list_key_t *headers,
+                            char *program_string)
+{
+  int status=0;
+
+  /* Write the keywords describing the data and the version
+     information. */
+  fits_img_write_meta(fptr, meta, hasblank);
+  gal_fits_key_write_version_in_ptr(&headers, program_string, fptr);
+
+  /* Close the FITS file. */
+  fits_close_file(fptr, &status);
+  gal_fits_io_error(status, NULL);
+}
+
+
+
+
+
 /* This function is mainly useful when you want to make FITS files in
    parallel (from one main WCS structure, with just differing CRPIX) for
    two reasons:
@@ -3494,11 +3715,13 @@ gal_fits_tab_info(char *filename, char *hdu, size_t *numcols,
 
 
 /* Read CFITSIO un-readable (INF, -INF or NAN) floating point values in
-   FITS ASCII tables. */
+   FITS ASCII tables ('numrows' rows from 'firstrow', counting from 1, are
+   written from the 'outrow' element of 'out'). */
 static void
 fits_tab_read_ascii_float_special(char *filename, char *hdu,
                                   fitsfile *fptr, gal_data_t *out,
-                                  size_t colnum, size_t numrows,
+                                  size_t colnum, size_t firstrow,
+                                  size_t outrow, size_t numrows,
                                   size_t minmapsize, int quietmmap)
 {
   double tmp;
@@ -3524,7 +3747,7 @@ fits_tab_read_ascii_float_special(char *filename, char *hdu,
     }
 
   /* Read the column as a string. */
-  fits_read_col(fptr, TSTRING, colnum, 1, 1, out->size, NULL,
+  fits_read_col(fptr, TSTRING, colnum, firstrow, 1, numrows, NULL,
                 strrows->array, &anynul, &status);
   gal_fits_io_error(status, NULL);
 
@@ -3538,9 +3761,9 @@ fits_tab_read_ascii_float_special(char *filename, char *hdu,
 
       /* Write it into the output dataset. */
       if(out->type==GAL_TYPE_FLOAT32)
-        ((float *)(out->array))[i]=tmp;
+        ((float *)(out->array))[outrow+i]=tmp;
       else
-        ((double *)(out->array))[i]=tmp;
+        ((double *)(out->array))[outrow+i]=tmp;
     }
 
   /* Clean up. */
@@ -3551,20 +3774,223 @@ fits_tab_read_ascii_float_special(char *filename, char *hdu,
 
 
 
-/* Read one column of the table in parallel. */
+/* Read the requested columns of a table in parallel. Each thread opens
+   its own 'fitsfile' pointer. Without row selection, every action is one
+   column over one range of rows (so even a few columns of a very long
+   table are read on all threads). With row selection, every action is a
+   block of rows in all the columns: the selection function is applied on
+   the block and only the selected rows are kept. */
+#define FITS_TAB_READ_BLOCK_ROWS 65536
 struct fits_tab_read_onecol_params
 {
   char              *filename;  /* Name of FITS file with table.     */
   char                   *hdu;  /* HDU of input table.               */
   size_t              numrows;  /* Number of rows in table to read.  */
   size_t              numcols;  /* Number of columns.                */
+  size_t            numranges;  /* Number of row ranges (no select). */
   size_t           minmapsize;  /* Minimum space to memory-map.      */
   int               quietmmap;  /* Don't print memory-mapping info.  */
   gal_data_t         *allcols;  /* Information of all columns.       */
   gal_data_t       **colarray;  /* Array of pointers to all columns. */
-  gal_list_sizet_t   *indexll;  /* Index of columns to read.         */
+  size_t              *colind;  /* Input index of each output column.*/
+  gal_data_t         **blocks;  /* Selected rows of each block.      */
+  void           *selectparams; /* Parameters of selection function. */
+  void (*select)(gal_data_t *, gal_data_t *, void *); /* Selection.  */
 };
-void *
+
+
+
+
+
+/* Allocate the dataset for 'numrows' rows of the input column 'indin'
+   (for strings, the pointers to each row's string are only initialized
+   to NULL, see 'fits_tab_read_strings'). */
+static gal_data_t *
+fits_tab_read_col_alloc(struct fits_tab_read_onecol_params *p,
+                        size_t indin, size_t numrows)
+{
+  size_t ndim, dsize[2];
+  uint8_t type=p->allcols[indin].type;
+  size_t repeat=p->allcols[indin].minmapsize;
+
+  if(type!=GAL_TYPE_STRING && repeat>1)
+    { ndim=2; dsize[0]=numrows; dsize[1]=repeat; }
+  else
+    { ndim=1; dsize[0]=numrows; }
+  return gal_data_alloc(NULL, type, ndim, dsize, NULL,
+                        type==GAL_TYPE_STRING, p->minmapsize,
+                        p->quietmmap, p->allcols[indin].name,
+                        p->allcols[indin].unit, p->allcols[indin].comment);
+}
+
+
+
+
+
+/* For a string column, we need an allocated array for each element, even
+   in binary values. This value should be stored in the disp_width element
+   of the data structure, which is done automatically in
+   'gal_fits_table_info'. */
+static void
+fits_tab_read_strings(struct fits_tab_read_onecol_params *p,
+                      gal_data_t *col, size_t indin, size_t first,
+                      size_t num)
+{
+  size_t j, strw;
+  char **strarr=col->array;
+
+  /* Since the column may contain blank values, and the blank string is
+     pre-defined in Gnuastro, we need to be sure that for each row, a
+     blank string can fit. */
+  strw = ( strlen(GAL_BLANK_STRING) > p->allcols[indin].disp_width
+           ? strlen(GAL_BLANK_STRING)
+           : p->allcols[indin].disp_width );
+
+  /* Allocate the space for each row's strings. */
+  for(j=first;j<first+num;++j)
+    {
+      errno=0;
+      strarr[j]=calloc(strw+1, sizeof *strarr[0]); /* +1 for '\0' */
+      if(strarr[j]==NULL)
+        error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
+              "strarr[%zu]", __func__, (strw+1) * sizeof *strarr[j], j);
+    }
+}
+
+
+
+
+
+/* Read 'num' rows of the input column 'indin' (starting from the row
+   'inrow', counting from zero) into the rows of 'col' that start from
+   'outrow'. */
+static void
+fits_tab_read_col_rows(struct fits_tab_read_onecol_params *p,
+                       fitsfile *fptr, int hdutype, gal_data_t *col,
+                       size_t indin, size_t inrow, size_t outrow,
+                       size_t num)
+{
+  char **strarr;
+  void *blank, *blankuse;
+  int isfloat, anynul=0, status=0;
+  size_t width = col->ndim==2 ? col->dsize[1] : 1;
+  void *start = ( (char *)(col->array)
+                  + outrow * width * gal_type_sizeof(col->type) );
+
+  /* If this column has a 'repeat' of zero, then there is nothing for
+     CFITSIO to read (it will crash with "FITSIO status = 308: bad first
+     element number First element to write is too large: 1; max allowed
+     value is 0"). Its elements are set to blank by the caller. */
+  if( num==0
+      || p->allcols[indin].flag & GAL_TABLEINTERN_FLAG_TFORM_REPEAT_IS_ZERO )
+    return;
+
+  /* Allocate a blank value for the given type and read/store the column
+     using CFITSIO.
+
+     * For binary tables, we only need blank values for integer types. For
+       binary floating point types, the FITS standard defines blanks as
+       NaN (same as almost any other software like Gnuastro). However if a
+       blank value is specified, CFITSIO will convert other special
+       numbers like 'inf' to NaN also. We want to be able to distringuish
+       'inf' and NaN here, so for floating point types in binary tables,
+       we won't define any blank value. In ASCII tables, CFITSIO doesn't
+       read the 'NAN' values (that it has written itself) unless we
+       specify a blank pointer/value.
+
+     * 'fits_read_col' takes the pointer to the thing that should be
+       placed in a blank column (for strings, the 'char *') pointer.
+       However, for strings, 'gal_blank_alloc_write' will return a 'char
+       **' pointer! So for strings, we need to dereference the blank. This
+       is why we need 'blankuse'. */
+  isfloat = ( col->type==GAL_TYPE_FLOAT32
+              || col->type==GAL_TYPE_FLOAT64 );
+  blank = ( ( hdutype==BINARY_TBL && isfloat )
+            ? NULL
+            : gal_blank_alloc_write(col->type) );
+  blankuse = ( col->type==GAL_TYPE_STRING
+               ? *((char **)blank)
+               : blank);
+  fits_read_col(fptr, gal_fits_type_to_datatype(col->type), indin+1,
+                inrow+1, 1, num*width, blankuse, start, &anynul, &status);
+
+  /* In the ASCII table format some things need to be checked. */
+  if( hdutype==ASCII_TBL )
+    {
+      /* CFITSIO might not be able to read 'INF' or '-INF'. In this case,
+        it will set status to 'BAD_C2D' or 'BAD_C2F'. So, we'll use our
+        own parser for the column values. */
+      if(isfloat && (status==BAD_C2D || status==BAD_C2F) )
+        {
+          fits_tab_read_ascii_float_special(p->filename, p->hdu, fptr, col,
+                                            indin+1, inrow+1, outrow, num,
+                                            p->minmapsize, p->quietmmap);
+          status=0;
+        }
+    }
+  gal_fits_io_error(status, NULL); /* After 'status' correction. */
+
+  /* Clean up (just note that the blank value for strings, is an array of
+     strings, so we need to free the contents before freeing itself). */
+  if(col->type==GAL_TYPE_STRING)
+    {strarr=blank; free(strarr[0]);}
+  if(blank) free(blank);
+}
+
+
+
+
+
+/* Read one block of rows in all the requested columns, and only keep the
+   rows that are selected by the caller's function. */
+static void
+fits_tab_read_select_block(struct fits_tab_read_onecol_params *p,
+                           fitsfile *fptr, int hdutype, size_t block)
+{
+  size_t c, first, num;
+  gal_data_t *col, *cols=NULL, *flag;
+
+  /* Rows of this block. */
+  first=block*FITS_TAB_READ_BLOCK_ROWS;
+  num = ( first+FITS_TAB_READ_BLOCK_ROWS > p->numrows
+          ? p->numrows-first
+          : FITS_TAB_READ_BLOCK_ROWS );
+
+  /* Read the columns (the list is built from the last column, so it is
+     in the same order as the output). */
+  for(c=p->numcols;c--;)
+    {
+      col=fits_tab_read_col_alloc(p, p->colind[c], num);
+      if(p->allcols[p->colind[c]].flag
+         & GAL_TABLEINTERN_FLAG_TFORM_REPEAT_IS_ZERO)
+        gal_blank_initialize(col);
+      else
+        {
+          if(col->type==GAL_TYPE_STRING)
+            fits_tab_read_strings(p, col, p->colind[c], 0, num);
+          fits_tab_read_col_rows(p, fptr, hdutype, col, p->colind[c],
+                                 first, 0, num);
+        }
+      col->next=cols;
+      cols=col;
+    }
+
+  /* Flag the rows that should be removed and remove them. */
+  flag=gal_data_alloc(NULL, GAL_TYPE_UINT8, 1, &num, NULL, 1,
+                      p->minmapsize, p->quietmmap, NULL, NULL, NULL);
+  p->select(cols, flag, p->selectparams);
+  gal_tableintern_rows_remove(cols, flag->array);
+
+  /* Keep the selected rows of this block and clean up. */
+  p->blocks[block]=cols;
+  gal_data_free(flag);
+}
+
+
+
+
+
+static void *
 fits_tab_read_onecol(void *in_prm)
 {
   /* Low-level definitions to be done first. */
@@ -3573,15 +3999,10 @@ fits_tab_read_onecol(void *in_prm)
     = (struct fits_tab_read_onecol_params *)tprm->params;
 
   /* Subsequent definitions. */
-  uint8_t type;
-  char **strarr;
   fitsfile *fptr;
   gal_data_t *col;
-  size_t dsize[2];
-  gal_list_sizet_t *tmp;
-  void *blank, *blankuse;
-  int isfloat, hdutype, anynul=0, status=0;
-  size_t i, j, c, ndim, strw, repeat, indout, indin=GAL_BLANK_SIZE_T;
+  size_t i, c, r, first, num;
+  int hdutype, status=0;
 
   /* Open the FITS file */
   fptr=gal_fits_hdu_open_format(p->filename, p->hdu, 1);
@@ -3591,127 +4012,30 @@ fits_tab_read_onecol(void *in_prm)
   if (fits_get_hdu_type(fptr, &hdutype, &status) )
     gal_fits_io_error(status, NULL);
 
-  /* Go over all the columns that were assigned to this thread. */
+  /* Go over all the actions that were assigned to this thread. */
   for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
-    {
-      /* Find the necessary indexs (index of output column 'indout', and
-         index of input 'indin'). */
-      c=0;
-      indout = tprm->indexs[i];
-      for(tmp=p->indexll;tmp!=NULL;tmp=tmp->next)
-        { if(c==indout) { indin=tmp->v; break; } ++c; }
-
-      /* Allocate the necessary space for this column. */
-      type=p->allcols[indin].type;
-      repeat=p->allcols[indin].minmapsize;
-      if(type!=GAL_TYPE_STRING && repeat>1)
-        { ndim=2; dsize[0]=p->numrows; dsize[1]=repeat; }
-      else
-        { ndim=1; dsize[0]=p->numrows; }
-      col=gal_data_alloc(NULL, type, ndim, dsize, NULL, 0,
-                         p->minmapsize, p->quietmmap,
-                         p->allcols[indin].name,
-                         p->allcols[indin].unit,
-                         p->allcols[indin].comment);
-
-      /* For a string column, we need an allocated array for each element,
-         even in binary values. This value should be stored in the
-         disp_width element of the data structure, which is done
-         automatically in 'gal_fits_table_info'. */
-      if(col->type==GAL_TYPE_STRING)
-        {
-          /* Since the column may contain blank values, and the blank
-             string is pre-defined in Gnuastro, we need to be sure that for
-             each row, a blank string can fit. */
-          strw = ( strlen(GAL_BLANK_STRING) > p->allcols[indin].disp_width
-                   ? strlen(GAL_BLANK_STRING)
-                   : p->allcols[indin].disp_width );
-
-          /* Allocate the space for each row's strings. */
-          strarr=col->array;
-          for(j=0;j<p->numrows;++j)
-            {
-              errno=0;
-              strarr[j]=calloc(strw+1, sizeof *strarr[0]); /* +1 for '\0' */
-              if(strarr[j]==NULL)
-                error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
-                      "strarr[%zu]", __func__,
-                      (p->allcols[indin].disp_width+1) * sizeof *strarr[j],
-                      j);
-            }
-        }
-
-      /* If this column has a 'repeat' of zero, then just set all its
-         elements to its relevant blank type and don't call CFITSIO (there
-         is nothing for it to read, and it will crash with "FITSIO status =
-         308: bad first element number First element to write is too large:
-         1; max allowed value is 0"). */
-      if(p->allcols[indin].flag & GAL_TABLEINTERN_FLAG_TFORM_REPEAT_IS_ZERO)
-        gal_blank_initialize(col);
-
-      /* The column has non-zero width, read its contents. */
-      else
-        {
-          /* Allocate a blank value for the given type and read/store the
-             column using CFITSIO.
-
-             * For binary tables, we only need blank values for integer
-               types. For binary floating point types, the FITS standard
-               defines blanks as NaN (same as almost any other software
-               like Gnuastro). However if a blank value is specified,
-               CFITSIO will convert other special numbers like 'inf' to NaN
-               also. We want to be able to distringuish 'inf' and NaN here,
-               so for floating point types in binary tables, we won't
-               define any blank value. In ASCII tables, CFITSIO doesn't
-               read the 'NAN' values (that it has written itself) unless we
-               specify a blank pointer/value.
-
-             * 'fits_read_col' takes the pointer to the thing that should
-               be placed in a blank column (for strings, the 'char *')
-               pointer. However, for strings, 'gal_blank_alloc_write' will
-               return a 'char **' pointer! So for strings, we need to
-               dereference the blank. This is why we need 'blankuse'. */
-          isfloat = ( col->type==GAL_TYPE_FLOAT32
-                      || col->type==GAL_TYPE_FLOAT64 );
-          blank = ( ( hdutype==BINARY_TBL && isfloat )
-                    ? NULL
-                    : gal_blank_alloc_write(col->type) );
-          blankuse = ( col->type==GAL_TYPE_STRING
-                       ? *((char **)blank)
-                       : blank);
-          fits_read_col(fptr, gal_fits_type_to_datatype(col->type),
-                        indin+1, 1, 1, col->size, blankuse, col->array,
-                        &anynul, &status);
-
-          /* In the ASCII table format some things need to be checked. */
-          if( hdutype==ASCII_TBL )
-            {
-              /* CFITSIO might not be able to read 'INF' or '-INF'. In this
-                case, it will set status to 'BAD_C2D' or 'BAD_C2F'. So,
-                we'll use our own parser for the column values. */
-              if(isfloat && (status==BAD_C2D || status==BAD_C2F) )
-                {
-                  fits_tab_read_ascii_float_special(p->filename, p->hdu,
-                                                    fptr, col, indin+1,
-                                                    p->numrows,
-                                                    p->minmapsize,
-                                                    p->quietmmap);
-                  status=0;
-                }
-            }
-          gal_fits_io_error(status, NULL); /* After 'status' correction. */
-
-          /* Clean up and sanity check (just note that the blank value for
-             strings, is an array of strings, so we need to free the
-             contents before freeing itself). */
-          if(col->type==GAL_TYPE_STRING)
-            {strarr=blank; free(strarr[0]);}
-          if(blank) free(blank);
-        }
-
-      /* Everything is fine, put this column in the output array. */
-      p->colarray[indout]=col;
-    }
+    if(p->select)
+      fits_tab_read_select_block(p, fptr, hdutype, tprm->indexs[i]);
+    else
+      {
+        /* Index of the output column ('c') and its range of rows ('r').
+           Consecutive actions are the columns of one range of rows, so
+           each thread reads nearby parts of the file. */
+        c = tprm->indexs[i] % p->numcols;
+        r = tprm->indexs[i] / p->numcols;
+        first = r * p->numrows / p->numranges;
+        num = (r+1) * p->numrows / p->numranges - first;
+
+        /* Read the rows of this column (strings need allocation
+           first). */
+        col=p->colarray[c];
+        if(col->type==GAL_TYPE_STRING
+           && !(p->allcols[p->colind[c]].flag
+                & GAL_TABLEINTERN_FLAG_TFORM_REPEAT_IS_ZERO) )
+          fits_tab_read_strings(p, col, p->colind[c], first, num);
+        fits_tab_read_col_rows(p, fptr, hdutype, col, p->colind[c], first,
+                               first, num);
+      }
 
   /* Close the FITS file */
   status=0;
@@ -3727,13 +4051,115 @@ fits_tab_read_onecol(void *in_prm)
 
 
 
+/* When there are no rows to read, make empty-sized columns. */
+static gal_data_t *
+fits_tab_read_empty(gal_data_t *allcols, gal_list_sizet_t *indexll,
+                    size_t minmapsize, int quietmmap)
+{
+  size_t numrows=1;
+  gal_data_t *out=NULL;
+  gal_list_sizet_t *ind;
+
+  /* We are setting a 1-element array to avoid any allocation errors. Then
+     we are freeing the allocated spaces and correcting the sizes. */
+  for(ind=indexll; ind!=NULL; ind=ind->next)
+    {
+      /* Do the allocation. */
+      gal_list_data_add_alloc(&out, NULL, allcols[ind->v].type, 1,
+                              &numrows, NULL, 0, minmapsize, quietmmap,
+                              allcols[ind->v].name,
+                              allcols[ind->v].unit,
+                              allcols[ind->v].comment);
+
+      /* Correct the array and sizes. */
+      out->size=0;
+      free(out->array);
+      out->array=NULL;
+      out->dsize[0]=0;
+    }
+
+  /* The list was built in the reverse order. */
+  gal_list_data_reverse(&out);
+  return out;
+}
+
+
+
+
+
+/* Put the selected rows of all the blocks into the final columns. */
+static gal_data_t *
+fits_tab_read_select_merge(struct fits_tab_read_onecol_params *p,
+                           size_t numblocks, gal_list_sizet_t *indexll)
+{
+  gal_data_t *bcol;
+  size_t b, c, i, nbytes, offset, numrows=0;
+
+  /* Find the total number of selected rows. */
+  for(b=0;b<numblocks;++b) numrows += p->blocks[b]->dsize[0];
+
+  /* Copy the rows of each block into the output. */
+  if(numrows)
+    for(c=0;c<p->numcols;++c)
+      {
+        offset=0;
+        p->colarray[c]=fits_tab_read_col_alloc(p, p->colind[c], numrows);
+        for(b=0;b<numblocks;++b)
+          {
+            bcol=p->blocks[b];
+            for(i=0;i<c;++i) bcol=bcol->next;
+            nbytes = bcol->size * gal_type_sizeof(bcol->type);
+            if(nbytes)
+              {
+                memcpy( (char *)(p->colarray[c]->array)+offset,
+                        bcol->array, nbytes );
+                offset+=nbytes;
+
+                /* The strings now belong to the output. */
+                if(bcol->type==GAL_TYPE_STRING) memset(bcol->array, 0,
+                                                       nbytes);
+              }
+          }
+      }
+
+  /* Clean up and return. */
+  for(b=0;b<numblocks;++b) gal_list_data_free(p->blocks[b]);
+  return ( numrows
+           ? NULL
+           : fits_tab_read_empty(p->allcols, indexll, p->minmapsize,
+                                 p->quietmmap) );
+}
+
+
+
+
+
 /* Read the column indexs into a dataset. */
 gal_data_t *
 gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
                   gal_data_t *allcols, gal_list_sizet_t *indexll,
                   size_t numthreads, size_t minmapsize, int quietmmap)
 {
-  size_t i;
+  return gal_fits_tab_read_select(filename, hdu, numrows, allcols,
+                                  indexll, NULL, NULL, numthreads,
+                                  minmapsize, quietmmap);
+}
+
+
+
+
+
+/* Read the column indexs into a dataset, only keeping the rows that
+   aren't flagged by the 'select' function (if it isn't NULL). */
+gal_data_t *
+gal_fits_tab_read_select(char *filename, char *hdu, size_t numrows,
+                         gal_data_t *allcols, gal_list_sizet_t *indexll,
+                         void (*select)(gal_data_t *, gal_data_t *,
+                                        void *),
+                         void *selectparams, size_t numthreads,
+                         size_t minmapsize, int quietmmap)
+{
+  size_t i, numblocks=0;
   gal_data_t *out=NULL;
   gal_list_sizet_t *ind;
   struct fits_tab_read_onecol_params p;
@@ -3747,63 +4173,79 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
   size_t nthreads=1;
 #endif
 
-  /* We actually do have columns to read. */
-  if(numrows)
+  /* There are no rows to read. */
+  if(numrows==0)
+    return fits_tab_read_empty(allcols, indexll, minmapsize, quietmmap);
+
+  /* Allocate array of output columns (to keep each read column in its
+     proper place as they are read in parallel) and the input index of
+     each output column. */
+  errno=0;
+  p.numcols = gal_list_sizet_number(indexll);
+  p.colarray = calloc( p.numcols, sizeof *(p.colarray) );
+  if(p.colarray==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'p.colarray'", __func__, p.numcols*(sizeof *(p.colarray)));
+  p.colind=gal_pointer_allocate(GAL_TYPE_SIZE_T, p.numcols, 0, __func__,
+                                "p.colind");
+  i=0; for(ind=indexll; ind!=NULL; ind=ind->next) p.colind[i++]=ind->v;
+
+  /* Basic settings. */
+  p.hdu = hdu;
+  p.blocks = NULL;
+  p.select = select;
+  p.allcols = allcols;
+  p.numrows = numrows;
+  p.filename = filename;
+  p.quietmmap = quietmmap;
+  p.minmapsize = minmapsize;
+  p.selectparams = selectparams;
+
+  /* With row selection, each action is one block of rows. */
+  if(select)
     {
-      /* Allocate array of output columns (to keep each read column in its
-         proper place as they are read in parallel). */
+      numblocks = (numrows-1) / FITS_TAB_READ_BLOCK_ROWS + 1;
       errno=0;
-      p.numcols = gal_list_sizet_number(indexll);
-      p.colarray = calloc( p.numcols, sizeof *(p.colarray) );
-      if(p.colarray==NULL)
-        error(EXIT_FAILURE, 0, "%s: couldn't allocate %zu bytes for "
-              "'p.colarray'", __func__, p.numcols*(sizeof *(p.colarray)));
-
-      /* Prepare for parallelization and spin-off the threads. */
-      p.hdu = hdu;
-      p.allcols = allcols;
-      p.numrows = numrows;
-      p.indexll = indexll;
-      p.filename = filename;
-      p.quietmmap = quietmmap;
-      p.minmapsize = minmapsize;
-      gal_threads_spin_off(fits_tab_read_onecol, &p, p.numcols, nthreads,
+      p.blocks=calloc(numblocks, sizeof *p.blocks);
+      if(p.blocks==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "'p.blocks'", __func__, numblocks*sizeof *p.blocks);
+      gal_threads_spin_off(fits_tab_read_onecol, &p, numblocks, nthreads,
                            minmapsize, quietmmap);
-
-      /* Put the columns into a single list and free the array of
-         pointers. */
-      out=p.colarray[0];
-      for(i=0;i<p.numcols-1;++i)
-        p.colarray[i]->next = p.colarray[i+1];
-      free(p.colarray);
+      out=fits_tab_read_select_merge(&p, numblocks, indexll);
+      free(p.blocks);
     }
 
-  /* There are no rows to read ('numrows==NULL'). Make an empty-sized
-     array. */
+  /* Without row selection, allocate the full columns here and read each
+     one in one range of rows per thread (when there are enough rows). */
   else
     {
-      /* We are setting a 1-element array to avoid any allocation
-         errors. Then we are freeing the allocated spaces and correcting
-         the sizes. */
-      numrows=1;
-      for(ind=indexll; ind!=NULL; ind=ind->next)
+      p.numranges = numrows / FITS_TAB_READ_BLOCK_ROWS + 1;
+      if(p.numranges>nthreads) p.numranges=nthreads;
+      for(i=0;i<p.numcols;++i)
         {
-          /* Do the allocation. */
-          gal_list_data_add_alloc(&out, NULL, allcols[ind->v].type, 1,
-                                  &numrows, NULL, 0, minmapsize, quietmmap,
-                                  allcols[ind->v].name,
-                                  allcols[ind->v].unit,
-                                  allcols[ind->v].comment);
-
-          /* Correct the array and sizes. */
-          out->size=0;
-          out->array=NULL;
-          out->dsize[0]=0;
-          free(out->array);
+          p.colarray[i]=fits_tab_read_col_alloc(&p, p.colind[i], numrows);
+          if(allcols[p.colind[i]].flag
+             & GAL_TABLEINTERN_FLAG_TFORM_REPEAT_IS_ZERO)
+            gal_blank_initialize(p.colarray[i]);
         }
+      gal_threads_spin_off(fits_tab_read_onecol, &p,
+                           p.numcols*p.numranges, nthreads, minmapsize,
+                           quietmmap);
     }
 
-  /* Return the output. */
+  /* Put the columns into a single list (if they weren't all removed by
+     the selection). */
+  if(out==NULL)
+    {
+      out=p.colarray[0];
+      for(i=0;i<p.numcols-1;++i)
+        p.colarray[i]->next = p.colarray[i+1];
+    }
+
+  /* Clean up and return. */
+  free(p.colind);
+  free(p.colarray);
   return out;
 }
 
@@ -3811,6 +4253,7 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
 
 
 
+
 /* This function will allocate new copies for all elements to have the same
    length as the maximum length and set all trailing elements to '\0' for
    those that are shorter than the length. The return value is the
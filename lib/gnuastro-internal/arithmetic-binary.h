@@ -35,34 +35,57 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 /************************************************************************/
 /*************             Low-level operators          *****************/
 /************************************************************************/
-/* Final step to be used by all operators and all types. */
+/* Check if the value 'V' is not blank (where 'B' is the blank value of its
+   type). For integers, the blank value is a number (so 'B==B'), and the
+   value should not be equal to it. For floating points, the blank value
+   is a NaN (so 'B!=B') and the value should not be NaN. Since 'B' doesn't
+   change within the loops, the compiler will remove the first check from
+   the loop. */
+#define BINARY_NOT_BLANK(V, B) ( (B)==(B) ? (V)!=(B) : (V)==(V) )
+
+
+
+
+
+/* Final step to be used by all operators and all types. All the
+   conditions are checked outside of the loops and each loop only works
+   with the indexs of its arrays. This allows the compiler to vectorize the
+   loops (use SIMD instructions). */
 #define BINARY_OP_OT_RT_LT_SET(OP, OT, LT, RT) {                        \
     LT lb, *la=l->array;                                                \
     RT rb, *ra=r->array;                                                \
-    OT ob, *oa=o->array, *of=oa + o->size;                              \
+    OT ob, *oa=o->array;                                                \
+    size_t i, n=o->size;                                                \
     if(checkblank)                                                      \
       {                                                                 \
         gal_blank_write(&lb, l->type);                                  \
         gal_blank_write(&rb, r->type);                                  \
         gal_blank_write(&ob, o->type);                                  \
-        do                                                              \
+        if(l->size==r->size)                                            \
+          for(i=0;i<n;++i)                                              \
+            oa[i] = ( BINARY_NOT_BLANK(la[i], lb)                       \
+                      && BINARY_NOT_BLANK(ra[i], rb) )                  \
+                    ? la[i] OP ra[i] : ob;                              \
+        else if(l->size==1)                                             \
+          {                                                             \
+            if( BINARY_NOT_BLANK(la[0], lb) )                           \
+              for(i=0;i<n;++i)                                          \
+                oa[i] = BINARY_NOT_BLANK(ra[i], rb) ? la[0] OP ra[i] : ob; \
+            else for(i=0;i<n;++i) oa[i]=ob;                             \
+          }                                                             \
+        else                                                            \
           {                                                             \
-            if(lb==lb && rb==rb)/* Both are integers.                */ \
-              *oa = (*la!=lb  && *ra!=rb)  ? *la OP *ra : ob ;          \
-            else if(lb==lb)     /* Only left operand is an integer.  */ \
-              *oa = (*la!=lb  && *ra==*ra) ? *la OP *ra : ob;           \
-            else                /* Only right operand is an integer. */ \
-              *oa = (*la==*la && *ra!=rb)  ? *la OP *ra : ob;           \
-            if(l->size>1) ++la;                                         \
-            if(r->size>1) ++ra;                                         \
+            if( BINARY_NOT_BLANK(ra[0], rb) )                           \
+              for(i=0;i<n;++i)                                          \
+                oa[i] = BINARY_NOT_BLANK(la[i], lb) ? la[i] OP ra[0] : ob; \
+            else for(i=0;i<n;++i) oa[i]=ob;                             \
           }                                                             \
-        while(++oa<of);                                                 \
       }                                                                 \
     else                                                                \
       {                                                                 \
-        if(l->size==r->size) do *oa = *la++ OP *ra++; while(++oa<of);   \
-        else if(l->size==1)  do *oa = *la   OP *ra++; while(++oa<of);   \
-        else                 do *oa = *la++ OP *ra;   while(++oa<of);   \
+        if(l->size==r->size) for(i=0;i<n;++i) oa[i] = la[i] OP ra[i];   \
+        else if(l->size==1)  for(i=0;i<n;++i) oa[i] = la[0] OP ra[i];   \
+        else                 for(i=0;i<n;++i) oa[i] = la[i] OP ra[0];   \
       }                                                                 \
   }
 
@@ -71,13 +94,14 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 /* Blank values aren't defined for integer operators. */
-#define BINARY_INT_OP_OT_RT_LT_SET(OP, OT, LT, RT) {               \
-    LT *la=l->array;                                               \
-    RT *ra=r->array;                                               \
-    OT *oa=o->array, *of=oa + o->size;                             \
-    if(l->size==r->size) do *oa = *la++ OP *ra++; while(++oa<of);  \
-    else if(l->size==1)  do *oa = *la   OP *ra++; while(++oa<of);  \
-    else                 do *oa = *la++ OP *ra;   while(++oa<of);  \
+#define BINARY_INT_OP_OT_RT_LT_SET(OP, OT, LT, RT) {                    \
+    LT *la=l->array;                                                    \
+    RT *ra=r->array;                                                    \
+    OT *oa=o->array;                                                    \
+    size_t i, n=o->size;                                                \
+    if(l->size==r->size) for(i=0;i<n;++i) oa[i] = la[i] OP ra[i];       \
+    else if(l->size==1)  for(i=0;i<n;++i) oa[i] = la[0] OP ra[i];       \
+    else                 for(i=0;i<n;++i) oa[i] = la[i] OP ra[0];       \
   }
 
 
@@ -85,15 +109,11 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 /* This is for operators like '&&' and '||', where the right operator is
-   not necessarily read (and thus incremented). */
-#define BINARY_OP_INCR_OT_RT_LT_SET(OP, OT, LT, RT) {                   \
-    LT *la=l->array;                                                    \
-    RT *ra=r->array;                                                    \
-    OT *oa=o->array, *of=oa + o->size;                                  \
-    if(l->size==r->size) do {*oa = *la++ OP *ra; ++ra;} while(++oa<of); \
-    else if(l->size==1)  do {*oa = *la   OP *ra; ++ra;} while(++oa<of); \
-    else                 do  *oa = *la++ OP *ra;        while(++oa<of); \
-  }
+   not necessarily read. Since the loops work on indexs (not incremented
+   pointers), this is now the same as the integer operators (no blank
+   checks), but is kept separate for clarity. */
+#define BINARY_OP_INCR_OT_RT_LT_SET(OP, OT, LT, RT)                     \
+  BINARY_INT_OP_OT_RT_LT_SET(OP, OT, LT, RT)
 
 
 
@@ -58,6 +58,15 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 /* Actual header contants (the above were for the Pre-processor). */
 __BEGIN_C_DECLS  /* From C++ preparations */
 
+/* Minimum number of elements that each thread should process in binary
+   operators. For smaller datasets, the overhead of using multiple threads
+   is larger than the gain. */
+#define ARITHMETIC_BINARY_MIN_PER_THREAD 131072
+
+
+
+
+
 int
 gal_arithmetic_binary_checkblank(gal_data_t *l, gal_data_t *r);
 
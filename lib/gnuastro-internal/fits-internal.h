@@ -0,0 +1,33 @@
+/*********************************************************************
+FITS constants that are used within the library, but shouldn't be
+installed with the public headers.
+This is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#ifndef __GAL_FITS_INTERNAL_H__
+#define __GAL_FITS_INTERNAL_H__
+
+/* Number of keywords that are reserved in the header of an image that is
+   written in blocks of rows (with 'gal_fits_img_write_rows_start'), so
+   the keywords that are written at the end don't need the data to be
+   shifted in the file. */
+#define GAL_FITSINTERNAL_IMG_ROWS_NUMKEYS 200
+
+#endif           /* __GAL_FITS_INTERNAL_H__ */
@@ -109,6 +109,14 @@ gal_tableintern_read_blank(gal_data_t *col, char *blank);
 
 
 
+/************************************************************************/
+/***************              Row selection               ***************/
+/************************************************************************/
+void
+gal_tableintern_rows_remove(gal_data_t *cols, uint8_t *flag);
+
+
+
 
 __END_C_DECLS    /* From C++ preparations */
 
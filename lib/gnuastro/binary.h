@@ -58,25 +58,68 @@ __BEGIN_C_DECLS  /* From C++ preparations */
    function. */
 #define GAL_BINARY_TMP_VALUE GAL_BLANK_UINT8-1
 
+/* Number of pixels in each word of a bit-packed binary image. */
+#define GAL_BINARY_PACKED_WORD_BITS 64
 
+/* Bit-packed (1D or 2D) binary image: each row is stored in 'nwords'
+   64-bit words, where bit 'j' of a word corresponds to its 'j'-th pixel
+   (from the lowest bit). Pixels with a value of 1 have their bit set in
+   'fg' and those with a value of 0 have their bit set in 'bg'. Pixels with
+   any other value (for example blank) have neither bit set, so they are
+   not touched. A 1D dataset is stored as a single row. */
+typedef struct gal_binary_packed_t
+{
+  size_t    dsize[2];  /* Number of rows and columns in the image.  */
+  size_t      nwords;  /* Number of 64-bit words in each row.       */
+  uint64_t       *fg;  /* Bits of the pixels with a value of 1.     */
+  uint64_t       *bg;  /* Bits of the pixels with a value of 0.     */
+} gal_binary_packed_t;
 
 
 
 
+
+
+/*********************************************************************/
+/*****************        Bit-packed images       ********************/
+/*********************************************************************/
+gal_binary_packed_t *
+gal_binary_pack(gal_data_t *input);
+
+gal_data_t *
+gal_binary_unpack(gal_binary_packed_t *packed, gal_data_t *out);
+
+void
+gal_binary_packed_free(gal_binary_packed_t *packed);
+
+void
+gal_binary_packed_erode(gal_binary_packed_t *packed, size_t num,
+                        int connectivity, size_t numthreads);
+
+void
+gal_binary_packed_dilate(gal_binary_packed_t *packed, size_t num,
+                         int connectivity, size_t numthreads);
+
+void
+gal_binary_packed_open(gal_binary_packed_t *packed, size_t num,
+                       int connectivity, size_t numthreads);
+
+
+
 /*********************************************************************/
 /*****************      Erosion and dilation      ********************/
 /*********************************************************************/
 gal_data_t *
 gal_binary_erode(gal_data_t *input, size_t num, int connectivity,
-                 int inplace);
+                 int inplace, size_t numthreads);
 
 gal_data_t *
 gal_binary_dilate(gal_data_t *input, size_t num, int connectivity,
-                  int inplace);
+                  int inplace, size_t numthreads);
 
 gal_data_t *
 gal_binary_open(gal_data_t *input, size_t num, int connectivity,
-                int inplace);
+                int inplace, size_t numthreads);
 
 
 
@@ -93,7 +136,7 @@ gal_binary_number_neighbors(gal_data_t *input, int connectivity, int inplace);
 /*********************************************************************/
 size_t
 gal_binary_connected_components(gal_data_t *binary, gal_data_t **out,
-                                int connectivity);
+                                int connectivity, size_t numthreads);
 
 gal_data_t *
 gal_binary_connected_indexs(gal_data_t *binary, int connectivity);
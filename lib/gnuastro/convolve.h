@@ -44,10 +44,45 @@ __BEGIN_C_DECLS  /* From C++ preparations */
 
 
 
+/* Methods of spatial convolution. */
+enum gal_convolve_spatial_methods
+{
+ GAL_CONVOLVE_SPATIAL_INVALID,
+
+ GAL_CONVOLVE_SPATIAL_AUTO,       /* Fastest method that fits the kernel. */
+ GAL_CONVOLVE_SPATIAL_DIRECT,     /* Tile-based, on each pixel.           */
+ GAL_CONVOLVE_SPATIAL_SEPARABLE,  /* One 1D pass along each dimension.    */
+ GAL_CONVOLVE_SPATIAL_FFT,        /* Overlap-save FFT (only 2D).          */
+};
+
+/* The kernel is considered separable when the difference of every element
+   with the product of the 1D factors is smaller than this fraction of the
+   kernel's maximum (absolute) value. */
+#define GAL_CONVOLVE_SEPARABLE_TOLERANCE 1e-6
+
+/* With 'GAL_CONVOLVE_SPATIAL_AUTO', the FFT method is used for kernels
+   that are not separable and have at least this many elements. */
+#define GAL_CONVOLVE_FFT_MIN_SIZE 441
+
+/* In the FFT method with edge correction, sums of kernel weights that are
+   smaller than this fraction of the sum of the kernel's absolute values
+   are considered to be zero (the output will be NaN). */
+#define GAL_CONVOLVE_FFT_ZERO 1e-10
+
+
+
 gal_data_t *
 gal_convolve_spatial(gal_data_t *tiles, gal_data_t *kernel,
                      size_t numthreads, int edgecorrection, int convoverch);
 
+gal_data_t *
+gal_convolve_spatial_method(gal_data_t *tiles, gal_data_t *kernel,
+                            size_t numthreads, int edgecorrection,
+                            int convoverch, int method);
+
+int
+gal_convolve_spatial_method_from_string(char *method);
+
 
 void
 gal_convolve_spatial_correct_ch_edge(gal_data_t *tiles, gal_data_t *kernel,
@@ -292,6 +292,10 @@ gal_fits_img_info_dim(char *filename, char *hdu, size_t *ndim);
 gal_data_t *
 gal_fits_img_read(char *filename, char *hdu, size_t minmapsize, int quietmmap);
 
+gal_data_t *
+gal_fits_img_read_rows(char *filename, char *hdu, size_t first,
+                       size_t number, size_t minmapsize, int quietmmap);
+
 gal_data_t *
 gal_fits_img_read_to_type(char *inputname, char *hdu, uint8_t type,
                           size_t minmapsize, int quietmmap);
@@ -312,6 +316,17 @@ gal_fits_img_write_to_type(gal_data_t *data, char *filename,
                            gal_fits_list_key_t *headers,
                            char *program_string, int type);
 
+fitsfile *
+gal_fits_img_write_rows_start(gal_data_t *meta, char *filename);
+
+void
+gal_fits_img_write_rows(fitsfile *fptr, gal_data_t *rows, size_t first);
+
+void
+gal_fits_img_write_rows_end(fitsfile *fptr, gal_data_t *meta, int hasblank,
+                            gal_fits_list_key_t *headers,
+                            char *program_string);
+
 void
 gal_fits_img_write_corr_wcs_str(gal_data_t *input, char *filename,
                                 char *wcsheader, int nkeyrec, double *crpix,
@@ -340,6 +355,14 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
                   gal_data_t *allcols, gal_list_sizet_t *indexll,
                   size_t numthreads, size_t minmapsize, int quietmmap);
 
+gal_data_t *
+gal_fits_tab_read_select(char *filename, char *hdu, size_t numrows,
+                         gal_data_t *allcols, gal_list_sizet_t *indexll,
+                         void (*select)(gal_data_t *, gal_data_t *,
+                                        void *),
+                         void *selectparams, size_t numthreads,
+                         size_t minmapsize, int quietmmap);
+
 void
 gal_fits_tab_write(gal_data_t *cols, gal_list_str_t *comments,
                    int tableformat, char *filename, char *extname,
@@ -48,13 +48,104 @@ __BEGIN_C_DECLS  /* From C++ preparations */
 
 
 
+/* Prepared k-d tree for repeated nearest-neighbour queries: all the
+   sanity checks and type conversions are done once when it is built, so
+   each query only reads from it. The same handle can therefore be used
+   by any number of threads at the same time. */
+typedef struct gal_kdtree_query_t
+{
+  size_t          ndim;  /* Number of dimensions.                      */
+  size_t          size;  /* Number of points in the k-d tree.          */
+  size_t          root;  /* Index of the root node.                    */
+  double       **coord;  /* Array of 'ndim' float64 coordinate arrays. */
+  uint32_t       *left;  /* Index of the left subtree of each node.    */
+  uint32_t      *right;  /* Index of the right subtree of each node.   */
+  gal_data_t   *copies;  /* Internal: converted copies of the inputs.  */
+} gal_kdtree_query_t;
+
+/* Growable output of the range search: there is no allocation for each
+   found point, and the same space can be re-used for many searches. */
+typedef struct gal_kdtree_found_t
+{
+  size_t       *index;  /* Index of each found point.                 */
+  double        *dist;  /* Distance of each found point.              */
+  size_t       number;  /* Number of found points.                    */
+  size_t    allocated;  /* Number of allocated elements.              */
+} gal_kdtree_found_t;
+
+/* Bucket k-d tree, prepared for queries: the rows are re-ordered such that
+   each node covers a contiguous range of rows and the leaves have at
+   most 'bucketsize' rows. The split values of the internal nodes are
+   kept in breadth-first order (children of node 'i' are '2i+1' and
+   '2i+2'). */
+typedef struct gal_kdtree_bucket_t
+{
+  size_t          ndim;  /* Number of dimensions.                      */
+  size_t          size;  /* Number of points.                          */
+  size_t    bucketsize;  /* Maximum number of points in each leaf.     */
+  size_t     numlevels;  /* Number of levels of internal nodes.        */
+  double       **coord;  /* Re-ordered float64 coordinates.            */
+  uint32_t      *index;  /* Input row of each re-ordered row.          */
+  double        *split;  /* Split value of each internal node.         */
+  gal_data_t   *copies;  /* Internal: converted copies of the inputs.  */
+} gal_kdtree_bucket_t;
+
+
+
+
+
 gal_data_t *
-gal_kdtree_create(gal_data_t *coords_raw, size_t *root);
+gal_kdtree_create(gal_data_t *coords_raw, size_t *root, size_t numthreads,
+                  int sampled);
 
 size_t
 gal_kdtree_nearest_neighbour(gal_data_t *coords_raw, gal_data_t *kdtree,
                              size_t root, double *point, double *least_dist);
 
+gal_kdtree_query_t *
+gal_kdtree_query_prepare(gal_data_t *coords_raw, gal_data_t *kdtree,
+                         size_t root);
+
+void
+gal_kdtree_query_free(gal_kdtree_query_t *query);
+
+size_t
+gal_kdtree_query_nearest(gal_kdtree_query_t *query, double *point,
+                         double *least_dist);
+
+void
+gal_kdtree_query_nearest_batch(gal_kdtree_query_t *query,
+                               gal_data_t *points, size_t first,
+                               size_t number, size_t *out_index,
+                               double *out_dist);
+
+size_t
+gal_kdtree_knn(gal_kdtree_query_t *query, double *point, size_t k,
+               size_t *out_index, double *out_dist);
+
+void
+gal_kdtree_found_init(gal_kdtree_found_t *found, size_t initsize);
+
+void
+gal_kdtree_found_free(gal_kdtree_found_t *found);
+
+size_t
+gal_kdtree_range(gal_kdtree_query_t *query, double *point,
+                 double *aperture, gal_kdtree_found_t *found);
+
+gal_data_t *
+gal_kdtree_bucket_create(gal_data_t *coords_raw, size_t bucketsize);
+
+gal_kdtree_bucket_t *
+gal_kdtree_bucket_prepare(gal_data_t *bucket, size_t bucketsize);
+
+void
+gal_kdtree_bucket_free(gal_kdtree_bucket_t *bucket);
+
+size_t
+gal_kdtree_bucket_nearest(gal_kdtree_bucket_t *bucket, double *point,
+                          double *least_dist);
+
 
 
 __END_C_DECLS    /* From C++ preparations */
@@ -332,6 +332,86 @@ gal_list_dosizet_free(gal_list_dosizet_t *largest);
 
 
 
+/****************************************************************
+ ******************     Queue of size_t     *********************
+ ****************************************************************/
+/* A growable ring buffer: values can be added to the end and popped from
+   either end (as a first-in-first-out queue or a last-in-first-out
+   stack). Unlike 'gal_list_sizet_t', there is no allocation for each
+   element, so it can be used in per-pixel loops. */
+typedef struct gal_list_qsizet_t
+{
+  size_t       *array;            /* Allocated space.                  */
+  size_t    allocated;            /* Number of allocated elements.     */
+  size_t        first;            /* Index of the first element.       */
+  size_t       number;            /* Number of elements in the queue.  */
+} gal_list_qsizet_t;
+
+void
+gal_list_qsizet_init(gal_list_qsizet_t *queue, size_t initsize);
+
+void
+gal_list_qsizet_add(gal_list_qsizet_t *queue, size_t value);
+
+size_t
+gal_list_qsizet_pop_first(gal_list_qsizet_t *queue);
+
+size_t
+gal_list_qsizet_pop_last(gal_list_qsizet_t *queue);
+
+size_t *
+gal_list_qsizet_to_array(gal_list_qsizet_t *queue, size_t *num);
+
+void
+gal_list_qsizet_free(gal_list_qsizet_t *queue);
+
+
+
+
+
+/****************************************************************
+ **************     Priority queue of size_t     ****************
+ ****************************************************************/
+/* A growable array that is kept sorted by the 's' value of each node:
+   popping the node with the smallest 's' is O(1). Nodes with an equal
+   's' are popped in the same order they were added (similar to
+   'gal_list_dosizet_t'). Adding a node starts from the largest values, so
+   it is fastest when the new values are usually larger than those in the
+   queue (like searches that go outwards from a point). Unlike the linked
+   lists, there is no allocation for each element. */
+typedef struct gal_list_psizet_node_t
+{
+  size_t v;                       /* The actual value.                */
+  float s;                        /* The parameter to sort by.        */
+} gal_list_psizet_node_t;
+
+typedef struct gal_list_psizet_t
+{
+  gal_list_psizet_node_t *nodes;  /* Allocated space.                 */
+  size_t            allocated;    /* Number of allocated nodes.       */
+  size_t                first;    /* Index of the smallest node.      */
+  size_t               number;    /* Number of nodes in the queue.    */
+} gal_list_psizet_t;
+
+void
+gal_list_psizet_init(gal_list_psizet_t *queue, size_t initsize);
+
+void
+gal_list_psizet_add(gal_list_psizet_t *queue, size_t value, float tosort);
+
+size_t
+gal_list_psizet_pop_smallest(gal_list_psizet_t *queue, float *tosort);
+
+void
+gal_list_psizet_clear(gal_list_psizet_t *queue);
+
+void
+gal_list_psizet_free(gal_list_psizet_t *queue);
+
+
+
+
+
 /****************************************************************
  *****************        gal_data_t         ********************
  ****************************************************************/
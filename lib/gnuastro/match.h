@@ -57,6 +57,11 @@ gal_match_kdtree(gal_data_t *coord1, gal_data_t *coord2,
                  double *aperture, size_t numthreads, size_t minmapsize,
                  int quietmmap, size_t *nummatched);
 
+gal_data_t *
+gal_match_sky_cells(gal_data_t *coord1, gal_data_t *coord2,
+                    double *aperture, size_t numthreads, size_t minmapsize,
+                    int quietmmap, size_t *nummatched);
+
 
 
 
@@ -0,0 +1,73 @@
+/*********************************************************************
+sort -- Type-specialized sorting of arrays and indexs.
+This is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#ifndef __GAL_SORT_H__
+#define __GAL_SORT_H__
+
+/* Include other headers if necessary here. Note that other header files
+   must be included before the C++ preparations below */
+#include <stdint.h>
+#include <stddef.h>
+
+
+
+/* C++ Preparations */
+#undef __BEGIN_C_DECLS
+#undef __END_C_DECLS
+#ifdef __cplusplus
+# define __BEGIN_C_DECLS extern "C" {
+# define __END_C_DECLS }
+#else
+# define __BEGIN_C_DECLS                /* empty */
+# define __END_C_DECLS                  /* empty */
+#endif
+/* End of C++ preparations */
+
+
+
+/* Actual header contants (the above were for the Pre-processor). */
+__BEGIN_C_DECLS  /* From C++ preparations */
+
+
+
+/* Arrays with fewer elements are sorted with insertion sort (not radix
+   sort). */
+#define GAL_SORT_RADIX_MIN 64
+
+/* Minimum number of elements to sort on multiple threads. */
+#define GAL_SORT_PARALLEL_MIN 1048576
+
+
+
+void
+gal_sort_array(void *array, uint8_t type, size_t size, int decreasing,
+               size_t numthreads);
+
+void
+gal_sort_index(size_t *index, size_t size, void *values, uint8_t type,
+               int decreasing, size_t numthreads);
+
+
+
+__END_C_DECLS    /* From C++ preparations */
+
+#endif           /* __GAL_SORT_H__ */
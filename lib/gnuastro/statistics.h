@@ -103,6 +103,10 @@ gal_statistics_quantile_index(size_t size, double quantile);
 gal_data_t *
 gal_statistics_quantile(gal_data_t *input, double quantile, int inplace);
 
+gal_data_t *
+gal_statistics_quantiles(gal_data_t *input, gal_data_t *quantiles,
+                         int inplace);
+
 size_t
 gal_statistics_quantile_function_index(gal_data_t *input, gal_data_t *value,
                                        int inplace);
@@ -155,6 +155,13 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
                size_t numthreads, size_t minmapsize, int quietmmap,
                size_t *colmatch);
 
+gal_data_t *
+gal_table_read_select(char *filename, char *hdu, gal_list_str_t *lines,
+                      gal_list_str_t *cols, int searchin, int ignorecase,
+                      void (*select)(gal_data_t *, gal_data_t *, void *),
+                      void *selectparams, size_t numthreads,
+                      size_t minmapsize, int quietmmap, size_t *colmatch);
+
 gal_list_sizet_t *
 gal_table_list_of_indexs(gal_list_str_t *cols, gal_data_t *allcols,
                          size_t numcols, int searchin, int ignorecase,
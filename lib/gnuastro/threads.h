@@ -130,6 +130,44 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
                      size_t numactions, size_t numthreads,
                      size_t minmapsize, int quietmmap);
 
+/* In dynamic distribution of actions, the cost of each chunk of actions
+   that is given to a thread is the cost of the remaining actions, divided
+   by the number of threads and this factor. */
+#define GAL_THREADS_DYNAMIC_GUIDED 2
+
+void
+gal_threads_spin_off_dynamic(void *(*worker)(void *), void *caller_params,
+                             size_t numactions, size_t numthreads,
+                             size_t *costs);
+
+
+
+
+/*******************************************************************/
+/************          Persistent thread pool         **************/
+/*******************************************************************/
+/* Initial number of tasks that can be kept in each worker's deque (it
+   will grow automatically when necessary). */
+#define GAL_THREADS_POOL_DEQUE_MINSIZE 16
+
+void
+gal_threads_pool_init(size_t numworkers);
+
+size_t
+gal_threads_pool_size();
+
+void
+gal_threads_pool_free();
+
+void
+gal_threads_pool_run(void *(*worker)(void *), void *args, size_t argsize,
+                     size_t numargs, size_t numthreads);
+
+void
+gal_threads_pool_spin_off(void *(*worker)(void *), void *caller_params,
+                          size_t numactions, size_t numthreads,
+                          size_t minmapsize, int quietmmap);
+
 
 __END_C_DECLS    /* From C++ preparations */
 
@@ -54,6 +54,8 @@ __BEGIN_C_DECLS  /* From C++ preparations */
 /* Macros. */
 #define GAL_WARP_OUTPUT_NAME_WARPED  "ALIGNED"
 #define GAL_WARP_OUTPUT_NAME_MAXFRAC "MAX-FRAC"
+#define GAL_WARP_OUTPUT_NAME_PIXAREA "OUT-PIX-AREA"
+#define GAL_WARP_OUTPUT_NAME_WEIGHTS "OVERLAP-WEIGHTS"
 
 
 
@@ -73,6 +75,8 @@ typedef struct
   gal_data_t       *cdelt;  /* WCS-Build: Pixel scale of the output.     */
   gal_data_t      *center;  /* WCS-Build: Center of output in RA and Dec.*/
   uint8_t    checkmaxfrac;  /* Check: Write max fraction per pixel.      */
+  gal_data_t      *inrows;  /* Streaming: input rows in memory (or NULL).*/
+  size_t       inrowstart;  /* Streaming: input row of first 'inrows'.   */
 
   /* Output (must be freed by caller) */
   gal_data_t      *output;  /* Pointer to output data structure.         */
@@ -110,6 +114,19 @@ void *
 gal_warp_wcsalign_onthread(void *inparam);
 
 
+/* Input rows that are necessary for a band of output rows. */
+void
+gal_warp_wcsalign_inrows(gal_warp_wcsalign_t *wa, size_t first,
+                         size_t number, size_t *infirst,
+                         size_t *innumber);
+
+
+/* Fill a band of output rows (using 'wa->inrows' if given). */
+void
+gal_warp_wcsalign_rows(gal_warp_wcsalign_t *wa, size_t first,
+                       size_t number);
+
+
 /* Spin-off the threads and finalize the output 'gal_data_t' image in
    'wa->output'. */
 void
@@ -127,6 +144,26 @@ void
 gal_warp_pixelarea(gal_warp_wcsalign_t *wa);
 
 
+/* Find the overlap of all output pixels with the input pixels (without
+   using the input's values) and put them in 'wa->output'. */
+void
+gal_warp_wcsalign_weights(gal_warp_wcsalign_t *wa);
+
+
+/* Warp an input with the overlap weights. */
+gal_data_t *
+gal_warp_weights_apply(gal_data_t *weights, gal_data_t *input,
+                       double coveredfrac, size_t numthreads);
+
+
+/* Write/read the overlap weights to/from a FITS file. */
+void
+gal_warp_weights_write(gal_data_t *weights, char *filename);
+
+gal_data_t *
+gal_warp_weights_read(char *filename, size_t minmapsize, int quietmmap);
+
+
 __END_C_DECLS    /* From C++ preparations */
 
 #endif           /* __GAL_WARP_H__ */
@@ -97,10 +97,10 @@ interpolate_neighbors_on_thread(void *in_prm)
   uint8_t *b, *bf, *bb;
   gal_list_void_t *tvll;
   size_t ngb_counter, pind;
-  gal_list_dosizet_t *lQ, *sQ;
+  gal_list_psizet_t Q;
+  gal_list_qsizet_t checked;
   size_t i, index, fullind, chstart=0, ndim=input->ndim;
   gal_data_t *tin, *tout, *tnear, *value=NULL, *nearest=NULL;
-  size_t size = (correct_index ? tl->tottilesinch : input->size);
   size_t *dsize = (correct_index ? tl->numtilesinch : input->dsize);
   size_t *icoord=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
                                       "icoord");
@@ -111,6 +111,11 @@ interpolate_neighbors_on_thread(void *in_prm)
   /* Based on the above. */
   size_t *dinc=gal_dimension_increment(ndim, dsize);
 
+  /* Allocate the priority queue of the neighbors (it will grow when
+     necessary). */
+  gal_list_psizet_init(&Q, 4*prm->numneighbors);
+  gal_list_qsizet_init(&checked, 4*prm->numneighbors);
+
 
   /* Initialize the flags array. We need two flags during this processing:
      1) to see if there are blanks. 2) to see if a neighbor has been
@@ -189,25 +194,27 @@ interpolate_neighbors_on_thread(void *in_prm)
         }
 
 
-      /* Reset all checked bits in the flags array to 0. */
+      /* Reset the checked bits of the elements that were checked for the
+         previous element (instead of going over the whole array). */
       ngb_counter=0;
-      bf=(b=flag)+size;
-      do *b &= ~(INTERPOLATE_FLAGS_NGB_CHECKED); while(++b<bf);
+      while(checked.number)
+        fullflag[ gal_list_qsizet_pop_last(&checked) ]
+          &= ~(INTERPOLATE_FLAGS_NGB_CHECKED);
 
 
       /* Get the coordinates of this pixel (to be interpolated). */
       gal_dimension_index_to_coord(index, ndim, dsize, icoord);
 
 
-      /* Start parsing the neighbors. We will use a two-way ordered linked
-         list structure. To start from the nearest and go out to the
-         farthest. */
-      lQ=sQ=NULL;
-      gal_list_dosizet_add(&lQ, &sQ, index, 0.0f);
-      while(sQ)
+      /* Start parsing the neighbors. We will use a priority queue (that
+         is re-used for all the elements of this thread), to start from
+         the nearest and go out to the farthest. */
+      gal_list_psizet_clear(&Q);
+      gal_list_psizet_add(&Q, index, 0.0f);
+      while(Q.number)
         {
           /* Pop-out (p) an index from the queue: */
-          pind=gal_list_dosizet_pop_smallest(&lQ, &sQ, &pdist);
+          pind=gal_list_psizet_pop_smallest(&Q, &pdist);
 
           /* If this isn't a blank value then add its values to the list of
              neighbor values. Note that we didn't check whether the values
@@ -225,13 +232,8 @@ interpolate_neighbors_on_thread(void *in_prm)
                   tin=tin->next;
                 }
 
-              /* If we have filled all the elements clean up the linked
-                 list and break out. */
-              if(++ngb_counter>=prm->numneighbors)
-                {
-                  if(lQ) gal_list_dosizet_free(lQ);
-                  break;
-                }
+              /* If we have filled all the elements, break out. */
+              if(++ngb_counter>=prm->numneighbors) break;
             }
 
           /* Go over all the neighbors of this popped pixel and add them to
@@ -251,10 +253,11 @@ interpolate_neighbors_on_thread(void *in_prm)
                  dist=prm->metric(icoord, ncoord, ndim);
 
                  /* Add this neighbor to the list. */
-                 gal_list_dosizet_add(&lQ, &sQ, nind, dist);
+                 gal_list_psizet_add(&Q, nind, dist);
 
                  /* Flag this neighbor as checked. */
                  flag[nind] |= INTERPOLATE_FLAGS_NGB_CHECKED;
+                 gal_list_qsizet_add(&checked, chstart+nind);
                }
            } );
 
@@ -262,7 +265,7 @@ interpolate_neighbors_on_thread(void *in_prm)
              shows, there were not enough points for
              interpolation. Normally, this loop should only be exited
              through the 'currentnum>=numnearest' check above. */
-          if(sQ==NULL)
+          if(Q.number==0)
             error(EXIT_FAILURE, 0, "%s: only %zu neighbors found while "
                   "you had asked to use %zu neighbors for close neighbor "
                   "interpolation", __func__, ngb_counter,
@@ -309,6 +312,8 @@ interpolate_neighbors_on_thread(void *in_prm)
   /* Clean up. */
   for(tnear=nearest; tnear!=NULL; tnear=tnear->next) tnear->array=NULL;
   gal_list_data_free(nearest);
+  gal_list_psizet_free(&Q);
+  gal_list_qsizet_free(&checked);
   free(icoord);
   free(ncoord);
   free(dinc);
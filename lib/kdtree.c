@@ -23,18 +23,24 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 **********************************************************************/
 #include <config.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <error.h>
 #include <float.h>
+#include <string.h>
 
 #include <gnuastro/data.h>
 #include <gnuastro/table.h>
 #include <gnuastro/blank.h>
+#include <gnuastro/kdtree.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/permutation.h>
 
+#include <gnuastro-internal/match-internal.h>
+
 
 
 
@@ -67,6 +73,11 @@ struct kdtree_params
 
   /* The values of the left and right columns. */
   gal_data_t *left_col, *right_col;
+
+  /* Construction settings. */
+  int sampled;            /* Split on a sampled median (not exact).   */
+  size_t pardepth;        /* Subtrees above this depth are parallel.  */
+  size_t numthreads;      /* Number of threads to build the subtrees. */
 };
 
 
@@ -98,35 +109,6 @@ kdtree_node_swap(struct kdtree_params *p, size_t node1, size_t node2)
 
 
 
-/* Return the distance between 2 given nodes. The distance is equivalent
-   to the radius of the hypersphere having node as its center.
-
-   Return: Radial distace from given point to the node.
-*/
-static double
-kdtree_distance_find(struct kdtree_params *p, size_t node,
-                     double *point)
-{
-  size_t i;
-  double *carr;
-  double t_distance, node_distance=0;
-
-  /* For all dimensions. */
-  for(i=0; i<p->ndim; ++i)
-    {
-      carr=p->coords[i]->array;
-      t_distance=carr[node]-point[i];
-
-      node_distance += t_distance*t_distance;
-    }
-
-  return node_distance;
-}
-
-
-
-
-
 
 
 
@@ -386,16 +368,98 @@ kdtree_median_find(struct kdtree_params *p, size_t node_left,
 
 
 
+/* Instead of finding the exact median with many partitions of the nodes
+   (in 'kdtree_median_find'), use the median of an evenly spaced sample
+   of the nodes as the pivot and partition only once. The split is
+   therefore not exactly at the middle (the tree is not perfectly
+   balanced), but it is still a valid k-d tree. If the split is too far
+   from the middle (for example when there are many equal values), the
+   exact median is used.
+
+   Return: The node that was used to split the nodes. */
+#define KDTREE_SAMPLED_NUM     127
+#define KDTREE_SAMPLED_MINSIZE 8192
+static size_t
+kdtree_median_sampled(struct kdtree_params *p, size_t node_left,
+                      size_t node_right, double *coordinate)
+{
+  double v;
+  size_t i, j, s, node_pivot, sample[KDTREE_SAMPLED_NUM];
+  size_t size=node_right-node_left+1;
+
+  /* For small ranges, the sample is not useful. */
+  if(size<KDTREE_SAMPLED_MINSIZE)
+    return kdtree_median_find(p, node_left, node_right, coordinate);
+
+  /* Select the sample and sort it by its coordinate (insertion sort is
+     enough for this small number). */
+  for(i=0;i<KDTREE_SAMPLED_NUM;++i)
+    {
+      s=node_left+i*(size-1)/(KDTREE_SAMPLED_NUM-1);
+      v=coordinate[p->input_row[s]];
+      for(j=i; j>0 && coordinate[p->input_row[sample[j-1]]]>v; --j)
+        sample[j]=sample[j-1];
+      sample[j]=s;
+    }
+
+  /* Partition the nodes using the median of the sample. */
+  node_pivot=kdtree_make_partition(p, node_left, node_right,
+                                   sample[KDTREE_SAMPLED_NUM/2],
+                                   coordinate);
+
+  /* If the split is very unbalanced, find the exact median. */
+  if( node_pivot-node_left < size/8 || node_right-node_pivot < size/8 )
+    return kdtree_median_find(p, node_left, node_right, coordinate);
+  return node_pivot;
+}
+
+
+
+
+
+/* Parameters to build one subtree on a thread of the pool. */
+struct kdtree_fill_task
+{
+  struct kdtree_params *p;      /* Main k-d tree parameters.          */
+  size_t node_left;             /* First node of the subtree.         */
+  size_t node_right;            /* Last node of the subtree.          */
+  size_t depth;                 /* Depth of the subtree's root.       */
+  uint32_t out;                 /* Output: the subtree's root.        */
+};
+
+static uint32_t
+kdtree_fill_subtrees(struct kdtree_params *p, size_t node_left,
+                     size_t node_right, size_t depth);
+
+static void *
+kdtree_fill_subtrees_worker(void *in_prm)
+{
+  struct kdtree_fill_task *t=(struct kdtree_fill_task *)in_prm;
+  t->out=kdtree_fill_subtrees(t->p, t->node_left, t->node_right, t->depth);
+  return NULL;
+}
+
+
+
+
+
 /* Make a kd-tree from a given set of points. For tree construction, a
    median point is selected for each axis and the left and right branches
    are recursively created by comparing points in that axis.
 
+   The two subtrees of each node only touch their own (separate) range of
+   nodes, so in the upper levels of the tree, they are built at the same
+   time on the threads of the pool.
+
    Return : Indexes of the nodes in the kd-tree.
 */
+#define KDTREE_PARALLEL_MINSIZE 65536
 static uint32_t
 kdtree_fill_subtrees(struct kdtree_params *p, size_t node_left,
                      size_t node_right, size_t depth)
 {
+  struct kdtree_fill_task tasks[2];
+
   /* Set the working axis. */
   size_t axis=depth % p->ndim;
 
@@ -408,8 +472,28 @@ kdtree_fill_subtrees(struct kdtree_params *p, size_t node_left,
   if(node_left==node_right) return p->input_row[node_left];
 
   /* Find the median node. */
-  node_median = kdtree_median_find(p, node_left, node_right,
-                                   p->coords[axis]->array);
+  node_median = ( p->sampled
+                  ? kdtree_median_sampled(p, node_left, node_right,
+                                          p->coords[axis]->array)
+                  : kdtree_median_find(p, node_left, node_right,
+                                       p->coords[axis]->array) );
+
+  /* In the upper levels of a large tree, build the two subtrees in
+     parallel (when they both exist). */
+  if( depth<p->pardepth
+      && node_median>node_left && node_median<node_right
+      && node_right-node_left+1>=KDTREE_PARALLEL_MINSIZE )
+    {
+      tasks[0].p=tasks[1].p=p;
+      tasks[0].depth=tasks[1].depth=depth+1;
+      tasks[0].node_left=node_left;     tasks[0].node_right=node_median-1;
+      tasks[1].node_left=node_median+1; tasks[1].node_right=node_right;
+      gal_threads_pool_run(kdtree_fill_subtrees_worker, tasks,
+                           sizeof *tasks, 2, p->numthreads);
+      p->left[node_median]=tasks[0].out;
+      p->right[node_median]=tasks[1].out;
+      return p->input_row[node_median];
+    }
 
   /* node_median == 0 : We are in the lowest node (leaf) so no need
      When we only have 2 nodes and the median is equal to the left,
@@ -443,7 +527,8 @@ kdtree_fill_subtrees(struct kdtree_params *p, size_t node_left,
    and creates the tree in top-down manner. Returns a list containing the
    indexes of left and right subtrees. */
 gal_data_t *
-gal_kdtree_create(gal_data_t *coords_raw, size_t *root)
+gal_kdtree_create(gal_data_t *coords_raw, size_t *root, size_t numthreads,
+                  int sampled)
 {
   struct kdtree_params p={0};
 
@@ -453,6 +538,13 @@ gal_kdtree_create(gal_data_t *coords_raw, size_t *root)
   /* Initialise the params structure. */
   kdtree_prepare(&p, coords_raw);
 
+  /* Set the construction settings: to balance the load, the number of
+     parallel subtrees is a few times the number of threads. */
+  p.sampled=sampled;
+  p.numthreads=numthreads;
+  if(numthreads>1)
+    while( ((size_t)1<<p.pardepth) < 4*numthreads ) ++p.pardepth;
+
   /* Fill the kd-tree*/
   *root=kdtree_fill_subtrees(&p, 0, coords_raw->size-1, 0);
 
@@ -496,6 +588,33 @@ gal_kdtree_create(gal_data_t *coords_raw, size_t *root)
 /****************************************************************
  ********          Nearest-Neighbour Search               *******
  ****************************************************************/
+/* Return the squared distance between the given node and point. The
+   distance is equivalent to the radius of the hypersphere having node as
+   its center (the square root is only taken once at the end of the
+   search).
+
+   Return: Squared radial distace from given point to the node.
+*/
+static double
+kdtree_distance_find(gal_kdtree_query_t *q, size_t node, double *point)
+{
+  size_t i;
+  double t_distance, node_distance=0;
+
+  /* For all dimensions. */
+  for(i=0; i<q->ndim; ++i)
+    {
+      t_distance=q->coord[i][node]-point[i];
+      node_distance += t_distance*t_distance;
+    }
+
+  return node_distance;
+}
+
+
+
+
+
 /* This is a helper function which finds the nearest neighbour of
    the given point in a kdtree. It calculates the least distance
    from the point, and the index of that nearest node (out_nn).
@@ -504,23 +623,22 @@ gal_kdtree_create(gal_data_t *coords_raw, size_t *root)
    for more information.
 */
 static void
-kdtree_nearest_neighbour(struct kdtree_params *p, uint32_t node_current,
+kdtree_nearest_neighbour(gal_kdtree_query_t *q, uint32_t node_current,
                          double *point, double *least_dist,
                          size_t *out_nn, size_t depth)
 {
   double d, dx, dx2;
-  size_t axis=depth % p->ndim;    /* Set the working axis. */
-  double *coordinates=p->coords[axis]->array;
+  size_t axis=depth % q->ndim;    /* Set the working axis. */
 
   /* If no subtree present, don't search further. */
   if(node_current==GAL_BLANK_UINT32) return;
 
   /* The distance between search point to the current node.*/
-  d = kdtree_distance_find(p, node_current, point);
+  d = kdtree_distance_find(q, node_current, point);
 
   /* Distance between the splitting coordinate of the search
      point and current node. */
-  dx = coordinates[node_current]-point[axis];
+  dx = q->coord[axis][node_current]-point[axis];
 
   /* Check if the current node is nearer than the previous
      nearest node. */
@@ -534,9 +652,9 @@ kdtree_nearest_neighbour(struct kdtree_params *p, uint32_t node_current,
   if(*least_dist==0.0f) return;
 
   /* Recursively search in subtrees. */
-  kdtree_nearest_neighbour(p, dx > 0
-                              ? p->left[node_current]
-                              : p->right[node_current],
+  kdtree_nearest_neighbour(q, dx > 0
+                              ? q->left[node_current]
+                              : q->right[node_current],
                            point, least_dist, out_nn, depth+1);
 
   /* Since the hyperplanes are all axis-aligned, to check if there is a
@@ -549,9 +667,9 @@ kdtree_nearest_neighbour(struct kdtree_params *p, uint32_t node_current,
   if(dx2 >= *least_dist) return;
 
   /* Recursively search other subtrees. */
-  kdtree_nearest_neighbour(p, dx > 0
-                              ? p->right[node_current]
-                              : p->left[node_current],
+  kdtree_nearest_neighbour(q, dx > 0
+                              ? q->right[node_current]
+                              : q->left[node_current],
                            point, least_dist, out_nn, depth+1);
 }
 
@@ -559,39 +677,1049 @@ kdtree_nearest_neighbour(struct kdtree_params *p, uint32_t node_current,
 
 
 
-/* High-level function used to find the nearest neighbour of a given
-   point in a kd-tree. It calculates the least distance of the point
-   from the nearest node and returns the index of that node.
+/* Prepare a k-d tree for many nearest-neighbour queries: the sanity
+   checks and the conversion of the coordinates to 'double' are done only
+   once here. After this, the queries don't allocate anything and don't
+   modify the returned structure, so it can be shared between threads. */
+gal_kdtree_query_t *
+gal_kdtree_query_prepare(gal_data_t *coords_raw, gal_data_t *kdtree,
+                         size_t root)
+{
+  size_t i;
+  gal_data_t *tmp;
+  gal_kdtree_query_t *q;
+  struct kdtree_params p={0};
+
+  /* An empty k-d tree can't be queried. */
+  if(kdtree==NULL || coords_raw==NULL)
+    error(EXIT_FAILURE, 0, "%s: the input coordinates and k-d tree "
+          "should not be NULL", __func__);
+
+  /* Do the sanity checks and type conversion (same as the other
+     k-d tree functions). */
+  p.left_col=kdtree;
+  kdtree_prepare(&p, coords_raw);
+
+  /* Make sure the k-d tree corresponds to the coordinates. */
+  if(p.left_col->size!=coords_raw->size)
+    error(EXIT_FAILURE, 0, "%s: the k-d tree has %zu rows, but the "
+          "coordinates have %zu rows", __func__, p.left_col->size,
+          coords_raw->size);
+  if(root>=coords_raw->size)
+    error(EXIT_FAILURE, 0, "%s: the root index (%zu) is larger than the "
+          "number of points (%zu)", __func__, root, coords_raw->size);
+
+  /* Allocate the output structure and its coordinate pointers. */
+  errno=0;
+  q=malloc(sizeof *q);
+  if(q==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'q'",
+          __func__, sizeof *q);
+  errno=0;
+  q->coord=malloc(p.ndim*sizeof *q->coord);
+  if(q->coord==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'q->coord'", __func__, p.ndim*sizeof *q->coord);
+
+  /* Fill the structure. Any converted copy of the input coordinates is
+     kept in 'copies' to be freed with the structure. */
+  q->root=root;
+  q->copies=NULL;
+  q->ndim=p.ndim;
+  q->left=p.left;
+  q->right=p.right;
+  q->size=coords_raw->size;
+  tmp=coords_raw;
+  for(i=0; i<p.ndim; ++i)
+    {
+      q->coord[i]=p.coords[i]->array;
+      if(p.coords[i]!=tmp)
+        {
+          /* The copy inherits the 'next' of its input column. */
+          p.coords[i]->next=NULL;
+          gal_list_data_add(&q->copies, p.coords[i]);
+        }
+      tmp=tmp->next;
+    }
+
+  /* Clean up and return ('p.coords' was only an array of pointers, the
+     copies it pointed to are now kept in 'q->copies'). */
+  free(p.coords);
+  return q;
+}
+
+
+
+
+
+void
+gal_kdtree_query_free(gal_kdtree_query_t *query)
+{
+  if(query==NULL) return;
+  gal_list_data_free(query->copies);
+  free(query->coord);
+  free(query);
+}
+
+
+
+
+
+/* Find the nearest neighbour of a single point using a prepared k-d
+   tree. The distance to the nearest neighbour is written in
+   'least_dist'.
 
    Return: The index of the nearest neighbour node in the kd-tree.
 */
 size_t
-gal_kdtree_nearest_neighbour(gal_data_t *coords_raw, gal_data_t *kdtree,
-                             size_t root, double *point,
-                             double *least_dist)
+gal_kdtree_query_nearest(gal_kdtree_query_t *query, double *point,
+                         double *least_dist)
 {
-  struct kdtree_params p={0};
   size_t out_nn=GAL_BLANK_SIZE_T;
 
-  /* Initialisation. */
-  p.left_col=kdtree;
-  *least_dist=DBL_MAX;
-  kdtree_prepare(&p, coords_raw);
-
   /* Use the low-level function to find th nearest neighbour. */
-  kdtree_nearest_neighbour(&p, root, point, least_dist, &out_nn, 0);
+  *least_dist=DBL_MAX;
+  kdtree_nearest_neighbour(query, query->root, point, least_dist,
+                           &out_nn, 0);
 
   /* least_dist is the square of the distance between the nearest
      neighbour and the point (used to improve processing).
      Square root of that is the actual distance. */
   *least_dist = sqrt(*least_dist);
+  return out_nn;
+}
 
-  /* For a check
-  printf("%s: root=%zu, out_nn=%zu, least_dis=%f\n",
-         __func__, root, out_nn, least_dist);
-  */
+
+
+
+
+/* Find the nearest neighbours of 'number' points starting from row
+   'first' of 'points' (a list of 'double' columns, one per dimension).
+   The index and distance of the nearest neighbour to each point are
+   written in the same element of 'out_index' and 'out_dist' (which
+   should already be allocated with 'number' elements). */
+#define KDTREE_QUERY_BATCH_NDIM 8
+void
+gal_kdtree_query_nearest_batch(gal_kdtree_query_t *query,
+                               gal_data_t *points, size_t first,
+                               size_t number, size_t *out_index,
+                               double *out_dist)
+{
+  gal_data_t *tmp;
+  size_t i, j, ndim=query->ndim;
+  double *point, *parr[KDTREE_QUERY_BATCH_NDIM];
+  double **pcoord, pointst[KDTREE_QUERY_BATCH_NDIM];
+
+  /* Sanity checks. */
+  if( gal_list_data_number(points)!=ndim )
+    error(EXIT_FAILURE, 0, "%s: 'points' has %zu columns, but the k-d "
+          "tree has %zu dimensions", __func__,
+          gal_list_data_number(points), ndim);
+  for(tmp=points; tmp!=NULL; tmp=tmp->next)
+    {
+      if(tmp->type!=GAL_TYPE_FLOAT64)
+        error(EXIT_FAILURE, 0, "%s: the type of all columns in 'points' "
+              "should be 'double', but at least one of them is '%s'",
+              __func__, gal_type_name(tmp->type, 1));
+      if(first+number>tmp->size)
+        error(EXIT_FAILURE, 0, "%s: the requested rows (%zu to %zu) are "
+              "not within the %zu rows of 'points'", __func__, first,
+              first+number-1, tmp->size);
+    }
+
+  /* In the common case of a small number of dimensions, the point and
+     its column pointers are kept on the stack. Otherwise, they are
+     allocated only once for the whole batch. */
+  if(ndim<=KDTREE_QUERY_BATCH_NDIM) { point=pointst; pcoord=parr; }
+  else
+    {
+      point=gal_pointer_allocate(GAL_TYPE_FLOAT64, ndim, 0, __func__,
+                                 "point");
+      errno=0;
+      pcoord=malloc(ndim*sizeof *pcoord);
+      if(pcoord==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "'pcoord'", __func__, ndim*sizeof *pcoord);
+    }
+  for(j=0, tmp=points; tmp!=NULL; tmp=tmp->next)
+    pcoord[j++]=(double *)(tmp->array)+first;
+
+  /* Find the nearest neighbour of each point. */
+  for(i=0;i<number;++i)
+    {
+      for(j=0;j<ndim;++j) point[j]=pcoord[j][i];
+      out_index[i]=gal_kdtree_query_nearest(query, point, &out_dist[i]);
+    }
+
+  /* Clean up. */
+  if(ndim>KDTREE_QUERY_BATCH_NDIM) { free(point); free(pcoord); }
+}
+
+
+
+
+
+/* High-level function used to find the nearest neighbour of a given
+   point in a kd-tree. It calculates the least distance of the point
+   from the nearest node and returns the index of that node. When many
+   points should be searched, it is much faster to prepare the k-d tree
+   once with 'gal_kdtree_query_prepare' and then call
+   'gal_kdtree_query_nearest' on each point.
+
+   Return: The index of the nearest neighbour node in the kd-tree.
+*/
+size_t
+gal_kdtree_nearest_neighbour(gal_data_t *coords_raw, gal_data_t *kdtree,
+                             size_t root, double *point,
+                             double *least_dist)
+{
+  size_t out_nn;
+  gal_kdtree_query_t *q=gal_kdtree_query_prepare(coords_raw, kdtree, root);
+
+  /* Find the nearest neighbour, clean up and return. */
+  out_nn=gal_kdtree_query_nearest(q, point, least_dist);
+  gal_kdtree_query_free(q);
+  return out_nn;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/****************************************************************
+ ********        K-nearest neighbours and range search    *******
+ ****************************************************************/
+/* Swap two elements of the k-nearest neighbour heap. */
+static void
+kdtree_knn_heap_swap(size_t *index, double *dist, size_t i, size_t j)
+{
+  size_t ti=index[i];
+  double td=dist[i];
+  index[i]=index[j]; dist[i]=dist[j];
+  index[j]=ti;       dist[j]=td;
+}
+
+
+
+
+
+/* The k-nearest neighbour heap is a max-heap (the farthest of the found
+   neighbours is on top), so the top can be replaced when a nearer point
+   is found. Equal distances are ordered by their index to have a
+   deterministic output. */
+#define KDTREE_KNN_FARTHER(index, dist, i, j)                           \
+  ( (dist)[i]>(dist)[j] || ( (dist)[i]==(dist)[j] && (index)[i]>(index)[j] ) )
+
+static void
+kdtree_knn_heap_down(size_t *index, double *dist, size_t num, size_t i)
+{
+  size_t l, r, largest;
+
+  while(1)
+    {
+      largest=i;
+      l=2*i+1; r=l+1;
+      if(l<num && KDTREE_KNN_FARTHER(index, dist, l, largest)) largest=l;
+      if(r<num && KDTREE_KNN_FARTHER(index, dist, r, largest)) largest=r;
+      if(largest==i) return;
+      kdtree_knn_heap_swap(index, dist, i, largest);
+      i=largest;
+    }
+}
+
+
+
+
+
+static void
+kdtree_knn_heap_up(size_t *index, double *dist, size_t i)
+{
+  size_t parent;
+  while(i)
+    {
+      parent=(i-1)/2;
+      if( !KDTREE_KNN_FARTHER(index, dist, i, parent) ) return;
+      kdtree_knn_heap_swap(index, dist, i, parent);
+      i=parent;
+    }
+}
+
+
+
+
+
+/* Recursive search for the 'k' nearest neighbours: similar to
+   'kdtree_nearest_neighbour', but the search radius is the distance of
+   the farthest point in the heap (once it is full). */
+static void
+kdtree_knn(gal_kdtree_query_t *q, uint32_t node_current, double *point,
+           size_t k, size_t *index, double *dist, size_t *num,
+           size_t depth)
+{
+  double d, dx;
+  size_t axis=depth % q->ndim;
+
+  /* If no subtree present, don't search further. */
+  if(node_current==GAL_BLANK_UINT32) return;
+
+  /* Add this node to the heap if it is not full, or replace the farthest
+     point if this node is nearer. */
+  d = kdtree_distance_find(q, node_current, point);
+  if(*num<k)
+    {
+      index[*num]=node_current;
+      dist[*num]=d;
+      kdtree_knn_heap_up(index, dist, (*num)++);
+    }
+  else if( d<dist[0] || (d==dist[0] && node_current<index[0]) )
+    {
+      index[0]=node_current;
+      dist[0]=d;
+      kdtree_knn_heap_down(index, dist, k, 0);
+    }
+
+  /* Search the side of the hyperplane that contains the point, then the
+     other side only if it can contain a nearer point. */
+  dx = q->coord[axis][node_current]-point[axis];
+  kdtree_knn(q, dx > 0 ? q->left[node_current] : q->right[node_current],
+             point, k, index, dist, num, depth+1);
+  if( *num==k && dx*dx > dist[0] ) return;
+  kdtree_knn(q, dx > 0 ? q->right[node_current] : q->left[node_current],
+             point, k, index, dist, num, depth+1);
+}
+
+
+
+
+
+/* Find the 'k' nearest neighbours of 'point' in a prepared k-d tree. The
+   indexs and distances are written in 'out_index' and 'out_dist' (that
+   should already have 'k' elements), sorted by distance (nearest
+   first). They are also used as the heap during the search, so nothing
+   is allocated here.
+
+   Return: The number of found neighbours (only less than 'k' when the
+   k-d tree has less than 'k' points). */
+size_t
+gal_kdtree_knn(gal_kdtree_query_t *query, double *point, size_t k,
+               size_t *out_index, double *out_dist)
+{
+  size_t i, num=0;
+
+  /* Find the neighbours. */
+  if(k==0) return 0;
+  kdtree_knn(query, query->root, point, k, out_index, out_dist, &num, 0);
+
+  /* Sort the heap: the farthest (top) element is moved to the end. */
+  for(i=num; i>1; --i)
+    {
+      kdtree_knn_heap_swap(out_index, out_dist, 0, i-1);
+      kdtree_knn_heap_down(out_index, out_dist, i-1, 0);
+    }
+
+  /* The distances were squared until now. */
+  for(i=0;i<num;++i) out_dist[i]=sqrt(out_dist[i]);
+  return num;
+}
+
+
+
+
+
+/* Initialize the (growable) output of the range search. */
+void
+gal_kdtree_found_init(gal_kdtree_found_t *found, size_t initsize)
+{
+  size_t allocated=16;
+  while(allocated<initsize) allocated*=2;
+  found->index=gal_pointer_allocate(GAL_TYPE_SIZE_T, allocated, 0,
+                                    __func__, "found->index");
+  found->dist=gal_pointer_allocate(GAL_TYPE_FLOAT64, allocated, 0,
+                                   __func__, "found->dist");
+  found->allocated=allocated;
+  found->number=0;
+}
+
+
+
+
+
+void
+gal_kdtree_found_free(gal_kdtree_found_t *found)
+{
+  free(found->dist);
+  free(found->index);
+  found->index=NULL;
+  found->dist=NULL;
+  found->allocated=found->number=0;
+}
+
+
+
+
+
+/* Add a point to the range search output. */
+static void
+kdtree_found_add(gal_kdtree_found_t *found, size_t index, double dist)
+{
+  size_t allocated;
+
+  /* If the space is full, double it. */
+  if(found->number==found->allocated)
+    {
+      allocated = found->allocated ? 2*found->allocated : 16;
+      errno=0;
+      found->index=realloc(found->index, allocated*sizeof *found->index);
+      if(found->index==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't re-allocate %zu bytes "
+              "for 'found->index'", __func__,
+              allocated*sizeof *found->index);
+      errno=0;
+      found->dist=realloc(found->dist, allocated*sizeof *found->dist);
+      if(found->dist==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't re-allocate %zu bytes "
+              "for 'found->dist'", __func__,
+              allocated*sizeof *found->dist);
+      found->allocated=allocated;
+    }
+
+  /* Add the point. */
+  found->index[found->number]=index;
+  found->dist[found->number++]=dist;
+}
+
+
+
+
+
+/* Parameters of the range search (that are fixed for all nodes). */
+struct kdtree_range_params
+{
+  gal_kdtree_query_t     *q;   /* The prepared k-d tree.              */
+  double             *point;   /* The query point.                    */
+  double          *aperture;   /* See 'gal_kdtree_range'.             */
+  double            radius2;   /* Square of the major axis.           */
+  int              iscircle;   /* If the aperture is circular.        */
+  double               c[3];   /* Fixed cos() of the aperture angles. */
+  double               s[3];   /* Fixed sin() of the aperture angles. */
+  gal_kdtree_found_t *found;   /* Output.                             */
+};
+
+
+
+
+
+/* Distance of a node (which is already known to be within the circle
+   enclosing the aperture) to the query point, on the aperture's
+   "radius" scale. For an elliptical aperture this is the semi-major axis
+   of the ellipse (with the same shape and orientation as the aperture)
+   that passes through the node. */
+static double
+kdtree_range_distance(struct kdtree_range_params *rp, size_t node,
+                      double d2)
+{
+  size_t i;
+  double delta[3];
+
+  /* For a circular aperture the distance is already known. */
+  if(rp->iscircle) return sqrt(d2);
+
+  /* Differences along each dimension (elliptical apertures are only
+     defined in 2D and 3D), with the same distance as matching. */
+  for(i=0;i<rp->q->ndim;++i)
+    delta[i]=rp->q->coord[i][node]-rp->point[i];
+  return ( rp->q->ndim==2
+           ? gal_matchinternal_elliptical_r_2d(delta[0], delta[1],
+                                               rp->aperture, rp->c[0],
+                                               rp->s[0])
+           : gal_matchinternal_elliptical_r_3d(delta, rp->aperture, rp->c,
+                                               rp->s) );
+}
+
+
+
+
+
+/* Recursive range search. The aperture is always within the circle that
+   has the major axis as its radius (the axis ratios are not larger than
+   one), so only that circle is used to select the branches. */
+static void
+kdtree_range(struct kdtree_range_params *rp, uint32_t node_current,
+             size_t depth)
+{
+  double d2, r, dx;
+  gal_kdtree_query_t *q=rp->q;
+  size_t axis=depth % q->ndim;
+
+  /* If no subtree present, don't search further. */
+  if(node_current==GAL_BLANK_UINT32) return;
+
+  /* Check if this node is within the aperture. */
+  d2=kdtree_distance_find(q, node_current, rp->point);
+  if(d2<rp->radius2)
+    {
+      r=kdtree_range_distance(rp, node_current, d2);
+      if(r<rp->aperture[0]) kdtree_found_add(rp->found, node_current, r);
+    }
+
+  /* Search the side of the hyperplane that contains the point, then the
+     other side only if the circle crosses the hyperplane. */
+  dx = q->coord[axis][node_current]-rp->point[axis];
+  kdtree_range(rp, dx > 0 ? q->left[node_current] : q->right[node_current],
+               depth+1);
+  if( dx*dx < rp->radius2 )
+    kdtree_range(rp, dx > 0 ? q->right[node_current]
+                            : q->left[node_current], depth+1);
+}
+
+
+
+
+
+/* Find all the points within the given aperture around 'point'. The
+   aperture has the same format as the one in 'gal_match_kdtree': in 2D
+   it is the major axis, axis ratio and position angle (in degrees) and
+   in 3D it is the major axis, the two axis ratios and the three ZXZ
+   Euler angles (in degrees). In any other dimension, only the first
+   element (radius) is used. The indexs and distances of the found points
+   are written into 'found' (its previous contents are discarded), in no
+   particular order. The distance of a point is the major axis of the
+   aperture (with the same shape and orientation) that passes through it.
+
+   Return: The number of found points. */
+size_t
+gal_kdtree_range(gal_kdtree_query_t *query, double *point,
+                 double *aperture, gal_kdtree_found_t *found)
+{
+  struct kdtree_range_params rp;
+
+  /* Basic sanity checks. */
+  if( !(aperture[0]>0) )
+    error(EXIT_FAILURE, 0, "%s: the major axis of the aperture (first "
+          "element) should be positive, but it is %g", __func__,
+          aperture[0]);
+  if( (query->ndim==2 && !(aperture[1]>0 && aperture[1]<=1))
+      || (query->ndim==3 && !(aperture[1]>0 && aperture[1]<=1
+                              && aperture[2]>0 && aperture[2]<=1)) )
+    error(EXIT_FAILURE, 0, "%s: the axis ratio(s) of the aperture should "
+          "be larger than 0 and not larger than 1", __func__);
+
+  /* Set the parameters. */
+  rp.q=query;
+  rp.found=found;
+  rp.point=point;
+  rp.aperture=aperture;
+  rp.radius2=aperture[0]*aperture[0];
+  switch(query->ndim)
+    {
+    case 2:
+      if( (rp.iscircle=(aperture[1]==1)) == 0 )
+        {
+          rp.c[0] = cos( aperture[2] * M_PI/180.0 );
+          rp.s[0] = sin( aperture[2] * M_PI/180.0 );
+        }
+      break;
+    case 3:
+      if( (rp.iscircle=(aperture[1]==1 && aperture[2]==1)) == 0 )
+        {
+          rp.c[0] = cos( aperture[3] * M_PI/180.0 );
+          rp.s[0] = sin( aperture[3] * M_PI/180.0 );
+          rp.c[1] = cos( aperture[4] * M_PI/180.0 );
+          rp.s[1] = sin( aperture[4] * M_PI/180.0 );
+          rp.c[2] = cos( aperture[5] * M_PI/180.0 );
+          rp.s[2] = sin( aperture[5] * M_PI/180.0 );
+        }
+      break;
+    default: rp.iscircle=1;
+    }
+
+  /* Do the search. */
+  found->number=0;
+  kdtree_range(&rp, query->root, 0);
+  return found->number;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/****************************************************************
+ ********          Bucket (flattened) k-d tree            *******
+ ****************************************************************/
+/* In the bucket k-d tree, the points are re-ordered such that every node
+   of the tree covers a contiguous range of rows: a node covering rows
+   'lo' to 'hi-1' is the point at row 'mid=lo+(hi-lo)/2', and all the
+   rows before 'mid' have a smaller or equal coordinate (along dimension
+   'depth%ndim') to it (which is the split value), while all the rows
+   after it have a larger or equal value. The rows before and after 'mid'
+   are the two children of the node. The splitting stops when the number
+   of rows in a node is not larger than the bucket size: these are the
+   leaves (buckets) that are scanned directly.
+
+   Therefore, the only thing that defines the tree is the order of the
+   rows and the bucket size: it can be written in a table like any other
+   set of columns. The bucket size is recorded at the end of the index
+   column's comment (see 'KDTREE_BUCKET_SIZE_STR') so it can be checked
+   when the columns are read back. When preparing it for queries, the
+   split values of the internal nodes are copied into a single array in
+   breadth-first (Eytzinger) order: the children of node 'i' are '2i+1'
+   and '2i+2'. */
+#define KDTREE_BUCKET_SIZE_STR "bucket size: "
+
+struct kdtree_bucket_params
+{
+  size_t              ndim;  /* Number of dimensions.                 */
+  size_t         numlevels;  /* Number of levels of internal nodes.   */
+  double           **coord;  /* Re-ordered coordinates (one per dim). */
+  uint32_t          *index;  /* Input row of each re-ordered row.     */
+};
+
+
+
+
+
+/* Number of levels of internal nodes: the sizes of the two children of a
+   node with 's' rows are 'floor((s-1)/2)' and 'floor(s/2)', and the
+   sizes of all the nodes in one level differ by at most one. Therefore
+   all internal nodes have at least one row (their own point), only the
+   leaves can be empty. */
+static size_t
+kdtree_bucket_numlevels(size_t size, size_t bucketsize)
+{
+  size_t l=0, largest=size;
+  while(largest>bucketsize) { largest/=2; ++l; }
+  return l;
+}
+
+
+
+
+
+/* Swap two rows in all the re-ordered arrays. */
+static void
+kdtree_bucket_swap(struct kdtree_bucket_params *p, size_t a, size_t b)
+{
+  size_t j;
+  double td;
+  uint32_t ti;
+
+  for(j=0;j<p->ndim;++j)
+    { td=p->coord[j][a]; p->coord[j][a]=p->coord[j][b]; p->coord[j][b]=td; }
+  ti=p->index[a]; p->index[a]=p->index[b]; p->index[b]=ti;
+}
+
+
+
+
+
+/* Re-order the rows from 'lo' to 'hi-1' such that the row at 'k' has the
+   value it would have if they were sorted along dimension 'dim', all the
+   rows before it are smaller or equal and all the rows after it are
+   larger or equal. A three-way partition is used to avoid quadratic
+   behavior when there are many equal values. */
+static void
+kdtree_bucket_select(struct kdtree_bucket_params *p, size_t lo, size_t hi,
+                     size_t k, size_t dim)
+{
+  double pivot, a, b, c;
+  double *x=p->coord[dim];
+  size_t lt, gt, i, m;
+
+  while(hi-lo>1)
+    {
+      /* Median of three as pivot. */
+      m=lo+(hi-lo)/2;
+      a=x[lo]; b=x[m]; c=x[hi-1];
+      pivot = ( a<b
+                ? ( b<c ? b : (a<c ? c : a) )
+                : ( a<c ? a : (b<c ? c : b) ) );
+
+      /* Partition into '<pivot' ([lo,lt)), '==pivot' ([lt,gt)) and
+         '>pivot' ([gt,hi)). */
+      lt=i=lo; gt=hi;
+      while(i<gt)
+        {
+          if(x[i]<pivot)      kdtree_bucket_swap(p, lt++, i++);
+          else if(x[i]>pivot) kdtree_bucket_swap(p, i, --gt);
+          else                ++i;
+        }
+
+      /* Continue in the part that contains 'k'. */
+      if(k<lt)      hi=lt;
+      else if(k>=gt) lo=gt;
+      else return;
+    }
+}
+
+
+
+
+
+/* Build the tree (re-order the rows) of the node covering rows 'lo' to
+   'hi-1'. */
+static void
+kdtree_bucket_build(struct kdtree_bucket_params *p, size_t lo, size_t hi,
+                    size_t depth)
+{
+  size_t mid;
+  if(depth==p->numlevels) return;
+  mid=lo+(hi-lo)/2;
+  kdtree_bucket_select(p, lo, hi, mid, depth%p->ndim);
+  kdtree_bucket_build(p, lo,    mid, depth+1);
+  kdtree_bucket_build(p, mid+1, hi,  depth+1);
+}
+
+
+
+
+
+/* Create a bucket k-d tree from the input coordinates. The output is a
+   list of 'ndim+1' columns: the re-ordered coordinates (in 'double') and
+   the input row of each re-ordered row (in 'uint32'). */
+gal_data_t *
+gal_kdtree_bucket_create(gal_data_t *coords_raw, size_t bucketsize)
+{
+  size_t i, j;
+  char *comment;
+  gal_data_t *tmp, *col, *out=NULL;
+  struct kdtree_bucket_params p={0};
+
+  /* If there are no coordinates, just return NULL. */
+  if(coords_raw->size==0) return NULL;
+
+  /* Sanity checks. */
+  if(bucketsize==0)
+    error(EXIT_FAILURE, 0, "%s: the bucket size should not be zero",
+          __func__);
+  if(coords_raw->size>=GAL_BLANK_UINT32)
+    error(EXIT_FAILURE, 0, "%s: the number of points (%zu) should be "
+          "smaller than %u", __func__, coords_raw->size, GAL_BLANK_UINT32);
+  p.ndim=gal_list_data_number(coords_raw);
+  for(tmp=coords_raw; tmp!=NULL; tmp=tmp->next)
+    if(tmp->size!=coords_raw->size)
+      error(EXIT_FAILURE, 0, "%s: all the coordinate columns should have "
+            "the same number of rows", __func__);
+
+  /* Copy the coordinates into the output (in 'double') and allocate the
+     index column. */
+  errno=0;
+  p.coord=malloc(p.ndim*sizeof *p.coord);
+  if(p.coord==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'p.coord'", __func__, p.ndim*sizeof *p.coord);
+  for(j=0, tmp=coords_raw; tmp!=NULL; tmp=tmp->next)
+    {
+      col=gal_data_copy_to_new_type(tmp, GAL_TYPE_FLOAT64);
+      col->next=NULL;
+      p.coord[j++]=col->array;
+      gal_list_data_add(&out, col);
+    }
+  if( asprintf(&comment, "Input row of each row in the bucket k-d tree "
+                "(" KDTREE_BUCKET_SIZE_STR "%zu).", bucketsize)<0 )
+    error(EXIT_FAILURE, 0, "%s: asprintf allocation error", __func__);
+  col=gal_data_alloc(NULL, GAL_TYPE_UINT32, 1, coords_raw->dsize, NULL,
+                     0, coords_raw->minmapsize, coords_raw->quietmmap,
+                     "index", "index", comment);
+  p.index=col->array;
+  free(comment);
+  for(i=0;i<coords_raw->size;++i) p.index[i]=i;
+  gal_list_data_add(&out, col);
+  gal_list_data_reverse(&out);
+
+  /* Re-order the rows. */
+  p.numlevels=kdtree_bucket_numlevels(coords_raw->size, bucketsize);
+  kdtree_bucket_build(&p, 0, coords_raw->size, 0);
 
   /* Clean up and return. */
-  kdtree_cleanup(&p, coords_raw);
+  free(p.coord);
+  return out;
+}
+
+
+
+
+
+/* Fill the split values of the node 'node' (covering rows 'lo' to
+   'hi-1') and its children. */
+static void
+kdtree_bucket_split_fill(gal_kdtree_bucket_t *b, size_t node, size_t lo,
+                         size_t hi, size_t depth)
+{
+  size_t mid;
+  if(depth==b->numlevels) return;
+  mid=lo+(hi-lo)/2;
+  b->split[node]=b->coord[depth%b->ndim][mid];
+  kdtree_bucket_split_fill(b, 2*node+1, lo,    mid, depth+1);
+  kdtree_bucket_split_fill(b, 2*node+2, mid+1, hi,  depth+1);
+}
+
+
+
+
+
+/* Return the bucket size that is recorded in the comment of the index
+   column (by 'gal_kdtree_bucket_create'), or zero if there is none. */
+static size_t
+kdtree_bucket_recorded_size(gal_data_t *icol)
+{
+  char *c;
+  size_t out=0;
+  if(icol->comment && (c=strstr(icol->comment, KDTREE_BUCKET_SIZE_STR)) )
+    if( sscanf(c+strlen(KDTREE_BUCKET_SIZE_STR), "%zu", &out)!=1 )
+      out=0;
+  return out;
+}
+
+
+
+
+
+/* Prepare a bucket k-d tree (the output of 'gal_kdtree_bucket_create' or
+   the same columns read from a table) for queries. */
+gal_kdtree_bucket_t *
+gal_kdtree_bucket_prepare(gal_data_t *bucket, size_t bucketsize)
+{
+  gal_kdtree_bucket_t *b;
+  size_t i, nsplit, recorded;
+  gal_data_t *tmp, *col, *icol;
+
+  /* Sanity checks. */
+  if(bucket==NULL || bucket->next==NULL)
+    error(EXIT_FAILURE, 0, "%s: the bucket k-d tree should have at least "
+          "two columns (coordinates and index)", __func__);
+  for(tmp=bucket; tmp!=NULL; tmp=tmp->next)
+    if(tmp->size!=bucket->size)
+      error(EXIT_FAILURE, 0, "%s: all the columns of the bucket k-d tree "
+            "should have the same number of rows", __func__);
+  icol=bucket; while(icol->next) icol=icol->next;
+  if(icol->type!=GAL_TYPE_UINT32)
+    error(EXIT_FAILURE, 0, "%s: the last column of the bucket k-d tree "
+          "should have a 'uint32' type, but it is '%s'", __func__,
+          gal_type_name(icol->type, 1));
+
+  /* The shape of the tree depends on the bucket size it was built with:
+     a different value would give wrong split values (and wrong
+     results), so it is checked against the recorded value (if any). */
+  recorded=kdtree_bucket_recorded_size(icol);
+  if(bucketsize==0) bucketsize=recorded;
+  if(bucketsize==0)
+    error(EXIT_FAILURE, 0, "%s: the bucket size is not recorded in the "
+          "comment of the index column, so it should be given (it "
+          "should not be zero)", __func__);
+  if(recorded && recorded!=bucketsize)
+    error(EXIT_FAILURE, 0, "%s: the bucket k-d tree was built with a "
+          "bucket size of %zu, but %zu was given", __func__, recorded,
+          bucketsize);
+
+  /* Allocate the output. */
+  errno=0;
+  b=malloc(sizeof *b);
+  if(b==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'b'",
+          __func__, sizeof *b);
+  b->copies=NULL;
+  b->index=icol->array;
+  b->size=bucket->size;
+  b->bucketsize=bucketsize;
+  b->ndim=gal_list_data_number(bucket)-1;
+  b->numlevels=kdtree_bucket_numlevels(b->size, bucketsize);
+  errno=0;
+  b->coord=malloc(b->ndim*sizeof *b->coord);
+  if(b->coord==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'b->coord'", __func__, b->ndim*sizeof *b->coord);
+
+  /* Coordinate arrays (converted to 'double' if necessary). */
+  for(i=0, tmp=bucket; tmp!=icol; tmp=tmp->next)
+    if(tmp->type==GAL_TYPE_FLOAT64) b->coord[i++]=tmp->array;
+    else
+      {
+        col=gal_data_copy_to_new_type(tmp, GAL_TYPE_FLOAT64);
+        col->next=NULL;
+        b->coord[i++]=col->array;
+        gal_list_data_add(&b->copies, col);
+      }
+
+  /* Split values of the internal nodes. */
+  nsplit=((size_t)1<<b->numlevels)-1;
+  b->split = ( nsplit
+               ? gal_pointer_allocate(GAL_TYPE_FLOAT64, nsplit, 0,
+                                      __func__, "b->split")
+               : NULL );
+  kdtree_bucket_split_fill(b, 0, 0, b->size, 0);
+  return b;
+}
+
+
+
+
+
+void
+gal_kdtree_bucket_free(gal_kdtree_bucket_t *bucket)
+{
+  if(bucket==NULL) return;
+  gal_list_data_free(bucket->copies);
+  free(bucket->coord);
+  free(bucket->split);
+  free(bucket);
+}
+
+
+
+
+
+/* Scan the rows of a leaf (bucket) for the nearest point. The one and
+   two/three dimensional cases are written separately so the compiler can
+   vectorize the distance calculation over the contiguous rows. Equal
+   distances are broken by the input row to have a deterministic
+   output. */
+static void
+kdtree_bucket_leaf(gal_kdtree_bucket_t *b, size_t lo, size_t hi,
+                   double *point, double *least_dist, size_t *out_nn)
+{
+  double d, t;
+  size_t i, j;
+  uint32_t *index=b->index;
+  double *x=b->coord[0], *y, *z;
+
+#define KDTREE_BUCKET_CHECK                                             \
+  if( d<*least_dist                                                     \
+      || (d==*least_dist && index[i]<*out_nn) )                         \
+    { *least_dist=d; *out_nn=index[i]; }
+
+  switch(b->ndim)
+    {
+    case 1:
+      for(i=lo;i<hi;++i)
+        { d=(x[i]-point[0])*(x[i]-point[0]); KDTREE_BUCKET_CHECK; }
+      break;
+    case 2:
+      y=b->coord[1];
+      for(i=lo;i<hi;++i)
+        {
+          d = (x[i]-point[0])*(x[i]-point[0])
+            + (y[i]-point[1])*(y[i]-point[1]);
+          KDTREE_BUCKET_CHECK;
+        }
+      break;
+    case 3:
+      y=b->coord[1]; z=b->coord[2];
+      for(i=lo;i<hi;++i)
+        {
+          d = (x[i]-point[0])*(x[i]-point[0])
+            + (y[i]-point[1])*(y[i]-point[1])
+            + (z[i]-point[2])*(z[i]-point[2]);
+          KDTREE_BUCKET_CHECK;
+        }
+      break;
+    default:
+      for(i=lo;i<hi;++i)
+        {
+          d=0;
+          for(j=0;j<b->ndim;++j)
+            { t=b->coord[j][i]-point[j]; d+=t*t; }
+          KDTREE_BUCKET_CHECK;
+        }
+    }
+
+#undef KDTREE_BUCKET_CHECK
+}
+
+
+
+
+
+/* Recursive nearest neighbour search in the node 'node' (covering rows
+   'lo' to 'hi-1'). */
+static void
+kdtree_bucket_nearest(gal_kdtree_bucket_t *b, size_t node, size_t lo,
+                      size_t hi, size_t depth, double *point,
+                      double *least_dist, size_t *out_nn)
+{
+  double dx;
+  size_t mid;
+
+  /* In a leaf, scan all the rows. */
+  if(depth==b->numlevels)
+    {
+      kdtree_bucket_leaf(b, lo, hi, point, least_dist, out_nn);
+      return;
+    }
+
+  /* Check the point of this node. */
+  mid=lo+(hi-lo)/2;
+  kdtree_bucket_leaf(b, mid, mid+1, point, least_dist, out_nn);
+
+  /* Search the child on the side of the point first, then the other
+     child if it can contain a nearer point (or an equally near point
+     with a smaller input row). */
+  dx=point[depth%b->ndim]-b->split[node];
+  if(dx<0)
+    {
+      kdtree_bucket_nearest(b, 2*node+1, lo, mid, depth+1, point,
+                            least_dist, out_nn);
+      if(dx*dx<=*least_dist)
+        kdtree_bucket_nearest(b, 2*node+2, mid+1, hi, depth+1, point,
+                              least_dist, out_nn);
+    }
+  else
+    {
+      kdtree_bucket_nearest(b, 2*node+2, mid+1, hi, depth+1, point,
+                            least_dist, out_nn);
+      if(dx*dx<=*least_dist)
+        kdtree_bucket_nearest(b, 2*node+1, lo, mid, depth+1, point,
+                              least_dist, out_nn);
+    }
+}
+
+
+
+
+
+/* Find the nearest neighbour of a point in a prepared bucket k-d tree.
+
+   Return: The input row of the nearest neighbour. */
+size_t
+gal_kdtree_bucket_nearest(gal_kdtree_bucket_t *bucket, double *point,
+                          double *least_dist)
+{
+  size_t out_nn=GAL_BLANK_SIZE_T;
+
+  *least_dist=DBL_MAX;
+  kdtree_bucket_nearest(bucket, 0, 0, bucket->size, 0, point, least_dist,
+                        &out_nn);
+  *least_dist=sqrt(*least_dist);
   return out_nn;
 }
@@ -187,7 +187,7 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
 
   int hasblank;
   float *arr=values->array;
-  gal_list_sizet_t *Q=NULL, *cleanup=NULL;
+  gal_list_qsizet_t Q, cleanup;
   size_t *a, *af, ind, *dsize=values->dsize;
   size_t *dinc=gal_dimension_increment(ndim, dsize);
   int32_t n1, nlab, rlab, curlab=1, *labs=labels->array;
@@ -259,6 +259,12 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
   do labs[*a]=GAL_LABEL_INIT; while(++a<af);
 
 
+  /* Allocate the queues for the equal-flux regions (they are re-used for
+     all the regions and will grow when necessary). */
+  gal_list_qsizet_init(&Q, 0);
+  gal_list_qsizet_init(&cleanup, 0);
+
+
   /* Go over all the given indexs and pull out the clumps. */
   af=(a=indexs->array)+indexs->size;
   do
@@ -286,23 +292,23 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
             n1=0;
 
             /* A small sanity check. */
-            if(Q!=NULL || cleanup!=NULL)
+            if(Q.number || cleanup.number)
               error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s so "
                     "we can fix this problem. 'Q' and 'cleanup' should be "
-                    "NULL but while checking the equal flux regions they "
+                    "empty but while checking the equal flux regions they "
                     "aren't", __func__, PACKAGE_BUGREPORT);
 
             /* Add this pixel to a queue. */
-            gal_list_sizet_add(&Q, *a);
-            gal_list_sizet_add(&cleanup, *a);
+            gal_list_qsizet_add(&Q, *a);
+            gal_list_qsizet_add(&cleanup, *a);
             labs[*a] = GAL_LABEL_TMPCHECK;
 
             /* Find all the pixels that have the same flux and are
-               connected. */
-            while(Q!=NULL)
+               connected (the last added pixel is checked first). */
+            while(Q.number)
               {
                 /* Pop an element from the queue. */
-                ind=gal_list_sizet_pop(&Q);
+                ind=gal_list_qsizet_pop_last(&Q);
 
                 /* Look at the neighbors and see if we already have a
                    label. */
@@ -324,8 +330,8 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
                              if( nlab==GAL_LABEL_INIT && arr[nind]==arr[*a] )
                                {
                                  labs[nind]=GAL_LABEL_TMPCHECK;
-                                 gal_list_sizet_add(&Q, nind);
-                                 gal_list_sizet_add(&cleanup, nind);
+                                 gal_list_qsizet_add(&Q, nind);
+                                 gal_list_qsizet_add(&cleanup, nind);
                                }
                              else
                                n1=( nlab>0
@@ -384,9 +390,9 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
             /* Give the same label to the whole connected equal flux
                region, except those that might have been on the side of
                the image and were a river pixel. */
-            while(cleanup!=NULL)
+            while(cleanup.number)
               {
-                ind=gal_list_sizet_pop(&cleanup);
+                ind=gal_list_qsizet_pop_last(&cleanup);
                 /* If it was on the sides of the image, it has been
                    changed to a river pixel. */
                 if( labs[ ind ]==GAL_LABEL_TMPCHECK ) labs[ ind ]=rlab;
@@ -502,6 +508,8 @@ gal_label_watershed(gal_data_t *values, gal_data_t *indexs,
 
   /* Clean up. */
   free(dinc);
+  gal_list_qsizet_free(&Q);
+  gal_list_qsizet_free(&cleanup);
 
   /* Return the total number of clumps. */
   return curlab-1;
@@ -1397,6 +1397,272 @@ gal_list_dosizet_free(gal_list_dosizet_t *largest)
 
 
 
+/****************************************************************
+ ******************     Queue of size_t     *********************
+ ****************************************************************/
+/* Initialize the queue with space for at least 'initsize' elements (the
+   allocated space is always a power of two, so the index of each element
+   in the ring can be found with a bit-wise AND). */
+void
+gal_list_qsizet_init(gal_list_qsizet_t *queue, size_t initsize)
+{
+  size_t allocated=16;
+  while(allocated<initsize) allocated*=2;
+  queue->array=gal_pointer_allocate(GAL_TYPE_SIZE_T, allocated, 0,
+                                    __func__, "queue->array");
+  queue->allocated=allocated;
+  queue->first=queue->number=0;
+}
+
+
+
+
+
+/* Add a value to the end of the queue. */
+void
+gal_list_qsizet_add(gal_list_qsizet_t *queue, size_t value)
+{
+  size_t wrapped, old=queue->allocated;
+
+  /* If the queue is full, double its space. When the elements wrap around
+     the end of the old space, the wrapped part (at the start) is moved
+     to after the old end, so the elements are contiguous again. */
+  if(queue->number==old)
+    {
+      errno=0;
+      queue->array=realloc(queue->array, 2*old*sizeof *queue->array);
+      if(queue->array==NULL)
+        error(EXIT_FAILURE, errno, "%s: reallocating %zu bytes for the "
+              "queue", __func__, 2*old*sizeof *queue->array);
+      wrapped=queue->first;
+      if(wrapped)
+        memcpy(queue->array+old, queue->array,
+               wrapped*sizeof *queue->array);
+      queue->allocated=2*old;
+    }
+
+  /* Put the value in the queue. */
+  queue->array[ (queue->first+queue->number++) & (queue->allocated-1) ]
+    = value;
+}
+
+
+
+
+
+/* Pop the first element (the queue is used as a first-in-first-out
+   queue). If the queue is empty, 'GAL_BLANK_SIZE_T' is returned. */
+size_t
+gal_list_qsizet_pop_first(gal_list_qsizet_t *queue)
+{
+  size_t out;
+  if(queue->number==0) return GAL_BLANK_SIZE_T;
+  out=queue->array[queue->first];
+  queue->first = (queue->first+1) & (queue->allocated-1);
+  --queue->number;
+  return out;
+}
+
+
+
+
+
+/* Pop the last element (the queue is used as a last-in-first-out
+   stack). If the queue is empty, 'GAL_BLANK_SIZE_T' is returned. */
+size_t
+gal_list_qsizet_pop_last(gal_list_qsizet_t *queue)
+{
+  if(queue->number==0) return GAL_BLANK_SIZE_T;
+  --queue->number;
+  return queue->array[ (queue->first+queue->number)
+                       & (queue->allocated-1) ];
+}
+
+
+
+
+
+/* Copy the elements of the queue (from the first to the last) into a
+   newly allocated array. The number of elements is put in 'num'. */
+size_t *
+gal_list_qsizet_to_array(gal_list_qsizet_t *queue, size_t *num)
+{
+  size_t i, *out=NULL;
+
+  *num=queue->number;
+  if(queue->number)
+    {
+      out=gal_pointer_allocate(GAL_TYPE_SIZE_T, queue->number, 0,
+                               __func__, "out");
+      for(i=0;i<queue->number;++i)
+        out[i]=queue->array[ (queue->first+i) & (queue->allocated-1) ];
+    }
+  return out;
+}
+
+
+
+
+
+/* Free the allocated space within the queue (not the structure itself). */
+void
+gal_list_qsizet_free(gal_list_qsizet_t *queue)
+{
+  free(queue->array);
+  queue->array=NULL;
+  queue->allocated=queue->first=queue->number=0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/****************************************************************
+ **************     Priority queue of size_t     ****************
+ ****************************************************************/
+void
+gal_list_psizet_init(gal_list_psizet_t *queue, size_t initsize)
+{
+  queue->allocated = initsize ? initsize : 16;
+  errno=0;
+  queue->nodes=malloc(queue->allocated*sizeof *queue->nodes);
+  if(queue->nodes==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for the queue",
+          __func__, queue->allocated*sizeof *queue->nodes);
+  queue->first=queue->number=0;
+}
+
+
+
+
+
+/* The nodes are kept sorted (by their 's' value) from 'first' to the end.
+   A new node is put after all the nodes with an equal or smaller 's', so
+   nodes with an equal 's' are popped in the same order that they were
+   added. The search for its place starts from the largest value: in
+   searches that go outwards from a point (where the new values are
+   usually larger than most of the queue), only a few nodes are moved. */
+void
+gal_list_psizet_add(gal_list_psizet_t *queue, size_t value, float tosort)
+{
+  size_t i, end;
+  gal_list_psizet_node_t *n;
+
+  /* When there is no more space after the last node: if more than half
+     of the space is free (before 'first'), move the nodes to the start,
+     otherwise, double the allocated space. */
+  end=queue->first+queue->number;
+  if(end==queue->allocated)
+    {
+      if(queue->first > queue->allocated/2)
+        memmove(queue->nodes, queue->nodes+queue->first,
+                queue->number*sizeof *queue->nodes);
+      else
+        {
+          queue->allocated*=2;
+          errno=0;
+          queue->nodes=realloc(queue->nodes,
+                               queue->allocated*sizeof *queue->nodes);
+          if(queue->nodes==NULL)
+            error(EXIT_FAILURE, errno, "%s: reallocating %zu bytes for "
+                  "the queue", __func__,
+                  queue->allocated*sizeof *queue->nodes);
+          memmove(queue->nodes, queue->nodes+queue->first,
+                  queue->number*sizeof *queue->nodes);
+        }
+      queue->first=0;
+      end=queue->number;
+    }
+
+  /* Find the place of the new node (moving the larger nodes up). */
+  n=queue->nodes;
+  for(i=end; i>queue->first && n[i-1].s>tosort; --i)
+    n[i]=n[i-1];
+  n[i].v=value;
+  n[i].s=tosort;
+  ++queue->number;
+}
+
+
+
+
+
+/* Pop the value with the smallest 's' (its 's' is put in 'tosort'). If
+   the queue is empty, 'GAL_BLANK_SIZE_T' is returned (and 'tosort' will
+   be NaN). */
+size_t
+gal_list_psizet_pop_smallest(gal_list_psizet_t *queue, float *tosort)
+{
+  gal_list_psizet_node_t *n;
+
+  /* Empty queue. */
+  if(queue->number==0) { *tosort=NAN; return GAL_BLANK_SIZE_T; }
+
+  /* Return the first node. */
+  n=&queue->nodes[queue->first++];
+  if(--queue->number==0) queue->first=0;
+  *tosort=n->s;
+  return n->v;
+}
+
+
+
+
+
+/* Remove all the elements (to re-use the allocated space). */
+void
+gal_list_psizet_clear(gal_list_psizet_t *queue)
+{
+  queue->first=queue->number=0;
+}
+
+
+
+
+
+/* Free the allocated space within the queue (not the structure itself). */
+void
+gal_list_psizet_free(gal_list_psizet_t *queue)
+{
+  free(queue->nodes);
+  queue->nodes=NULL;
+  queue->allocated=queue->first=queue->number=0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*********************************************************************/
 /*************    Data structure as a linked list   ******************/
 /*********************************************************************/
@@ -27,12 +27,12 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <errno.h>
 #include <error.h>
 #include <float.h>
+#include <math.h>
 #include <stdlib.h>
 
-#include <gsl/gsl_sort.h>
-
 #include <gnuastro/box.h>
 #include <gnuastro/list.h>
+#include <gnuastro/sort.h>
 #include <gnuastro/blank.h>
 #include <gnuastro/binary.h>
 #include <gnuastro/kdtree.h>
@@ -41,6 +41,8 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/statistics.h>
 #include <gnuastro/permutation.h>
 
+#include <gnuastro-internal/match-internal.h>
+
 
 
 
@@ -202,9 +204,14 @@ match_aperture_prepare(gal_data_t *A, gal_data_t *B,
 
 
 
-static double
-match_elliptical_r_2d(double d1, double d2, double *ellipse,
-                      double c, double s)
+/* Distance of a point (with differences 'd1' and 'd2' from the center)
+   on the scale of the major axis of the ellipse: the major axis of the
+   ellipse (with the same axis ratio and position angle) that passes
+   through the point. 'c' and 's' are the cosine and sine of the position
+   angle. */
+double
+gal_matchinternal_elliptical_r_2d(double d1, double d2, double *ellipse,
+                                  double c, double s)
 {
   double Xr = d1 * ( c       )     +   d2 * ( s );
   double Yr = d1 * ( -1.0f*s )     +   d2 * ( c );
@@ -215,9 +222,11 @@ match_elliptical_r_2d(double d1, double d2, double *ellipse,
 
 
 
-static double
-match_elliptical_r_3d(double *delta, double *ellipsoid,
-                      double *c, double *s)
+/* Similar to 'gal_matchinternal_elliptical_r_2d', but for an ellipsoid
+   (the cosines and sines are for the three ZXZ Euler angles). */
+double
+gal_matchinternal_elliptical_r_3d(double *delta, double *ellipsoid,
+                                  double *c, double *s)
 {
   double Xr, Yr, Zr;
   double c1=c[0], s1=s[0];
@@ -250,15 +259,16 @@ match_distance(double *delta, int iscircle, size_t ndim,
     case 2:
       return ( iscircle
                ? sqrt( delta[0]*delta[0] + delta[1]*delta[1] )
-               : match_elliptical_r_2d(delta[0], delta[1],
-                                       aperture, c[0], s[0]) );
+               : gal_matchinternal_elliptical_r_2d(delta[0], delta[1],
+                                                   aperture, c[0], s[0]) );
 
     case 3:
       return ( iscircle
                ? sqrt( delta[0]*delta[0]
                        + delta[1]*delta[1]
                        + delta[2]*delta[2] )
-               : match_elliptical_r_3d(delta, aperture, c, s) );
+               : gal_matchinternal_elliptical_r_3d(delta, aperture, c,
+                                                   s) );
 
     default:
       error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
@@ -617,8 +627,9 @@ match_sort_based_prepare_sort(gal_data_t *coords, size_t minmapsize)
   size_t *permutation=gal_pointer_allocate(GAL_TYPE_SIZE_T, coords->size,
                                            0, __func__, "permutation");
 
-  /* Unfortunately 'gsl_sort_index' doesn't account for NaN elements. So we
-     need to set them to the maximum possible floating point value. */
+  /* NaN elements should not match with anything, so set them to the
+     maximum possible floating point value (the matching steps below
+     would be confused by NaN). */
   if( gal_blank_present(coords, 1) )
     {
       darr=coords->array;
@@ -628,7 +639,9 @@ match_sort_based_prepare_sort(gal_data_t *coords, size_t minmapsize)
 
   /* Get the permutation necessary to sort all the columns (based on the
      first column). */
-  gsl_sort_index(permutation, coords->array, 1, coords->size);
+  for(i=0;i<coords->size;++i) permutation[i]=i;
+  gal_sort_index(permutation, coords->size, coords->array,
+                 GAL_TYPE_FLOAT64, 0, 1);
 
   /* For a check.
   if(coords->size>1)
@@ -974,6 +987,7 @@ struct match_kdtree_params
   double          *aperture;  /* Acceptable aperture for match.       */
   size_t        kdtree_root;  /* Index (counting from 0) of root.     */
   gal_data_t      *A_kdtree;  /* k-d tree of first coordinate.        */
+  gal_kdtree_query_t *query;  /* Prepared k-d tree for the queries.   */
 
   /* Internal parameters for easy aperture checking. For example there is
      no need to calculate the fixed 'cos()' and 'sin()' functions every
@@ -1080,7 +1094,7 @@ match_kdtree_A_coverage(struct match_kdtree_params *p)
              equal/larger than ther user's given aperture and that these
              bins are only for rejecting points before the k-d tree (they
              aren't used within the k-d tree matching). */
-          gal_binary_dilate(hist, 1, 1, 1);
+          gal_binary_dilate(hist, 1, 1, 1, 1);
 
           /* Set the general bin properties along this dimension. */
           d=bins->array;
@@ -1273,9 +1287,7 @@ match_kdtree_worker(void *in_prm)
         {
           /* Find the index of the nearest neighbor in the first catalog to
              this point in the second catalog. */
-          ai = gal_kdtree_nearest_neighbour(p->A, p->A_kdtree,
-                                            p->kdtree_root, point,
-                                            &least_dist);
+          ai = gal_kdtree_query_nearest(p->query, point, &least_dist);
 
           /* If nothing was found within the least distance, then the 'ai'
              will be 'GAL_BLANK_SIZE_T'. */
@@ -1327,9 +1339,16 @@ match_kdtree_second_in_first(struct match_kdtree_params *p,
                          p->ndim, p->a, p->b, dist, p->c,
                          p->s, &p->iscircle);
 
+  /* Prepare the k-d tree for the queries once (so the threads don't
+     repeat the checks and allocations for every point). */
+  p->query=gal_kdtree_query_prepare(p->A, p->A_kdtree, p->kdtree_root);
+
   /* Distribute the jobs in multiple threads. */
   gal_threads_spin_off(match_kdtree_worker, p, p->B->size,
                        numthreads, minmapsize, quietmmap);
+
+  /* Clean up. */
+  gal_kdtree_query_free(p->query);
 }
 
 
@@ -1380,3 +1399,533 @@ gal_match_kdtree(gal_data_t *coord1, gal_data_t *coord2,
   gal_list_data_free(p.Aexist);
   return out;
 }
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/********************************************************************/
+/*************        Sky-cell (spherical) matching      *************/
+/********************************************************************/
+/* For matching (possibly all-sky) catalogs with RA and Dec coordinates,
+   the sky is divided into cells: declination bands with a fixed height,
+   each divided into a number of RA cells that are (roughly) as wide as
+   the band is high (the number of RA cells therefore decreases towards
+   the poles). Each row of the second catalog is placed in its own cell,
+   but each row of the first catalog is placed in all the cells that its
+   aperture (a circle on the sphere) touches. Therefore the nearest
+   neighbour of a second-catalog row within the aperture is always in
+   the same cell and each cell can be matched independently (in
+   parallel). Within each cell, the distances are measured between unit
+   vectors in 3D, so they are correct in any part of the sky (including
+   the poles and RA=0/360). */
+#define MATCH_SKY_CELL_ROWS    4096   /* Desired rows in each cell.   */
+#define MATCH_SKY_BUCKET_SIZE  16     /* Bucket size of k-d trees.    */
+struct match_sky_params
+{
+  /* Inputs. */
+  gal_data_t             *A;  /* 1st coordinate list of 'gal_data_t's */
+  gal_data_t             *B;  /* 2nd coordinate list of 'gal_data_t's */
+  double           aperture;  /* Aperture radius (degrees).           */
+  size_t         minmapsize;  /* Minimum size for memory-mapping.     */
+  int             quietmmap;  /* Don't print memory-mapping info.     */
+
+  /* Cells. */
+  double             height;  /* Height of declination bands (deg).   */
+  size_t             nbands;  /* Number of declination bands.         */
+  size_t              maxra;  /* Maximum number of RA cells per band. */
+
+  /* Rows within the cells. */
+  size_t               *ids;  /* Row (in A, or A->size+row in B).     */
+  size_t             *index;  /* Sorted (by cell) indexs of 'ids'.    */
+  size_t         *cellstart;  /* Start of each cell in 'index'.       */
+  size_t            *cellna;  /* Number of A rows in each cell.       */
+  size_t           *cellend;  /* End of each cell in 'index'.         */
+
+  /* Outputs. */
+  size_t             *bnear;  /* Matched row in A of each B row.      */
+  double             *bdist;  /* Distance to matched row (degrees).   */
+};
+
+
+
+
+
+/* Declination band of the given declination. */
+static size_t
+match_sky_band(struct match_sky_params *p, double dec)
+{
+  double b=floor( (dec+90.0)/p->height );
+  return b<0 ? 0 : ( b>=p->nbands ? p->nbands-1 : (size_t)b );
+}
+
+
+
+
+
+/* Number of RA cells in the given band: the width of the cells at the
+   declination nearest to the equator (within the band) is the band's
+   height. */
+static size_t
+match_sky_numra(struct match_sky_params *p, size_t band)
+{
+  double n, d0=-90.0+band*p->height, d1=d0+p->height;
+  double dnear = d0>0 ? d0 : (d1<0 ? d1 : 0);
+
+  n=floor( 360.0*cos(dnear*M_PI/180.0)/p->height );
+  return n<1 ? 1 : ( n>p->maxra ? p->maxra : (size_t)n );
+}
+
+
+
+
+
+/* Unique identifier of a cell (within all the bands). The RA cell can be
+   negative or larger than the number of RA cells in the band (around
+   RA=0/360). */
+static uint64_t
+match_sky_cell_key(struct match_sky_params *p, size_t band, long racell,
+                   size_t numra)
+{
+  long c=racell % (long)numra;
+  return (uint64_t)band*p->maxra + (uint64_t)(c<0 ? c+(long)numra : c);
+}
+
+
+
+
+
+/* Call 'match_sky_cell_key' on all cells that the aperture around the
+   given point touches. When 'keys' is NULL, only count them.
+
+   The RA half-width of a circle with radius 'r' around a point at
+   declination 'd' is 'asin(sin(r)/cos(d))' when the circle does not
+   contain a pole (in that case, all RA cells of the band are used). */
+static size_t
+match_sky_cells_of_A(struct match_sky_params *p, double ra, double dec,
+                     uint64_t *keys)
+{
+  long c, c0, c1;
+  double dra=0, w;
+  size_t b, b0, b1, numra, n=0;
+  int pole = ( dec-p->aperture<=-90.0 || dec+p->aperture>=90.0 );
+
+  /* RA half-width of the aperture. */
+  if(!pole)
+    dra = asin( sin(p->aperture*M_PI/180.0)/cos(dec*M_PI/180.0) )
+          * 180.0/M_PI;
+
+  /* Go over the bands. */
+  b0=match_sky_band(p, dec-p->aperture);
+  b1=match_sky_band(p, dec+p->aperture);
+  for(b=b0; b<=b1; ++b)
+    {
+      numra=match_sky_numra(p, b);
+      w=360.0/numra;
+      c0=floor( (ra-dra)/w );
+      c1=floor( (ra+dra)/w );
+      if( pole || c1-c0+1>=(long)numra ) { c0=0; c1=numra-1; }
+      for(c=c0; c<=c1; ++c)
+        {
+          if(keys) keys[n]=match_sky_cell_key(p, b, c, numra);
+          ++n;
+        }
+    }
+  return n;
+}
+
+
+
+
+
+/* Cell of a row in the second input. */
+static uint64_t
+match_sky_cell_of_B(struct match_sky_params *p, double ra, double dec)
+{
+  size_t band=match_sky_band(p, dec);
+  size_t numra=match_sky_numra(p, band);
+  return match_sky_cell_key(p, band, floor(ra/(360.0/numra)), numra);
+}
+
+
+
+
+
+/* RA within the 0 to 360 range. */
+static double
+match_sky_ra(double ra)
+{
+  ra=fmod(ra, 360.0);
+  return ra<0 ? ra+360.0 : ra;
+}
+
+
+
+
+
+/* Find the layout of the cells from the footprint of the inputs (so
+   there are roughly 'MATCH_SKY_CELL_ROWS' rows in each cell). */
+static void
+match_sky_layout(struct match_sky_params *p, size_t numthreads)
+{
+  size_t i, j, ncells;
+  double *ra, *dec, r, area;
+  gal_data_t *tmp[2]={p->A, p->B};
+  double rmin=DBL_MAX, rmax=-DBL_MAX, dmin=DBL_MAX, dmax=-DBL_MAX;
+
+  /* The range of the coordinates (ignoring blank values). */
+  for(i=0;i<2;++i)
+    {
+      ra=tmp[i]->array;
+      dec=tmp[i]->next->array;
+      for(j=0;j<tmp[i]->size;++j)
+        if( !isnan(ra[j]) && !isnan(dec[j]) )
+          {
+            if(dec[j]<-90.0 || dec[j]>90.0)
+              error(EXIT_FAILURE, 0, "%s: the declination of row %zu "
+                    "of input %zu (%g) is not within -90 and 90", __func__,
+                    j+1, i+1, dec[j]);
+            r=match_sky_ra(ra[j]);
+            if(r<rmin)      rmin=r;
+            if(r>rmax)      rmax=r;
+            if(dec[j]<dmin) dmin=dec[j];
+            if(dec[j]>dmax) dmax=dec[j];
+          }
+    }
+
+  /* Area of the footprint (in square degrees). */
+  area = ( rmin>rmax              /* All rows were blank. */
+           ? 0
+           : ( (180.0/M_PI) * (rmax-rmin)
+               * ( sin(dmax*M_PI/180.0)-sin(dmin*M_PI/180.0) ) ) );
+
+  /* Height of the bands: there should be at least a few cells for each
+     thread, but they shouldn't be much smaller than the aperture (to
+     avoid placing the first catalog rows in too many cells). */
+  ncells=(p->A->size+p->B->size)/MATCH_SKY_CELL_ROWS;
+  if(ncells<4*numthreads) ncells=4*numthreads;
+  p->height=sqrt(area/ncells);
+  if(p->height<4*p->aperture) p->height=4*p->aperture;
+  if(p->height>180.0) p->height=180.0;
+
+  /* Number of bands and RA cells. */
+  p->nbands=ceil(180.0/p->height);
+  p->maxra=floor(360.0/p->height);
+  if(p->maxra==0) p->maxra=1;
+}
+
+
+
+
+
+/* Place the rows of both inputs in the cells and sort them by cell. The
+   rows of the first input come before the second within each cell. */
+static size_t
+match_sky_fill_cells(struct match_sky_params *p, size_t numthreads)
+{
+  uint64_t *keys;
+  double *ra, *dec;
+  int pass;
+  size_t i, n, na, nentries=0, numcells=0;
+
+  /* Count the number of entries. */
+  ra=p->A->array;
+  dec=p->A->next->array;
+  for(i=0;i<p->A->size;++i)
+    if( !isnan(ra[i]) && !isnan(dec[i]) )
+      nentries+=match_sky_cells_of_A(p, match_sky_ra(ra[i]), dec[i],
+                                     NULL);
+  ra=p->B->array;
+  dec=p->B->next->array;
+  for(i=0;i<p->B->size;++i)
+    if( !isnan(ra[i]) && !isnan(dec[i]) ) ++nentries;
+
+  /* Allocate the arrays. */
+  keys=gal_pointer_allocate(GAL_TYPE_UINT64, nentries, 0, __func__,
+                            "keys");
+  p->ids=gal_pointer_allocate(GAL_TYPE_SIZE_T, nentries, 0, __func__,
+                              "p->ids");
+  p->index=gal_pointer_allocate(GAL_TYPE_SIZE_T, nentries, 0, __func__,
+                                "p->index");
+
+  /* Fill the cell keys and the rows of each entry. */
+  n=0;
+  ra=p->A->array;
+  dec=p->A->next->array;
+  for(i=0;i<p->A->size;++i)
+    if( !isnan(ra[i]) && !isnan(dec[i]) )
+      {
+        nentries=match_sky_cells_of_A(p, match_sky_ra(ra[i]), dec[i],
+                                      keys+n);
+        while(nentries--) p->ids[n++]=i;
+      }
+  ra=p->B->array;
+  dec=p->B->next->array;
+  for(i=0;i<p->B->size;++i)
+    if( !isnan(ra[i]) && !isnan(dec[i]) )
+      {
+        keys[n]=match_sky_cell_of_B(p, match_sky_ra(ra[i]), dec[i]);
+        p->ids[n++]=p->A->size+i;
+      }
+  nentries=n;
+
+  /* Sort the entries by their cell (equal keys are sorted by their
+     index, so the first input's rows come first in each cell). */
+  for(i=0;i<nentries;++i) p->index[i]=i;
+  gal_sort_index(p->index, nentries, keys, GAL_TYPE_UINT64, 0,
+                 numthreads);
+
+  /* Find the cells that contain rows of both inputs: in the first pass,
+     they are only counted, in the second, their ranges are stored. */
+  for(pass=0;pass<2;++pass)
+    {
+      if(pass)
+        {
+          errno=0;
+          p->cellstart=malloc(3*numcells*sizeof *p->cellstart);
+          if(p->cellstart==NULL)
+            error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes "
+                  "for 'p->cellstart'", __func__,
+                  3*numcells*sizeof *p->cellstart);
+          p->cellna=p->cellstart+numcells;
+          p->cellend=p->cellna+numcells;
+          numcells=0;
+        }
+      for(i=0; i<nentries; i=n)
+        {
+          /* Find the end of this cell and the number of its A rows. */
+          n=i;
+          while(n<nentries && keys[p->index[n]]==keys[p->index[i]]) ++n;
+          na=i;
+          while(na<n && p->ids[p->index[na]]<p->A->size) ++na;
+
+          /* Only keep the cell if it has rows from both inputs. */
+          if(na>i && na<n)
+            {
+              if(pass)
+                {
+                  p->cellstart[numcells]=i;
+                  p->cellna[numcells]=na-i;
+                  p->cellend[numcells]=n;
+                }
+              ++numcells;
+            }
+        }
+    }
+
+  /* Clean up and return. */
+  free(keys);
+  return numcells;
+}
+
+
+
+
+
+/* Unit vector (in 3D) of the given RA and Dec (in degrees). */
+static void
+match_sky_unit_vector(double ra, double dec, double *v)
+{
+  double cd=cos(dec*M_PI/180.0);
+  v[0]=cd*cos(ra*M_PI/180.0);
+  v[1]=cd*sin(ra*M_PI/180.0);
+  v[2]=sin(dec*M_PI/180.0);
+}
+
+
+
+
+
+/* Match the rows of the second input to those of the first in each of
+   the cells assigned to this thread. */
+static void *
+match_sky_worker(void *in_prm)
+{
+  /* Low-level definitions to be done first. */
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct match_sky_params *p=(struct match_sky_params *)tprm->params;
+
+  /* High level definitions. */
+  size_t dsize[1];
+  gal_kdtree_bucket_t *b;
+  gal_data_t *cols, *bucket;
+  double *ra, *dec, *x, *y, *z, point[3], chord, ang;
+  size_t i, j, c, ai, bi, start, na, *ids=p->ids, *index=p->index;
+
+  /* Go over all the cells that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Basic properties of this cell. */
+      c=tprm->indexs[i];
+      na=dsize[0]=p->cellna[c];
+      start=p->cellstart[c];
+
+      /* Unit vectors of the first input's rows in this cell. */
+      cols=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, dsize, NULL, 0,
+                          p->minmapsize, p->quietmmap, NULL, NULL, NULL);
+      cols->next=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, dsize, NULL, 0,
+                                p->minmapsize, p->quietmmap, NULL, NULL,
+                                NULL);
+      cols->next->next=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, dsize,
+                                      NULL, 0, p->minmapsize, p->quietmmap,
+                                      NULL, NULL, NULL);
+      x=cols->array; y=cols->next->array; z=cols->next->next->array;
+      ra=p->A->array;
+      dec=p->A->next->array;
+      for(j=0;j<na;++j)
+        {
+          ai=ids[ index[start+j] ];
+          match_sky_unit_vector(ra[ai], dec[ai], point);
+          x[j]=point[0]; y[j]=point[1]; z[j]=point[2];
+        }
+
+      /* Build the bucket k-d tree of this cell (the unit vectors are
+         copied into it, so they can be freed). */
+      bucket=gal_kdtree_bucket_create(cols, MATCH_SKY_BUCKET_SIZE);
+      b=gal_kdtree_bucket_prepare(bucket, MATCH_SKY_BUCKET_SIZE);
+      gal_list_data_free(cols);
+
+      /* Find the nearest neighbour of each second input row in this cell
+         and keep it if it is within the aperture. The distance is the
+         angle between the two unit vectors (derived from the chord). */
+      ra=p->B->array;
+      dec=p->B->next->array;
+      for(j=start+na; j<p->cellend[c]; ++j)
+        {
+          bi=ids[ index[j] ] - p->A->size;
+          match_sky_unit_vector(ra[bi], dec[bi], point);
+          ai=gal_kdtree_bucket_nearest(b, point, &chord);
+          ang=2*asin( chord/2<1 ? chord/2 : 1 )*180.0/M_PI;
+          if(ang<p->aperture)
+            {
+              p->bnear[bi]=ids[ index[start+ai] ];
+              p->bdist[bi]=ang;
+            }
+        }
+
+      /* Clean up. */
+      gal_kdtree_bucket_free(b);
+      gal_list_data_free(bucket);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Match two catalogs with RA and Dec coordinates (in degrees) on the
+   sphere: the sky is divided into cells (see the comments at the start of
+   this section) and each cell is matched independently with its own
+   (small) k-d tree. */
+gal_data_t *
+gal_match_sky_cells(gal_data_t *coord1, gal_data_t *coord2,
+                    double *aperture, size_t numthreads, size_t minmapsize,
+                    int quietmmap, size_t *nummatched)
+{
+  size_t bi, numcells, *costs;
+  gal_data_t *tmp, *out=NULL;
+  struct match_sfll **bina;
+  struct match_sky_params p={0};
+  gal_data_t *tmpin[2]={coord1, coord2};
+
+  /* Basic sanity checks. */
+  for(bi=0;bi<2;++bi)
+    {
+      if( gal_list_data_number(tmpin[bi])!=2 )
+        error(EXIT_FAILURE, 0, "%s: 'coord%zu' should have two columns "
+              "(RA and Dec), but it has %zu", __func__, bi+1,
+              gal_list_data_number(tmpin[bi]));
+      for(tmp=tmpin[bi]; tmp!=NULL; tmp=tmp->next)
+        if( tmp->type!=GAL_TYPE_FLOAT64 )
+          error(EXIT_FAILURE, 0, "%s: the type of all columns in "
+                "'coord%zu' should be 'double', but at least one of them "
+                "is '%s'", __func__, bi+1, gal_type_name(tmp->type, 1));
+      if(tmpin[bi]->next->size!=tmpin[bi]->size)
+        error(EXIT_FAILURE, 0, "%s: the two columns of 'coord%zu' should "
+              "have the same number of rows", __func__, bi+1);
+    }
+  if( !(aperture[0]>0 && aperture[0]<90) )
+    error(EXIT_FAILURE, 0, "%s: the aperture radius should be larger than "
+          "0 and smaller than 90 degrees, but it is %g", __func__,
+          aperture[0]);
+
+  /* If any of the inputs is empty, there is no match. */
+  if(coord1->size==0 || coord2->size==0) { *nummatched=0; return NULL; }
+
+  /* Write the parameters into the structure. */
+  p.A=coord1;
+  p.B=coord2;
+  p.aperture=aperture[0];
+  p.quietmmap=quietmmap;
+  p.minmapsize=minmapsize;
+
+  /* Set the cells and place the rows in them. */
+  match_sky_layout(&p, numthreads);
+  numcells=match_sky_fill_cells(&p, numthreads);
+
+  /* Match the cells (the number of rows in each cell is used to balance
+     the load between the threads). */
+  p.bnear=gal_pointer_allocate(GAL_TYPE_SIZE_T, p.B->size, 0, __func__,
+                               "p.bnear");
+  p.bdist=gal_pointer_allocate(GAL_TYPE_FLOAT64, p.B->size, 0, __func__,
+                               "p.bdist");
+  for(bi=0;bi<p.B->size;++bi) p.bnear[bi]=GAL_BLANK_SIZE_T;
+  if(numcells)
+    {
+      costs=gal_pointer_allocate(GAL_TYPE_SIZE_T, numcells, 0, __func__,
+                                 "costs");
+      for(bi=0;bi<numcells;++bi) costs[bi]=p.cellend[bi]-p.cellstart[bi];
+      gal_threads_spin_off_dynamic(match_sky_worker, &p, numcells,
+                                   numthreads, costs);
+      free(costs);
+    }
+
+  /* Put the matches into the 'bina' array (an array of lists, see
+     'gal_match_sort_based'). */
+  errno=0;
+  bina=calloc(p.A->size, sizeof *bina);
+  if(bina==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'bina'", __func__,
+          p.A->size*sizeof *bina);
+  for(bi=0;bi<p.B->size;++bi)
+    if(p.bnear[bi]!=GAL_BLANK_SIZE_T)
+      match_add_to_sfll(&bina[ p.bnear[bi] ], bi, p.bdist[bi]);
+
+  /* Find the best match for each item (from possibly multiple matches). */
+  match_rearrange(p.A, p.B, bina);
+
+  /* The match is done, write the output. */
+  out=match_output(p.A, p.B, NULL, NULL, bina, minmapsize, quietmmap);
+
+  /* Set 'nummatched' and return output. */
+  *nummatched = out ?  out->next->next->size : 0;
+
+  /* Clean up and return. */
+  free(bina);
+  free(p.ids);
+  free(p.index);
+  free(p.bnear);
+  free(p.bdist);
+  free(p.cellstart);
+  return out;
+}
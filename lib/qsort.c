@@ -113,49 +113,65 @@ gal_qsort_int16_i(const void *a, const void *b)
 int
 gal_qsort_uint32_d(const void *a, const void *b)
 {
-  return ( *(uint32_t *)b - *(uint32_t *)a );
+  uint32_t ta=*(uint32_t *)a;
+  uint32_t tb=*(uint32_t *)b;
+  return (tb > ta) - (tb < ta);
 }
 
 int
 gal_qsort_uint32_i(const void *a, const void *b)
 {
-  return ( *(uint32_t *)a - *(uint32_t *)b );
+  uint32_t ta=*(uint32_t *)a;
+  uint32_t tb=*(uint32_t *)b;
+  return (ta > tb) - (ta < tb);
 }
 
 int
 gal_qsort_int32_d(const void *a, const void *b)
 {
-  return ( *(int32_t *)b - *(int32_t *)a );
+  int32_t ta=*(int32_t *)a;
+  int32_t tb=*(int32_t *)b;
+  return (tb > ta) - (tb < ta);
 }
 
 int
 gal_qsort_int32_i(const void *a, const void *b)
 {
-  return ( *(int32_t *)a - *(int32_t *)b );
+  int32_t ta=*(int32_t *)a;
+  int32_t tb=*(int32_t *)b;
+  return (ta > tb) - (ta < tb);
 }
 
 int
 gal_qsort_uint64_d(const void *a, const void *b)
 {
-  return ( *(uint64_t *)b - *(uint64_t *)a );
+  uint64_t ta=*(uint64_t *)a;
+  uint64_t tb=*(uint64_t *)b;
+  return (tb > ta) - (tb < ta);
 }
 
 int
 gal_qsort_uint64_i(const void *a, const void *b)
 {
-  return ( *(uint64_t *)a - *(uint64_t *)b );
+  uint64_t ta=*(uint64_t *)a;
+  uint64_t tb=*(uint64_t *)b;
+  return (ta > tb) - (ta < tb);
 }
 
 int
 gal_qsort_int64_d(const void *a, const void *b)
 {
-  return ( *(int64_t *)b - *(int64_t *)a );
+  int64_t ta=*(int64_t *)a;
+  int64_t tb=*(int64_t *)b;
+  return (tb > ta) - (tb < ta);
 }
 
 int
 gal_qsort_int64_i(const void *a, const void *b)
 {
-  return ( *(int64_t *)a - *(int64_t *)b );
+  int64_t ta=*(int64_t *)a;
+  int64_t tb=*(int64_t *)b;
+  return (ta > tb) - (ta < tb);
 }
 
 int
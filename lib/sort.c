@@ -0,0 +1,914 @@
+/*********************************************************************
+sort -- Type-specialized sorting of arrays and indexs.
+This is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <config.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <errno.h>
+#include <error.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gnuastro/type.h>
+#include <gnuastro/sort.h>
+#include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/***************               Keys                ******************/
+/*********************************************************************/
+/* The sorting functions of this file don't use the values directly, but
+   unsigned integer "keys" with the same width that have the same order
+   as the values: for signed integers, the sign bit is flipped (so the
+   negative values come first) and for floating points, the sign bit is
+   flipped for positive values and all the bits are flipped for negative
+   values. For a decreasing sort, all the bits of the keys are also
+   flipped. The keys are written in the same place as the values (and
+   the values are restored after sorting), so no extra space is
+   necessary.
+
+   To avoid aliasing problems (reading floating point values as integers),
+   the keys are always read and written with 'memcpy' (which compilers
+   will replace with a simple load/store). */
+#define SORT_KIND_UNSIGNED 0
+#define SORT_KIND_SIGNED   1
+#define SORT_KIND_FLOAT    2
+
+#define SORT_KEYS_MAKE(UT, KIND) {                                      \
+    UT k, sign=(UT)1<<(8*sizeof(UT)-1);                                 \
+    unsigned char *p=array, *pf=p+size*sizeof(UT);                      \
+    do                                                                  \
+      {                                                                 \
+        memcpy(&k, p, sizeof k);                                        \
+        if(KIND==SORT_KIND_FLOAT) k = (k & sign) ? (UT)~k : (k | sign); \
+        else if(KIND==SORT_KIND_SIGNED) k ^= sign;                      \
+        if(decreasing) k=~k;                                            \
+        memcpy(p, &k, sizeof k);                                        \
+      }                                                                 \
+    while( (p+=sizeof(UT)) < pf );                                      \
+  }
+
+#define SORT_KEYS_UNDO(UT, KIND) {                                      \
+    UT k, sign=(UT)1<<(8*sizeof(UT)-1);                                 \
+    unsigned char *p=array, *pf=p+size*sizeof(UT);                      \
+    do                                                                  \
+      {                                                                 \
+        memcpy(&k, p, sizeof k);                                        \
+        if(decreasing) k=~k;                                            \
+        if(KIND==SORT_KIND_FLOAT) k = (k & sign) ? (k & ~sign) : (UT)~k;\
+        else if(KIND==SORT_KIND_SIGNED) k ^= sign;                      \
+        memcpy(p, &k, sizeof k);                                        \
+      }                                                                 \
+    while( (p+=sizeof(UT)) < pf );                                      \
+  }
+
+#define SORT_KEYS(UT, KIND) {                                           \
+    if(undo) SORT_KEYS_UNDO(UT, KIND) else SORT_KEYS_MAKE(UT, KIND)     \
+  }
+static void
+sort_keys(void *array, uint8_t type, size_t size, int decreasing, int undo)
+{
+  if(size==0) return;
+  switch(type)
+    {
+    case GAL_TYPE_UINT8:   SORT_KEYS(uint8_t,  SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT8:    SORT_KEYS(uint8_t,  SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_UINT16:  SORT_KEYS(uint16_t, SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT16:   SORT_KEYS(uint16_t, SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_UINT32:  SORT_KEYS(uint32_t, SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT32:   SORT_KEYS(uint32_t, SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_UINT64:  SORT_KEYS(uint64_t, SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT64:   SORT_KEYS(uint64_t, SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_FLOAT32: SORT_KEYS(uint32_t, SORT_KIND_FLOAT);    break;
+    case GAL_TYPE_FLOAT64: SORT_KEYS(uint64_t, SORT_KIND_FLOAT);    break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+            __func__, type);
+    }
+}
+
+
+
+
+
+/* Larger and smaller are not defined for NaN, so (like the 'gal_qsort_*'
+   functions) they are put after all the other elements (irrespective of
+   the requested order). Here, all the NaN elements are moved to the end
+   of the array and the number of non-NaN elements is returned. */
+#define SORT_NAN_TO_END(IT) {                                           \
+    IT t, *a=array, *b=array, *af=a+size;                               \
+    do if( !isnan(*a) ) { t=*b; *b++=*a; *a=t; } while(++a<af);         \
+    nonan=b-(IT *)array;                                                \
+  }
+static size_t
+sort_nan_to_end(void *array, uint8_t type, size_t size)
+{
+  size_t nonan=size;
+  if(size)
+    switch(type)
+      {
+      case GAL_TYPE_FLOAT32: SORT_NAN_TO_END( float  ); break;
+      case GAL_TYPE_FLOAT64: SORT_NAN_TO_END( double ); break;
+      }
+  return nonan;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/***************            Radix sort             ******************/
+/*********************************************************************/
+/* Parameters for sorting the keys on multiple threads. In each pass
+   (over one byte of the keys), the array is divided into one part for
+   each thread. In the first step, each thread counts the number of keys
+   in each bin of its part. These counts are then converted to the
+   positions that each thread should start writing each bin and in the
+   second step, each thread copies its own keys into the new array. */
+struct sort_radix_params
+{
+  void          *src;  /* Keys to read in this pass.                    */
+  void          *dst;  /* Place to write the keys in this pass.         */
+  size_t        size;  /* Number of keys.                               */
+  size_t       width;  /* Number of bytes in each key.                  */
+  size_t       shift;  /* Bits to shift the keys for this pass's digit. */
+  size_t      nparts;  /* Number of parts (one for each thread).        */
+  size_t     *counts;  /* Counts (then start) of each bin in each part. */
+  int        scatter;  /* ==0: count the digits, ==1: copy the keys.    */
+};
+
+
+
+
+
+/* Count the digits or copy the keys of one part. */
+#define SORT_RADIX_PART(UT) {                                           \
+    UT *s=(UT *)(rprm->src)+lo, *sf=(UT *)(rprm->src)+hi;               \
+    UT *dst=rprm->dst;                                                  \
+    if(rprm->scatter)                                                   \
+      for(; s<sf; ++s) dst[ c[ (*s>>rprm->shift) & 0xff ]++ ] = *s;     \
+    else                                                                \
+      {                                                                 \
+        memset(c, 0, 256*sizeof *c);                                    \
+        for(; s<sf; ++s) ++c[ (*s>>rprm->shift) & 0xff ];               \
+      }                                                                 \
+  }
+static void *
+sort_radix_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct sort_radix_params *rprm=(struct sort_radix_params *)tprm->params;
+
+  size_t i, j, lo, hi, *c;
+
+  /* Go over all the parts given to this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      /* For easy reading. */
+      j = tprm->indexs[i];
+      c = rprm->counts + j*256;
+      lo = j     * rprm->size / rprm->nparts;
+      hi = (j+1) * rprm->size / rprm->nparts;
+
+      /* Do the job. */
+      switch(rprm->width)
+        {
+        case 1: SORT_RADIX_PART( uint8_t  ); break;
+        case 2: SORT_RADIX_PART( uint16_t ); break;
+        case 4: SORT_RADIX_PART( uint32_t ); break;
+        case 8: SORT_RADIX_PART( uint64_t ); break;
+        default:
+          error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to "
+                "fix the problem. %zu is not a recognized width",
+                __func__, PACKAGE_BUGREPORT, rprm->width);
+        }
+    }
+
+  /* Wait for all threads to finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Sort the keys on multiple threads (one pass for each byte). */
+static void
+sort_radix_threaded(void *array, void *tmp, size_t width, size_t size,
+                    size_t numthreads)
+{
+  void *swp;
+  size_t b, d, j, t, sum, total;
+  struct sort_radix_params rprm;
+
+  /* Set the basic parameters. */
+  rprm.src=array;
+  rprm.dst=tmp;
+  rprm.size=size;
+  rprm.width=width;
+  rprm.nparts=numthreads;
+  rprm.counts=gal_pointer_allocate(GAL_TYPE_SIZE_T, 256*rprm.nparts, 0,
+                                   __func__, "rprm.counts");
+
+  /* Go over the bytes (least significant first). */
+  for(b=0;b<width;++b)
+    {
+      /* Count the number of keys in each bin of each part. */
+      rprm.scatter=0;
+      rprm.shift=8*b;
+      gal_threads_spin_off(sort_radix_on_thread, &rprm, rprm.nparts,
+                           numthreads, -1, 1);
+
+      /* Convert the counts to starting positions. If all the keys are
+         in one bin, this byte is the same in all keys and there is no
+         need to copy them. */
+      for(sum=d=0; d<256; ++d)
+        {
+          for(total=j=0; j<rprm.nparts; ++j)
+            {
+              t = rprm.counts[j*256+d];
+              rprm.counts[j*256+d] = sum+total;
+              total += t;
+            }
+          if(total==size) break;
+          sum+=total;
+        }
+      if(d<256) continue;
+
+      /* Copy the keys into the other array and swap the arrays. */
+      rprm.scatter=1;
+      gal_threads_spin_off(sort_radix_on_thread, &rprm, rprm.nparts,
+                           numthreads, -1, 1);
+      swp=rprm.src; rprm.src=rprm.dst; rprm.dst=swp;
+    }
+
+  /* If the final keys are in the temporary array, copy them back. */
+  if(rprm.src!=array) memcpy(array, rprm.src, size*width);
+  free(rprm.counts);
+}
+
+
+
+
+
+/* Least significant digit radix sort of the unsigned integer keys (one
+   byte in each pass). The counts of all the bytes are found in one pass
+   over the keys and bytes that are identical in all the keys (for
+   example the higher bytes of small integers) are not sorted. */
+#define SORT_RADIX(UT) {                                                \
+    UT *src=array, *dst=tmp, *swp, *s, *sf;                             \
+    size_t b, d, t, sum, c[sizeof(UT)][256];                            \
+                                                                        \
+    /* Count the keys in each bin of all the bytes. */                  \
+    memset(c, 0, sizeof c);                                             \
+    sf=(s=src)+size;                                                    \
+    do for(b=0;b<sizeof(UT);++b) ++c[b][ (*s>>(8*b)) & 0xff ];          \
+    while(++s<sf);                                                      \
+                                                                        \
+    /* Sort by each byte. */                                            \
+    for(b=0;b<sizeof(UT);++b)                                           \
+      if( c[b][ (*src>>(8*b)) & 0xff ] != size )                        \
+        {                                                               \
+          for(sum=d=0; d<256; ++d) { t=c[b][d]; c[b][d]=sum; sum+=t; }  \
+          sf=(s=src)+size;                                              \
+          do dst[ c[b][ (*s>>(8*b)) & 0xff ]++ ] = *s; while(++s<sf);   \
+          swp=src; src=dst; dst=swp;                                    \
+        }                                                               \
+                                                                        \
+    /* Put the sorted keys in the input array. */                       \
+    if(src!=array) memcpy(array, src, size*sizeof *src);                \
+  }
+
+/* For small arrays, a simple insertion sort is faster. */
+#define SORT_INSERTION(UT) {                                            \
+    UT t, *a=array;                                                     \
+    size_t i, j;                                                        \
+    for(i=1;i<size;++i)                                                 \
+      {                                                                 \
+        t=a[i];                                                         \
+        for(j=i; j>0 && t<a[j-1]; --j) a[j]=a[j-1];                     \
+        a[j]=t;                                                         \
+      }                                                                 \
+  }
+
+static void
+sort_radix(void *array, size_t width, size_t size, size_t numthreads)
+{
+  void *tmp;
+
+  /* Small arrays. */
+  if(size<GAL_SORT_RADIX_MIN)
+    {
+      switch(width)
+        {
+        case 1: SORT_INSERTION( uint8_t  ); break;
+        case 2: SORT_INSERTION( uint16_t ); break;
+        case 4: SORT_INSERTION( uint32_t ); break;
+        case 8: SORT_INSERTION( uint64_t ); break;
+        }
+      return;
+    }
+
+  /* Allocate the temporary space and sort. */
+  tmp=gal_pointer_allocate(GAL_TYPE_UINT8, size*width, 0, __func__, "tmp");
+  if(numthreads>1 && size>=GAL_SORT_PARALLEL_MIN)
+    sort_radix_threaded(array, tmp, width, size, numthreads);
+  else
+    switch(width)
+      {
+      case 1: SORT_RADIX( uint8_t  ); break;
+      case 2: SORT_RADIX( uint16_t ); break;
+      case 4: SORT_RADIX( uint32_t ); break;
+      case 8: SORT_RADIX( uint64_t ); break;
+      default:
+        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
+              "the problem. %zu is not a recognized width", __func__,
+              PACKAGE_BUGREPORT, width);
+      }
+
+  /* Clean up. */
+  free(tmp);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/***************     Pattern-defeating quicksort   ******************/
+/*********************************************************************/
+/* To sort indexs, the key of each index's value (see the "Keys" section
+   above) is kept beside it, so the comparisons don't need to go back to
+   the values array (which is usually in a random order compared to the
+   indexs) and a single implementation works for all types. Elements with
+   equal keys are sorted by their index, so the result is deterministic
+   (identical to a stable sort when the indexs are initially increasing).
+
+   The sorting is done with a pattern-defeating quicksort (Orson Peters,
+   2021, arXiv:2106.05123): a quicksort with a median of three (or
+   pseudo-median of nine for large ranges) pivot that detects partitions
+   where nothing had to be moved (when the input is already sorted) and
+   breaks patterns that cause bad partitions. When there are too many bad
+   partitions, it falls back to heapsort, so the worst case is always
+   O(n*log(n)). */
+#define SORT_PDQ_INSERTION 24   /* Smaller ranges: insertion sort.     */
+#define SORT_PDQ_NINTHER  128   /* Larger ranges: pseudo-median of 9.  */
+#define SORT_PDQ_PARTIAL    8   /* Max. moves in partial insertion.    */
+
+struct sort_pair
+{
+  uint64_t   key;       /* Key of the value at this index.               */
+  size_t   index;       /* Index of the value.                           */
+};
+
+#define SORT_PAIR_LT(A,B) sort_pair_lt(&(A), &(B))
+#define SORT_PAIR_SWAP(A,B) { struct sort_pair t=(A); (A)=(B); (B)=t; }
+
+
+
+
+
+/* If 'a' should be placed before 'b' (as a function, so the arguments are
+   only evaluated once). */
+static inline int
+sort_pair_lt(struct sort_pair *a, struct sort_pair *b)
+{
+  return a->key < b->key || ( a->key==b->key && a->index < b->index );
+}
+
+
+
+
+
+static void
+sort_pdq_insertion(struct sort_pair *a, size_t n)
+{
+  size_t i, j;
+  struct sort_pair t;
+
+  for(i=1;i<n;++i)
+    {
+      t=a[i];
+      for(j=i; j>0 && SORT_PAIR_LT(t, a[j-1]); --j) a[j]=a[j-1];
+      a[j]=t;
+    }
+}
+
+
+
+
+
+/* Similar to 'sort_pdq_insertion', but it will stop (and return 0) when
+   more than 'SORT_PDQ_PARTIAL' elements have been moved. */
+static int
+sort_pdq_insertion_partial(struct sort_pair *a, size_t n)
+{
+  size_t i, j, moved=0;
+  struct sort_pair t;
+
+  for(i=1;i<n;++i)
+    if( SORT_PAIR_LT(a[i], a[i-1]) )
+      {
+        t=a[i];
+        j=i;
+        do { a[j]=a[j-1]; --j; } while(j>0 && SORT_PAIR_LT(t, a[j-1]));
+        a[j]=t;
+        moved += i-j;
+        if(moved>SORT_PDQ_PARTIAL) return 0;
+      }
+  return 1;
+}
+
+
+
+
+
+static void
+sort_pdq_heap_sift(struct sort_pair *a, size_t n, size_t i)
+{
+  size_t c;
+  struct sort_pair t=a[i];
+
+  while( (c=2*i+1) < n )
+    {
+      if( c+1<n && SORT_PAIR_LT(a[c], a[c+1]) ) ++c;
+      if( !SORT_PAIR_LT(t, a[c]) ) break;
+      a[i]=a[c];
+      i=c;
+    }
+  a[i]=t;
+}
+
+
+
+
+
+static void
+sort_pdq_heap(struct sort_pair *a, size_t n)
+{
+  size_t i;
+
+  for(i=n/2; i-->0;) sort_pdq_heap_sift(a, n, i);
+  for(i=n-1; i>0; --i)
+    {
+      SORT_PAIR_SWAP(a[0], a[i]);
+      sort_pdq_heap_sift(a, i, 0);
+    }
+}
+
+
+
+
+
+/* Sort the three elements (so 'a[i]<=a[j]<=a[k]'). */
+static void
+sort_pdq_three(struct sort_pair *a, size_t i, size_t j, size_t k)
+{
+  if( SORT_PAIR_LT(a[j], a[i]) ) SORT_PAIR_SWAP(a[i], a[j]);
+  if( SORT_PAIR_LT(a[k], a[j]) ) SORT_PAIR_SWAP(a[j], a[k]);
+  if( SORT_PAIR_LT(a[j], a[i]) ) SORT_PAIR_SWAP(a[i], a[j]);
+}
+
+
+
+
+
+/* Partition the range around its first element (the pivot) and return
+   the final position of the pivot. An element that is not smaller than
+   the pivot should exist after it (this is guaranteed by the choice of
+   the pivot). If no elements had to be swapped, 'partitioned' will be
+   1. */
+static size_t
+sort_pdq_partition(struct sort_pair *a, size_t n, int *partitioned)
+{
+  size_t first=0, last=n;
+  struct sort_pair pivot=a[0];
+
+  /* Find the first element that is not smaller than the pivot and the
+     last element that is smaller than it. When there was no smaller
+     element before 'first', there is no guard for the second search. */
+  while( SORT_PAIR_LT(a[++first], pivot) );
+  if(first==1) while( first<last && !SORT_PAIR_LT(a[--last], pivot) );
+  else         while(              !SORT_PAIR_LT(a[--last], pivot) );
+
+  /* If they have already crossed, the range was already partitioned. */
+  *partitioned = first>=last;
+
+  /* Swap the elements on the wrong side. */
+  while(first<last)
+    {
+      SORT_PAIR_SWAP(a[first], a[last]);
+      while(  SORT_PAIR_LT(a[++first], pivot) );
+      while( !SORT_PAIR_LT(a[--last],  pivot) );
+    }
+
+  /* Put the pivot in its final place. */
+  a[0]=a[first-1];
+  a[first-1]=pivot;
+  return first-1;
+}
+
+
+
+
+
+/* Swap some elements of a range that was badly partitioned (to break any
+   pattern that caused it). */
+static void
+sort_pdq_shuffle(struct sort_pair *a, size_t n)
+{
+  size_t q=n/4;
+
+  if(n<SORT_PDQ_INSERTION) return;
+  SORT_PAIR_SWAP(a[0],   a[q]);
+  SORT_PAIR_SWAP(a[n-1], a[n-q]);
+  if(n>SORT_PDQ_NINTHER)
+    {
+      SORT_PAIR_SWAP(a[1],   a[q+1]);
+      SORT_PAIR_SWAP(a[2],   a[q+2]);
+      SORT_PAIR_SWAP(a[n-2], a[n-q-1]);
+      SORT_PAIR_SWAP(a[n-3], a[n-q-2]);
+    }
+}
+
+
+
+
+
+static void
+sort_pdq(struct sort_pair *a, size_t n, size_t badallowed)
+{
+  int partitioned;
+  size_t pos, l, r, h;
+
+  while(1)
+    {
+      /* Small ranges. */
+      if(n<SORT_PDQ_INSERTION) { sort_pdq_insertion(a, n); return; }
+
+      /* Choose the pivot and put it in the first element. */
+      h=n/2;
+      if(n>SORT_PDQ_NINTHER)
+        {
+          sort_pdq_three(a, 0,   h,   n-1);
+          sort_pdq_three(a, 1,   h-1, n-2);
+          sort_pdq_three(a, 2,   h+1, n-3);
+          sort_pdq_three(a, h-1, h,   h+1);
+          SORT_PAIR_SWAP(a[0], a[h]);
+        }
+      else
+        sort_pdq_three(a, h, 0, n-1);
+
+      /* Partition the range. */
+      pos=sort_pdq_partition(a, n, &partitioned);
+      l=pos;
+      r=n-pos-1;
+
+      /* A highly unbalanced partition: if there have been too many,
+         use heapsort, otherwise, break the possible patterns. */
+      if( l<n/8 || r<n/8 )
+        {
+          if(--badallowed==0) { sort_pdq_heap(a, n); return; }
+          sort_pdq_shuffle(a, l);
+          sort_pdq_shuffle(a+pos+1, r);
+        }
+
+      /* A balanced partition where nothing was moved: the range may
+         already be sorted, so try insertion sort (which will stop if too
+         many elements need to be moved). */
+      else if( partitioned
+               && sort_pdq_insertion_partial(a, l)
+               && sort_pdq_insertion_partial(a+pos+1, r) )
+        return;
+
+      /* Sort the left side and continue with the right side. */
+      sort_pdq(a, l, badallowed);
+      a+=pos+1;
+      n=r;
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/***************           Sorting indexs          ******************/
+/*********************************************************************/
+/* Parameters to sort the pairs on multiple threads: each thread sorts
+   one part of the pairs, then the sorted parts are merged (two by two)
+   until there is only one. */
+struct sort_index_params
+{
+  struct sort_pair  *src;  /* Pairs to sort or merge.                    */
+  struct sort_pair  *dst;  /* Output of merging.                         */
+  size_t          *bound;  /* Start of each part ('nparts+1' elements).  */
+  size_t          nparts;  /* Number of parts.                           */
+  size_t           width;  /* Parts in each half of a merge (0: sort).   */
+};
+
+
+
+
+
+static void *
+sort_index_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct sort_index_params *iprm=(struct sort_index_params *)tprm->params;
+
+  size_t i, j, w, n, lo, mid, hi, badallowed;
+  struct sort_pair *a, *af, *b, *bf, *o;
+
+  /* Go over all the actions given to this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      j=tprm->indexs[i];
+      w=iprm->width;
+
+      /* Sort one part. */
+      if(w==0)
+        {
+          n=iprm->bound[j+1]-iprm->bound[j];
+          for(badallowed=1; n>>badallowed; ++badallowed);
+          sort_pdq(iprm->src+iprm->bound[j], n, badallowed);
+        }
+
+      /* Merge two groups of parts. */
+      else
+        {
+          lo  = iprm->bound[ 2*j*w ];
+          mid = iprm->bound[ 2*j*w+w   < iprm->nparts
+                             ? 2*j*w+w   : iprm->nparts ];
+          hi  = iprm->bound[ 2*j*w+2*w < iprm->nparts
+                             ? 2*j*w+2*w : iprm->nparts ];
+          a=iprm->src+lo;  af=iprm->src+mid;
+          b=af;            bf=iprm->src+hi;
+          o=iprm->dst+lo;
+          while(a<af && b<bf) *o++ = SORT_PAIR_LT(*b, *a) ? *b++ : *a++;
+          while(a<af) *o++=*a++;
+          while(b<bf) *o++=*b++;
+        }
+    }
+
+  /* Wait for all threads to finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Sort the pairs (possibly on multiple threads). */
+static void
+sort_index_pairs(struct sort_pair *pairs, size_t size, size_t numthreads)
+{
+  size_t i, badallowed, *bound;
+  struct sort_pair *tmp, *swp;
+  struct sort_index_params iprm;
+
+  /* Single-threaded. */
+  if(numthreads<2 || size<GAL_SORT_PARALLEL_MIN)
+    {
+      for(badallowed=1; size>>badallowed; ++badallowed);
+      sort_pdq(pairs, size, badallowed);
+      return;
+    }
+
+  /* Allocate the necessary spaces. */
+  errno=0;
+  tmp=malloc(size*sizeof *tmp);
+  if(tmp==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'tmp'",
+          __func__, size*sizeof *tmp);
+  bound=gal_pointer_allocate(GAL_TYPE_SIZE_T, numthreads+1, 0, __func__,
+                             "bound");
+  for(i=0;i<=numthreads;++i) bound[i]=i*size/numthreads;
+
+  /* Sort each part. */
+  iprm.src=pairs;
+  iprm.dst=tmp;
+  iprm.width=0;
+  iprm.bound=bound;
+  iprm.nparts=numthreads;
+  gal_threads_spin_off(sort_index_on_thread, &iprm, iprm.nparts,
+                       numthreads, -1, 1);
+
+  /* Merge the parts. */
+  for(iprm.width=1; iprm.width<iprm.nparts; iprm.width*=2)
+    {
+      gal_threads_spin_off(sort_index_on_thread, &iprm,
+                           (iprm.nparts+2*iprm.width-1)/(2*iprm.width),
+                           numthreads, -1, 1);
+      swp=iprm.src; iprm.src=iprm.dst; iprm.dst=swp;
+    }
+
+  /* Clean up. */
+  if(iprm.src!=pairs) memcpy(pairs, iprm.src, size*sizeof *pairs);
+  free(bound);
+  free(tmp);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/***************         High-level functions      ******************/
+/*********************************************************************/
+/* Sort the given array in place. */
+void
+gal_sort_array(void *array, uint8_t type, size_t size, int decreasing,
+               size_t numthreads)
+{
+  size_t nonan;
+
+  /* Move all NaNs to the end, and only sort the rest. */
+  if(size<2) return;
+  nonan=sort_nan_to_end(array, type, size);
+  if(nonan<2) return;
+
+  /* Only check the number of threads when it may be used. */
+  if(numthreads==0)
+    numthreads = nonan>=GAL_SORT_PARALLEL_MIN ? gal_threads_number() : 1;
+
+  /* Convert the values to keys, sort them and convert them back. */
+  sort_keys(array, type, nonan, decreasing, 0);
+  sort_radix(array, gal_type_sizeof(type), nonan, numthreads);
+  sort_keys(array, type, nonan, decreasing, 1);
+}
+
+
+
+
+
+/* Sort the indexs in 'index' (that are within 'values') based on their
+   values. */
+#define SORT_INDEX_KEYS(IT, UT, KIND) {                                 \
+    IT *v=values;                                                       \
+    UT k, sign=(UT)1<<(8*sizeof(UT)-1);                                 \
+    for(i=0;i<size;++i)                                                 \
+      {                                                                 \
+        pairs[i].index=index[i];                                        \
+        if( v[index[i]]!=v[index[i]] )       /* Only true for NaN. */ \
+          pairs[i].key=UINT64_MAX;                                      \
+        else                                                            \
+          {                                                             \
+            memcpy(&k, &v[index[i]], sizeof k);                         \
+            if(KIND==SORT_KIND_FLOAT)                                   \
+              k = (k & sign) ? (UT)~k : (k | sign);                     \
+            else if(KIND==SORT_KIND_SIGNED) k ^= sign;                  \
+            pairs[i].key = decreasing ? ~(uint64_t)k : k;               \
+          }                                                             \
+      }                                                                 \
+  }
+void
+gal_sort_index(size_t *index, size_t size, void *values, uint8_t type,
+               int decreasing, size_t numthreads)
+{
+  size_t i;
+  struct sort_pair *pairs;
+
+  /* Basic checks. */
+  if(size<2) return;
+  if(numthreads==0)
+    numthreads = size>=GAL_SORT_PARALLEL_MIN ? gal_threads_number() : 1;
+
+  /* Allocate the pairs. */
+  errno=0;
+  pairs=malloc(size*sizeof *pairs);
+  if(pairs==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'pairs'",
+          __func__, size*sizeof *pairs);
+
+  /* Fill the keys. The key of NaN values is larger than all other keys
+     (in both increasing and decreasing sorts), because the largest
+     possible key of a non-NaN floating point (infinity) has zero valued
+     lower bits. */
+  switch(type)
+    {
+    case GAL_TYPE_UINT8:
+      SORT_INDEX_KEYS(uint8_t,  uint8_t,  SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT8:
+      SORT_INDEX_KEYS(int8_t,   uint8_t,  SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_UINT16:
+      SORT_INDEX_KEYS(uint16_t, uint16_t, SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT16:
+      SORT_INDEX_KEYS(int16_t,  uint16_t, SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_UINT32:
+      SORT_INDEX_KEYS(uint32_t, uint32_t, SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT32:
+      SORT_INDEX_KEYS(int32_t,  uint32_t, SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_UINT64:
+      SORT_INDEX_KEYS(uint64_t, uint64_t, SORT_KIND_UNSIGNED); break;
+    case GAL_TYPE_INT64:
+      SORT_INDEX_KEYS(int64_t,  uint64_t, SORT_KIND_SIGNED);   break;
+    case GAL_TYPE_FLOAT32:
+      SORT_INDEX_KEYS(float,    uint32_t, SORT_KIND_FLOAT);    break;
+    case GAL_TYPE_FLOAT64:
+      SORT_INDEX_KEYS(double,   uint64_t, SORT_KIND_FLOAT);    break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+            __func__, type);
+    }
+
+  /* Sort the pairs and write the sorted indexs. */
+  sort_index_pairs(pairs, size, numthreads);
+  for(i=0;i<size;++i) index[i]=pairs[i].index;
+
+  /* Clean up. */
+  free(pairs);
+}
@@ -35,7 +35,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/tile.h>
 #include <gnuastro/fits.h>
 #include <gnuastro/blank.h>
-#include <gnuastro/qsort.h>
+#include <gnuastro/sort.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/arithmetic.h>
 #include <gnuastro/statistics.h>
@@ -51,6 +51,170 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 
 
+/****************************************************************
+ ********                   Selection                     *******
+ ****************************************************************/
+/* Many statistics (for example the median or a quantile) only need the
+   element that would be at a certain index if the dataset was sorted. To
+   find it, there is no need to sort the full dataset: with selection
+   (Hoare's "quickselect"), the dataset is only partially sorted around the
+   desired index in O(n) operations (on average). To avoid the O(n^2) worst
+   case, the range is fully sorted when the partitioning doesn't converge
+   fast enough (this is known as "introselect").
+
+   After selecting index 'k' within the range 'lo' to 'hi' (inclusive),
+   'k' has the element that would be there if the range was sorted
+   (increasing): no element before it is larger, and no element after it
+   is smaller. */
+#define STATISTICS_SELECT(IT) {                                         \
+    IT t, pivot, *a=data->array;                                        \
+    size_t i, j, m, depth=2;                                            \
+                                                                        \
+    /* Maximum number of partitions: twice the base-2 logarithm. */     \
+    for(i=hi-lo+1; i>1; i/=2) depth+=2;                                 \
+                                                                        \
+    /* Partition until the range only contains 'k'. */                  \
+    while(hi>lo)                                                        \
+      {                                                                 \
+        /* Partitioning isn't converging: sort the remaining range. */  \
+        if(depth--==0)                                                  \
+          { gal_sort_array(a+lo, data->type, hi-lo+1, 0, 1); break; }   \
+                                                                        \
+        /* The pivot is the median of the first, middle and last */     \
+        /* elements. After this, 'a[lo]<=pivot<=a[hi]', so the scans */ \
+        /* below will not go out of the range. */                       \
+        m=lo+(hi-lo)/2;                                                 \
+        if(a[m] <a[lo]) { t=a[m];  a[m]=a[lo];  a[lo]=t; }              \
+        if(a[hi]<a[lo]) { t=a[hi]; a[hi]=a[lo]; a[lo]=t; }              \
+        if(a[hi]<a[m])  { t=a[hi]; a[hi]=a[m];  a[m]=t;  }              \
+        pivot=a[m];                                                     \
+                                                                        \
+        /* Hoare partitioning: after it, all elements up to 'j' are */  \
+        /* smaller or equal to the pivot and all elements from 'i' */   \
+        /* are larger or equal (those in between are equal to it). */  \
+        i=lo; j=hi;                                                     \
+        do                                                              \
+          {                                                             \
+            while(a[i]<pivot) ++i;                                      \
+            while(pivot<a[j]) --j;                                      \
+            if(i<=j)                                                    \
+              {                                                         \
+                t=a[i]; a[i]=a[j]; a[j]=t;                              \
+                ++i; if(j) --j;                                         \
+              }                                                         \
+          }                                                             \
+        while(i<=j);                                                    \
+                                                                        \
+        /* Continue with the part that contains 'k'. */                 \
+        if(k<=j)      hi=j;                                             \
+        else if(k>=i) lo=i;                                             \
+        else          break;                                            \
+      }                                                                 \
+  }
+static void
+statistics_select(gal_data_t *data, size_t lo, size_t hi, size_t k)
+{
+  switch(data->type)
+    {
+    case GAL_TYPE_UINT8:
+      STATISTICS_SELECT( uint8_t  );  break;
+    case GAL_TYPE_INT8:
+      STATISTICS_SELECT( int8_t   );  break;
+    case GAL_TYPE_UINT16:
+      STATISTICS_SELECT( uint16_t );  break;
+    case GAL_TYPE_INT16:
+      STATISTICS_SELECT( int16_t  );  break;
+    case GAL_TYPE_UINT32:
+      STATISTICS_SELECT( uint32_t );  break;
+    case GAL_TYPE_INT32:
+      STATISTICS_SELECT( int32_t  );  break;
+    case GAL_TYPE_UINT64:
+      STATISTICS_SELECT( uint64_t );  break;
+    case GAL_TYPE_INT64:
+      STATISTICS_SELECT( int64_t  );  break;
+    case GAL_TYPE_FLOAT32:
+      STATISTICS_SELECT( float    );  break;
+    case GAL_TYPE_FLOAT64:
+      STATISTICS_SELECT( double   );  break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+            __func__, data->type);
+    }
+}
+
+
+
+
+
+/* Select all the indexs in 'ks' (that are sorted and within the range
+   'lo' to 'hi'). The middle index is selected first, so the smaller and
+   larger indexs only need to be searched on one side of it. */
+static void
+statistics_select_multi(gal_data_t *data, size_t lo, size_t hi,
+                        size_t *ks, size_t nk)
+{
+  size_t m=nk/2;
+
+  if(nk==0) return;
+  statistics_select(data, lo, hi, ks[m]);
+  if(m)      statistics_select_multi(data, lo, ks[m], ks, m);
+  if(m+1<nk) statistics_select_multi(data, ks[m], hi, ks+m+1, nk-m-1);
+}
+
+
+
+
+
+/* Return a contiguous dataset without blank values for the statistics
+   that can be found by selection. If the input is already sorted (and has
+   no blank values), it is returned and 'sorted' will be 1 (the values can
+   be read directly). Otherwise, the returned dataset can be modified: it
+   is the input itself only when 'inplace' is non-zero and the input is
+   not a tile. */
+static gal_data_t *
+statistics_no_blank_select(gal_data_t *input, int inplace, int *sorted)
+{
+  gal_data_t *out;
+
+  /* Empty or already sorted without blanks. */
+  if( input->size==0
+      || ( input->block==NULL
+           && gal_blank_present(input, 1)==0
+           && gal_statistics_is_sorted(input, 1) ) )
+    { *sorted=1; return input; }
+
+  /* Copy the input if necessary (the copy of a tile is contiguous) and
+     remove the blank values. */
+  *sorted=0;
+  out = inplace && input->block==NULL ? input : gal_data_copy(input);
+  if( gal_blank_present(out, 1) ) gal_blank_remove(out);
+
+  /* The order of the elements will change, so the sorted flags are no
+     longer valid. */
+  out->flag &= ~( GAL_DATA_FLAG_SORT_CH | GAL_DATA_FLAG_SORTED_I
+                  | GAL_DATA_FLAG_SORTED_D );
+  return out;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /****************************************************************
  ********               Simple statistics                 *******
  ****************************************************************/
@@ -360,21 +524,72 @@ statistics_median_in_sorted_no_blank(gal_data_t *sorted, void *median)
 
 
 
+/* Similar to 'statistics_median_in_sorted_no_blank', but the input isn't
+   sorted (its elements will be re-ordered). When the number of elements
+   is even, after selecting the element at 'n/2', the other middle element
+   is the largest element before it. */
+#define MED_SELECT(IT) {                                                \
+    IT m, *a=nb->array, *b, *bf=a+n/2;                                  \
+    if(n%2) *(IT *)median=a[n/2];                                       \
+    else                                                                \
+      {                                                                 \
+        m=*(b=a); while(++b<bf) if(*b>m) m=*b;                          \
+        *(IT *)median=(a[n/2]+m)/2;                                     \
+      }                                                                 \
+  }
+static void
+statistics_median_select(gal_data_t *nb, void *median)
+{
+  size_t n=nb->size;
+
+  /* Do the processing if there are actually any elements. */
+  if(n)
+    {
+      statistics_select(nb, 0, n-1, n/2);
+      switch(nb->type)
+        {
+        case GAL_TYPE_UINT8:     MED_SELECT( uint8_t  );    break;
+        case GAL_TYPE_INT8:      MED_SELECT( int8_t   );    break;
+        case GAL_TYPE_UINT16:    MED_SELECT( uint16_t );    break;
+        case GAL_TYPE_INT16:     MED_SELECT( int16_t  );    break;
+        case GAL_TYPE_UINT32:    MED_SELECT( uint32_t );    break;
+        case GAL_TYPE_INT32:     MED_SELECT( int32_t  );    break;
+        case GAL_TYPE_UINT64:    MED_SELECT( uint64_t );    break;
+        case GAL_TYPE_INT64:     MED_SELECT( int64_t  );    break;
+        case GAL_TYPE_FLOAT32:   MED_SELECT( float    );    break;
+        case GAL_TYPE_FLOAT64:   MED_SELECT( double   );    break;
+        default:
+          error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+                __func__, nb->type);
+        }
+    }
+  else
+    gal_blank_write(median, nb->type);
+}
+
+
+
+
+
 /* Return the median value of the dataset in the same type as the input as
    a one element dataset. If the 'inplace' flag is set, the input data
-   structure will be modified: it will have no blank values and will be
-   sorted (increasing). */
+   structure will be modified: it will have no blank values and its
+   elements will be re-ordered (but not necessarily sorted). */
 gal_data_t *
 gal_statistics_median(gal_data_t *input, int inplace)
 {
+  int sorted;
   size_t dsize=1;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);;
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &sorted);
   gal_data_t *out=gal_data_alloc(NULL, nbs->type, 1, &dsize, NULL, 1, -1,
                                  1, NULL, NULL, NULL);
 
   /* Write the median. */
   if(nbs->size)
-    statistics_median_in_sorted_no_blank(nbs, out->array);
+    {
+      if(sorted) statistics_median_in_sorted_no_blank(nbs, out->array);
+      else       statistics_median_select(nbs, out->array);
+    }
   else
     gal_blank_write(out->array, out->type);
 
@@ -428,17 +643,18 @@ gal_data_t *
 gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
 {
   void *blank;
-  int increasing;
   size_t dsize=1, index;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  int sorted, increasing;
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &sorted);
   gal_data_t *out=gal_data_alloc(NULL, nbs->type, 1, &dsize,
                                  NULL, 1, -1, 1, NULL, NULL, NULL);
 
   /* Only continue processing if there are non-blank elements. */
   if(nbs->size)
     {
-      /* Set the increasing value. */
-      increasing = nbs->flag & GAL_DATA_FLAG_SORTED_I;
+      /* Set the increasing value (after selection, the element at the
+         index is the same as an increasing sorted array). */
+      increasing = sorted ? nbs->flag & GAL_DATA_FLAG_SORTED_I : 1;
 
       /* Find the index of the quantile, note that if it sorted in
          decreasing order, then we'll need to get the index of the inverse
@@ -456,9 +672,12 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
           free(blank);
         }
       else
-        memcpy(out->array,
-               gal_pointer_increment(nbs->array, index, nbs->type),
-               gal_type_sizeof(nbs->type));
+        {
+          if(!sorted) statistics_select(nbs, 0, nbs->size-1, index);
+          memcpy(out->array,
+                 gal_pointer_increment(nbs->array, index, nbs->type),
+                 gal_type_sizeof(nbs->type));
+        }
     }
   else
     gal_blank_write(out->array, out->type);
@@ -472,6 +691,81 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
 
 
 
+/* Return the values at all the given quantiles (a dataset that will be
+   converted to 'float64' if necessary) as a dataset with the same type as
+   the input. All the quantiles are found together by selection, so it is
+   much faster than calling 'gal_statistics_quantile' for each one (which
+   may need to copy and re-order the input each time). */
+gal_data_t *
+gal_statistics_quantiles(gal_data_t *input, gal_data_t *quantiles,
+                         int inplace)
+{
+  double *q;
+  int sorted;
+  gal_data_t *qs;
+  size_t i, j, t, nq, *ind, *ord;
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &sorted);
+  gal_data_t *out=gal_data_alloc(NULL, nbs->type, 1, &quantiles->size,
+                                 NULL, 0, -1, 1, NULL, NULL, NULL);
+
+  /* If there are no non-blank elements, all the outputs are blank. */
+  nq=quantiles->size;
+  if(nbs->size==0 || nq==0)
+    {
+      gal_blank_initialize(out);
+      if(nbs!=input) gal_data_free(nbs);
+      return out;
+    }
+
+  /* Get the index of each quantile (for a decreasing sorted array, we
+     need the index of the inverse quantile). */
+  qs = ( quantiles->type==GAL_TYPE_FLOAT64
+         ? quantiles
+         : gal_data_copy_to_new_type(quantiles, GAL_TYPE_FLOAT64) );
+  q=qs->array;
+  ind=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2*nq, 0, __func__, "ind");
+  ord=ind+nq;
+  for(i=0;i<nq;++i)
+    {
+      ind[i]=gal_statistics_quantile_index(nbs->size,
+                                           ( sorted
+                                             && (nbs->flag
+                                                 & GAL_DATA_FLAG_SORTED_D)
+                                             ? 1.0f - q[i]
+                                             : q[i] ) );
+      ord[i]=ind[i];
+    }
+
+  /* Select all the indexs together (they need to be sorted, the number
+     of quantiles is usually small, so an insertion sort is enough). */
+  if(!sorted)
+    {
+      for(i=1;i<nq;++i)
+        {
+          t=ord[i];
+          for(j=i; j>0 && ord[j-1]>t; --j) ord[j]=ord[j-1];
+          ord[j]=t;
+        }
+      statistics_select_multi(nbs, 0, nbs->size-1, ord, nq);
+    }
+
+  /* Write the values into the output. */
+  for(i=0;i<nq;++i)
+    memcpy(gal_pointer_increment(out->array, i, out->type),
+           gal_pointer_increment(nbs->array, ind[i], nbs->type),
+           gal_type_sizeof(nbs->type));
+
+  /* Clean up and return. */
+  free(ind);
+  if(qs!=quantiles) gal_data_free(qs);
+  if(nbs!=input) gal_data_free(nbs);
+  return out;
+}
+
+
+
+
+
 /* Return the index of the (first) point in the sorted dataset that has the
    closest value to 'value' (which has to be the same type as the 'input'
    dataset). */
@@ -507,14 +801,33 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
     /* Set the difference if the value is actually in the range. */     \
     if(parsed && a<af) index = a-r;                                     \
   }
+
+/* When the dataset isn't sorted, there is no need to sort it: the index
+   (in the sorted array) of the element closest to the value is the number
+   of elements that are smaller or equal to it (or one less). So we just
+   need to count them and find the nearest elements on each side. */
+#define STATS_QFUNC_IND_UNSORTED(IT) {                                  \
+    size_t nle=0, ngt=0;                                                \
+    IT *a=nbs->array, *af=a+nbs->size, v=*((IT *)(value->array));       \
+    IT le=v, gt=v;                                                      \
+    do                                                                  \
+      if(*a<=v) { if(nle++==0 || *a>le) le=*a; }                        \
+      else      { if(ngt++==0 || *a<gt) gt=*a; }                        \
+    while(++a<af);                                                      \
+    if(nle && ngt) index = v - le < gt - v ? nle-1 : nle;               \
+  }
+#define STATS_QFUNC_IND_ALL(IT) {                                       \
+    if(sorted) STATS_QFUNC_IND(IT)                                      \
+    else       STATS_QFUNC_IND_UNSORTED(IT)                             \
+  }
 size_t
 gal_statistics_quantile_function_index(gal_data_t *input,
                                        gal_data_t *invalue, int inplace)
 {
-  int parsed=0;
   gal_data_t *value;
+  int parsed=0, sorted;
   size_t index=GAL_BLANK_SIZE_T;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &sorted);
 
   /* Make sure the value has the same type. */
   if(invalue->size>1)
@@ -529,16 +842,16 @@ gal_statistics_quantile_function_index(gal_data_t *input,
     /* Find the result: */
     switch(nbs->type)
       {
-      case GAL_TYPE_UINT8:     STATS_QFUNC_IND( uint8_t  );     break;
-      case GAL_TYPE_INT8:      STATS_QFUNC_IND( int8_t   );     break;
-      case GAL_TYPE_UINT16:    STATS_QFUNC_IND( uint16_t );     break;
-      case GAL_TYPE_INT16:     STATS_QFUNC_IND( int16_t  );     break;
-      case GAL_TYPE_UINT32:    STATS_QFUNC_IND( uint32_t );     break;
-      case GAL_TYPE_INT32:     STATS_QFUNC_IND( int32_t  );     break;
-      case GAL_TYPE_UINT64:    STATS_QFUNC_IND( uint64_t );     break;
-      case GAL_TYPE_INT64:     STATS_QFUNC_IND( int64_t  );     break;
-      case GAL_TYPE_FLOAT32:   STATS_QFUNC_IND( float    );     break;
-      case GAL_TYPE_FLOAT64:   STATS_QFUNC_IND( double   );     break;
+      case GAL_TYPE_UINT8:     STATS_QFUNC_IND_ALL( uint8_t  );  break;
+      case GAL_TYPE_INT8:      STATS_QFUNC_IND_ALL( int8_t   );  break;
+      case GAL_TYPE_UINT16:    STATS_QFUNC_IND_ALL( uint16_t );  break;
+      case GAL_TYPE_INT16:     STATS_QFUNC_IND_ALL( int16_t  );  break;
+      case GAL_TYPE_UINT32:    STATS_QFUNC_IND_ALL( uint32_t );  break;
+      case GAL_TYPE_INT32:     STATS_QFUNC_IND_ALL( int32_t  );  break;
+      case GAL_TYPE_UINT64:    STATS_QFUNC_IND_ALL( uint64_t );  break;
+      case GAL_TYPE_INT64:     STATS_QFUNC_IND_ALL( int64_t  );  break;
+      case GAL_TYPE_FLOAT32:   STATS_QFUNC_IND_ALL( float    );  break;
+      case GAL_TYPE_FLOAT64:   STATS_QFUNC_IND_ALL( double   );  break;
       default:
         error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
               __func__, nbs->type);
@@ -560,12 +873,18 @@ gal_statistics_quantile_function_index(gal_data_t *input,
 
 
 
-/* Return the quantile function of the given value as float64. */
+/* Return the quantile function of the given value as float64. When the
+   dataset isn't sorted, the value is outside the range of the dataset, so
+   it is enough to compare it with any element. */
 #define STATS_QFUNC(IT) {                                               \
     IT *a=nbs->array, v=*((IT *)(value->array));                        \
                                                                         \
+    /* Unsorted array. */                                               \
+    if(!sorted)                                                         \
+      d[0] = v<*a ? -INFINITY : INFINITY;                               \
+                                                                        \
     /* Increasing array: */                                             \
-    if( *a < *(a+1) )                                                   \
+    else if( *a < *(a+1) )                                              \
       d[0] = v<*a ? -INFINITY : INFINITY;                               \
                                                                         \
     /* Decreasing array. */                                             \
@@ -573,23 +892,32 @@ gal_statistics_quantile_function_index(gal_data_t *input,
       d[0] = v>*a ? INFINITY : -INFINITY;                               \
   }
 gal_data_t *
-gal_statistics_quantile_function(gal_data_t *input, gal_data_t *value,
+gal_statistics_quantile_function(gal_data_t *input, gal_data_t *invalue,
                                  int inplace)
 {
   double *d;
+  int sorted;
+  gal_data_t *value;
   size_t ind, dsize=1;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &sorted);
   gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &dsize,
                                  NULL, 1, -1, 1, NULL, NULL, NULL);
 
   /* Sanity checks. */
-  if(value->size>1)
+  if(invalue->size>1)
     error(EXIT_FAILURE, 0, "%s: the 'value' argument must only have "
           "one element", __func__);
 
-  /* Calculate the index of the value. */
-  ind=gal_statistics_quantile_function_index(input, value, inplace);
-  //printf("ind: %zu (%zu)\n", ind, input->size);
+  /* Make sure the value has the same type. */
+  value = ( (nbs->type==invalue->type)
+            ? invalue
+            : gal_data_copy_to_new_type(invalue, nbs->type) );
+
+  /* Calculate the index of the value ('nbs' has no blank values and can
+     be modified, so it doesn't need to be copied again). */
+  ind = ( nbs->size
+          ? gal_statistics_quantile_function_index(nbs, value, 1)
+          : GAL_BLANK_SIZE_T );
 
   /* Only continue processing if there are non-blank values. */
   if(nbs->size)
@@ -625,6 +953,7 @@ gal_statistics_quantile_function(gal_data_t *input, gal_data_t *value,
     gal_blank_write(out->array, out->type);
 
   /* Clean up and return. */
+  if(value!=invalue) gal_data_free(value);
   if(nbs!=input) gal_data_free(nbs);
   return out;
 }
@@ -1487,40 +1816,11 @@ gal_statistics_is_sorted(gal_data_t *input, int updateflags)
 
 /* This function is ignorant to blank values, if you want to make sure
    there is no blank values, you can call 'gal_blank_remove' first. */
-#define STATISTICS_SORT(QSORT_F) {                                      \
-    qsort(input->array, input->size, gal_type_sizeof(input->type), QSORT_F); \
-  }
 void
 gal_statistics_sort_increasing(gal_data_t *input)
 {
-  /* Do the sorting. */
-  if(input->size)
-    switch(input->type)
-      {
-      case GAL_TYPE_UINT8:
-        STATISTICS_SORT(gal_qsort_uint8_i);    break;
-      case GAL_TYPE_INT8:
-        STATISTICS_SORT(gal_qsort_int8_i);     break;
-      case GAL_TYPE_UINT16:
-        STATISTICS_SORT(gal_qsort_uint16_i);   break;
-      case GAL_TYPE_INT16:
-        STATISTICS_SORT(gal_qsort_int16_i);    break;
-      case GAL_TYPE_UINT32:
-        STATISTICS_SORT(gal_qsort_uint32_i);   break;
-      case GAL_TYPE_INT32:
-        STATISTICS_SORT(gal_qsort_int32_i);    break;
-      case GAL_TYPE_UINT64:
-        STATISTICS_SORT(gal_qsort_uint64_i);   break;
-      case GAL_TYPE_INT64:
-        STATISTICS_SORT(gal_qsort_int64_i);    break;
-      case GAL_TYPE_FLOAT32:
-        STATISTICS_SORT(gal_qsort_float32_i);  break;
-      case GAL_TYPE_FLOAT64:
-        STATISTICS_SORT(gal_qsort_float64_i);  break;
-      default:
-        error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
-              __func__, input->type);
-      }
+  /* Do the sorting (on the caller's thread). */
+  gal_sort_array(input->array, input->type, input->size, 0, 1);
 
   /* Set the flags. */
   input->flag |=  GAL_DATA_FLAG_SORT_CH;
@@ -1537,33 +1837,7 @@ void
 gal_statistics_sort_decreasing(gal_data_t *input)
 {
   /* Do the sorting. */
-  if(input->size)
-    switch(input->type)
-      {
-      case GAL_TYPE_UINT8:
-        STATISTICS_SORT(gal_qsort_uint8_d);    break;
-      case GAL_TYPE_INT8:
-        STATISTICS_SORT(gal_qsort_int8_d);     break;
-      case GAL_TYPE_UINT16:
-        STATISTICS_SORT(gal_qsort_uint16_d);   break;
-      case GAL_TYPE_INT16:
-        STATISTICS_SORT(gal_qsort_int16_d);    break;
-      case GAL_TYPE_UINT32:
-        STATISTICS_SORT(gal_qsort_uint32_d);   break;
-      case GAL_TYPE_INT32:
-        STATISTICS_SORT(gal_qsort_int32_d);    break;
-      case GAL_TYPE_UINT64:
-        STATISTICS_SORT(gal_qsort_uint64_d);   break;
-      case GAL_TYPE_INT64:
-        STATISTICS_SORT(gal_qsort_int64_d);    break;
-      case GAL_TYPE_FLOAT32:
-        STATISTICS_SORT(gal_qsort_float32_d);  break;
-      case GAL_TYPE_FLOAT64:
-        STATISTICS_SORT(gal_qsort_float64_d);  break;
-      default:
-        error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
-              __func__, input->type);
-      }
+  gal_sort_array(input->array, input->type, input->size, 1, 1);
 
   /* Set the flags. */
   input->flag |=  GAL_DATA_FLAG_SORT_CH;
@@ -2284,10 +2558,13 @@ gal_statistics_cfp(gal_data_t *input, gal_data_t *bins, int normalize)
      - 2: Mean.
      - 3: Standard deviation.
 
-  The way this function works is very simple: first it will sort the input
-  (if it isn't sorted). Afterwards, it will recursively change the starting
-  point of the array and its size, calcluating the basic statistics in each
-  round to define the new starting point and size.
+  The way this function works is very simple: if the input is sorted, it
+  will recursively change the starting point of the array and its size,
+  calcluating the basic statistics in each round to define the new
+  starting point and size. Otherwise, there is no need to sort it: in each
+  round, the median is found by selection and the elements that are
+  within the range are moved to the start of the same buffer (so the next
+  round only has to look into them).
 */
 #define SIGCLIP(IT) {                                                   \
     IT *a  = nbs->array, *af = a  + nbs->size;                          \
@@ -2314,19 +2591,32 @@ gal_statistics_cfp(gal_data_t *input, gal_data_t *bins, int normalize)
       while(--b>=bf);                                                   \
   }
 
+/* For an unsorted array: swap the elements within the range to the start
+   of the array. Since the elements are only swapped, none of the input's
+   values are lost. */
+#define SIGCLIP_SELECT(IT) {                                            \
+    IT t, *a = nbs->array, *af = a + nbs->size, *b = a;                 \
+    do if( *a > (*med - (multip * *std))                                \
+           && *a < (*med + (multip * *std)) )                           \
+         { t=*b; *b++=*a; *a=t; }                                       \
+    while(++a<af);                                                      \
+    if(b>(IT *)(nbs->array)) size=b-(IT *)(nbs->array);                 \
+  }
+
 gal_data_t *
 gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
                           int inplace, int quiet)
 {
+  int sorted;
   float *oa;
   void *start, *nbs_array;
   double *med, *mean, *std;
   uint8_t type=gal_tile_block(input)->type;
   uint8_t bytolerance = param>=1.0f ? 0 : 1;
   double oldmed=NAN, oldmean=NAN, oldstd=NAN;
-  size_t num=0, one=1, four=4, size, oldsize;
+  size_t num=0, one=1, four=4, size, oldsize, nbs_size;
   gal_data_t *fcopy, *median_i, *median_d, *out, *meanstd;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &sorted);
   size_t maxnum = param>=1.0f ? param : GAL_STATISTICS_SIG_CLIP_MAX_CONVERGE;
 
   /* Some sanity checks. */
@@ -2340,11 +2630,12 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
     error(EXIT_FAILURE, 0, "%s: when 'param' is larger than 1.0, it is "
           "interpretted as an absolute number of clips. So it must be an "
           "integer. However, your given value %g", __func__, param);
-  if( (nbs->flag & GAL_DATA_FLAG_SORT_CH)==0 )
+  if( sorted && nbs->size && (nbs->flag & GAL_DATA_FLAG_SORT_CH)==0 )
     error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix the "
           "problem. 'nbs->flag', doesn't have the 'GAL_DATA_FLAG_SORT_CH' "
           "bit activated", __func__, PACKAGE_BUGREPORT);
-  if( (nbs->flag & GAL_DATA_FLAG_SORTED_I)==0
+  if( sorted && nbs->size
+      && (nbs->flag & GAL_DATA_FLAG_SORTED_I)==0
       && (nbs->flag & GAL_DATA_FLAG_SORTED_D)==0 )
     error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix the "
           "problem. 'nbs' isn't sorted", __func__, PACKAGE_BUGREPORT);
@@ -2359,6 +2650,7 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
 
   /* Only continue processing if we have non-blank elements. */
   oa=out->array;
+  nbs_size=nbs->size;
   nbs_array=nbs->array;
   switch(nbs->size)
     {
@@ -2424,7 +2716,9 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
 
           /* Find the mean, median and standard deviation. */
           meanstd=gal_statistics_mean_std(nbs);
-          statistics_median_in_sorted_no_blank(nbs, median_i->array);
+          if(sorted) statistics_median_in_sorted_no_blank(nbs,
+                                                          median_i->array);
+          else       statistics_median_select(nbs, median_i->array);
           median_d=gal_data_copy_to_new_type(median_i, GAL_TYPE_FLOAT64);
 
           /* Put them in usable (with a type) pointers. */
@@ -2455,25 +2749,43 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
                 break;
               }
 
-          /* Clip all the elements outside of the desired range: since the
+          /* Clip all the elements outside of the desired range: if the
              array is sorted, this means to just change the starting
              pointer and size of the array. */
-          switch(type)
-            {
-            case GAL_TYPE_UINT8:     SIGCLIP( uint8_t  );   break;
-            case GAL_TYPE_INT8:      SIGCLIP( int8_t   );   break;
-            case GAL_TYPE_UINT16:    SIGCLIP( uint16_t );   break;
-            case GAL_TYPE_INT16:     SIGCLIP( int16_t  );   break;
-            case GAL_TYPE_UINT32:    SIGCLIP( uint32_t );   break;
-            case GAL_TYPE_INT32:     SIGCLIP( int32_t  );   break;
-            case GAL_TYPE_UINT64:    SIGCLIP( uint64_t );   break;
-            case GAL_TYPE_INT64:     SIGCLIP( int64_t  );   break;
-            case GAL_TYPE_FLOAT32:   SIGCLIP( float    );   break;
-            case GAL_TYPE_FLOAT64:   SIGCLIP( double   );   break;
-            default:
-              error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
-                    __func__, type);
-            }
+          if(sorted)
+            switch(type)
+              {
+              case GAL_TYPE_UINT8:     SIGCLIP( uint8_t  );   break;
+              case GAL_TYPE_INT8:      SIGCLIP( int8_t   );   break;
+              case GAL_TYPE_UINT16:    SIGCLIP( uint16_t );   break;
+              case GAL_TYPE_INT16:     SIGCLIP( int16_t  );   break;
+              case GAL_TYPE_UINT32:    SIGCLIP( uint32_t );   break;
+              case GAL_TYPE_INT32:     SIGCLIP( int32_t  );   break;
+              case GAL_TYPE_UINT64:    SIGCLIP( uint64_t );   break;
+              case GAL_TYPE_INT64:     SIGCLIP( int64_t  );   break;
+              case GAL_TYPE_FLOAT32:   SIGCLIP( float    );   break;
+              case GAL_TYPE_FLOAT64:   SIGCLIP( double   );   break;
+              default:
+                error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+                      __func__, type);
+              }
+          else
+            switch(type)
+              {
+              case GAL_TYPE_UINT8:     SIGCLIP_SELECT( uint8_t  );  break;
+              case GAL_TYPE_INT8:      SIGCLIP_SELECT( int8_t   );  break;
+              case GAL_TYPE_UINT16:    SIGCLIP_SELECT( uint16_t );  break;
+              case GAL_TYPE_INT16:     SIGCLIP_SELECT( int16_t  );  break;
+              case GAL_TYPE_UINT32:    SIGCLIP_SELECT( uint32_t );  break;
+              case GAL_TYPE_INT32:     SIGCLIP_SELECT( int32_t  );  break;
+              case GAL_TYPE_UINT64:    SIGCLIP_SELECT( uint64_t );  break;
+              case GAL_TYPE_INT64:     SIGCLIP_SELECT( int64_t  );  break;
+              case GAL_TYPE_FLOAT32:   SIGCLIP_SELECT( float    );  break;
+              case GAL_TYPE_FLOAT64:   SIGCLIP_SELECT( double   );  break;
+              default:
+                error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+                      __func__, type);
+              }
 
           /* Set the values from this round in the old elements, so the
              next round can compare with, and return then if necessary. */
@@ -2502,6 +2814,7 @@ gal_statistics_sigma_clip(gal_data_t *input, float multip, float param,
     }
 
   /* Clean up and return. */
+  nbs->size=nbs_size;
   nbs->array=nbs_array;
   gal_data_free(median_i);
   if(nbs!=input) gal_data_free(nbs);
@@ -484,11 +484,31 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
                gal_list_str_t *cols, int searchin, int ignorecase,
                size_t numthreads, size_t minmapsize, int quietmmap,
                size_t *colmatch)
+{
+  return gal_table_read_select(filename, hdu, lines, cols, searchin,
+                               ignorecase, NULL, NULL, numthreads,
+                               minmapsize, quietmmap, colmatch);
+}
+
+
+
+
+
+/* Similar to 'gal_table_read', but only keep the rows that are not
+   flagged by 'select' (if it isn't NULL). For FITS tables, the selection
+   is done while the table is being read (on blocks of rows in parallel),
+   so the full columns are never kept in memory. */
+gal_data_t *
+gal_table_read_select(char *filename, char *hdu, gal_list_str_t *lines,
+                      gal_list_str_t *cols, int searchin, int ignorecase,
+                      void (*select)(gal_data_t *, gal_data_t *, void *),
+                      void *selectparams, size_t numthreads,
+                      size_t minmapsize, int quietmmap, size_t *colmatch)
 {
   int tableformat;
   gal_list_sizet_t *indexll;
   size_t i, numcols, numrows;
-  gal_data_t *allcols, *out=NULL;
+  gal_data_t *allcols, *flag, *out=NULL;
 
   /* First get the information of all the columns. */
   allcols=gal_table_info(filename, hdu, lines, &numcols, &numrows,
@@ -508,13 +528,24 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
     {
     case GAL_TABLE_FORMAT_TXT:
       out=gal_txt_table_read(filename, lines, numrows, allcols, indexll,
-                             minmapsize, quietmmap);
+                             numthreads, minmapsize, quietmmap);
+
+      /* Apply the selection on the full table. */
+      if(select && out && out->size)
+        {
+          flag=gal_data_alloc(NULL, GAL_TYPE_UINT8, 1, out->dsize, NULL, 1,
+                              minmapsize, quietmmap, NULL, NULL, NULL);
+          select(out, flag, selectparams);
+          gal_tableintern_rows_remove(out, flag->array);
+          gal_data_free(flag);
+        }
       break;
 
     case GAL_TABLE_FORMAT_AFITS:
     case GAL_TABLE_FORMAT_BFITS:
-      out=gal_fits_tab_read(filename, hdu, numrows, allcols, indexll,
-                            numthreads, minmapsize, quietmmap);
+      out=gal_fits_tab_read_select(filename, hdu, numrows, allcols,
+                                   indexll, select, selectparams,
+                                   numthreads, minmapsize, quietmmap);
       break;
 
     default:
@@ -550,6 +581,7 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
 
 
 
+
 
 /************************************************************************/
 /***************              Write a table               ***************/
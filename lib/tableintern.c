@@ -239,7 +239,7 @@ gal_tableintern_col_print_info(gal_data_t *col, int tableformat,
 {
   size_t j;
   char **strarr;
-  int maxstrlen, width=0, precision=GAL_BLANK_INT;
+  int len, maxstrlen, width=0, precision=GAL_BLANK_INT;
 
 
   /* First do a sanity check, so we can safly stop checking in the steps
@@ -283,8 +283,11 @@ gal_tableintern_col_print_info(gal_data_t *col, int tableformat,
       maxstrlen=0;
       strarr=col->array;
       for(j=0;j<col->size;++j)
-        maxstrlen = ( (int)strlen(strarr[j]) > maxstrlen
-                      ? (int)strlen(strarr[j]) : maxstrlen );
+        {
+          /* NULL strings are printed as '(null)' (see 'gal_txt_write'). */
+          len = strarr[j] ? (int)strlen(strarr[j]) : 6;
+          if(len>maxstrlen) maxstrlen=len;
+        }
       width = col->disp_width>maxstrlen ? col->disp_width : maxstrlen;
       break;
 
@@ -459,3 +462,76 @@ gal_tableintern_read_blank(gal_data_t *col, char *blank)
       col->dsize[0]=col->ndim=col->size=1;
     }
 }
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/************************************************************************/
+/***************              Row selection               ***************/
+/************************************************************************/
+/* Remove the rows of all the columns in the 'cols' list that have a
+   non-zero value in 'flag' (that must have the same number of elements as
+   the rows of the columns). The remaining rows are shifted to the start of
+   each column and its sizes are corrected (the array isn't re-allocated,
+   except for when no rows remain: it will be freed and set to NULL). */
+void
+gal_tableintern_rows_remove(gal_data_t *cols, uint8_t *flag)
+{
+  gal_data_t *col;
+  char *a, **strarr;
+  size_t i, num, width, rowsize, nrows;
+
+  for(col=cols; col!=NULL; col=col->next)
+    {
+      /* Basic properties. */
+      num=0;
+      nrows=col->dsize[0];
+      width = col->ndim==2 ? col->dsize[1] : 1;
+      rowsize = width * gal_type_sizeof(col->type);
+
+      /* Shift the rows that should be kept. */
+      if(col->type==GAL_TYPE_STRING)
+        {
+          strarr=col->array;
+          for(i=0;i<nrows;++i)
+            if(flag[i]) { free(strarr[i]); strarr[i]=NULL; }
+            else        strarr[num++]=strarr[i];
+        }
+      else
+        {
+          a=col->array;
+          for(i=0;i<nrows;++i)
+            if(flag[i]==0)
+              {
+                if(num!=i) memcpy(a+num*rowsize, a+i*rowsize, rowsize);
+                ++num;
+              }
+        }
+
+      /* Correct the sizes. */
+      col->dsize[0]=num;
+      col->size=num*width;
+      if(num==0 && col->array && col->block==NULL)
+        {
+          if(col->mmapname)
+            gal_pointer_mmap_free(&col->mmapname, col->quietmmap);
+          else free(col->array);
+          col->array=NULL;
+        }
+    }
+}
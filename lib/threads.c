@@ -262,6 +262,643 @@ gal_threads_attr_barrier_init(pthread_attr_t *attr, pthread_barrier_t *b,
 
 
 
+/*******************************************************************/
+/************          Persistent thread pool         **************/
+/*******************************************************************/
+/* Creating new threads (and destroying them) on every call to
+   'gal_threads_spin_off' is expensive when it is called many times within
+   a program (for example on many small tiles). So a single pool of
+   threads is created the first time they are needed and re-used by all
+   later calls in the process.
+
+   Each worker of the pool has its own double-ended queue (deque) of
+   tasks. A worker takes tasks from the bottom (most recent) of its own
+   deque and when its deque is empty, it "steals" tasks from the top
+   (oldest) of the other workers' deques. The thread that submits a job
+   also helps in running the tasks of that job (from any deque) until all
+   of them have finished. This also allows workers to submit new jobs from
+   within a task (nested parallelism) without a dead-lock.
+
+   The pool has one less worker than the number of threads that the
+   caller requests (since the caller also runs tasks). When a job requests
+   a different number of threads while no other job is running, the pool
+   is re-created with the new number of workers. */
+struct threads_pool_job
+{
+  size_t        remaining;  /* Number of tasks that haven't finished.  */
+  pthread_mutex_t   mutex;  /* Mutex to protect 'remaining'.           */
+  pthread_cond_t     done;  /* Signaled when 'remaining' becomes zero. */
+};
+
+struct threads_pool_task
+{
+  void *(*worker)(void *);   /* Function to run.                       */
+  void               *arg;   /* Argument to pass to the function.      */
+  struct threads_pool_job *job; /* Job that this task belongs to.      */
+};
+
+struct threads_pool_deque
+{
+  struct threads_pool_task *tasks; /* Circular array of tasks.         */
+  size_t                     head; /* Index of the top (oldest) task.  */
+  size_t                      num; /* Number of tasks in the deque.    */
+  size_t                     size; /* Allocated size of 'tasks'.       */
+  pthread_mutex_t           mutex; /* Mutex for this deque.            */
+};
+
+struct threads_pool
+{
+  size_t               numworkers; /* Number of threads in the pool.   */
+  pthread_t              *threads; /* Thread IDs of the workers.       */
+  size_t                     *ids; /* Index of each worker.            */
+  struct threads_pool_deque *deques; /* One deque for each worker.     */
+  size_t                  pending; /* Tasks queued but not yet taken.  */
+  size_t                    nextq; /* Next deque for external jobs.    */
+  int                    shutdown; /* Workers should return.           */
+  pthread_mutex_t           mutex; /* Mutex for 'pending' and 'nextq'. */
+  pthread_cond_t             wake; /* Signaled when tasks are queued.  */
+  pthread_key_t               key; /* Pointer to worker's ID in 'ids'. */
+};
+
+/* The single pool of the process and the number of jobs running on it
+   (both protected by 'threads_pool_lock'). */
+static size_t threads_pool_jobs=0;
+static struct threads_pool *threads_pool=NULL;
+static pthread_mutex_t threads_pool_lock=PTHREAD_MUTEX_INITIALIZER;
+
+
+
+
+
+/* Put a task at the bottom of the given deque. */
+static void
+threads_pool_deque_push(struct threads_pool_deque *dq,
+                        struct threads_pool_task *task)
+{
+  size_t i, nsize;
+  struct threads_pool_task *ntasks;
+
+  pthread_mutex_lock(&dq->mutex);
+
+  /* Increase the size of the deque if necessary (while keeping the order
+     of the already queued tasks). */
+  if(dq->num==dq->size)
+    {
+      nsize = dq->size ? 2*dq->size : GAL_THREADS_POOL_DEQUE_MINSIZE;
+      errno=0;
+      ntasks=malloc(nsize*sizeof *ntasks);
+      if(ntasks==NULL)
+        error(EXIT_FAILURE, errno, "%s: %zu bytes for 'ntasks'",
+              __func__, nsize*sizeof *ntasks);
+      for(i=0;i<dq->num;++i)
+        ntasks[i]=dq->tasks[ (dq->head+i) % dq->size ];
+      free(dq->tasks);
+      dq->head=0;
+      dq->size=nsize;
+      dq->tasks=ntasks;
+    }
+
+  /* Put the task at the bottom. */
+  dq->tasks[ (dq->head+dq->num++) % dq->size ] = *task;
+  pthread_mutex_unlock(&dq->mutex);
+}
+
+
+
+
+
+/* Take a task from the bottom (when 'bottom==1') or top of the deque. If
+   the deque is empty, return 0. When 'job' is not NULL, only a task of
+   that job is taken: the first one found from the requested side (the
+   tasks after it are shifted to keep the order). */
+static int
+threads_pool_deque_take(struct threads_pool_deque *dq,
+                        struct threads_pool_task *task, int bottom,
+                        struct threads_pool_job *job)
+{
+  int out=0;
+  size_t i, k;
+
+  pthread_mutex_lock(&dq->mutex);
+  if(dq->num)
+    {
+      if(job)
+        {
+          /* Find the position of the first task of this job (counting
+             from the top). */
+          for(i=0;i<dq->num;++i)
+            {
+              k = bottom ? dq->num-1-i : i;
+              if(dq->tasks[ (dq->head+k) % dq->size ].job==job) break;
+            }
+
+          /* Take it and shift the tasks below it one position up. */
+          if(i<dq->num)
+            {
+              *task=dq->tasks[ (dq->head+k) % dq->size ];
+              for(i=k;i+1<dq->num;++i)
+                dq->tasks[ (dq->head+i) % dq->size ]
+                  = dq->tasks[ (dq->head+i+1) % dq->size ];
+              --dq->num;
+              out=1;
+            }
+        }
+      else
+        {
+          if(bottom)
+            *task=dq->tasks[ (dq->head+dq->num-1) % dq->size ];
+          else
+            {
+              *task=dq->tasks[dq->head];
+              dq->head = (dq->head+1) % dq->size;
+            }
+          --dq->num;
+          out=1;
+        }
+    }
+  pthread_mutex_unlock(&dq->mutex);
+  return out;
+}
+
+
+
+
+
+/* Find a task for the worker with ID 'wid' (which is 'numworkers' when
+   the calling thread is not a worker of the pool): first look into the
+   worker's own deque, then try to steal from the other deques. When
+   'job' is not NULL, only tasks of that job are taken. */
+static int
+threads_pool_take(struct threads_pool *pool, size_t wid,
+                  struct threads_pool_task *task,
+                  struct threads_pool_job *job)
+{
+  size_t i, n=pool->numworkers;
+
+  /* Look in the worker's own deque. */
+  if( wid<n && threads_pool_deque_take(&pool->deques[wid], task, 1, job) )
+    {
+      pthread_mutex_lock(&pool->mutex);
+      --pool->pending;
+      pthread_mutex_unlock(&pool->mutex);
+      return 1;
+    }
+
+  /* Steal from the top of the other deques (starting with the one after
+     this worker to avoid all idle workers going after the same deque). */
+  for(i=1;i<=n;++i)
+    if( threads_pool_deque_take(&pool->deques[(wid+i)%n], task, 0, job) )
+      {
+        pthread_mutex_lock(&pool->mutex);
+        --pool->pending;
+        pthread_mutex_unlock(&pool->mutex);
+        return 1;
+      }
+
+  /* No task could be found. */
+  return 0;
+}
+
+
+
+
+
+/* Run the task and tell its job that it has finished. */
+static void
+threads_pool_run_task(struct threads_pool_task *task)
+{
+  struct threads_pool_job *job=task->job;
+
+  task->worker(task->arg);
+
+  pthread_mutex_lock(&job->mutex);
+  if(--job->remaining==0) pthread_cond_broadcast(&job->done);
+  pthread_mutex_unlock(&job->mutex);
+}
+
+
+
+
+
+/* The function that runs on each thread of the pool. */
+static void *
+threads_pool_worker(void *in)
+{
+  size_t wid=*(size_t *)in;
+  struct threads_pool_task task;
+  struct threads_pool *pool=threads_pool;
+
+  /* Keep the ID of this worker for nested calls. */
+  pthread_setspecific(pool->key, in);
+
+  /* Run tasks until the pool is shut down. */
+  while(1)
+    {
+      /* If a task can be found, run it and look for the next one. */
+      if( threads_pool_take(pool, wid, &task, NULL) )
+        { threads_pool_run_task(&task); continue; }
+
+      /* No task could be found: sleep until new tasks are queued. When
+         'pending' is positive, but no task could be found, another
+         thread is in the middle of queuing its tasks, so we'll just try
+         again. */
+      pthread_mutex_lock(&pool->mutex);
+      while(pool->pending==0 && pool->shutdown==0)
+        pthread_cond_wait(&pool->wake, &pool->mutex);
+      if(pool->pending==0 && pool->shutdown)
+        { pthread_mutex_unlock(&pool->mutex); break; }
+      pthread_mutex_unlock(&pool->mutex);
+    }
+
+  return NULL;
+}
+
+
+
+
+
+/* Create the pool with the given number of worker threads. This should
+   be called while 'threads_pool_lock' is locked and there is no pool. */
+static void
+threads_pool_create(size_t numworkers)
+{
+  int err;
+  size_t i;
+  struct threads_pool *pool;
+
+  /* Allocate the pool's structure. */
+  errno=0;
+  pool=calloc(1, sizeof *pool);
+  if(pool==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'pool'", __func__,
+          sizeof *pool);
+  pool->numworkers=numworkers;
+  errno=0;
+  pool->threads=malloc(pool->numworkers*sizeof *pool->threads);
+  if(pool->threads==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'pool->threads'",
+          __func__, pool->numworkers*sizeof *pool->threads);
+  errno=0;
+  pool->ids=malloc(pool->numworkers*sizeof *pool->ids);
+  if(pool->ids==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'pool->ids'",
+          __func__, pool->numworkers*sizeof *pool->ids);
+  errno=0;
+  pool->deques=calloc(pool->numworkers, sizeof *pool->deques);
+  if(pool->deques==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'pool->deques'",
+          __func__, pool->numworkers*sizeof *pool->deques);
+
+  /* Initialize the mutexes, condition variable and key. */
+  for(i=0;i<pool->numworkers;++i)
+    {
+      pool->ids[i]=i;
+      pthread_mutex_init(&pool->deques[i].mutex, NULL);
+    }
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  err=pthread_key_create(&pool->key, NULL);
+  if(err) error(EXIT_FAILURE, err, "%s: thread key not created", __func__);
+
+  /* The pool has to be globally visible before the workers start. */
+  threads_pool=pool;
+
+  /* Spin-off the workers. */
+  for(i=0;i<pool->numworkers;++i)
+    {
+      err=pthread_create(&pool->threads[i], NULL, threads_pool_worker,
+                         &pool->ids[i]);
+      if(err)
+        error(EXIT_FAILURE, err, "%s: can't create thread %zu", __func__, i);
+    }
+}
+
+
+
+
+
+/* Stop all the workers of the pool (after all queued tasks are finished)
+   and free it. This should be called while 'threads_pool_lock' is
+   locked. */
+static void
+threads_pool_destroy()
+{
+  size_t i;
+  struct threads_pool *pool=threads_pool;
+
+  /* If there is no pool, there is nothing to do. */
+  if(pool==NULL) return;
+
+  /* Tell the workers to return and wait for them. */
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutdown=1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+  for(i=0;i<pool->numworkers;++i)
+    pthread_join(pool->threads[i], NULL);
+
+  /* Clean up. */
+  for(i=0;i<pool->numworkers;++i)
+    {
+      free(pool->deques[i].tasks);
+      pthread_mutex_destroy(&pool->deques[i].mutex);
+    }
+  pthread_key_delete(pool->key);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool->ids);
+  free(pool->deques);
+  free(pool->threads);
+  free(pool);
+  threads_pool=NULL;
+}
+
+
+
+
+
+/* Make sure the pool has 'numworkers' workers and register a new job on
+   it. When no job is running on the pool, a pool with a different number
+   of workers is re-created. Otherwise (for example in nested calls), the
+   existing pool is used. Each call to this function should be followed by
+   a call to 'threads_pool_release' when the job has finished. */
+static struct threads_pool *
+threads_pool_acquire(size_t numworkers)
+{
+  struct threads_pool *pool;
+
+  pthread_mutex_lock(&threads_pool_lock);
+  if( threads_pool_jobs==0
+      && threads_pool
+      && threads_pool->numworkers!=numworkers )
+    threads_pool_destroy();
+  if(threads_pool==NULL) threads_pool_create(numworkers);
+  pool=threads_pool;
+  ++threads_pool_jobs;
+  pthread_mutex_unlock(&threads_pool_lock);
+  return pool;
+}
+
+
+
+
+
+static void
+threads_pool_release()
+{
+  pthread_mutex_lock(&threads_pool_lock);
+  --threads_pool_jobs;
+  pthread_mutex_unlock(&threads_pool_lock);
+}
+
+
+
+
+
+/* Create the pool with the given number of worker threads (when
+   'numworkers==0', one less than the number of available threads on the
+   system, since the calling thread also runs tasks). If a pool with a
+   different number of workers already exists and no job is running on
+   it, it will be re-created. */
+void
+gal_threads_pool_init(size_t numworkers)
+{
+  size_t nt;
+
+  /* Set the number of workers. */
+  if(numworkers==0)
+    numworkers = (nt=gal_threads_number())>1 ? nt-1 : 1;
+
+  /* Create (or re-create) the pool. */
+  pthread_mutex_lock(&threads_pool_lock);
+  if( threads_pool_jobs==0
+      && threads_pool
+      && threads_pool->numworkers!=numworkers )
+    threads_pool_destroy();
+  if(threads_pool==NULL) threads_pool_create(numworkers);
+  pthread_mutex_unlock(&threads_pool_lock);
+}
+
+
+
+
+
+/* Number of worker threads in the pool (zero if it hasn't been created
+   yet). */
+size_t
+gal_threads_pool_size()
+{
+  size_t out;
+  pthread_mutex_lock(&threads_pool_lock);
+  out = threads_pool ? threads_pool->numworkers : 0;
+  pthread_mutex_unlock(&threads_pool_lock);
+  return out;
+}
+
+
+
+
+
+/* Stop all the workers of the pool (after all queued tasks are finished)
+   and free the pool. A new pool will be created on the next call to the
+   pool's functions. This should not be called while jobs are running. */
+void
+gal_threads_pool_free()
+{
+  pthread_mutex_lock(&threads_pool_lock);
+  threads_pool_destroy();
+  pthread_mutex_unlock(&threads_pool_lock);
+}
+
+
+
+
+
+/* Run 'worker' on each element of 'args' (that has 'numargs' elements of
+   'argsize' bytes) using the pool and return when all of them have
+   finished. At most 'numthreads' threads run the tasks simultaneously:
+   the pool has 'numthreads-1' workers and the calling thread also runs
+   tasks while waiting (only tasks of this job, so it never runs an
+   unrelated task while the caller may be holding a lock). When the
+   caller is itself a worker of the pool, the tasks are put in its own
+   deque (to be stolen by idle workers), otherwise they are distributed
+   between the deques of all workers. */
+void
+gal_threads_pool_run(void *(*worker)(void *), void *args, size_t argsize,
+                     size_t numargs, size_t numthreads)
+{
+  void *key;
+  size_t i, wid;
+  struct threads_pool *pool;
+  struct threads_pool_task task;
+  struct threads_pool_job job;
+
+  /* If there are no tasks, then just return. */
+  if(numargs==0) return;
+
+  /* When only one thread is requested, there is no need to involve the
+     pool: just run the tasks on this thread. */
+  if(numthreads==0) numthreads=gal_threads_number();
+  if(numthreads==1 || numargs==1)
+    {
+      for(i=0;i<numargs;++i) worker( (char *)args+i*argsize );
+      return;
+    }
+
+  /* Make sure the pool exists with the proper number of workers. */
+  pool=threads_pool_acquire(numthreads-1);
+
+  /* Identify if this thread is a worker of the pool. */
+  key=pthread_getspecific(pool->key);
+  wid = key ? *(size_t *)key : pool->numworkers;
+
+  /* Initialize the job. */
+  job.remaining=numargs;
+  pthread_mutex_init(&job.mutex, NULL);
+  pthread_cond_init(&job.done, NULL);
+
+  /* Put the tasks in the deques. The 'pending' counter is incremented
+     before the tasks are actually queued so it is never smaller than the
+     number of queued tasks. */
+  pthread_mutex_lock(&pool->mutex);
+  pool->pending+=numargs;
+  pthread_mutex_unlock(&pool->mutex);
+  for(i=0;i<numargs;++i)
+    {
+      task.job=&job;
+      task.worker=worker;
+      task.arg=(char *)args+i*argsize;
+      if(wid<pool->numworkers)
+        threads_pool_deque_push(&pool->deques[wid], &task);
+      else
+        {
+          pthread_mutex_lock(&pool->mutex);
+          wid=pool->nextq++ % pool->numworkers;
+          pthread_mutex_unlock(&pool->mutex);
+          threads_pool_deque_push(&pool->deques[wid], &task);
+          wid=pool->numworkers;
+        }
+    }
+
+  /* Wake up the sleeping workers. */
+  pthread_mutex_lock(&pool->mutex);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  /* Help in running the tasks of this job until all of them have
+     finished. When no task of this job can be found, all its remaining
+     tasks are already running on other threads, so we can safely wait for
+     them. Note that 'remaining' should only be checked while the job's
+     mutex is locked (the job is about to be destroyed). */
+  while(1)
+    {
+      pthread_mutex_lock(&job.mutex);
+      if(job.remaining==0) { pthread_mutex_unlock(&job.mutex); break; }
+      pthread_mutex_unlock(&job.mutex);
+
+      if( threads_pool_take(pool, wid, &task, &job) )
+        threads_pool_run_task(&task);
+      else
+        {
+          pthread_mutex_lock(&job.mutex);
+          while(job.remaining)
+            pthread_cond_wait(&job.done, &job.mutex);
+          pthread_mutex_unlock(&job.mutex);
+        }
+    }
+
+  /* Clean up. */
+  pthread_cond_destroy(&job.done);
+  pthread_mutex_destroy(&job.mutex);
+  threads_pool_release();
+}
+
+
+
+
+
+/* Similar to 'gal_threads_spin_off', but explicitly using the pool. The
+   actions are distributed between 'numthreads' tasks (each with the same
+   'gal_threads_params' structure that 'gal_threads_spin_off' gives to its
+   worker), but the tasks are run by the pool's threads. Since the pool
+   itself knows when all the tasks have finished, the barrier pointer
+   ('b') of each task's structure is NULL. */
+void
+gal_threads_pool_spin_off(void *(*worker)(void *), void *caller_params,
+                          size_t numactions, size_t numthreads,
+                          size_t minmapsize, int quietmmap)
+{
+  char *mmapname=NULL;
+  struct gal_threads_params *prm;
+  size_t i, *indexs, thrdcols, numtasks;
+
+  /* If there are no actions, then just return. */
+  if(numactions==0) return;
+
+  /* Sanity check. */
+  if(numthreads==0)
+    error(EXIT_FAILURE, 0, "%s: the number of threads ('numthreads') "
+          "cannot be zero", __func__);
+
+  /* Allocate the array of parameters structure. */
+  errno=0;
+  prm=malloc(numthreads*sizeof *prm);
+  if(prm==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'prm'", __func__,
+          numthreads*sizeof *prm);
+
+  /* Distribute the actions into the threads: */
+  mmapname=gal_threads_dist_in_threads(numactions, numthreads, minmapsize,
+                                       quietmmap, &indexs, &thrdcols);
+
+  /* Set the parameters of each task. Note that when there are fewer
+     actions than threads, the later threads have no actions, so they are
+     not given to the pool. */
+  numtasks = numactions<numthreads ? numactions : numthreads;
+  for(i=0;i<numtasks;++i)
+    {
+      prm[i].id=i;
+      prm[i].b=NULL;
+      prm[i].params=caller_params;
+      prm[i].indexs=&indexs[i*thrdcols];
+    }
+
+  /* When only one thread is necessary, there is no need to involve the
+     pool, just call the worker function directly. */
+  if(numtasks==1) worker(&prm[0]);
+  else gal_threads_pool_run(worker, prm, sizeof *prm, numtasks,
+                            numthreads);
+
+  /* If 'mmapname' is NULL, then 'indexs' is in RAM and we can safely
+     'free' it. However, when its not NULL, then the space for 'indexs' has
+     been memory-mapped (its not in RAM) so special treatment is necessary
+     to delete it through the proper function. */
+  if(mmapname) gal_pointer_mmap_free(&mmapname, quietmmap);
+  else         free(indexs);
+
+  /* Clean up. */
+  free(prm);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*******************************************************************/
 /************     Run a function on multiple threads  **************/
 /*******************************************************************/
@@ -336,13 +973,153 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
                      size_t numactions, size_t numthreads,
                      size_t minmapsize, int quietmmap)
 {
-  int err;
-  pthread_t t;          /* All thread ids saved in this, not used. */
-  char *mmapname=NULL;
-  pthread_attr_t attr;
-  pthread_barrier_t b;
-  struct gal_threads_params *prm;
-  size_t i, *indexs, thrdcols, numbarriers;
+  /* Spinning off new threads (and waiting behind a barrier) on every call
+     is expensive when this function is called many times (for example on
+     small tiles), so the persistent thread pool is used for all calls. */
+  gal_threads_pool_spin_off(worker, caller_params, numactions,
+                            numthreads, minmapsize, quietmmap);
+}
+
+
+
+
+
+/* Structures for dynamic distribution of the actions. */
+struct threads_dynamic
+{
+  void *(*worker)(void *);  /* Caller's worker function.               */
+  void     *caller_params;  /* Caller's parameters.                    */
+  size_t           *order;  /* Actions in the order they should start. */
+  size_t           *costs;  /* Cost of each action (in 'order').       */
+  size_t       numactions;  /* Total number of actions.                */
+  size_t       numthreads;  /* Number of threads.                      */
+  size_t             next;  /* Next action (in 'order') to give out.   */
+  double          remcost;  /* Cost of actions that aren't given yet.  */
+  pthread_mutex_t   mutex;  /* Mutex to protect 'next' and 'remcost'.  */
+};
+
+struct threads_dynamic_task
+{
+  size_t                  id;  /* ID of this thread.                   */
+  struct threads_dynamic *dp;  /* Pointer to the shared structure.     */
+};
+
+struct threads_dynamic_sort
+{
+  size_t cost;               /* Cost of the action.                    */
+  size_t index;              /* Index of the action.                   */
+};
+
+
+
+
+
+/* Sort the actions by decreasing cost (equal costs are sorted by their
+   index for a deterministic order). */
+static int
+threads_dynamic_sort_d(const void *a, const void *b)
+{
+  const struct threads_dynamic_sort *ta=a, *tb=b;
+  return ( ta->cost==tb->cost
+           ? (ta->index > tb->index) - (ta->index < tb->index)
+           : (tb->cost > ta->cost) - (tb->cost < ta->cost) );
+}
+
+
+
+
+
+/* Each thread takes a chunk of the (sorted) actions, gives it to the
+   caller's worker and continues until no more actions remain. The size of
+   each chunk is defined through "guided" scheduling: the cost of each
+   chunk is a fixed fraction of the total cost of the remaining actions
+   divided by the number of threads. So initially the chunks are large
+   (reducing the overhead) and as we approach the end, the chunks become
+   smaller (to keep all the threads busy until the end). */
+static void *
+threads_dynamic_worker(void *in_prm)
+{
+  struct threads_dynamic_task *task=(struct threads_dynamic_task *)in_prm;
+  struct threads_dynamic *dp=task->dp;
+
+  double target, sum;
+  size_t i, start, end, size=0, *indexs=NULL;
+  struct gal_threads_params tprm={task->id, dp->caller_params, NULL, NULL};
+
+  /* Continue as long as there are actions. */
+  while(1)
+    {
+      /* Take the next chunk. */
+      pthread_mutex_lock(&dp->mutex);
+      start=end=dp->next;
+      target=dp->remcost/(GAL_THREADS_DYNAMIC_GUIDED*dp->numthreads);
+      sum=0.0;
+      while( end<dp->numactions && (end==start || sum<target) )
+        {
+          sum += dp->costs ? dp->costs[end] : 1.0;
+          ++end;
+        }
+      dp->next=end;
+      dp->remcost-=sum;
+      pthread_mutex_unlock(&dp->mutex);
+
+      /* If no actions remain, we are done. */
+      if(start==end) break;
+
+      /* Put the indexs of this chunk into this thread's 'indexs' array
+         (finishing with a blank value, as in 'gal_threads_spin_off'). */
+      if(end-start+1>size)
+        {
+          size=end-start+1;
+          errno=0;
+          indexs=realloc(indexs, size*sizeof *indexs);
+          if(indexs==NULL)
+            error(EXIT_FAILURE, errno, "%s: %zu bytes for 'indexs'",
+                  __func__, size*sizeof *indexs);
+        }
+      for(i=start;i<end;++i)
+        indexs[i-start] = dp->order ? dp->order[i] : i;
+      indexs[end-start]=GAL_BLANK_SIZE_T;
+
+      /* Run the caller's worker on this chunk. */
+      tprm.indexs=indexs;
+      dp->worker(&tprm);
+    }
+
+  /* Clean up and return. */
+  free(indexs);
+  return NULL;
+}
+
+
+
+
+
+/* Similar to 'gal_threads_spin_off', but the actions are given to the
+   threads dynamically (in chunks) while the threads are working, not
+   distributed in the beginning. When 'costs' is not NULL, it should have
+   'numactions' elements that are an estimate of the cost of each action
+   (for example the number of pixels in a label). In this case, the
+   actions with the largest cost are started first, and the size of the
+   chunks is defined by their cost. This is useful when the cost of the
+   actions differ significantly, for example when one action may take
+   1000 times longer than another (like a large galaxy compared to a faint
+   source in the same image).
+
+   The caller's worker may be called multiple times on each thread (each
+   time with a new set of actions in its 'indexs'). The 'id' of the
+   structure given to the worker is the same on each thread (and smaller
+   than 'numthreads'), so it can be used to access per-thread
+   resources. */
+void
+gal_threads_spin_off_dynamic(void *(*worker)(void *), void *caller_params,
+                             size_t numactions, size_t numthreads,
+                             size_t *costs)
+{
+  size_t i, numtasks;
+  struct threads_dynamic dp;
+  struct threads_dynamic_sort *srt;
+  struct threads_dynamic_task *tasks;
 
   /* If there are no actions, then just return. */
   if(numactions==0) return;
@@ -352,71 +1129,61 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
     error(EXIT_FAILURE, 0, "%s: the number of threads ('numthreads') "
           "cannot be zero", __func__);
 
-  /* Allocate the array of parameters structure. */
-  errno=0;
-  prm=malloc(numthreads*sizeof *prm);
-  if(prm==NULL)
-    {
-      fprintf(stderr, "%zu bytes could not be allocated for prm.",
-              numthreads*sizeof *prm);
-      exit(EXIT_FAILURE);
-    }
-
-  /* Distribute the actions into the threads: */
-  mmapname=gal_threads_dist_in_threads(numactions, numthreads, minmapsize,
-                                       quietmmap, &indexs, &thrdcols);
-
-  /* Do the job: when only one thread is necessary, there is no need to
-     spin off one thread, just call the workerfunction directly (spinning
-     off threads is expensive). This is for the generic thread spinner
-     function, not this simple function where 'numthreads' is a
-     constant. */
-  if(numthreads==1)
-    {
-      prm[0].id=0;
-      prm[0].b=NULL;
-      prm[0].indexs=indexs;
-      prm[0].params=caller_params;
-      worker(&prm[0]);
-    }
-  else
+  /* Set the basic parameters. */
+  dp.next=0;
+  dp.order=dp.costs=NULL;
+  dp.worker=worker;
+  dp.numactions=numactions;
+  dp.caller_params=caller_params;
+  numtasks = numactions<numthreads ? numactions : numthreads;
+  dp.numthreads=numtasks;
+
+  /* When costs are given, sort the actions by their cost. */
+  if(costs)
     {
-      /* Initialize the attributes. Note that this running thread
-         (that spinns off the nt threads) is also a thread, so the
-         number the barriers should be one more than the number of
-         threads spinned off. */
-      numbarriers = (numactions<numthreads ? numactions : numthreads) + 1;
-      gal_threads_attr_barrier_init(&attr, &b, numbarriers);
-
-      /* Spin off the threads: */
-      for(i=0;i<numthreads;++i)
-        if(indexs[i*thrdcols]!=GAL_BLANK_SIZE_T)
-          {
-            prm[i].id=i;
-            prm[i].b=&b;
-            prm[i].params=caller_params;
-            prm[i].indexs=&indexs[i*thrdcols];
-            err=pthread_create(&t, &attr, worker, &prm[i]);
-            if(err)
-              {
-                fprintf(stderr, "can't create thread %zu", i);
-                exit(EXIT_FAILURE);
-              }
-          }
-
-      /* Wait for all threads to finish and free the spaces. */
-      pthread_barrier_wait(&b);
-      pthread_attr_destroy(&attr);
-      pthread_barrier_destroy(&b);
+      /* Allocate the necessary arrays. */
+      errno=0;
+      srt=malloc(numactions*sizeof *srt);
+      if(srt==NULL)
+        error(EXIT_FAILURE, errno, "%s: %zu bytes for 'srt'", __func__,
+              numactions*sizeof *srt);
+      dp.order=gal_pointer_allocate(GAL_TYPE_SIZE_T, numactions, 0,
+                                    __func__, "dp.order");
+      dp.costs=gal_pointer_allocate(GAL_TYPE_SIZE_T, numactions, 0,
+                                    __func__, "dp.costs");
+
+      /* Sort the actions and keep the order. */
+      for(i=0;i<numactions;++i) { srt[i].cost=costs[i]; srt[i].index=i; }
+      qsort(srt, numactions, sizeof *srt, threads_dynamic_sort_d);
+      dp.remcost=0.0;
+      for(i=0;i<numactions;++i)
+        {
+          dp.order[i]=srt[i].index;
+          dp.costs[i]=srt[i].cost;
+          dp.remcost+=srt[i].cost;
+        }
+      free(srt);
     }
+  else dp.remcost=numactions;
 
-  /* If 'mmapname' is NULL, then 'indexs' is in RAM and we can safely
-     'free' it. However, when its not NULL, then the space for 'indexs' has
-     been memory-mapped (its not in RAM) so special treatment is necessary
-     to delete it through the proper function. */
-  if(mmapname) gal_pointer_mmap_free(&mmapname, quietmmap);
-  else         free(indexs);
+  /* Allocate and fill the parameters of each task. */
+  errno=0;
+  tasks=malloc(numtasks*sizeof *tasks);
+  if(tasks==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'tasks'", __func__,
+          numtasks*sizeof *tasks);
+  for(i=0;i<numtasks;++i) { tasks[i].id=i; tasks[i].dp=&dp; }
+
+  /* Do the job (when only one thread is necessary, there is no need to
+     involve the pool). */
+  pthread_mutex_init(&dp.mutex, NULL);
+  if(numtasks==1) threads_dynamic_worker(&tasks[0]);
+  else gal_threads_pool_run(threads_dynamic_worker, tasks, sizeof *tasks,
+                            numtasks, numthreads);
+  pthread_mutex_destroy(&dp.mutex);
 
   /* Clean up. */
-  free(prm);
+  free(tasks);
+  free(dp.order);
+  free(dp.costs);
 }
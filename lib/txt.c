@@ -24,12 +24,17 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include <math.h>
 #include <ctype.h>
+#include <float.h>
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
+#include <fcntl.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <gnuastro/txt.h>
 #include <gnuastro/list.h>
@@ -37,6 +42,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/blank.h>
 #include <gnuastro/table.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/statistics.h>
 
 #include <gnuastro-internal/checkset.h>
@@ -66,6 +72,16 @@ enum txt_formats_code
 };
 
 
+/* Number of bytes of a file in each job when reading it on many threads
+   (every job starts at the first line after a multiple of this). */
+#define TXT_READ_CHUNK 1048576
+
+/* Size of the buffer to keep the formatted rows before writing them, and
+   the maximum length of one directly formatted value. */
+#define TXT_WRITE_BUFFER_SIZE 1048576
+#define TXT_WRITE_VALUE_MAX   64
+
+
 
 
 
@@ -854,6 +870,74 @@ txt_blocklist_number(gal_data_t *list)
 
 
 
+/* Powers of ten that are exactly representable in double precision. */
+static const double txt_pow10[]={1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+
+
+
+
+
+/* Read a floating point number from 'token' (like 'strtod'). Most numbers
+   in tables are plain decimals (for example '-12.3456' or '1.2e-5') with
+   few significant digits. When the significant digits are exactly
+   representable in double precision (less than 2^53) and so is the power
+   of ten (not more than 22), a single multiplication or division gives the
+   correctly rounded result (identical to 'strtod'), without the generic
+   (and much slower) parsing of 'strtod'. Any other token (for example
+   'nan', hexadecimal numbers or '_h_m_s' coordinates), or one that is not
+   fully consumed, is passed to 'strtod'. */
+static double
+txt_strtod(char *token, char **tailptr)
+{
+  char *c=token;
+  double out;
+  uint64_t m=0;
+  long e=0, ee=0;
+  int neg=0, eneg=0;
+  size_t ndigits=0, nsig=0;
+
+  /* Sign. */
+  if(*c=='-' || *c=='+') neg = *c++=='-';
+
+  /* Significant digits (before and after the decimal point). Leading
+     zeros are not significant (they don't change 'm'). The significant
+     digits are counted from the first non-zero digit (not with the value
+     of 'm', which may overflow to zero). */
+  for(; *c>='0' && *c<='9'; ++c, ++ndigits)
+    { m = m*10 + (*c-'0'); if(nsig || *c!='0') ++nsig; }
+  if(*c=='.')
+    for(++c; *c>='0' && *c<='9'; ++c, ++ndigits)
+      { m = m*10 + (*c-'0'); if(nsig || *c!='0') ++nsig; --e; }
+
+  /* Exponent. */
+  if( ndigits && (*c=='e' || *c=='E') )
+    {
+      ++c;
+      if(*c=='-' || *c=='+') eneg = *c++=='-';
+      if(*c<'0' || *c>'9') return strtod(token, tailptr);
+      for(; *c>='0' && *c<='9'; ++c) if(ee<100000) ee = ee*10 + (*c-'0');
+      e += eneg ? -ee : ee;
+    }
+
+  /* See if the fast path can be used. */
+  if( ndigits==0 || *c!='\0' || nsig>19 || m>(1ULL<<53)
+      || (m && (e<-22 || e>22)) )
+    return strtod(token, tailptr);
+
+  /* Calculate the value and return. */
+  if(m==0) out=0.0f;
+  else     out = e<0 ? m/txt_pow10[-e] : m*txt_pow10[e];
+  *tailptr=c;
+  return neg ? -out : out;
+}
+
+
+
+
+
 static void
 txt_read_token(gal_data_t *data, gal_data_t *info, char *token,
                size_t i, char *filename, size_t lineno, size_t toknum)
@@ -968,7 +1052,7 @@ txt_read_token(gal_data_t *data, gal_data_t *info, char *token,
              condition check (even '=='). If it isn't NaN, then we can
              compare the values. */
         case GAL_TYPE_FLOAT32:
-          f[i]=strtod(token, &tailptr);
+          f[i]=txt_strtod(token, &tailptr);
           if( (*tailptr=='h' || *tailptr=='d') && isdigit(*(tailptr+1)) )
             {
               f[i] = ( *tailptr=='h'
@@ -986,7 +1070,7 @@ txt_read_token(gal_data_t *data, gal_data_t *info, char *token,
            in these cases, they are actually coordinates (RA for first, Dec
            for second). */
         case GAL_TYPE_FLOAT64:
-          d[i]=strtod(token, &tailptr);
+          d[i]=txt_strtod(token, &tailptr);
           if( (*tailptr=='h' || *tailptr=='d') && isdigit(*(tailptr+1)) )
             {
               d[i] = ( *tailptr=='h'
@@ -1369,8 +1453,7 @@ txt_read_prepare_img(gal_data_t *info, size_t *indsize,
 static gal_data_t *
 txt_read_prepare(gal_data_t *info, size_t *indsize,
                  gal_list_sizet_t *indexll, size_t minmapsize,
-                 int quietmmap, int format, char **line,
-                 size_t linelen, gal_data_t ***tokeninout,
+                 int quietmmap, int format, gal_data_t ***tokeninout,
                  size_t *ntokforout, gal_data_t ***tokenininfo,
                  size_t **tokenvecind)
 {
@@ -1395,15 +1478,6 @@ txt_read_prepare(gal_data_t *info, size_t *indsize,
             __func__, PACKAGE_BUGREPORT, format);
     }
 
-  /* Allocate the space necessary to keep a copy of each line as we parse
-     it. Note that 'getline' is going to later 'realloc' this space to fit
-     the line length. */
-  errno=0;
-  *line=malloc(linelen*sizeof *line);
-  if(*line==NULL)
-    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'line'",
-          __func__, linelen*sizeof **line);
-
   /* Return the output dataset. */
   return out;
 }
@@ -1412,18 +1486,244 @@ txt_read_prepare(gal_data_t *info, size_t *indsize,
 
 
 
+/* Parameters for reading a plain text file on multiple threads. */
+struct txt_read_params
+{
+  char             *filename;  /* Name of the file (for error messages). */
+  char                 *text;  /* Full contents of the file (mmap'd).     */
+  size_t             *bounds;  /* Start of each chunk (and end of file).  */
+  size_t            *rowind0;  /* First row index of each chunk.          */
+  size_t           *lineno0;  /* Line number before each chunk.          */
+  int                 format;  /* Format of the file (table or image).    */
+  int              countonly;  /* Only count the rows and lines.          */
+  size_t          ntokforout;  /* Last input token used in the output.    */
+  size_t        *tokenvecind;  /* Index of each token in its vector.      */
+  gal_data_t    **tokeninout;  /* Output dataset(s) of each token.        */
+  gal_data_t   **tokenininfo;  /* Information of the column of each token.*/
+};
+
+
+
+
+
+/* Similar to 'gal_txt_line_stat', but for a line that ends at 'end' (not
+   necessarily with a new-line character, like the last line of a
+   file). */
+static int
+txt_line_stat_bounded(char *line, char *end)
+{
+  for(; line<end && *line!='\n'; ++line)
+    switch(*line)
+      {
+      case ' ': case ',': case '\t': break;
+      case '#':                      return GAL_TXT_LINESTAT_COMMENT;
+      default:                       return GAL_TXT_LINESTAT_DATAROW;
+      }
+
+  /* Like 'gal_txt_line_stat' (on the output of 'getline'), a final line
+     that only has white space (and no new-line) is a data row. */
+  return line==end ? GAL_TXT_LINESTAT_DATAROW : GAL_TXT_LINESTAT_BLANK;
+}
+
+
+
+
+
+/* Parse (or only count) the lines in one chunk of the file. The chunks
+   start after a new-line character, so each chunk only has full lines.
+   The line buffer is kept between the chunks of a thread. */
+static void
+txt_read_chunk(struct txt_read_params *rprm, size_t chunk, char **line,
+               size_t *linelen)
+{
+  char *c, *nl, *end;
+  size_t len, nrows=0, nlines=0, rowind, lineno;
+
+  /* The lines of this chunk. */
+  c=rprm->text+rprm->bounds[chunk];
+  end=rprm->text+rprm->bounds[chunk+1];
+  rowind=rprm->countonly ? 0 : rprm->rowind0[chunk];
+  lineno=rprm->countonly ? 0 : rprm->lineno0[chunk];
+
+  /* Go over the lines ('memchr' is much faster than checking every
+     character in a loop). */
+  while(c<end)
+    {
+      nl=memchr(c, '\n', end-c);
+      len = nl ? nl+1-c : (size_t)(end-c);
+
+      /* If this is a data row, parse it (when not only counting). */
+      ++nlines;
+      if( txt_line_stat_bounded(c, c+len)==GAL_TXT_LINESTAT_DATAROW )
+        {
+          if(rprm->countonly==0)
+            {
+              /* Copy the line into a (NULL-terminated) buffer because it
+                 is modified while parsing. */
+              if(len+1>*linelen)
+                {
+                  *linelen=2*(len+1);
+                  free(*line);
+                  *line=gal_pointer_allocate(GAL_TYPE_UINT8, *linelen, 0,
+                                             __func__, "line");
+                }
+              memcpy(*line, c, len);
+              (*line)[len]='\0';
+              txt_fill(*line, rprm->tokeninout, rprm->ntokforout,
+                       rprm->tokenininfo, rprm->tokenvecind, rowind++,
+                       rprm->filename, lineno+nlines, 1, rprm->format);
+            }
+          ++nrows;
+        }
+      c+=len;
+    }
+
+  /* When counting, keep the numbers for this chunk. */
+  if(rprm->countonly)
+    {
+      rprm->rowind0[chunk]=nrows;
+      rprm->lineno0[chunk]=nlines;
+    }
+}
+
+
+
+
+
+/* Parse (or only count) the chunks of one thread. */
+static void *
+txt_read_onthread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct txt_read_params *rprm=(struct txt_read_params *)tprm->params;
+
+  size_t i, linelen=0;
+  char *line=NULL;
+
+  /* Go over all the chunks that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    txt_read_chunk(rprm, tprm->indexs[i], &line, &linelen);
+
+  /* Clean up, wait for other threads to finish and return. */
+  free(line);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Read the contents of a plain text file on multiple threads: the file is
+   mapped into memory and split into chunks of (approximately)
+   'TXT_READ_CHUNK' bytes (at new-line characters), and each chunk is one
+   job for the threads. In a first pass, the rows and lines of each chunk
+   are counted (so the row and line number that each chunk starts with
+   are known). In the second pass, the rows of each chunk are parsed
+   directly into the output. */
+static void
+txt_read_file(char *filename, size_t numthreads, size_t minmapsize,
+              int quietmmap, int format, size_t ntokforout,
+              size_t *tokenvecind, gal_data_t **tokeninout,
+              gal_data_t **tokenininfo)
+{
+  int fd;
+  size_t i, t, nchunks, tmp;
+  struct stat st;
+  struct txt_read_params rprm;
+  char *nl, *text=MAP_FAILED;
+
+  /* Open the file and map it into memory. */
+  errno=0;
+  fd=open(filename, O_RDONLY);
+  if(fd==-1)
+    error(EXIT_FAILURE, errno, "%s: couldn't open to read as a text "
+          "table in %s", filename, __func__);
+  if(fstat(fd, &st)==-1)
+    error(EXIT_FAILURE, errno, "%s: couldn't get the size in %s",
+          filename, __func__);
+  if(st.st_size>0)
+    {
+      text=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(text==MAP_FAILED)
+        error(EXIT_FAILURE, errno, "%s: couldn't map into memory in %s",
+              filename, __func__);
+    }
+
+  /* Set the number of chunks (on one thread, there is no need to split
+     the file). */
+  if(numthreads==0) numthreads=gal_threads_number();
+  nchunks = numthreads==1 ? 1 : st.st_size / TXT_READ_CHUNK + 1;
+
+  /* Find the start of each chunk: the first line that begins after a
+     multiple of the chunk size. */
+  rprm.bounds=gal_pointer_allocate(GAL_TYPE_SIZE_T, nchunks+1, 0, __func__,
+                                   "rprm.bounds");
+  rprm.bounds[0]=0;
+  rprm.bounds[nchunks]=st.st_size;
+  for(t=1;t<nchunks;++t)
+    {
+      tmp=t*TXT_READ_CHUNK;
+      if(tmp<rprm.bounds[t-1]) tmp=rprm.bounds[t-1];
+      nl = tmp<(size_t)(st.st_size)
+           ? memchr(text+tmp, '\n', st.st_size-tmp) : NULL;
+      rprm.bounds[t] = nl ? (size_t)(nl+1-text) : (size_t)(st.st_size);
+    }
+
+  /* Count the rows and lines of each chunk, then convert them to the
+     first row index and line number of each chunk. */
+  rprm.text=text;
+  rprm.format=format;
+  rprm.filename=filename;
+  rprm.ntokforout=ntokforout;
+  rprm.tokenvecind=tokenvecind;
+  rprm.tokeninout=tokeninout;
+  rprm.tokenininfo=tokenininfo;
+  rprm.rowind0=gal_pointer_allocate(GAL_TYPE_SIZE_T, nchunks, 0, __func__,
+                                    "rprm.rowind0");
+  rprm.lineno0=gal_pointer_allocate(GAL_TYPE_SIZE_T, nchunks, 0, __func__,
+                                    "rprm.lineno0");
+  if(nchunks>1)
+    {
+      rprm.countonly=1;
+      gal_threads_spin_off(txt_read_onthread, &rprm, nchunks, numthreads,
+                           minmapsize, quietmmap);
+      for(i=t=0;t<nchunks;++t)
+        { tmp=rprm.rowind0[t]; rprm.rowind0[t]=i; i+=tmp; }
+      for(i=t=0;t<nchunks;++t)
+        { tmp=rprm.lineno0[t]; rprm.lineno0[t]=i; i+=tmp; }
+    }
+  else rprm.rowind0[0]=rprm.lineno0[0]=0;
+
+  /* Parse the rows. */
+  rprm.countonly=0;
+  gal_threads_spin_off(txt_read_onthread, &rprm, nchunks, numthreads,
+                       minmapsize, quietmmap);
+
+  /* Clean up. */
+  free(rprm.bounds);
+  free(rprm.rowind0);
+  free(rprm.lineno0);
+  if(text!=MAP_FAILED) munmap(text, st.st_size);
+  errno=0;
+  if(close(fd))
+    error(EXIT_FAILURE, errno, "%s: couldn't close file after reading "
+          "ASCII table information in %s", filename, __func__);
+}
+
+
+
+
+
 static gal_data_t *
 txt_read(char *filename, gal_list_str_t *lines, size_t *indsize,
-         gal_data_t *info, gal_list_sizet_t *indexll, size_t minmapsize,
-         int quietmmap, int format)
+         gal_data_t *info, gal_list_sizet_t *indexll, size_t numthreads,
+         size_t minmapsize, int quietmmap, int format)
 {
-  FILE *fp;
   int test;
-  char *line;
   gal_list_str_t *tmp;
   size_t ntokforout=0, rowind=0, lineno=0, *tokenvecind;
   gal_data_t *out=NULL, *ocol, **tokeninout, **tokenininfo;
-  size_t linelen=10;        /* 'linelen' will be increased by 'getline'. */
 
   /* 'filename' and 'lines' cannot both be non-NULL. */
   test = (filename!=NULL) + (lines!=NULL);
@@ -1434,34 +1734,13 @@ txt_read(char *filename, gal_list_str_t *lines, size_t *indsize,
 
   /* Necessary preparations/allocations */
   out=txt_read_prepare(info, indsize, indexll, minmapsize, quietmmap,
-                       format, &line, linelen, &tokeninout, &ntokforout,
-                       &tokenininfo, &tokenvecind);
+                       format, &tokeninout, &ntokforout, &tokenininfo,
+                       &tokenvecind);
 
-  /* Read the input line by line. */
-  if(filename) /* Input from a file. */
-    {
-      /* Open the file. */
-      errno=0;
-      fp=fopen(filename, "r");
-      if(fp==NULL)
-        error(EXIT_FAILURE, errno, "%s: couldn't open to read as a text "
-              "table in %s", filename, __func__);
-
-      /* Read the file, line by line. */
-      while( getline(&line, &linelen, fp) != -1 )
-        {
-          ++lineno;
-          if( gal_txt_line_stat(line) == GAL_TXT_LINESTAT_DATAROW )
-            txt_fill(line, tokeninout, ntokforout, tokenininfo,
-                     tokenvecind, rowind++, filename, lineno, 1, format);
-        }
-
-      /* Clean up and close the file. */
-      errno=0;
-      if(fclose(fp))
-        error(EXIT_FAILURE, errno, "%s: couldn't close file after reading "
-              "ASCII table information in %s", filename, __func__);
-    }
+  /* Read the input. */
+  if(filename) /* Input from a file (possibly on many threads). */
+    txt_read_file(filename, numthreads, minmapsize, quietmmap, format,
+                  ntokforout, tokenvecind, tokeninout, tokenininfo);
 
   else /* Input from standard input */
     for(tmp=lines; tmp!=NULL; tmp=tmp->next)
@@ -1485,7 +1764,6 @@ txt_read(char *filename, gal_list_str_t *lines, size_t *indsize,
   if(format==TXT_FORMAT_TABLE) free(tokeninout);
   free(tokenininfo);
   free(tokenvecind);
-  free(line);
   return out;
 }
 
@@ -1496,10 +1774,10 @@ txt_read(char *filename, gal_list_str_t *lines, size_t *indsize,
 gal_data_t *
 gal_txt_table_read(char *filename, gal_list_str_t *lines, size_t numrows,
                    gal_data_t *colinfo, gal_list_sizet_t *indexll,
-                   size_t minmapsize, int quietmmap)
+                   size_t numthreads, size_t minmapsize, int quietmmap)
 {
-  return txt_read(filename, lines, &numrows, colinfo, indexll, minmapsize,
-                  quietmmap, TXT_FORMAT_TABLE);
+  return txt_read(filename, lines, &numrows, colinfo, indexll, numthreads,
+                  minmapsize, quietmmap, TXT_FORMAT_TABLE);
 }
 
 
@@ -1518,7 +1796,7 @@ gal_txt_image_read(char *filename, gal_list_str_t *lines,
   imginfo=gal_txt_image_info(filename, lines, &numimg, dsize);
 
   /* Read the table. */
-  img=txt_read(filename, lines, dsize, imginfo, indexll, minmapsize,
+  img=txt_read(filename, lines, dsize, imginfo, indexll, 1, minmapsize,
                quietmmap, TXT_FORMAT_IMAGE);
 
   /* Clean up and return. */
@@ -1790,43 +2068,525 @@ txt_fmts_for_printf(gal_data_t *datall, int leftadjust, int tab0_img1)
 
 
 
+/* Buffer to keep the formatted values before writing them into the file
+   in large blocks (with 'fwrite'). */
+struct txt_buffer
+{
+  FILE        *fp;   /* File to write into.                      */
+  char         *a;   /* Allocated buffer.                        */
+  size_t        n;   /* Number of used bytes in the buffer.      */
+  size_t     size;   /* Allocated size of the buffer.            */
+};
+
+
+
+
+
+/* Parsed version of a column's printf format string (that is built in
+   'txt_fmts_for_printf'), to format its values directly (without
+   'printf'). */
+struct txt_fmt
+{
+  char       *fmt;   /* The full format string.                  */
+  int        fast;   /* ==1: the format can be done directly.    */
+  int       space;   /* The ' ' flag (space before positives).   */
+  int        left;   /* The '-' flag (left adjustment).          */
+  int       width;   /* Minimum width (0 if not given).          */
+  int        prec;   /* Precision (-1 if not given).             */
+  char       conv;   /* The conversion character.                */
+  char    *suffix;   /* Characters after the conversion.         */
+  size_t  sufflen;   /* Length of the suffix.                    */
+};
+
+
+
+
+
+/* Exact powers of ten. The 'long double' ones are exact up to 1e27
+   (5^27 fits in the 64-bit significand of the x87 extended format). */
+static const uint64_t txt_pow10u[]={1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL,
+      100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+      10000000000ULL, 100000000000ULL, 1000000000000ULL,
+      10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+      10000000000000000ULL, 100000000000000000ULL,
+      1000000000000000000ULL, 10000000000000000000ULL};
+static const long double txt_pow10l[]={1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L,
+      1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L,
+      1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L,
+      1e25L, 1e26L, 1e27L};
+
+
+
+
+
+static void
+txt_buffer_flush(struct txt_buffer *buf)
+{
+  if(buf->n && fwrite(buf->a, 1, buf->n, buf->fp)!=buf->n)
+    error(EXIT_FAILURE, errno, "%s: couldn't write %zu bytes",
+          __func__, buf->n);
+  buf->n=0;
+}
+
+
+
+
+
+/* Write 'len' bytes of 'str' into the buffer. */
+static void
+txt_buffer_write(struct txt_buffer *buf, char *str, size_t len)
+{
+  if(buf->n+len > buf->size) txt_buffer_flush(buf);
+  if(len > buf->size)
+    {
+      if(fwrite(str, 1, len, buf->fp)!=len)
+        error(EXIT_FAILURE, errno, "%s: couldn't write %zu bytes",
+              __func__, len);
+    }
+  else
+    {
+      memcpy(buf->a+buf->n, str, len);
+      buf->n+=len;
+    }
+}
+
+
+
+
+
+/* Write 'num' space characters into the buffer. */
+static void
+txt_buffer_spaces(struct txt_buffer *buf, size_t num)
+{
+  size_t n;
+  while(num)
+    {
+      if(buf->n==buf->size) txt_buffer_flush(buf);
+      n = num < buf->size-buf->n ? num : buf->size-buf->n;
+      memset(buf->a+buf->n, ' ', n);
+      buf->n+=n;
+      num-=n;
+    }
+}
+
+
+
+
+
+/* Format the arguments with 'vsnprintf' into the buffer (for the formats
+   that can't be done directly). */
+static void
+txt_buffer_printf(struct txt_buffer *buf, char *fmt, ...)
+{
+  int n;
+  va_list ap;
+
+  /* Try to print in the free space of the buffer. */
+  va_start(ap, fmt);
+  n=vsnprintf(buf->a+buf->n, buf->size-buf->n, fmt, ap);
+  va_end(ap);
+  if(n<0)
+    error(EXIT_FAILURE, errno, "%s: couldn't print with '%s'",
+          __func__, fmt);
+  if( (size_t)n < buf->size-buf->n ) { buf->n+=n; return; }
+
+  /* It didn't fit: flush the buffer and try again (if it is larger than
+     the whole buffer, print it directly into the file). */
+  txt_buffer_flush(buf);
+  va_start(ap, fmt);
+  if( (size_t)n < buf->size ) buf->n=vsnprintf(buf->a, buf->size, fmt, ap);
+  else                        vfprintf(buf->fp, fmt, ap);
+  va_end(ap);
+}
+
+
+
+
+
+/* Write an already converted value ('len' characters in 'str'), with the
+   width and suffix of the format. */
+static void
+txt_buffer_put(struct txt_buffer *buf, struct txt_fmt *spec, char *str,
+               size_t len)
+{
+  size_t pad = (size_t)spec->width>len ? spec->width-len : 0;
+  if(pad && !spec->left) txt_buffer_spaces(buf, pad);
+  txt_buffer_write(buf, str, len);
+  if(pad &&  spec->left) txt_buffer_spaces(buf, pad);
+  if(spec->sufflen) txt_buffer_write(buf, spec->suffix, spec->sufflen);
+}
+
+
+
+
+
+/* Parse a format string (like '% -14.6e ') that was made by
+   'txt_fmts_for_printf'. If it has any feature that isn't supported in
+   the direct formatting functions below, 'fast' will be zero (and
+   'vsnprintf' will be used). */
+static void
+txt_fmt_parse(char *fmt, struct txt_fmt *spec)
+{
+  char *c=fmt;
+
+  /* Initialize. */
+  spec->fmt=fmt;
+  spec->fast=0;
+  spec->space=spec->left=spec->width=0;
+  spec->prec=-1;
+  spec->conv='\0';
+  spec->suffix=NULL;
+  spec->sufflen=0;
+
+  /* Parse the format. */
+  if(*c++!='%') return;
+  for(;*c==' ' || *c=='-';++c)
+    { if(*c==' ') spec->space=1; else spec->left=1; }
+  for(;isdigit(*c);++c) spec->width = spec->width*10 + (*c-'0');
+  if(*c=='.')
+    for(spec->prec=0, ++c; isdigit(*c); ++c)
+      spec->prec = spec->prec*10 + (*c-'0');
+  while(*c=='h' || *c=='l') ++c;
+  spec->conv=*c++;
+  spec->suffix=c;
+  spec->sufflen=strlen(c);
+
+  /* See if the conversion can be done directly. The limits on the
+     precision of floating point formats are to keep all the digits in a
+     64-bit integer (see 'txt_format_digits'), and they need the 64-bit
+     significand of 'long double' for the scaling. */
+  if( strchr(spec->suffix, '%') ) return;
+  switch(spec->conv)
+    {
+    case 's':           spec->fast = spec->prec==-1;              break;
+    case 'd': case 'u': spec->fast = spec->prec<=32;              break;
+    case 'e': case 'f': case 'g':
+      if(spec->prec==-1) spec->prec=6;
+      spec->fast = LDBL_MANT_DIG>=64 && spec->prec<=15;
+      break;
+    }
+}
+
+
+
+
+
+/* Write the 'ndig' least significant decimal digits of 'n' into 'out'
+   (with leading zeros if necessary). */
+static void
+txt_format_digits(char *out, uint64_t n, int ndig)
+{
+  while(ndig--) { out[ndig]='0'+n%10; n/=10; }
+}
+
+
+
+
+
+/* Number of decimal digits in 'n' (one for zero). */
+static int
+txt_format_ndigits(uint64_t n)
+{
+  int nd=1;
+  while(nd<20 && n>=txt_pow10u[nd]) ++nd;
+  return nd;
+}
+
+
+
+
+
+/* Format an integer (with the sign given separately) like the '%d' or
+   '%u' of 'printf' into 'out' and return the number of characters. */
+static size_t
+txt_format_int(char *out, struct txt_fmt *spec, int neg, uint64_t mag)
+{
+  size_t len=0;
+  int i, nd=txt_format_ndigits(mag);
+
+  /* A zero with a precision of zero has no digits. */
+  if(mag==0 && spec->prec==0) nd=0;
+
+  /* Sign (the space flag is ignored by '%u'). */
+  if(neg)                                 out[len++]='-';
+  else if(spec->space && spec->conv=='d') out[len++]=' ';
+
+  /* Leading zeros for the precision, then the digits. */
+  for(i=nd;i<spec->prec;++i) out[len++]='0';
+  txt_format_digits(out+len, mag, nd);
+  return len+nd;
+}
+
+
+
+
+
+/* Round 'x' (that was scaled from the value to the desired digits) to the
+   nearest integer. The scaling has a relative error of at most 2^-63, so
+   when the fractional part is too close to 0.5 to decide the rounding,
+   this function will return 0 (to let 'printf' decide). */
+static int
+txt_format_round(long double x, uint64_t *out)
+{
+  uint64_t n=x;
+  long double frac=x-n;
+
+  if( fabsl(frac-0.5L) <= x*0x1p-61L ) return 0;
+  *out = frac>0.5L ? n+1 : n;
+  return 1;
+}
+
+
+
+
+
+/* Scale the positive 'v' by '10^k' into a 'long double'. */
+static long double
+txt_format_scale(double v, int k)
+{
+  return k>=0 ? v*txt_pow10l[k] : v/txt_pow10l[-k];
+}
+
+
+
+
+
+/* Find the 'ndig' significant digits of the positive and finite 'v'
+   (put in 'sig') and its (decimal) exponent (put in 'exp') after
+   rounding. If the digits can't be found reliably, return 0. */
+static int
+txt_format_significand(double v, int ndig, uint64_t *sig, int *exp)
+{
+  long double x;
+  int k, e=floor(log10(v));
+
+  /* 'log10' may be off by one close to the powers of ten. */
+  while(1)
+    {
+      k=ndig-1-e;
+      if(k>27 || k<-27) return 0;
+      x=txt_format_scale(v, k);
+      if     (x <  txt_pow10l[ndig-1]) --e;
+      else if(x >= txt_pow10l[ndig]  ) ++e;
+      else break;
+    }
+
+  /* Round, and correct the exponent if rounding went to the next power
+     of ten. */
+  if( txt_format_round(x, sig)==0 ) return 0;
+  if(*sig==txt_pow10u[ndig]) { *sig=txt_pow10u[ndig-1]; ++e; }
+  *exp=e;
+  return 1;
+}
+
+
+
+
+
+/* Write the 'ndig' digits in 'sig' in the '%e' notation ('d.ddde+XX')
+   into 'out' and return the number of characters. When 'strip' is
+   non-zero, the trailing zeros of the fraction will be removed (as in
+   '%g'). */
+static size_t
+txt_format_e(char *out, uint64_t sig, int ndig, int exp, int strip)
+{
+  size_t len=0;
+  int nfrac=ndig-1;
+
+  /* Remove the trailing zeros if necessary. */
+  if(strip) while(nfrac && sig%10==0) { sig/=10; --nfrac; }
+
+  /* The digits. */
+  txt_format_digits(out+1, sig, nfrac+1);
+  out[0]=out[1];
+  if(nfrac) { out[1]='.'; len=nfrac+2; }
+  else len=1;
+
+  /* The exponent (with at least two digits). */
+  out[len++]='e';
+  out[len++] = exp<0 ? '-' : '+';
+  if(exp<0) exp=-exp;
+  if(exp>=100) out[len++]='0'+exp/100;
+  out[len++]='0'+(exp/10)%10;
+  out[len++]='0'+exp%10;
+  return len;
+}
+
+
+
+
+
+/* Write 'sig' (with 'nfrac' digits after the decimal point) in the '%f'
+   notation into 'out' and return the number of characters. When 'strip'
+   is non-zero, the trailing zeros of the fraction will be removed (as in
+   '%g'). */
+static size_t
+txt_format_f(char *out, uint64_t sig, int nfrac, int strip)
+{
+  int nint;
+  uint64_t ipart;
+
+  /* Remove the trailing zeros if necessary. */
+  if(strip) while(nfrac && sig%10==0) { sig/=10; --nfrac; }
+
+  /* The integer part, then the fraction. */
+  ipart=sig/txt_pow10u[nfrac];
+  nint=txt_format_ndigits(ipart);
+  txt_format_digits(out, ipart, nint);
+  if(nfrac==0) return nint;
+  out[nint]='.';
+  txt_format_digits(out+nint+1, sig-ipart*txt_pow10u[nfrac], nfrac);
+  return nint+1+nfrac;
+}
+
+
+
+
+
+/* Format the floating point 'v' with the '%e', '%f' or '%g' conversions
+   of 'spec' into 'out' and return the number of characters. If the value
+   can't be reliably formatted here (for example NaN, infinity, very large
+   or small exponents, or rounding that is too close to call), this
+   function will return 0. */
+static size_t
+txt_format_float(char *out, struct txt_fmt *spec, double v)
+{
+  long double x;
+  uint64_t sig;
+  size_t len=0;
+  int p=spec->prec, exp;
+
+  /* Values that are printed by 'printf'. */
+  if( !isfinite(v) ) return 0;
+
+  /* The sign ('signbit' is used to also account for '-0.0'). */
+  if( signbit(v) ) { out[len++]='-'; v=-v; }
+  else if(spec->space) out[len++]=' ';
+
+  /* Zero is simple. */
+  if(v==0.0)
+    switch(spec->conv)
+      {
+      case 'e': return len + txt_format_e(out+len, 0, p+1, 0, 0);
+      case 'f': return len + txt_format_f(out+len, 0, p,      0);
+      default:  out[len]='0'; return len+1;
+      }
+
+  /* Non-zero values. */
+  switch(spec->conv)
+    {
+    case 'e':
+      if( txt_format_significand(v, p+1, &sig, &exp)==0 ) return 0;
+      return len + txt_format_e(out+len, sig, p+1, exp, 0);
+
+    case 'f':
+      x=txt_format_scale(v, p);
+      if( x>=0x1p53L || txt_format_round(x, &sig)==0 ) return 0;
+      return len + txt_format_f(out+len, sig, p, 0);
+
+    case 'g':
+      if(p==0) p=1;
+      if( txt_format_significand(v, p, &sig, &exp)==0 ) return 0;
+      if(exp<p && exp>=-4)
+        {
+          /* The '%f' notation with 'p-1-exp' digits after the point. When
+             the exponent is negative, 'sig' only has the significant
+             digits, and 'txt_format_f' will add the leading zeros. */
+          return len + txt_format_f(out+len, sig, p-1-exp, 1);
+        }
+      else
+        return len + txt_format_e(out+len, sig, p, exp, 1);
+    }
+
+  /* Other conversions (shouldn't happen, this is only for safety). */
+  return 0;
+}
+
+
+
+
+
+/* Write the value of 'data' at index 'ind' into the buffer with the
+   format in 'spec'. */
 static void
-txt_print_value(FILE *fp, gal_data_t *data, size_t ind, char *fmt)
+txt_write_value(struct txt_buffer *buf, gal_data_t *data, size_t ind,
+                struct txt_fmt *spec)
 {
+  char *str;
+  int64_t sv;
+  uint64_t uv;
+  size_t len=0;
+  int direct=0;
   void *a=data->array;
+  char out[TXT_WRITE_VALUE_MAX];
 
   switch(data->type)
     {
       /* Numerical types. */
-    case GAL_TYPE_UINT8:   fprintf(fp, fmt, ((uint8_t *) a)[ind]); break;
-    case GAL_TYPE_INT8:    fprintf(fp, fmt, ((int8_t *)  a)[ind]); break;
-    case GAL_TYPE_UINT16:  fprintf(fp, fmt, ((uint16_t *)a)[ind]); break;
-    case GAL_TYPE_INT16:   fprintf(fp, fmt, ((int16_t *) a)[ind]); break;
-    case GAL_TYPE_UINT32:  fprintf(fp, fmt, ((uint32_t *)a)[ind]); break;
-    case GAL_TYPE_INT32:   fprintf(fp, fmt, ((int32_t *) a)[ind]); break;
-    case GAL_TYPE_UINT64:  fprintf(fp, fmt, ((uint64_t *)a)[ind]); break;
-    case GAL_TYPE_INT64:   fprintf(fp, fmt, ((int64_t *) a)[ind]); break;
-    case GAL_TYPE_FLOAT32: fprintf(fp, fmt, ((float *)   a)[ind]); break;
-    case GAL_TYPE_FLOAT64: fprintf(fp, fmt, ((double *)  a)[ind]); break;
-
-      /* Special consideration for strings. */
-    case GAL_TYPE_STRING:
-      if( !strcmp( ((char **)a)[ind], GAL_BLANK_STRING ) )
-        fprintf(fp, fmt, GAL_BLANK_STRING);
-      else
-        fprintf(fp, fmt, ((char **)a)[ind]);
+    case GAL_TYPE_UINT8:  uv=((uint8_t  *)a)[ind]; goto unsign;
+    case GAL_TYPE_UINT16: uv=((uint16_t *)a)[ind]; goto unsign;
+    case GAL_TYPE_UINT32: uv=((uint32_t *)a)[ind]; goto unsign;
+    case GAL_TYPE_UINT64: uv=((uint64_t *)a)[ind];
+    unsign:
+      if(spec->fast) { len=txt_format_int(out, spec, 0, uv); direct=1; }
+      else if(data->type==GAL_TYPE_UINT64)
+        txt_buffer_printf(buf, spec->fmt, uv);
+      else txt_buffer_printf(buf, spec->fmt, (unsigned int)uv);
+      break;
+
+    case GAL_TYPE_INT8:   sv=((int8_t   *)a)[ind]; goto sign;
+    case GAL_TYPE_INT16:  sv=((int16_t  *)a)[ind]; goto sign;
+    case GAL_TYPE_INT32:  sv=((int32_t  *)a)[ind]; goto sign;
+    case GAL_TYPE_INT64:  sv=((int64_t  *)a)[ind];
+    sign:
+      if(spec->fast)
+        {
+          len=txt_format_int(out, spec, sv<0,
+                             sv<0 ? -(uint64_t)sv : (uint64_t)sv);
+          direct=1;
+        }
+      else if(data->type==GAL_TYPE_INT64)
+        txt_buffer_printf(buf, spec->fmt, sv);
+      else txt_buffer_printf(buf, spec->fmt, (int)sv);
+      break;
+
+    case GAL_TYPE_FLOAT32:
+      if( spec->fast
+          && (len=txt_format_float(out, spec, ((float *)a)[ind])) )
+        direct=1;
+      else txt_buffer_printf(buf, spec->fmt, ((float *)a)[ind]);
+      break;
+
+    case GAL_TYPE_FLOAT64:
+      if( spec->fast
+          && (len=txt_format_float(out, spec, ((double *)a)[ind])) )
+        direct=1;
+      else txt_buffer_printf(buf, spec->fmt, ((double *)a)[ind]);
       break;
 
+      /* Strings (blank strings are also printed as they are, and NULL
+         pointers are printed like the 'printf' of the GNU C Library). */
+    case GAL_TYPE_STRING:
+      str=((char **)a)[ind];
+      if(str==NULL) str="(null)";
+      if(spec->fast) txt_buffer_put(buf, spec, str, strlen(str));
+      else     txt_buffer_printf(buf, spec->fmt, str);
+      return;
+
     default:
       error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
             __func__, data->type);
     }
+
+  /* Put the directly formatted value into the buffer. */
+  if(direct) txt_buffer_put(buf, spec, out, len);
 }
 
 
 
 
 
+
 static void
 txt_write_metadata(FILE *fp, gal_data_t *datall, char **fmts,
                    int tab0_img1)
@@ -1998,6 +2758,8 @@ gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t **keylist,
   FILE *fp;
   char **fmts;
   gal_list_str_t *strt;
+  struct txt_buffer buf;
+  struct txt_fmt *specs, *spec;
   size_t i, j, k, num=0, d1;
   gal_data_t *data, *nextimg=NULL;
 
@@ -2081,40 +2843,72 @@ gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t **keylist,
     txt_write_metadata(fp, input, fmts, tab0_img1);
 
 
-  /* Print row-by-row (if we actually have data to print! */
+  /* Print row-by-row (if we actually have data to print!). The values
+     are formatted into a large buffer that is written into the file when
+     it is full. Since the buffer is written with the same 'FILE' pointer,
+     its contents will be placed after the metadata above. */
   if(input->array)
     {
+      /* Parse the formats: the second format of each column is the one
+         for the last element of a vector column (when it is the last
+         column). */
+      errno=0;
+      specs=malloc(2*num*sizeof *specs);
+      buf.a=malloc(TXT_WRITE_BUFFER_SIZE);
+      if(specs==NULL || buf.a==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate the formats "
+              "or the %d byte buffer", __func__, TXT_WRITE_BUFFER_SIZE);
+      for(k=0, data=input; k<num; ++k, data=data->next)
+        {
+          /* The last-element format is only written for the last column
+             (and only differs when it is a vector). */
+          txt_fmt_parse(fmts[k*FMTS_COLS], &specs[2*k]);
+          if(data->next==NULL && data->ndim==2)
+            txt_fmt_parse(fmts[k*FMTS_COLS+3], &specs[2*k+1]);
+          else specs[2*k+1]=specs[2*k];
+        }
+      buf.fp=fp;
+      buf.n=0;
+      buf.size=TXT_WRITE_BUFFER_SIZE;
+
+      /* Write the values. */
       if(tab0_img1) /* Image. */
         for(i=0;i<input->dsize[0];++i)
           {
             d1=input->dsize[1];
             for(j=0;j<d1;++j)
-              txt_print_value(fp, input, i*d1+j, fmts[j==d1-1 ? 3 : 0]);
-            fprintf(fp, "\n");
+              txt_write_value(&buf, input, i*d1+j, &specs[j==d1-1]);
+            txt_buffer_write(&buf, "\n", 1);
           }
       else /* Table. */
         {
           for(i=0;i<input->dsize[0];++i)                  /* Row.    */
             {
-              k=0; /* Column counter. */
+              spec=specs; /* Formats of the column. */
               for(data=input;data!=NULL;data=data->next)  /* Column. */
                 {
                   if(data->ndim>1)  /* Vector column. */
                     {
                       d1=data->dsize[1];
                       for(j=0;j<d1;++j)
-                        txt_print_value(fp, data, i*d1+j,
-                          fmts[ k * FMTS_COLS
-                      /* Last of vector column has a different format. */
-                                + (j==d1-1 && data->next==NULL ? 3 : 0) ]);
+                        txt_write_value(&buf, data, i*d1+j,
+                                        /* Last of vector column has a
+                                           different format. */
+                                        spec + (j==d1-1
+                                                && data->next==NULL) );
                     }
                   else /* Non-vector column: simple! */
-                    txt_print_value(fp, data, i, fmts[k * FMTS_COLS]);
-                  ++k;
+                    txt_write_value(&buf, data, i, spec);
+                  spec+=2;
                 }
-              fprintf(fp, "\n");
+              txt_buffer_write(&buf, "\n", 1);
             }
         }
+
+      /* Write the remaining contents of the buffer and clean up. */
+      txt_buffer_flush(&buf);
+      free(specs);
+      free(buf.a);
     }
 
 
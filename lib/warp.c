@@ -26,16 +26,22 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <errno.h>
 #include <error.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <gnuastro/wcs.h>
+#include <gnuastro/fits.h>
 #include <gnuastro/type.h>
 #include <gnuastro/warp.h>
 #include <gnuastro/blank.h>
+#include <gnuastro/table.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/polygon.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
 
+#include <gnuastro-internal/checkset.h>
+
 
 
 
@@ -235,8 +241,9 @@ warp_wcsalign_init_output_from_params(gal_warp_wcsalign_t *wa)
           "given center is too far from the image)", __func__, osize[1],
           osize[0]);
 
-  /* Create the output image dataset with the base WCS */
-  wa->output=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 2, osize, bwcs, 0,
+  /* Create the output image dataset with the base WCS (with the same
+     type as the input). */
+  wa->output=gal_data_alloc(NULL, input->type, 2, osize, bwcs, 0,
                             minmapsize, quietmmap,
                             GAL_WARP_OUTPUT_NAME_WARPED, NULL, NULL);
 
@@ -572,8 +579,9 @@ warp_wcsalign_init_output_from_wcs(gal_warp_wcsalign_t *wa,
   int quietmmap=wa->input->quietmmap;
   size_t *dsize=wa->widthinpix->array, minmapsize=wa->input->minmapsize;
 
-  /* Create the output image dataset with the target WCS given. */
-  output=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 2, dsize, wa->twcs, 0,
+  /* Create the output image dataset with the target WCS given (with the
+     same type as the input). */
+  output=gal_data_alloc(NULL, wa->input->type, 2, dsize, wa->twcs, 0,
                         minmapsize, quietmmap, GAL_WARP_OUTPUT_NAME_WARPED,
                         NULL, NULL);
 
@@ -594,10 +602,12 @@ warp_check_basic_params(gal_warp_wcsalign_t *wa, const char *func)
   if(wa==NULL) error(EXIT_FAILURE, 0, "%s: 'wa' structure is NULL", func);
   if(wa->input==NULL) error(EXIT_FAILURE, 0, "%s: input is NULL", func);
 
-  /* This function assumes the input is double precision. */
-  if(wa->input->type != GAL_TYPE_FLOAT64)
-    error(EXIT_FAILURE, 0, "%s: input must have a double precision "
-          "floating point type, but its type is '%s', you can use "
+  /* The input should be floating point (single or double precision). The
+     sums are done in double precision for both. */
+  if(wa->input->type != GAL_TYPE_FLOAT32
+     && wa->input->type != GAL_TYPE_FLOAT64)
+    error(EXIT_FAILURE, 0, "%s: input must have a floating point type "
+          "('float32' or 'float64'), but its type is '%s', you can use "
           "'gal_data_copy_to_new_type' or "
           "'gal_data_copy_to_new_type_free' for the conversion", func,
           gal_type_name(wa->input->type, 1));
@@ -891,6 +901,10 @@ gal_warp_wcsalign_init(gal_warp_wcsalign_t *wa)
 
 
 
+/* Warp one output pixel. The input pixel values can be single or double
+   precision, but the sum is always done in double precision. When
+   'wa->inrows' is given, only the input rows within it are used (the
+   rest of the input is treated like the regions outside of it). */
 void
 gal_warp_wcsalign_onpix(gal_warp_wcsalign_t *wa, size_t ind)
 {
@@ -899,22 +913,28 @@ gal_warp_wcsalign_onpix(gal_warp_wcsalign_t *wa, size_t ind)
   gal_data_t *output=wa->output;
   double xmin, xmax, ymin, ymax;
   long xstart, ystart, xend, yend, x, y; /* Might be negative */
-  double filledarea, v, *ocrn=NULL, pcrn[8], opixarea;
+  double filledarea, sum, v, *ocrn=NULL, pcrn[8], opixarea;
 
   size_t numcrn=0;
   size_t ncrn=wa->ncrn;
   size_t is0=input->dsize[0];
   size_t is1=input->dsize[1];
-  double *inputarr=input->array;
-  double *outputarr=output->array;
   double ccrn[GAL_POLYGON_MAX_CORNERS], area;
   double *maxfrac=output->next ? output->next->array : NULL;
 
+  /* The input pixels in memory: 'memfirst' and 'memlast' are the first
+     and last input rows (counting from 1) that are available. */
+  gal_data_t *inmem = wa->inrows ? wa->inrows : input;
+  size_t memfirst = wa->inrows ? wa->inrowstart+1 : 1;
+  size_t memlast = memfirst+inmem->dsize[0]-1;
+  float  *in32 = inmem->type==GAL_TYPE_FLOAT32 ? inmem->array : NULL;
+  double *in64 = inmem->type==GAL_TYPE_FLOAT64 ? inmem->array : NULL;
+
   /* Initialize if asked for each pixel's maximum coverage fraction. */
   if(maxfrac) maxfrac[ind]=-DBL_MAX;
 
   /* Initialize the output pixel value: */
-  outputarr[ind] = filledarea = 0.0f;
+  sum = filledarea = 0.0f;
 
   if( wa->isccw==1 )
     ocrn=warp_pixel_perimeter_cw(wa, ind);
@@ -949,8 +969,8 @@ gal_warp_wcsalign_onpix(gal_warp_wcsalign_t *wa, size_t ind)
   for(y=ystart;y<yend;++y)
     {
       /* If the pixel isn't in the image (note that the pixel
-         coordinates start from 1), skip this pixel. */
-      if( y<1 || y>is0 ) continue;
+         coordinates start from 1) or isn't in memory, skip it. */
+      if( y<1 || y>is0 || y<memfirst || y>memlast ) continue;
 
       /* Y of base pixel vertices, in pixel coords. */
       pcrn[1]=y-0.5f; pcrn[3]=y-0.5f;
@@ -965,7 +985,9 @@ gal_warp_wcsalign_onpix(gal_warp_wcsalign_t *wa, size_t ind)
           pcrn[4]=x+0.5f; pcrn[6]=x-0.5f;
 
           /* Read the value of the input pixel. */
-          v=inputarr[(y-1)*is1+x-1];
+          v = ( in32
+                ? in32[ (y-memfirst)*is1+x-1 ]
+                : in64[ (y-memfirst)*is1+x-1 ] );
 
           /* Find the overlapping (clipped) polygon: */
           numcrn=0; /* initialize it. */
@@ -983,12 +1005,11 @@ gal_warp_wcsalign_onpix(gal_warp_wcsalign_t *wa, size_t ind)
             {
               numinput+=1;
               filledarea+=area;
-              outputarr[ind]+=v*area;
+              sum+=v*area;
 
               /* Check
                  printf("Check: numinput %zu filledarea %f "
-                 "outputarr[%zu]=%f\n",
-                 filledarea, ind, outputarr[ind]);
+                 "sum[%zu]=%f\n", numinput, filledarea, ind, sum);
               */
             }
         }
@@ -1005,7 +1026,9 @@ gal_warp_wcsalign_onpix(gal_warp_wcsalign_t *wa, size_t ind)
     numinput=0;
 
   /* Write the final value and return. */
-  if( numinput==0 ) outputarr[ind]=NAN;
+  if( numinput==0 ) sum=NAN;
+  if(output->type==GAL_TYPE_FLOAT32) ((float  *)(output->array))[ind]=sum;
+  else                               ((double *)(output->array))[ind]=sum;
 
   /* Clean up. */
   free(ocrn);
@@ -1038,6 +1061,147 @@ gal_warp_wcsalign_onthread(void *inparam)
 
 
 
+/* Find the input rows that overlap with the 'number' output rows starting
+   from output row 'first' (both counting from zero). The first necessary
+   input row (counting from zero) is written in 'infirst' and the number
+   of necessary rows in 'innumber' (which will be zero if the band doesn't
+   overlap with the input). This can only be called after
+   'gal_warp_wcsalign_init' (when the output vertices are in the input's
+   pixel coordinates). */
+void
+gal_warp_wcsalign_inrows(gal_warp_wcsalign_t *wa, size_t first,
+                         size_t number, size_t *infirst, size_t *innumber)
+{
+  long ystart, yend;
+  double ymin=DBL_MAX, ymax=-DBL_MAX, *y;
+  size_t i, os1, hfirst, hlast, vfirst, vlast;
+  size_t os0=wa->output ? wa->output->dsize[0] : 0;
+
+  /* Sanity checks. */
+  if(wa->vertices==NULL)
+    error(EXIT_FAILURE, 0, "%s: the output vertices are not defined, "
+          "this function should be called after 'gal_warp_wcsalign_init'",
+          __func__);
+  if(number==0 || first+number>os0)
+    error(EXIT_FAILURE, 0, "%s: the output has %zu rows, but %zu rows "
+          "starting from row %zu were requested", __func__, os0, number,
+          first);
+
+  /* The horizontal vertices of each output row are contiguous (the top
+     vertices of one row are the bottom vertices of the next) and so are
+     the vertical ones (that start from 'v0'). */
+  os1=wa->output->dsize[1];
+  y=wa->vertices->next->array;
+  hfirst=first*wa->gcrn;
+  hlast=(first+number+1)*wa->gcrn;
+  vfirst=wa->v0+wa->edgesampling*first*(os1+1);
+  vlast=wa->v0+wa->edgesampling*(first+number)*(os1+1);
+  for(i=hfirst;i<hlast;++i)
+    { if(y[i]<ymin) ymin=y[i]; if(y[i]>ymax) ymax=y[i]; }
+  for(i=vfirst;i<vlast;++i)
+    { if(y[i]<ymin) ymin=y[i]; if(y[i]>ymax) ymax=y[i]; }
+
+  /* Convert the range of vertices to input rows (like
+     'gal_warp_wcsalign_onpix'), only keeping the rows within the
+     input. */
+  *infirst=*innumber=0;
+  if(ymin>ymax) return;
+  ystart = GAL_DIMENSION_NEARESTINT_HALFHIGHER( ymin );
+  yend   = GAL_DIMENSION_NEARESTINT_HALFLOWER(  ymax ) + 1;
+  if(ystart<1) ystart=1;
+  if(yend>(long)(wa->input->dsize[0])+1) yend=wa->input->dsize[0]+1;
+  if(yend>ystart)
+    {
+      *infirst=ystart-1;
+      *innumber=yend-ystart;
+    }
+}
+
+
+
+
+
+/* Parameters for warping a band of output rows. */
+struct warp_rows_params
+{
+  size_t                 offset;  /* Index of first output pixel.      */
+  gal_warp_wcsalign_t       *wa;  /* Warp parameters.                  */
+};
+
+
+
+
+
+static void *
+warp_wcsalign_rows_onthread(void *inparam)
+{
+  size_t i;
+  struct gal_threads_params *tprm=(struct gal_threads_params *)inparam;
+  struct warp_rows_params *rprm=(struct warp_rows_params *)tprm->params;
+
+  /* Loop over the output pixels of this thread in the band. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    gal_warp_wcsalign_onpix(rprm->wa, rprm->offset+tprm->indexs[i]);
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) { pthread_barrier_wait(tprm->b); }
+  return NULL;
+}
+
+
+
+
+
+/* Fill the 'number' output rows starting from output row 'first'
+   (counting from zero). If 'wa->inrows' is given, the input's pixel
+   values will be read from it (its first row is row 'wa->inrowstart' of
+   the input), so 'wa->input' only needs the input's size, type and WCS
+   (its 'array' can be NULL). In this way, a very large input doesn't
+   have to be fully in memory: the input rows that are necessary for each
+   band of output rows can be found with 'gal_warp_wcsalign_inrows'. */
+void
+gal_warp_wcsalign_rows(gal_warp_wcsalign_t *wa, size_t first,
+                       size_t number)
+{
+  gal_data_t *inrows=wa->inrows;
+  struct warp_rows_params rprm;
+
+  /* Sanity checks. */
+  if(wa->output==NULL || wa->vertices==NULL)
+    error(EXIT_FAILURE, 0, "%s: the output is not initialized, this "
+          "function should be called after 'gal_warp_wcsalign_init'",
+          __func__);
+  if(first+number>wa->output->dsize[0])
+    error(EXIT_FAILURE, 0, "%s: the output has %zu rows, but %zu rows "
+          "starting from row %zu were requested", __func__,
+          wa->output->dsize[0], number, first);
+  if(inrows)
+    {
+      if( inrows->type!=wa->input->type || inrows->ndim!=2
+          || inrows->dsize[1]!=wa->input->dsize[1]
+          || wa->inrowstart+inrows->dsize[0]>wa->input->dsize[0] )
+        error(EXIT_FAILURE, 0, "%s: 'inrows' must be a 2D dataset with "
+              "the same type and number of columns as 'input', and its "
+              "rows (starting from 'inrowstart') must be within the "
+              "input", __func__);
+    }
+  else if(wa->input->array==NULL)
+    error(EXIT_FAILURE, 0, "%s: the input has no pixels in memory and "
+          "no 'inrows' are given", __func__);
+  if(number==0) return;
+
+  /* Warp the pixels of this band. */
+  rprm.wa=wa;
+  rprm.offset=first*wa->output->dsize[1];
+  gal_threads_spin_off(warp_wcsalign_rows_onthread, &rprm,
+                       number*wa->output->dsize[1], wa->numthreads,
+                       wa->input->minmapsize, wa->input->quietmmap);
+}
+
+
+
+
+
 /* Helper function that returns an empty set of the wcsalign data structure
    to prevent using uninitialized variables without warnings. Please note
    if you are not using this template to set 'gal_warp_wcsalign_t' values,
@@ -1055,9 +1219,11 @@ gal_warp_wcsalign_template()
   wa.center=NULL;
   wa.output=NULL;
   wa.vertices=NULL;
+  wa.inrows=NULL;
   wa.widthinpix=NULL;
 
   /* Initialize values. */
+  wa.inrowstart=0;
   wa.checkmaxfrac=0;
   wa.isccw=GAL_BLANK_INT;
   wa.v0=GAL_BLANK_SIZE_T;
@@ -1095,9 +1261,7 @@ gal_warp_wcsalign(gal_warp_wcsalign_t *wa)
   gal_warp_wcsalign_init(wa);
 
   /* Fill the output image */
-  gal_threads_spin_off(gal_warp_wcsalign_onthread, wa, wa->output->size,
-                       wa->numthreads, wa->input->minmapsize,
-                       wa->input->quietmmap);
+  gal_warp_wcsalign_rows(wa, 0, wa->output->dsize[0]);
 
   /* Clean up the internally allocated variables */
   gal_warp_wcsalign_free(wa);
@@ -1185,3 +1349,446 @@ gal_warp_pixelarea(gal_warp_wcsalign_t *wa)
   /* Clean up. */
   gal_warp_wcsalign_free(wa);
 }
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/*******************         Overlap weights         *****************/
+/*********************************************************************/
+/* Parameters for finding (or applying) the overlap weights. The overlaps
+   are found separately for each output row (each row is one job for the
+   threads), so the overlaps of all rows can be concatenated (in order of
+   the rows) to have them sorted by the output pixel index. */
+struct warp_weights_params
+{
+  gal_warp_wcsalign_t     *wa;  /* Warping parameters ('weights' only).  */
+  size_t              *number;  /* Number of overlaps in each row.       */
+  int64_t            **outind;  /* Output pixel index of each overlap.   */
+  int64_t             **inind;  /* Input pixel index of each overlap.    */
+  double               **area;  /* Overlapping area (in input pixels).   */
+
+  gal_data_t         *weights;  /* Overlap weights ('apply' only).       */
+  gal_data_t           *input;  /* Input image ('apply' only).           */
+  gal_data_t          *output;  /* Output image ('apply' only).          */
+  size_t            *rowstart;  /* First overlap of each output pixel.   */
+  double          coveredfrac;  /* Acceptable fraction of output covered.*/
+};
+
+
+
+
+
+/* Add one overlap to the arrays of output row 'id' (allocating more
+   space if necessary). */
+static void
+warp_weights_add(struct warp_weights_params *wprm, size_t id,
+                 size_t *allocated, int64_t outind, int64_t inind,
+                 double area)
+{
+  size_t n=wprm->number[id];
+
+  /* Allocate more space if necessary. */
+  if(n==*allocated)
+    {
+      *allocated = *allocated ? *allocated*2 : 64;
+      errno=0;
+      wprm->outind[id]=realloc(wprm->outind[id],
+                               *allocated*sizeof *wprm->outind[id]);
+      wprm->inind[id]=realloc(wprm->inind[id],
+                              *allocated*sizeof *wprm->inind[id]);
+      wprm->area[id]=realloc(wprm->area[id],
+                             *allocated*sizeof *wprm->area[id]);
+      if(wprm->outind[id]==NULL || wprm->inind[id]==NULL
+         || wprm->area[id]==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate space for "
+              "%zu overlaps", __func__, *allocated);
+    }
+
+  /* Write the values. */
+  wprm->outind[id][n] = outind;
+  wprm->inind[id][n]  = inind;
+  wprm->area[id][n]   = area;
+  ++wprm->number[id];
+}
+
+
+
+
+
+/* Find the overlaps of the output pixels in the rows of one thread. This
+   is the same as 'gal_warp_wcsalign_onpix', but instead of using the
+   input's pixel values, the index and area of all the input pixels that
+   overlap with each output pixel are kept (in the same order). */
+static void *
+warp_weights_onthread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct warp_weights_params *wprm=tprm->params;
+  gal_warp_wcsalign_t *wa=wprm->wa;
+
+  size_t i, row, numcrn, allocated;
+  size_t ind, ic, temp, os1=wa->output->dsize[1];
+  double xmin, xmax, ymin, ymax, area;
+  size_t ncrn=wa->ncrn, is0=wa->input->dsize[0], is1=wa->input->dsize[1];
+  double *ocrn, pcrn[8], ccrn[GAL_POLYGON_MAX_CORNERS];
+  double *pixarea=wa->output->array;
+  long xstart, ystart, xend, yend, x, y; /* Might be negative */
+  double *(*warp_pixel_perimeter)(gal_warp_wcsalign_t *, size_t)=
+    wa->isccw==1 ? warp_pixel_perimeter_cw : warp_pixel_perimeter_ccw;
+
+  /* Go over the output pixels of the rows of this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      row=tprm->indexs[i];
+      allocated=0;
+      for(ind=row*os1; ind<(row+1)*os1; ++ind)
+        {
+          /* Find the bounding box of this output pixel over the input. */
+          ocrn=warp_pixel_perimeter(wa, ind);
+          xmin =  DBL_MAX; ymin =  DBL_MAX;
+          xmax = -DBL_MAX; ymax = -DBL_MAX;
+          for(ic=ncrn; ic--;)
+            {
+              temp=ic*2;
+              if(xmin > ocrn[ temp   ]) { xmin = ocrn[ temp   ]; }
+              if(xmax < ocrn[ temp   ]) { xmax = ocrn[ temp   ]; }
+              if(ymin > ocrn[ temp+1 ]) { ymin = ocrn[ temp+1 ]; }
+              if(ymax < ocrn[ temp+1 ]) { ymax = ocrn[ temp+1 ]; }
+            }
+          xstart = GAL_DIMENSION_NEARESTINT_HALFHIGHER( xmin );
+          ystart = GAL_DIMENSION_NEARESTINT_HALFHIGHER( ymin );
+          xend   = GAL_DIMENSION_NEARESTINT_HALFLOWER(  xmax ) + 1;
+          yend   = GAL_DIMENSION_NEARESTINT_HALFLOWER(  ymax ) + 1;
+
+          /* Keep the overlap with all the input pixels in the box. */
+          for(y=ystart;y<yend;++y)
+            {
+              if( y<1 || y>is0 ) continue;
+              pcrn[1]=y-0.5f; pcrn[3]=y-0.5f;
+              pcrn[5]=y+0.5f; pcrn[7]=y+0.5f;
+              for(x=xstart;x<xend;++x)
+                {
+                  if( x<1 || x>is1 ) continue;
+                  pcrn[0]=x-0.5f; pcrn[2]=x+0.5f;
+                  pcrn[4]=x+0.5f; pcrn[6]=x-0.5f;
+                  numcrn=0;
+                  gal_polygon_clip(ocrn, ncrn, pcrn, 4, ccrn, &numcrn);
+                  area=gal_polygon_area(ccrn, numcrn);
+                  warp_weights_add(wprm, row, &allocated, ind,
+                                   (y-1)*is1+x-1, area);
+                }
+            }
+
+          /* Area of the output pixel (in units of input pixels). */
+          pixarea[ind]=gal_polygon_area(ocrn, ncrn);
+          free(ocrn);
+        }
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Find the overlap of every output pixel with the input pixels, without
+   using the input's pixel values. The result is written in 'wa->output'
+   as a list of four datasets (to be freed with 'gal_list_data_free'):
+
+     1. The area of each output pixel (in units of input pixels). This is
+        a 2D image with the output's size and WCS.
+     2. 'OUT-INDEX': The output pixel index of each overlap (sorted).
+     3. 'IN-INDEX': The input pixel index of each overlap.
+     4. 'AREA': The overlapping area (in units of input pixels).
+
+   The warping can then be done on any number of inputs with the same
+   size and WCS with 'gal_warp_weights_apply' (which only does a sparse
+   matrix-vector product). */
+void
+gal_warp_wcsalign_weights(gal_warp_wcsalign_t *wa)
+{
+  double *a;
+  int64_t *o, *i;
+  size_t t, nrows, total=0;
+  gal_data_t *outind, *inind, *area;
+  struct warp_weights_params wprm={0};
+
+  /* Calculate and allocate the output image size and WCS. The maximum
+     coverage fraction is not relevant here (it depends on the input). */
+  gal_warp_wcsalign_init(wa);
+  if(wa->output->next)
+    { gal_data_free(wa->output->next); wa->output->next=NULL; }
+
+  /* The output has the input's type, but the areas are double
+     precision. */
+  if(wa->output->type!=GAL_TYPE_FLOAT64)
+    wa->output=gal_data_copy_to_new_type_free(wa->output,
+                                              GAL_TYPE_FLOAT64);
+
+  /* Allocate the per-row arrays. */
+  wprm.wa=wa;
+  nrows=wa->output->dsize[0];
+  wprm.number=gal_pointer_allocate(GAL_TYPE_SIZE_T, nrows, 1, __func__,
+                                   "wprm.number");
+  errno=0;
+  wprm.outind=calloc(nrows, sizeof *wprm.outind);
+  wprm.inind=calloc(nrows, sizeof *wprm.inind);
+  wprm.area=calloc(nrows, sizeof *wprm.area);
+  if(wprm.outind==NULL || wprm.inind==NULL || wprm.area==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate the per-row "
+          "arrays", __func__);
+
+  /* Find the overlaps (each output row is one job). */
+  gal_threads_spin_off(warp_weights_onthread, &wprm, nrows,
+                       wa->numthreads, wa->input->minmapsize,
+                       wa->input->quietmmap);
+
+  /* Allocate the output columns and concatenate the overlaps of all the
+     rows into them. */
+  for(t=0;t<nrows;++t) total+=wprm.number[t];
+  outind=gal_data_alloc(NULL, GAL_TYPE_INT64, 1, &total, NULL, 0,
+                        wa->input->minmapsize, wa->input->quietmmap,
+                        "OUT-INDEX", "counter", "Index of output pixel "
+                        "(counting from 0).");
+  inind=gal_data_alloc(NULL, GAL_TYPE_INT64, 1, &total, NULL, 0,
+                       wa->input->minmapsize, wa->input->quietmmap,
+                       "IN-INDEX", "counter", "Index of input pixel "
+                       "(counting from 0).");
+  area=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &total, NULL, 0,
+                      wa->input->minmapsize, wa->input->quietmmap,
+                      "AREA", "pixel", "Overlap area (in input pixels).");
+  o=outind->array; i=inind->array; a=area->array;
+  for(t=0;t<nrows;++t)
+    {
+      if(wprm.number[t])
+        {
+          memcpy(o, wprm.outind[t], wprm.number[t]*sizeof *o);
+          memcpy(i, wprm.inind[t],  wprm.number[t]*sizeof *i);
+          memcpy(a, wprm.area[t],   wprm.number[t]*sizeof *a);
+          o+=wprm.number[t]; i+=wprm.number[t]; a+=wprm.number[t];
+        }
+      free(wprm.outind[t]);
+      free(wprm.inind[t]);
+      free(wprm.area[t]);
+    }
+
+  /* The output image now contains the area of each output pixel. */
+  free(wa->output->name);
+  gal_checkset_allocate_copy(GAL_WARP_OUTPUT_NAME_PIXAREA,
+                             &wa->output->name);
+  wa->output->next=outind;
+  outind->next=inind;
+  inind->next=area;
+
+  /* Clean up. */
+  free(wprm.area);
+  free(wprm.inind);
+  free(wprm.number);
+  free(wprm.outind);
+  gal_warp_wcsalign_free(wa);
+}
+
+
+
+
+
+/* Warp the output pixels of one thread using the overlap weights. This
+   follows 'gal_warp_wcsalign_onpix' exactly (the overlaps are in the same
+   order), so the output is identical to 'gal_warp_wcsalign'. */
+static void *
+warp_weights_apply_onthread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct warp_weights_params *wprm=tprm->params;
+
+  gal_data_t *weights=wprm->weights;
+  double v, sum, filledarea, *pixarea=weights->array;
+  size_t i, ind, e, numinput;
+  int64_t *inind=weights->next->next->array;
+  double *area=weights->next->next->next->array;
+  int is32=wprm->input->type==GAL_TYPE_FLOAT32;
+  float  *in32=wprm->input->array, *out32=wprm->output->array;
+  double *in64=wprm->input->array, *out64=wprm->output->array;
+
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Add the overlapping input pixels (in double precision). */
+      ind=tprm->indexs[i];
+      numinput=0;
+      sum=filledarea=0.0f;
+      for(e=wprm->rowstart[ind]; e<wprm->rowstart[ind+1]; ++e)
+        {
+          v = is32 ? in32[ inind[e] ] : in64[ inind[e] ];
+          if( !isnan(v) )
+            {
+              numinput+=1;
+              filledarea+=area[e];
+              sum+=v*area[e];
+            }
+        }
+
+      /* See if the pixel has enough coverage. */
+      if( numinput && filledarea/pixarea[ind] < wprm->coveredfrac-1e-5)
+        numinput=0;
+      if( numinput==0 ) sum=NAN;
+      if(is32) out32[ind]=sum; else out64[ind]=sum;
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Warp the input using the overlap weights that were found by
+   'gal_warp_wcsalign_weights' (or read with 'gal_warp_weights_read'). The
+   input must be a floating point (single or double precision) 2D image
+   with the same size (and WCS) as the input that the weights were found
+   for. The output will have the same type as the input. */
+gal_data_t *
+gal_warp_weights_apply(gal_data_t *weights, gal_data_t *input,
+                       double coveredfrac, size_t numthreads)
+{
+  int64_t *o, *i;
+  size_t e, nnz, osize;
+  gal_data_t *output, *outind, *inind, *area;
+  struct warp_weights_params wprm={0};
+
+  /* Basic sanity checks. */
+  if( weights==NULL || (outind=weights->next)==NULL
+      || (inind=outind->next)==NULL || (area=inind->next)==NULL )
+    error(EXIT_FAILURE, 0, "%s: the weights must be a list of four "
+          "datasets (see 'gal_warp_wcsalign_weights')", __func__);
+  if( weights->type!=GAL_TYPE_FLOAT64 || outind->type!=GAL_TYPE_INT64
+      || inind->type!=GAL_TYPE_INT64 || area->type!=GAL_TYPE_FLOAT64 )
+    error(EXIT_FAILURE, 0, "%s: the weights don't have the expected "
+          "types (see 'gal_warp_wcsalign_weights')", __func__);
+  if( weights->ndim!=2 || outind->size!=inind->size
+      || outind->size!=area->size )
+    error(EXIT_FAILURE, 0, "%s: the first dataset of the weights must be "
+          "a 2D image and the three columns after it must have the same "
+          "size", __func__);
+  if( (input->type!=GAL_TYPE_FLOAT32 && input->type!=GAL_TYPE_FLOAT64)
+      || input->ndim!=2 )
+    error(EXIT_FAILURE, 0, "%s: input must be a 2D image with a floating "
+          "point type ('float32' or 'float64'), but it is %zuD with type "
+          "'%s'", __func__, input->ndim, gal_type_name(input->type, 1));
+
+  /* Find the first overlap of each output pixel (the overlaps are sorted
+     by the output pixel index) and check the input indexs. */
+  nnz=outind->size;
+  osize=weights->size;
+  o=outind->array; i=inind->array;
+  wprm.rowstart=gal_pointer_allocate(GAL_TYPE_SIZE_T, osize+1, 1,
+                                     __func__, "wprm.rowstart");
+  for(e=0;e<nnz;++e)
+    {
+      if(o[e]<0 || (size_t)(o[e])>=osize || (e && o[e]<o[e-1]))
+        error(EXIT_FAILURE, 0, "%s: the output indexs of the weights "
+              "must be sorted and within the output image", __func__);
+      if(i[e]<0 || (size_t)(i[e])>=input->size)
+        error(EXIT_FAILURE, 0, "%s: input pixel index %ld of the weights "
+              "is not within the input image (with %zu pixels). The "
+              "weights were probably found for a different input",
+              __func__, (long)(i[e]), input->size);
+      ++wprm.rowstart[ o[e]+1 ];
+    }
+  for(e=0;e<osize;++e) wprm.rowstart[e+1]+=wprm.rowstart[e];
+
+  /* Allocate the output image (with the WCS of the weights). */
+  output=gal_data_alloc(NULL, input->type, 2, weights->dsize,
+                        weights->wcs, 0, input->minmapsize,
+                        input->quietmmap, GAL_WARP_OUTPUT_NAME_WARPED,
+                        NULL, NULL);
+
+  /* Do the warping (each output pixel is one job). */
+  if(numthreads==0) numthreads=gal_threads_number();
+  wprm.input=input;
+  wprm.output=output;
+  wprm.weights=weights;
+  wprm.coveredfrac=coveredfrac;
+  gal_threads_spin_off(warp_weights_apply_onthread, &wprm, osize,
+                       numthreads, input->minmapsize, input->quietmmap);
+
+  /* Clean up and return. */
+  free(wprm.rowstart);
+  return output;
+}
+
+
+
+
+
+/* Write the overlap weights into a FITS file: the area of each output
+   pixel (that also has the output's WCS) is written as an image HDU and
+   the overlaps are written as a binary table HDU after it (both are
+   appended to the file if it already exists). */
+void
+gal_warp_weights_write(gal_data_t *weights, char *filename)
+{
+  gal_data_t *cols;
+
+  /* Sanity check. */
+  if(weights==NULL || weights->next==NULL)
+    error(EXIT_FAILURE, 0, "%s: the weights must be a list of four "
+          "datasets (see 'gal_warp_wcsalign_weights')", __func__);
+
+  /* Write the image, then the table. */
+  cols=weights->next;
+  weights->next=NULL;
+  gal_fits_img_write(weights, filename, NULL, NULL);
+  gal_table_write(cols, NULL, NULL, GAL_TABLE_FORMAT_BFITS, filename,
+                  GAL_WARP_OUTPUT_NAME_WEIGHTS, 0);
+  weights->next=cols;
+}
+
+
+
+
+
+/* Read the overlap weights that were written by
+   'gal_warp_weights_write'. When the table is large, it can be
+   memory-mapped (see 'minmapsize'). */
+gal_data_t *
+gal_warp_weights_read(char *filename, size_t minmapsize, int quietmmap)
+{
+  gal_data_t *weights;
+
+  /* Read the area image and its WCS. */
+  weights=gal_fits_img_read(filename, GAL_WARP_OUTPUT_NAME_PIXAREA,
+                            minmapsize, quietmmap);
+  weights->wcs=gal_wcs_read(filename, GAL_WARP_OUTPUT_NAME_PIXAREA,
+                            GAL_WCS_LINEAR_MATRIX_PC, 0, 0,
+                            &weights->nwcs);
+  if(weights->type!=GAL_TYPE_FLOAT64)
+    weights=gal_data_copy_to_new_type_free(weights, GAL_TYPE_FLOAT64);
+
+  /* Read the table. */
+  weights->next=gal_table_read(filename, GAL_WARP_OUTPUT_NAME_WEIGHTS,
+                               NULL, NULL, GAL_TABLE_SEARCH_NAME, 0, 1,
+                               minmapsize, quietmmap, NULL);
+  return weights;
+}
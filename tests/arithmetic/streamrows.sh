@@ -0,0 +1,77 @@
+# Check that reading and writing the images in blocks of rows (with
+# '--streamrows') gives the same output as reading the full images.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2023 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=arithmetic
+execname=../bin/$prog/ast$prog
+img=mkprofcat1.fits
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $img      ]; then echo "$img does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The expression has element-wise operators, a stacking operator and the
+# 'where' operator. It is run once on the full images and once in blocks
+# of 7 rows (which doesn't divide the 100 rows of the image, so the last
+# block is smaller), with and without '--fuse'. The number of different
+# pixels between the outputs should be zero.
+expression="$img 2 x $img $img 3 mean sqrt $img 0.01 lt 0 where -g1"
+$check_with_program $execname $expression --output=streamrows-full.fits
+$check_with_program $execname $expression --streamrows=7 \
+                              --output=streamrows-7.fits
+$check_with_program $execname $expression --streamrows=7 --fuse \
+                              --output=streamrows-7-fuse.fits
+for out in streamrows-7.fits streamrows-7-fuse.fits; do
+    numdiff=$($execname streamrows-full.fits $out ne sumvalue -g1 --quiet)
+    if [ x"$numdiff" = x ] || [ $($AWK -v n="$numdiff" \
+                                    'BEGIN{print (n!=0)}') = 1 ]; then
+        echo "$out is different from streamrows-full.fits ($numdiff).";
+        exit 1;
+    fi
+done
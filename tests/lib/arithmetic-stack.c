@@ -0,0 +1,312 @@
+/*********************************************************************
+A test program for the multi-operand (stacking) operators of the
+arithmetic library: the output should be identical to calculating the
+statistic of each pixel separately.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/arithmetic.h"
+#include "gnuastro/statistics.h"
+
+
+
+
+/* Parameters of the quantile and sigma-clipping operators. */
+#define QUANTILE       0.3f
+#define SIGCLIP_MULTIP 3.0f
+#define SIGCLIP_TOL    0.2f
+
+/* The operators to check. */
+static int operators[]={
+  GAL_ARITHMETIC_OP_MIN, GAL_ARITHMETIC_OP_MAX, GAL_ARITHMETIC_OP_NUMBER,
+  GAL_ARITHMETIC_OP_SUM, GAL_ARITHMETIC_OP_MEAN, GAL_ARITHMETIC_OP_STD,
+  GAL_ARITHMETIC_OP_MEDIAN, GAL_ARITHMETIC_OP_QUANTILE,
+  GAL_ARITHMETIC_OP_SIGCLIP_STD, GAL_ARITHMETIC_OP_SIGCLIP_MEAN,
+  GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN, GAL_ARITHMETIC_OP_SIGCLIP_NUMBER };
+#define NUM_OPERATORS ( sizeof operators / sizeof *operators )
+
+
+
+
+/* Value of element 'i' of 'data' as a 'double' (exact for the types that
+   are used here). */
+static double
+value(gal_data_t *data, size_t i)
+{
+  switch(data->type)
+    {
+    case GAL_TYPE_INT16:   return ((int16_t  *)(data->array))[i];
+    case GAL_TYPE_UINT32:  return ((uint32_t *)(data->array))[i];
+    case GAL_TYPE_FLOAT32: return ((float    *)(data->array))[i];
+    }
+  printf("%s: type %d not expected.\n", __func__, data->type);
+  exit(EXIT_FAILURE);
+}
+
+
+
+
+/* For sorting the values of a pixel. */
+static int
+compare_values(const void *a, const void *b)
+{
+  double da=*(const double *)a, db=*(const double *)b;
+  return da<db ? -1 : (da>db);
+}
+
+
+
+
+/* Allocate 'num' random images of the given type and size. Some values
+   are blank and some pixels are blank in all the images. */
+static gal_data_t *
+random_images(uint8_t type, size_t num, size_t *dsize)
+{
+  size_t i, n;
+  gal_data_t *out=NULL, *img;
+
+  for(n=0;n<num;++n)
+    {
+      img=gal_data_alloc(NULL, type, 2, dsize, NULL, 0, -1, 1, NULL, NULL,
+                         NULL);
+      for(i=0;i<img->size;++i)
+        if(i%97==0 || rand()%5==0)
+          {
+            if(type==GAL_TYPE_FLOAT32) ((float *)(img->array))[i]=NAN;
+            else ((int16_t *)(img->array))[i]=GAL_BLANK_INT16;
+          }
+        else
+          {
+            /* A few outliers for the sigma-clipping. */
+            if(type==GAL_TYPE_FLOAT32)
+              ((float *)(img->array))[i] = ( (float)rand()/RAND_MAX
+                                             * (rand()%20 ? 1 : 50) );
+            else
+              ((int16_t *)(img->array))[i] = rand()%201-100;
+          }
+      gal_list_data_add(&out, img);
+    }
+  return out;
+}
+
+
+
+
+/* Calculate the output of the operator on one pixel from the values of
+   all the inputs in 'pix' (in the order of the list, including blank
+   values), in the same way as the operators did before working on blocks
+   of pixels. The only difference is the minimum and maximum of floating
+   point pixels that are blank in all the inputs: they are now blank (as
+   was intended), not the largest or smallest value. */
+static double
+reference(int operator, gal_data_t *pix)
+{
+  float f;
+  size_t i, n=0;
+  gal_data_t *res;
+  int isfloat=pix->type==GAL_TYPE_FLOAT32;
+  double v, out=NAN, sum=0, sum2=0, *sorted;
+
+  /* The usable values (in order) and their sums. */
+  sorted=malloc(pix->size*sizeof *sorted);
+  for(i=0;i<pix->size;++i)
+    {
+      v=value(pix, i);
+      if( isfloat ? isnan(v) : v==GAL_BLANK_INT16 ) continue;
+      sorted[n++]=v;
+      sum+=v;
+      if(isfloat) { f=v; sum2+=f*f; } else sum2+=v*v;
+    }
+
+  /* Calculate the output. */
+  switch(operator)
+    {
+    case GAL_ARITHMETIC_OP_MIN:
+    case GAL_ARITHMETIC_OP_MAX:
+      if(n==0) { out = isfloat ? NAN : GAL_BLANK_INT16; break; }
+      for(out=sorted[0], i=1;i<n;++i)
+        out = ( operator==GAL_ARITHMETIC_OP_MIN
+                ? (sorted[i]<out ? sorted[i] : out)
+                : (sorted[i]>out ? sorted[i] : out) );
+      break;
+    case GAL_ARITHMETIC_OP_NUMBER: out=n;                         break;
+    case GAL_ARITHMETIC_OP_SUM:    out = n ? (float)sum : NAN;     break;
+    case GAL_ARITHMETIC_OP_MEAN:   out = n ? (float)(sum/n) : NAN; break;
+    case GAL_ARITHMETIC_OP_STD:
+      out = n ? (float)sqrt( (sum2-sum*sum/n)/n ) : NAN;
+      break;
+
+    /* The median of integers is the integer average of the two middle
+       values (like the types of the inputs). */
+    case GAL_ARITHMETIC_OP_MEDIAN:
+      if(n==0) break;
+      qsort(sorted, n, sizeof *sorted, compare_values);
+      if(n%2) out=(float)sorted[n/2];
+      else if(isfloat)
+        out=((float)sorted[n/2]+(float)sorted[n/2-1])/2;
+      else
+        out=(float)( ((int)sorted[n/2]+(int)sorted[n/2-1])/2 );
+      break;
+
+    /* The quantile and sigma-clipping use the statistics library on all
+       the values (including blanks), like before. */
+    case GAL_ARITHMETIC_OP_QUANTILE:
+      res=gal_statistics_quantile(pix, QUANTILE, 0);
+      out=value(res, 0);
+      gal_data_free(res);
+      break;
+    default:
+      res=gal_statistics_sigma_clip(pix, SIGCLIP_MULTIP, SIGCLIP_TOL, 0, 1);
+      if(n)
+        switch(operator)
+          {
+          case GAL_ARITHMETIC_OP_SIGCLIP_NUMBER:
+            out=(uint32_t)((float *)(res->array))[0];         break;
+          case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:
+            out=((float *)(res->array))[1];                   break;
+          case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:
+            out=((float *)(res->array))[2];                   break;
+          case GAL_ARITHMETIC_OP_SIGCLIP_STD:
+            out=((float *)(res->array))[3];                   break;
+          }
+      else out = operator==GAL_ARITHMETIC_OP_SIGCLIP_NUMBER ? 0 : NAN;
+      gal_data_free(res);
+    }
+
+  /* Clean up and return. */
+  free(sorted);
+  return out;
+}
+
+
+
+
+/* Parameters of the operator (as the arithmetic library expects them). */
+static gal_data_t *
+operator_params(int operator)
+{
+  size_t one=1;
+  gal_data_t *out=NULL, *p;
+  float values[2]={SIGCLIP_MULTIP, SIGCLIP_TOL};
+  size_t i, num;
+
+  switch(operator)
+    {
+    case GAL_ARITHMETIC_OP_QUANTILE:
+      num=1; values[0]=QUANTILE;                     break;
+    case GAL_ARITHMETIC_OP_SIGCLIP_STD:
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:
+    case GAL_ARITHMETIC_OP_SIGCLIP_NUMBER:
+      num=2;                                         break;
+    default:
+      num=0;
+    }
+  for(i=num;i--;)
+    {
+      p=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 1, &one, NULL, 0, -1, 1,
+                       NULL, NULL, NULL);
+      ((float *)(p->array))[0]=values[i];
+      gal_list_data_add(&out, p);
+    }
+  return out;
+}
+
+
+
+
+/* Stack 'num' images with all the operators and compare every pixel with
+   the reference. Return the number of different pixels. */
+static size_t
+check_one(uint8_t type, size_t num, size_t *dsize, size_t numthreads)
+{
+  double r, o;
+  gal_data_t *list, *pix, *tmp, *params, *out;
+  size_t i, j, op, bad, allbad=0;
+
+  list=random_images(type, num, dsize);
+  pix=gal_data_alloc(NULL, type, 1, &num, NULL, 0, -1, 1, NULL, NULL,
+                     NULL);
+  for(op=0;op<NUM_OPERATORS;++op)
+    {
+      /* Stack the images. */
+      params=operator_params(operators[op]);
+      out=gal_arithmetic(operators[op], numthreads, 0, list, params);
+
+      /* Compare every pixel with the reference. */
+      bad=0;
+      for(j=0;j<out->size;++j)
+        {
+          for(i=0, tmp=list; tmp!=NULL; tmp=tmp->next, ++i)
+            memcpy(gal_pointer_increment(pix->array, i, type),
+                   gal_pointer_increment(tmp->array, j, type),
+                   gal_type_sizeof(type));
+          pix->flag=0;
+          r=reference(operators[op], pix);
+          o=value(out, j);
+          if( isnan(r) ? !isnan(o) : r!=o ) ++bad;
+        }
+      if(bad)
+        printf("%s, %zu %s inputs, %zu threads: %zu different pixels.\n",
+               gal_arithmetic_operator_string(operators[op]), num,
+               gal_type_name(type, 1), numthreads, bad);
+      allbad+=bad;
+
+      /* Clean up. */
+      gal_data_free(out);
+      gal_list_data_free(params);
+    }
+
+  /* Clean up and return. */
+  gal_data_free(pix);
+  gal_list_data_free(list);
+  return allbad;
+}
+
+
+
+
+/* Check few and many inputs (the number of pixels in each block depends
+   on the number of inputs) with an image size that is not a multiple of
+   the block size, on one and many threads. */
+int
+main(void)
+{
+  size_t bad=0;
+  size_t dsize[2]={123, 77};
+
+  srand(1);
+  bad+=check_one(GAL_TYPE_FLOAT32, 7,  dsize, 1);
+  bad+=check_one(GAL_TYPE_FLOAT32, 40, dsize, 4);
+  bad+=check_one(GAL_TYPE_INT16,   7,  dsize, 4);
+  bad+=check_one(GAL_TYPE_INT16,   40, dsize, 1);
+
+  /* Report the result. */
+  printf("Stacking operators: %s.\n",
+         bad ? "FAILED" : "identical to each pixel separately");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/*********************************************************************
+A test program for the connected components labeling of the library.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <error.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/binary.h"
+#include "gnuastro/dimension.h"
+
+
+
+
+/* The labeling algorithm of 'gal_binary_connected_components' before it
+   was parallelized: a breadth-first search from every pixel that is not
+   yet labeled (in the order of the pixels). The parallel implementation
+   should give exactly the same labels. */
+static size_t
+reference_labels(gal_data_t *binary, int32_t *l, int connectivity)
+{
+  size_t p, i, curlab=1;
+  uint8_t *b=binary->array;
+  gal_list_sizet_t *Q=NULL;
+  size_t *dinc=gal_dimension_increment(binary->ndim, binary->dsize);
+
+  /* Blank pixels are given a blank label (so they are not labeled). */
+  for(i=0;i<binary->size;++i)
+    l[i] = b[i]==GAL_BLANK_UINT8 ? GAL_BLANK_INT32 : 0;
+
+  /* Label every connected region with a breadth-first search. */
+  for(i=0;i<binary->size;++i)
+    if( b[i] && l[i]==0 )
+      {
+        l[i]=curlab;
+        gal_list_sizet_add(&Q, i);
+        while(Q!=NULL)
+          {
+            p=gal_list_sizet_pop(&Q);
+            GAL_DIMENSION_NEIGHBOR_OP(p, binary->ndim, binary->dsize,
+                                      connectivity, dinc,
+              {
+                if( b[ nind ] && l[ nind ]==0 )
+                  {
+                    l[ nind ] = curlab;
+                    gal_list_sizet_add(&Q, nind);
+                  }
+              } );
+          }
+        ++curlab;
+      }
+
+  /* Clean up and return the number of labels. */
+  free(dinc);
+  return curlab-1;
+}
+
+
+
+
+/* Label a random binary dataset with the library and the reference
+   algorithm and report any difference. Return the number of bad
+   pixels. */
+static size_t
+check_one(size_t ndim, size_t *dsize, double fraction, int connectivity,
+          size_t numthreads)
+{
+  size_t i, nref, nlib, bad=0;
+  int32_t *ref, *lab;
+  uint8_t *b;
+  gal_data_t *binary, *out=NULL;
+
+  /* Build the random binary dataset (with a few blank pixels). */
+  binary=gal_data_alloc(NULL, GAL_TYPE_UINT8, ndim, dsize, NULL, 0, -1, 1,
+                        NULL, NULL, NULL);
+  b=binary->array;
+  for(i=0;i<binary->size;++i)
+    b[i] = ( rand()%100==0
+             ? GAL_BLANK_UINT8
+             : rand() < fraction*RAND_MAX );
+
+  /* Label it with both methods. */
+  ref=malloc(binary->size*sizeof *ref);
+  if(ref==NULL)
+    {
+      fprintf(stderr, "couldn't allocate the reference labels.\n");
+      exit(EXIT_FAILURE);
+    }
+  nref=reference_labels(binary, ref, connectivity);
+  nlib=gal_binary_connected_components(binary, &out, connectivity,
+                                       numthreads);
+
+  /* Compare the labels. */
+  lab=out->array;
+  for(i=0;i<binary->size;++i) if(lab[i]!=ref[i]) ++bad;
+  if(bad || nref!=nlib)
+    printf("%zuD (first length %zu), connectivity %d, %zu threads: %zu "
+           "labels (expected %zu), %zu different pixels.\n", ndim,
+           dsize[0], connectivity, numthreads, nlib, nref, bad);
+
+  /* Clean up and return. */
+  free(ref);
+  gal_data_free(out);
+  gal_data_free(binary);
+  return bad + (nref!=nlib);
+}
+
+
+
+
+/* Check the labels of random datasets of different shapes (including
+   sizes that are not a multiple of the internal blocks) on different
+   numbers of threads. */
+int
+main(void)
+{
+  size_t t, f, bad=0;
+  size_t d1[1]={100003}, d2a[2]={257, 131}, d2b[2]={1000, 700};
+  size_t d2c[2]={3, 5000}, d3[3]={23, 37, 41};
+  size_t threads[]={1, 2, 3, 8};
+  double fractions[]={0.3, 0.55, 0.7};
+
+  srand(1);
+  for(t=0;t<sizeof threads/sizeof *threads;++t)
+    for(f=0;f<sizeof fractions/sizeof *fractions;++f)
+      {
+        bad+=check_one(1, d1,  fractions[f], 1, threads[t]);
+        bad+=check_one(2, d2a, fractions[f], 1, threads[t]);
+        bad+=check_one(2, d2a, fractions[f], 2, threads[t]);
+        bad+=check_one(2, d2b, fractions[f], 1, threads[t]);
+        bad+=check_one(2, d2b, fractions[f], 2, threads[t]);
+        bad+=check_one(2, d2c, fractions[f], 2, threads[t]);
+        bad+=check_one(3, d3,  fractions[f], 1, threads[t]);
+        bad+=check_one(3, d3,  fractions[f], 3, threads[t]);
+      }
+
+  /* Report the result. */
+  printf("Connected components: %s.\n", bad ? "FAILED" : "identical");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
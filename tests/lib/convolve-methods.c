@@ -0,0 +1,210 @@
+/*********************************************************************
+A test program for the methods of spatial convolution in the library.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/tile.h"
+#include "gnuastro/convolve.h"
+
+
+
+
+/* The separable and FFT methods only differ from the direct convolution
+   in floating point round-off errors. */
+#define CHECK_TOLERANCE 1e-5
+
+
+
+
+/* Random dataset with values between 0 and 1 and some blank pixels. */
+static gal_data_t *
+random_image(size_t ndim, size_t *dsize)
+{
+  size_t i;
+  float *f;
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, ndim, dsize,
+                                 NULL, 0, -1, 1, NULL, NULL, NULL);
+
+  f=out->array;
+  for(i=0;i<out->size;++i)
+    f[i] = rand()%25==0 ? NAN : (float)rand()/RAND_MAX;
+  return out;
+}
+
+
+
+
+/* Kernel (with a sum of one): when 'separable' is non-zero, it is the
+   product of one Gaussian along each dimension, otherwise it has random
+   values. */
+static gal_data_t *
+kernel_make(size_t ndim, size_t *dsize, int separable)
+{
+  float *k;
+  double sum=0, d;
+  size_t i, j, c, coord[3];
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, ndim, dsize,
+                                 NULL, 0, -1, 1, NULL, NULL, NULL);
+
+  k=out->array;
+  for(i=0;i<out->size;++i)
+    {
+      if(separable)
+        {
+          /* Coordinate of this element along each dimension. */
+          for(c=i,j=ndim;j-->0;) { coord[j]=c%dsize[j]; c/=dsize[j]; }
+          k[i]=1.0f;
+          for(j=0;j<ndim;++j)
+            {
+              d=(double)coord[j]-(double)(dsize[j]/2);
+              k[i]*=exp( -d*d/(1.5+j) );
+            }
+        }
+      else
+        k[i]=0.1+(float)rand()/RAND_MAX;
+      sum+=k[i];
+    }
+  for(i=0;i<out->size;++i) k[i]/=sum;
+  return out;
+}
+
+
+
+
+/* Return the number of pixels where the two outputs differ (a different
+   blank pixel, or a difference larger than the tolerance). */
+static size_t
+compare(gal_data_t *direct, gal_data_t *other)
+{
+  size_t i, bad=0;
+  float *d=direct->array, *o=other->array;
+
+  for(i=0;i<direct->size;++i)
+    if( isnan(d[i]) ? !isnan(o[i])
+        : ( isnan(o[i])
+            || fabs(d[i]-o[i]) > CHECK_TOLERANCE*(1+fabs(d[i])) ) )
+      ++bad;
+  return bad;
+}
+
+
+
+
+/* Convolve 'tiles' with all the methods and compare them with the direct
+   method. */
+static size_t
+check_methods(gal_data_t *tiles, gal_data_t *kernel, size_t numthreads,
+              int edgecorrection, int convoverch, char *name)
+{
+  size_t i, bad, allbad=0;
+  gal_data_t *direct, *other;
+  int methods[]={GAL_CONVOLVE_SPATIAL_SEPARABLE, GAL_CONVOLVE_SPATIAL_FFT,
+                 GAL_CONVOLVE_SPATIAL_AUTO};
+  char *names[]={"separable", "fft", "auto"};
+
+  direct=gal_convolve_spatial_method(tiles, kernel, numthreads,
+                                     edgecorrection, convoverch,
+                                     GAL_CONVOLVE_SPATIAL_DIRECT);
+  for(i=0;i<sizeof methods/sizeof *methods;++i)
+    {
+      other=gal_convolve_spatial_method(tiles, kernel, numthreads,
+                                        edgecorrection, convoverch,
+                                        methods[i]);
+      bad=compare(direct, other);
+      if(bad)
+        printf("%s, %s method, %zu threads, edge correction %d, over "
+               "channels %d: %zu different pixels.\n", name, names[i],
+               numthreads, edgecorrection, convoverch, bad);
+      allbad+=bad;
+      gal_data_free(other);
+    }
+  gal_data_free(direct);
+  return allbad;
+}
+
+
+
+
+/* Convolve a 2D image (on a tessellation with channels and as one full
+   image) and a 3D cube with a separable kernel and a large kernel that is
+   not separable, using all the methods (when a method can't be used for a
+   kernel, the direct method is used). */
+int
+main(void)
+{
+  int edge, och;
+  gal_data_t *img, *cube, *ksep, *kbig, *k3d;
+  struct gal_tile_two_layer_params tl={0};
+  size_t t, bad=0, threads[]={1, 4};
+  size_t dimg[2]={96, 84}, dcube[3]={20, 18, 16};
+  size_t dksep[2]={7, 9}, dkbig[2]={23, 23}, dk3d[3]={3, 5, 5};
+  size_t tilesize[3]={10, 12, -1}, numchannels[3]={2, 3, -1};
+
+  /* The inputs. */
+  srand(1);
+  img=random_image(2, dimg);
+  cube=random_image(3, dcube);
+  ksep=kernel_make(2, dksep, 1);
+  kbig=kernel_make(2, dkbig, 0);
+  k3d=kernel_make(3, dk3d, 1);
+
+  /* The tessellation of the 2D image. */
+  tl.tilesize=tilesize;
+  tl.numchannels=numchannels;
+  tl.remainderfrac=0.1;
+  gal_tile_full_sanity_check("random", "image", img, &tl);
+  gal_tile_full_two_layers(img, &tl);
+
+  /* Do the checks. */
+  for(t=0;t<sizeof threads/sizeof *threads;++t)
+    for(edge=0;edge<2;++edge)
+      {
+        for(och=0;och<2;++och)
+          {
+            bad+=check_methods(tl.tiles, ksep, threads[t], edge, och,
+                               "2D tiles, separable kernel");
+            bad+=check_methods(tl.tiles, kbig, threads[t], edge, och,
+                               "2D tiles, large kernel");
+          }
+        bad+=check_methods(img, ksep, threads[t], edge, 1,
+                           "2D image, separable kernel");
+        bad+=check_methods(img, kbig, threads[t], edge, 1,
+                           "2D image, large kernel");
+        bad+=check_methods(cube, k3d, threads[t], edge, 1,
+                           "3D cube, separable kernel");
+      }
+
+  /* Clean up (the tile sizes and number of channels aren't allocated) and
+     report the result. */
+  tl.tilesize=tl.numchannels=NULL;
+  gal_tile_full_free_contents(&tl);
+  gal_data_free(img);
+  gal_data_free(cube);
+  gal_data_free(ksep);
+  gal_data_free(kbig);
+  gal_data_free(k3d);
+  printf("Spatial convolution methods: %s.\n",
+         bad ? "FAILED" : "identical to direct convolution");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
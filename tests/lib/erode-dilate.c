@@ -0,0 +1,162 @@
+/*********************************************************************
+A test program for the erosion, dilation and opening of the library.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <error.h>
+#include <stdlib.h>
+
+#include "gnuastro/blank.h"
+#include "gnuastro/binary.h"
+#include "gnuastro/dimension.h"
+
+
+
+
+/* Operations that are checked. */
+enum check_operations
+{
+  CHECK_ERODE,
+  CHECK_DILATE,
+  CHECK_OPEN,
+};
+
+
+
+
+/* One erosion ('dilate0_erode1==1') or dilation on every pixel (this is
+   the general, per-pixel, implementation of the library before the
+   bit-packed one). Only the pixels with a value of 0 or 1 are changed. */
+static void
+reference_step(gal_data_t *input, int dilate0_erode1, int connectivity)
+{
+  uint8_t f, b, *pt, *fpt, *byt=input->array;
+  size_t i, *dinc=gal_dimension_increment(input->ndim, input->dsize);
+
+  /* Set the foreground and background values. */
+  if(dilate0_erode1==0) {f=1; b=0;}
+  else                  {f=0; b=1;}
+
+  /* Go over the neighbors of each pixel. */
+  for(i=0;i<input->size;++i)
+    if(byt[i]==b)
+      GAL_DIMENSION_NEIGHBOR_OP(i, input->ndim, input->dsize, connectivity,
+                                dinc,{
+                                  if(byt[i]!=GAL_BINARY_TMP_VALUE
+                                     && byt[nind]==f)
+                                    byt[i]=GAL_BINARY_TMP_VALUE;
+                                });
+
+  /* Set all the changed pixels to the proper values. */
+  fpt=(pt=byt)+input->size;
+  do *pt = *pt==GAL_BINARY_TMP_VALUE ? f : *pt; while(++pt<fpt);
+  free(dinc);
+}
+
+
+
+
+/* Apply the operation on a random binary dataset with the library and the
+   reference and return the number of different pixels. */
+static size_t
+check_one(size_t ndim, size_t *dsize, int operation, size_t num,
+          int connectivity, size_t numthreads)
+{
+  uint8_t *b, *r;
+  size_t i, bad=0;
+  gal_data_t *in, *ref, *out;
+  char *names[]={"erode", "dilate", "open"};
+
+  /* Build the random binary dataset (with a few blank pixels). */
+  in=gal_data_alloc(NULL, GAL_TYPE_UINT8, ndim, dsize, NULL, 0, -1, 1,
+                    NULL, NULL, NULL);
+  b=in->array;
+  for(i=0;i<in->size;++i)
+    b[i] = rand()%50==0 ? GAL_BLANK_UINT8 : rand()%2;
+
+  /* The reference result. */
+  ref=gal_data_copy(in);
+  for(i=0;i<num;++i)
+    reference_step(ref, operation!=CHECK_DILATE, connectivity);
+  if(operation==CHECK_OPEN)
+    for(i=0;i<num;++i) reference_step(ref, 0, connectivity);
+
+  /* The library's result (not in place, so the input is not changed). */
+  switch(operation)
+    {
+    case CHECK_ERODE:
+      out=gal_binary_erode(in, num, connectivity, 0, numthreads);  break;
+    case CHECK_DILATE:
+      out=gal_binary_dilate(in, num, connectivity, 0, numthreads); break;
+    default:
+      out=gal_binary_open(in, num, connectivity, 0, numthreads);
+    }
+
+  /* Compare them. */
+  b=out->array;
+  r=ref->array;
+  for(i=0;i<in->size;++i) if(b[i]!=r[i]) ++bad;
+  if(bad)
+    printf("%zuD (first length %zu), %s %zu times, connectivity %d, %zu "
+           "threads: %zu different pixels.\n", ndim, dsize[0],
+           names[operation], num, connectivity, numthreads, bad);
+
+  /* Clean up and return. */
+  gal_data_free(in);
+  gal_data_free(ref);
+  gal_data_free(out);
+  return bad;
+}
+
+
+
+
+/* Check random datasets of different shapes (including widths that are
+   not a multiple of the 64 pixels in each word of the bit-packed image)
+   for different number of iterations (more than the number of steps
+   that are done on each band together) and threads. */
+int
+main(void)
+{
+  int c, op;
+  size_t t, n, bad=0;
+  size_t d1[1]={1000}, d2a[2]={2, 63}, d2b[2]={97, 130}, d2c[2]={600, 257};
+  size_t threads[]={1, 2, 5};
+  size_t nums[]={1, 2, 3, 9, 20};
+
+  srand(1);
+  for(op=CHECK_ERODE; op<=CHECK_OPEN; ++op)
+    for(t=0;t<sizeof threads/sizeof *threads;++t)
+      for(n=0;n<sizeof nums/sizeof *nums;++n)
+        {
+          bad+=check_one(1, d1, op, nums[n], 1, threads[t]);
+          for(c=1;c<=2;++c)
+            {
+              bad+=check_one(2, d2a, op, nums[n], c, threads[t]);
+              bad+=check_one(2, d2b, op, nums[n], c, threads[t]);
+              bad+=check_one(2, d2c, op, nums[n], c, threads[t]);
+            }
+        }
+
+  /* Report the result. */
+  printf("Erosion, dilation and opening: %s.\n",
+         bad ? "FAILED" : "identical");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/*********************************************************************
+Compare the speed of the standard and bucket k-d trees (this is not a
+test, it is only built with 'make kdtree-bench' in the 'tests'
+directory).
+
+Usage: ./kdtree-bench NDIM NUMPOINTS BUCKETSIZE NUMQUERIES
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/kdtree.h"
+
+
+
+
+/* Seconds since 't0'. */
+static double
+seconds_since(struct timeval *t0)
+{
+  struct timeval t1;
+  gettimeofday(&t1, NULL);
+  return (t1.tv_sec-t0->tv_sec) + (t1.tv_usec-t0->tv_usec)/1e6;
+}
+
+
+
+
+/* Allocate 'ndim' columns of 'num' random coordinates (between 0 and
+   1). */
+static gal_data_t *
+random_columns(size_t ndim, size_t num)
+{
+  size_t i, d;
+  double *c;
+  gal_data_t *out=NULL, *col;
+
+  for(d=0;d<ndim;++d)
+    {
+      col=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &num, NULL, 0, -1, 1,
+                         NULL, NULL, NULL);
+      c=col->array;
+      for(i=0;i<num;++i) c[i]=(double)rand()/RAND_MAX;
+      gal_list_data_add(&out, col);
+    }
+  gal_list_data_reverse(&out);
+  return out;
+}
+
+
+
+
+/* Build the two trees over the same random points (on one thread) and
+   find the nearest neighbours of the same random query points, reporting
+   the time of each step and the number of different results (ties are
+   not counted). */
+int
+main(int argc, char *argv[])
+{
+  double *qc[3];
+  struct timeval t0;
+  gal_kdtree_bucket_t *b;
+  gal_kdtree_query_t *query;
+  size_t *kind, *bind, i, d, root, diff=0;
+  double point[3], *kdist, *bdist, tquery, tbucket;
+  gal_data_t *coords, *queries, *kdtree, *bucket, *col;
+  size_t ndim, num, bucketsize, numq;
+
+  /* Read the arguments. */
+  if(argc!=5)
+    {
+      fprintf(stderr, "Usage: %s NDIM NUMPOINTS BUCKETSIZE NUMQUERIES\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+  ndim=atol(argv[1]); num=atol(argv[2]);
+  bucketsize=atol(argv[3]); numq=atol(argv[4]);
+  if(ndim<1 || ndim>3 || num==0 || bucketsize==0)
+    {
+      fprintf(stderr, "%s: NDIM should be 1, 2 or 3 and NUMPOINTS and "
+              "BUCKETSIZE should be positive\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  /* The inputs and outputs. */
+  srand(1);
+  coords=random_columns(ndim, num);
+  queries=random_columns(ndim, numq);
+  for(d=0, col=queries; col!=NULL; col=col->next, ++d) qc[d]=col->array;
+  kind=malloc(numq*sizeof *kind);
+  bind=malloc(numq*sizeof *bind);
+  kdist=malloc(numq*sizeof *kdist);
+  bdist=malloc(numq*sizeof *bdist);
+  if(kind==NULL || bind==NULL || kdist==NULL || bdist==NULL)
+    {
+      fprintf(stderr, "%s: couldn't allocate the outputs\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  /* The standard k-d tree. */
+  gettimeofday(&t0, NULL);
+  kdtree=gal_kdtree_create(coords, &root, 1, 0);
+  query=gal_kdtree_query_prepare(coords, kdtree, root);
+  printf("Standard k-d tree: built in %.3f seconds, ", seconds_since(&t0));
+  gettimeofday(&t0, NULL);
+  for(i=0;i<numq;++i)
+    {
+      for(d=0;d<ndim;++d) point[d]=qc[d][i];
+      kind[i]=gal_kdtree_query_nearest(query, point, &kdist[i]);
+    }
+  tquery=seconds_since(&t0);
+  printf("queried in %.3f seconds.\n", tquery);
+
+  /* The bucket k-d tree. */
+  gettimeofday(&t0, NULL);
+  bucket=gal_kdtree_bucket_create(coords, bucketsize);
+  b=gal_kdtree_bucket_prepare(bucket, bucketsize);
+  printf("Bucket k-d tree:   built in %.3f seconds, ", seconds_since(&t0));
+  gettimeofday(&t0, NULL);
+  for(i=0;i<numq;++i)
+    {
+      for(d=0;d<ndim;++d) point[d]=qc[d][i];
+      bind[i]=gal_kdtree_bucket_nearest(b, point, &bdist[i]);
+    }
+  tbucket=seconds_since(&t0);
+  printf("queried in %.3f seconds.\n", tbucket);
+
+  /* Compare the results. */
+  for(i=0;i<numq;++i)
+    if( kdist[i]!=bdist[i] ) ++diff;
+  printf("%zuD, %zu points, bucket size %zu, %zu queries: %zu different "
+         "distances.\n", ndim, num, bucketsize, numq, diff);
+
+  /* Clean up and return. */
+  free(kind);
+  free(bind);
+  free(kdist);
+  free(bdist);
+  gal_kdtree_bucket_free(b);
+  gal_list_data_free(bucket);
+  gal_kdtree_query_free(query);
+  gal_list_data_free(kdtree);
+  gal_list_data_free(queries);
+  gal_list_data_free(coords);
+  return diff ? EXIT_FAILURE : EXIT_SUCCESS;
+}
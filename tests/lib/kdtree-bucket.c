@@ -0,0 +1,175 @@
+/*********************************************************************
+A test program for the bucket k-d tree after it is written into a FITS
+table and read back.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/table.h"
+#include "gnuastro/kdtree.h"
+
+
+
+
+/* Allocate 'ndim' columns of 'num' random coordinates (between 0 and 1)
+   with the given type. */
+static gal_data_t *
+random_columns(size_t ndim, size_t num, uint8_t type)
+{
+  size_t i, d;
+  gal_data_t *out=NULL, *col;
+
+  for(d=0;d<ndim;++d)
+    {
+      col=gal_data_alloc(NULL, type, 1, &num, NULL, 0, -1, 1, NULL, NULL,
+                         NULL);
+      for(i=0;i<num;++i)
+        if(type==GAL_TYPE_FLOAT32)
+          ((float *)(col->array))[i]=(float)rand()/RAND_MAX;
+        else
+          ((double *)(col->array))[i]=(double)rand()/RAND_MAX;
+      gal_list_data_add(&out, col);
+    }
+  gal_list_data_reverse(&out);
+  return out;
+}
+
+
+
+
+/* Value of a coordinate as a 'double'. */
+static double
+coord_value(gal_data_t *col, size_t i)
+{
+  return ( col->type==GAL_TYPE_FLOAT32
+           ? ((float *)(col->array))[i]
+           : ((double *)(col->array))[i] );
+}
+
+
+
+
+/* Distance of the point at row 'i' of 'coords' to 'point'. */
+static double
+point_distance(gal_data_t *coords, size_t i, double *point)
+{
+  size_t d;
+  double t, d2=0;
+  gal_data_t *col;
+
+  for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+    { t=coord_value(col, i)-point[d]; d2+=t*t; }
+  return sqrt(d2);
+}
+
+
+
+
+/* Build a bucket k-d tree, write it into a FITS table and read it back
+   (only using the bucket size that is recorded in the comment of the
+   index column), then compare its nearest neighbours with those of the
+   standard k-d tree (a different index is only accepted when it has the
+   same distance). Return the number of differences. */
+static size_t
+check_one(size_t ndim, size_t num, size_t numq, uint8_t type,
+          size_t bucketsize, char *filename)
+{
+  gal_kdtree_bucket_t *b;
+  gal_kdtree_query_t *query;
+  double point[3], dist, bdist;
+  gal_data_t *coords, *kdtree, *bucket, *read, *col;
+  size_t i, d, ind, bind, root, bad=0;
+
+  /* The standard k-d tree. */
+  coords=random_columns(ndim, num, type);
+  kdtree=gal_kdtree_create(coords, &root, 1, 0);
+  query=gal_kdtree_query_prepare(coords, kdtree, root);
+
+  /* The bucket k-d tree, after a round trip through a FITS file. */
+  bucket=gal_kdtree_bucket_create(coords, bucketsize);
+  remove(filename);
+  gal_table_write(bucket, NULL, NULL, GAL_TABLE_FORMAT_BFITS, filename,
+                  "BUCKET", 0);
+  read=gal_table_read(filename, "1", NULL, NULL, GAL_TABLE_SEARCH_NAME, 1,
+                      1, -1, 1, NULL);
+  if(gal_list_data_number(read)!=ndim+1) ++bad;
+  b=gal_kdtree_bucket_prepare(read, 0);
+  if(b->bucketsize!=bucketsize) ++bad;
+
+  /* Queries (the first are on points of the tree). */
+  for(i=0;i<numq;++i)
+    {
+      for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+        point[d] = ( i<numq/10
+                     ? coord_value(col, i%num)
+                     : (double)rand()/RAND_MAX );
+      ind=gal_kdtree_query_nearest(query, point, &dist);
+      bind=gal_kdtree_bucket_nearest(b, point, &bdist);
+      if( dist!=bdist
+          || ( ind!=bind && point_distance(coords, bind, point)!=dist ) )
+        ++bad;
+    }
+  if(bad)
+    printf("%zuD, %zu %s points, bucket size %zu: %zu different nearest "
+           "neighbours.\n", ndim, num,
+           type==GAL_TYPE_FLOAT32 ? "float32" : "float64", bucketsize,
+           bad);
+
+  /* Clean up and return (the prepared tree uses the columns that were
+     read). */
+  gal_kdtree_bucket_free(b);
+  gal_list_data_free(read);
+  gal_list_data_free(bucket);
+  gal_kdtree_query_free(query);
+  gal_list_data_free(kdtree);
+  gal_list_data_free(coords);
+  return bad;
+}
+
+
+
+
+/* Check the bucket k-d tree in different dimensions, with 32-bit and
+   64-bit floating point coordinates and with different bucket sizes (one
+   point in each bucket, the default-like size and a tree that is a single
+   bucket). */
+int
+main(void)
+{
+  size_t d, bad=0;
+  char *filename="kdtree-bucket.fits";
+
+  srand(1);
+  for(d=1;d<=3;++d)
+    {
+      bad+=check_one(d, 3000, 2000, GAL_TYPE_FLOAT32, 1,  filename);
+      bad+=check_one(d, 3000, 2000, GAL_TYPE_FLOAT64, 16, filename);
+    }
+  bad+=check_one(2, 5, 50, GAL_TYPE_FLOAT64, 16, filename);
+
+  /* Report the result. */
+  printf("Bucket k-d tree from a FITS table: %s.\n",
+         bad ? "FAILED" : "identical to the standard k-d tree");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*********************************************************************
+A test program for building k-d trees on many threads and with sampled
+medians.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/kdtree.h"
+
+
+
+
+/* Allocate 'ndim' columns of 'num' random coordinates between 0 and 1.
+   When 'clumped' is non-zero, the first coordinate of half the points is
+   zero (so the median of a sample is far from the middle of the sorted
+   points and the exact median has to be used). */
+static gal_data_t *
+random_columns(size_t ndim, size_t num, int clumped)
+{
+  double *c;
+  size_t i, d;
+  gal_data_t *out=NULL, *col;
+
+  for(d=0;d<ndim;++d)
+    {
+      col=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &num, NULL, 0, -1, 1,
+                         NULL, NULL, NULL);
+      c=col->array;
+      for(i=0;i<num;++i)
+        c[i] = ( clumped && d==0 && rand()%2
+                 ? 0.0
+                 : (double)rand()/RAND_MAX );
+      gal_list_data_add(&out, col);
+    }
+  gal_list_data_reverse(&out);
+  return out;
+}
+
+
+
+
+/* Build the k-d tree of more points than are built in parallel (65536)
+   on one and on many threads and return the number of differences in the
+   root and in the left and right columns. */
+static size_t
+check_threads(size_t ndim, size_t num, int sampled)
+{
+  uint32_t *l1, *r1, *ln, *rn;
+  gal_data_t *coords, *one, *many;
+  size_t i, root1, rootn, bad=0;
+
+  coords=random_columns(ndim, num, 0);
+  one=gal_kdtree_create(coords, &root1, 1, sampled);
+  many=gal_kdtree_create(coords, &rootn, 4, sampled);
+  l1=one->array;  r1=one->next->array;
+  ln=many->array; rn=many->next->array;
+  if(root1!=rootn) ++bad;
+  for(i=0;i<num;++i)
+    if(l1[i]!=ln[i] || r1[i]!=rn[i]) ++bad;
+  if(bad)
+    printf("%zuD, %zu points (sampled %d): %zu differences between one "
+           "and four threads.\n", ndim, num, sampled, bad);
+
+  /* Clean up and return. */
+  gal_list_data_free(many);
+  gal_list_data_free(one);
+  gal_list_data_free(coords);
+  return bad;
+}
+
+
+
+
+/* Distance of the point at row 'i' of 'coords' to 'point'. */
+static double
+point_distance(gal_data_t *coords, size_t i, double *point)
+{
+  size_t d;
+  double t, d2=0;
+  gal_data_t *col;
+
+  for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+    { t=((double *)(col->array))[i]-point[d]; d2+=t*t; }
+  return sqrt(d2);
+}
+
+
+
+
+/* Build the k-d tree with sampled medians and compare its nearest
+   neighbours with checking all the points (a different index is only
+   accepted when it has the same distance). Return the number of
+   differences. */
+static size_t
+check_sampled(size_t ndim, size_t num, size_t numq, int clumped)
+{
+  double point[3], dist, r, min;
+  gal_kdtree_query_t *query;
+  gal_data_t *coords, *kdtree, *col;
+  size_t i, j, d, ind, root, bad=0;
+
+  coords=random_columns(ndim, num, clumped);
+  kdtree=gal_kdtree_create(coords, &root, 1, 1);
+  query=gal_kdtree_query_prepare(coords, kdtree, root);
+  for(i=0;i<numq;++i)
+    {
+      /* The first query points are on points of the tree. */
+      for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+        point[d] = ( i<numq/10
+                     ? ((double *)(col->array))[i]
+                     : (double)rand()/RAND_MAX );
+      ind=gal_kdtree_query_nearest(query, point, &dist);
+      for(min=INFINITY, j=0;j<num;++j)
+        if( (r=point_distance(coords, j, point)) < min ) min=r;
+      if( dist!=min || point_distance(coords, ind, point)!=min ) ++bad;
+    }
+  if(bad)
+    printf("%zuD, %zu points (clumped %d): %zu different nearest "
+           "neighbours with sampled medians.\n", ndim, num, clumped, bad);
+
+  /* Clean up and return. */
+  gal_kdtree_query_free(query);
+  gal_list_data_free(kdtree);
+  gal_list_data_free(coords);
+  return bad;
+}
+
+
+
+
+/* Check that the tree doesn't depend on the number of threads (with
+   exact and sampled medians) and that the tree with sampled medians
+   gives the correct nearest neighbours (also when half the points have
+   the same coordinate, so the exact median is used instead). */
+int
+main(void)
+{
+  size_t bad=0;
+
+  srand(1);
+  bad+=check_threads(2, 150000, 0);
+  bad+=check_threads(3, 100000, 1);
+  bad+=check_sampled(2, 20000, 500, 0);
+  bad+=check_sampled(3, 20000, 500, 0);
+  bad+=check_sampled(2, 10000, 500, 1);
+
+  /* Report the result. */
+  printf("Building k-d trees: %s.\n",
+         bad ? "FAILED" : "independent of threads, correct neighbours");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
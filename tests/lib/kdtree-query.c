@@ -0,0 +1,203 @@
+/*********************************************************************
+A test program for the prepared nearest neighbour queries of k-d trees.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/kdtree.h"
+#include "gnuastro/pointer.h"
+
+
+
+
+/* Allocate 'ndim' columns of 'num' random coordinates (between 0 and 1)
+   with the given type. */
+static gal_data_t *
+random_columns(size_t ndim, size_t num, uint8_t type)
+{
+  size_t i, d;
+  gal_data_t *out=NULL, *col;
+
+  for(d=0;d<ndim;++d)
+    {
+      col=gal_data_alloc(NULL, type, 1, &num, NULL, 0, -1, 1, NULL, NULL,
+                         NULL);
+      for(i=0;i<num;++i)
+        if(type==GAL_TYPE_FLOAT32)
+          ((float *)(col->array))[i]=(float)rand()/RAND_MAX;
+        else
+          ((double *)(col->array))[i]=(double)rand()/RAND_MAX;
+      gal_list_data_add(&out, col);
+    }
+  gal_list_data_reverse(&out);
+  return out;
+}
+
+
+
+
+/* Value of a coordinate as a 'double'. */
+static double
+coord_value(gal_data_t *col, size_t i)
+{
+  return ( col->type==GAL_TYPE_FLOAT32
+           ? ((float *)(col->array))[i]
+           : ((double *)(col->array))[i] );
+}
+
+
+
+
+/* Nearest point to 'point' by checking all the points. The distance is
+   calculated in the same way as the k-d tree, so they are identical. */
+static size_t
+brute_nearest(gal_data_t *coords, double *point, double *dist)
+{
+  gal_data_t *col;
+  double t, d2, min=INFINITY;
+  size_t d, i, out=GAL_BLANK_SIZE_T;
+
+  for(i=0;i<coords->size;++i)
+    {
+      d2=0;
+      for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+        { t=coord_value(col, i)-point[d]; d2+=t*t; }
+      if(d2<min) { min=d2; out=i; }
+    }
+  *dist=sqrt(min);
+  return out;
+}
+
+
+
+
+/* Distance of the point at row 'i' of 'coords' to 'point'. */
+static double
+point_distance(gal_data_t *coords, size_t i, double *point)
+{
+  size_t d;
+  double t, d2=0;
+  gal_data_t *col;
+
+  for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+    { t=coord_value(col, i)-point[d]; d2+=t*t; }
+  return sqrt(d2);
+}
+
+
+
+
+/* Build a k-d tree over random points of the given type and dimensions,
+   then find the nearest neighbours of random query points (and of some
+   of the points in the tree) with the single and batch queries. A
+   different index is only accepted when it has the same distance (a
+   tie). Return the number of differences. */
+static size_t
+check_one(size_t ndim, size_t num, size_t numq, uint8_t type)
+{
+  double *p, point[3], dist, bdist, *odist;
+  gal_kdtree_query_t *query;
+  gal_data_t *coords, *kdtree, *queries, *col, *tcol;
+  size_t i, d, ind, bind, root, first, bad=0, *oindex;
+
+  /* The k-d tree and the query points (as 'double'), the first query
+     points are on points of the tree. */
+  coords=random_columns(ndim, num, type);
+  kdtree=gal_kdtree_create(coords, &root, 1, 0);
+  queries=random_columns(ndim, numq, GAL_TYPE_FLOAT64);
+  for(col=queries, tcol=coords; col!=NULL; col=col->next, tcol=tcol->next)
+    {
+      p=col->array;
+      for(i=0;i<numq/10;++i) p[i]=coord_value(tcol, i%num);
+    }
+  query=gal_kdtree_query_prepare(coords, kdtree, root);
+
+  /* Single queries. */
+  for(i=0;i<numq;++i)
+    {
+      for(d=0, col=queries; col!=NULL; col=col->next, ++d)
+        point[d]=((double *)(col->array))[i];
+      ind=gal_kdtree_query_nearest(query, point, &dist);
+      bind=brute_nearest(coords, point, &bdist);
+      if( dist!=bdist
+          || ( ind!=bind && point_distance(coords, ind, point)!=bdist ) )
+        ++bad;
+    }
+
+  /* Batch queries (not starting from the first row). */
+  first=numq/3;
+  oindex=gal_pointer_allocate(GAL_TYPE_SIZE_T, numq-first, 0, __func__,
+                              "oindex");
+  odist=gal_pointer_allocate(GAL_TYPE_FLOAT64, numq-first, 0, __func__,
+                             "odist");
+  gal_kdtree_query_nearest_batch(query, queries, first, numq-first, oindex,
+                                 odist);
+  for(i=first;i<numq;++i)
+    {
+      for(d=0, col=queries; col!=NULL; col=col->next, ++d)
+        point[d]=((double *)(col->array))[i];
+      bind=brute_nearest(coords, point, &bdist);
+      if( odist[i-first]!=bdist
+          || ( oindex[i-first]!=bind
+               && point_distance(coords, oindex[i-first], point)!=bdist ) )
+        ++bad;
+    }
+  if(bad)
+    printf("%zuD, %zu %s points: %zu different nearest neighbours.\n",
+           ndim, num, type==GAL_TYPE_FLOAT32 ? "float32" : "float64", bad);
+
+  /* Clean up and return. */
+  free(odist);
+  free(oindex);
+  gal_kdtree_query_free(query);
+  gal_list_data_free(queries);
+  gal_list_data_free(kdtree);
+  gal_list_data_free(coords);
+  return bad;
+}
+
+
+
+
+/* Check the queries in different dimensions, with 32-bit and 64-bit
+   floating point coordinates (which are converted when the query is
+   prepared). */
+int
+main(void)
+{
+  size_t d, bad=0;
+
+  srand(1);
+  for(d=1;d<=3;++d)
+    {
+      bad+=check_one(d, 3000, 2000, GAL_TYPE_FLOAT32);
+      bad+=check_one(d, 3000, 2000, GAL_TYPE_FLOAT64);
+    }
+  bad+=check_one(2, 1, 10, GAL_TYPE_FLOAT64);
+
+  /* Report the result. */
+  printf("Nearest neighbours with a prepared k-d tree: %s.\n",
+         bad ? "FAILED" : "identical to checking all points");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,324 @@
+/*********************************************************************
+A test program for the k-nearest neighbour and range searches of k-d
+trees.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/kdtree.h"
+#include "gnuastro/pointer.h"
+
+
+
+
+/* The distances within elliptical apertures are calculated differently
+   here (with one rotation at a time), so they can only be compared to
+   this precision, and points that are this close to the edge of the
+   aperture are not checked. */
+#define CHECK_TOLERANCE 1e-9
+
+
+
+
+/* Allocate 'ndim' columns of 'num' coordinates. When 'grid' is non-zero,
+   the coordinates are random integers between 0 and 'grid'-1 (so many
+   points have the same distance to the query points and some points are
+   repeated), otherwise they are random values between 0 and 1. */
+static gal_data_t *
+random_columns(size_t ndim, size_t num, size_t grid)
+{
+  double *c;
+  size_t i, d;
+  gal_data_t *out=NULL, *col;
+
+  for(d=0;d<ndim;++d)
+    {
+      col=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &num, NULL, 0, -1, 1,
+                         NULL, NULL, NULL);
+      c=col->array;
+      for(i=0;i<num;++i)
+        c[i] = grid ? rand()%grid : (double)rand()/RAND_MAX;
+      gal_list_data_add(&out, col);
+    }
+  gal_list_data_reverse(&out);
+  return out;
+}
+
+
+
+
+/* Squared distance of row 'i' to 'point' (in the same order of
+   operations as the k-d tree, so it is identical). */
+static double
+distance2(gal_data_t *coords, size_t i, double *point)
+{
+  size_t d;
+  double t, d2=0;
+  gal_data_t *col;
+
+  for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+    { t=((double *)(col->array))[i]-point[d]; d2+=t*t; }
+  return d2;
+}
+
+
+
+
+/* Rotate the point (x,y) by 'angle' degrees (in the frame of the
+   rotated axises). */
+static void
+rotate(double *x, double *y, double angle)
+{
+  double c=cos(angle*M_PI/180), s=sin(angle*M_PI/180), t=*x;
+  *x =  c*t + s*(*y);
+  *y = -s*t + c*(*y);
+}
+
+
+
+
+/* Distance of row 'i' to 'point' on the scale of the aperture's major
+   axis: the differences are rotated into the frame of the aperture
+   (in 3D, with the three ZXZ Euler angles one after the other) and the
+   minor axises are scaled to the major axis. */
+static double
+aperture_distance(gal_data_t *coords, size_t i, double *point,
+                  size_t ndim, double *ap)
+{
+  size_t d;
+  gal_data_t *col;
+  double delta[3];
+
+  for(d=0, col=coords; col!=NULL; col=col->next, ++d)
+    delta[d]=((double *)(col->array))[i]-point[d];
+  if(ndim==2)
+    {
+      rotate(&delta[0], &delta[1], ap[2]);
+      return sqrt( delta[0]*delta[0] + delta[1]*delta[1]/ap[1]/ap[1] );
+    }
+  rotate(&delta[0], &delta[1], ap[3]);
+  rotate(&delta[1], &delta[2], ap[4]);
+  rotate(&delta[0], &delta[1], ap[5]);
+  return sqrt( delta[0]*delta[0] + delta[1]*delta[1]/ap[1]/ap[1]
+               + delta[2]*delta[2]/ap[2]/ap[2] );
+}
+
+
+
+
+/* For sorting the points by distance (and index for equal distances). */
+struct check_point
+{
+  size_t index;
+  double  dist;
+};
+
+static int
+compare_points(const void *a, const void *b)
+{
+  const struct check_point *pa=a, *pb=b;
+  if(pa->dist!=pb->dist) return pa->dist < pb->dist ? -1 : 1;
+  return pa->index < pb->index ? -1 : (pa->index > pb->index);
+}
+
+
+
+
+/* Compare the k nearest neighbours of 'point' with those of sorting all
+   the points by distance. Return the number of differences. */
+static size_t
+check_knn(gal_kdtree_query_t *query, gal_data_t *coords, double *point,
+          size_t k, struct check_point *all)
+{
+  double *dist;
+  size_t i, num, bad=0, *index;
+
+  /* Sort all the points by distance. */
+  for(i=0;i<coords->size;++i)
+    {
+      all[i].index=i;
+      all[i].dist=sqrt( distance2(coords, i, point) );
+    }
+  qsort(all, coords->size, sizeof *all, compare_points);
+
+  /* Find the nearest neighbours and compare them. */
+  index=gal_pointer_allocate(GAL_TYPE_SIZE_T, k, 0, __func__, "index");
+  dist=gal_pointer_allocate(GAL_TYPE_FLOAT64, k, 0, __func__, "dist");
+  num=gal_kdtree_knn(query, point, k, index, dist);
+  if( num != (k<coords->size ? k : coords->size) ) ++bad;
+  else
+    for(i=0;i<num;++i)
+      if(index[i]!=all[i].index || dist[i]!=all[i].dist) ++bad;
+
+  /* Clean up and return. */
+  free(dist);
+  free(index);
+  return bad;
+}
+
+
+
+
+/* Compare the points within the aperture around 'point' with checking all
+   the points. Return the number of differences. */
+static size_t
+check_range(gal_kdtree_query_t *query, gal_data_t *coords, double *point,
+            size_t ndim, double *ap, gal_kdtree_found_t *found,
+            struct check_point *all)
+{
+  double r;
+  int circle;
+  size_t i, j, num=0, bad=0;
+  struct check_point *sorted;
+
+  /* All the points within the aperture (those that are very close to its
+     edge are kept with a negative distance, to be ignored). */
+  circle = ( ndim==2 ? ap[1]==1.0
+                     : ( ndim==3 ? ap[1]==1.0 && ap[2]==1.0 : 1 ) );
+  for(i=0;i<coords->size;++i)
+    {
+      r = ( circle
+            ? sqrt( distance2(coords, i, point) )
+            : aperture_distance(coords, i, point, ndim, ap) );
+      if( r < ap[0]+CHECK_TOLERANCE )
+        {
+          all[num].index=i;
+          all[num++].dist = fabs(r-ap[0])<CHECK_TOLERANCE ? -1 : r;
+        }
+    }
+
+  /* The library's output, sorted by index. */
+  gal_kdtree_range(query, point, ap, found);
+  sorted=gal_pointer_allocate(GAL_TYPE_UINT8,
+                              (found->number+1)*sizeof *sorted, 0,
+                              __func__, "sorted");
+  for(i=0;i<found->number;++i)
+    { sorted[i].index=found->index[i]; sorted[i].dist=0; }
+  qsort(sorted, found->number, sizeof *sorted, compare_points);
+  for(i=0;i<found->number;++i)
+    for(j=0;j<found->number;++j)
+      if(found->index[j]==sorted[i].index)
+        { sorted[i].dist=found->dist[j]; break; }
+
+  /* Compare the two (the reference is already sorted by index). */
+  for(i=j=0; i<num || j<found->number; )
+    if( j<found->number && i<num && all[i].index==sorted[j].index )
+      {
+        if( all[i].dist>=0
+            && fabs(all[i].dist-sorted[j].dist) > CHECK_TOLERANCE )
+          ++bad;
+        ++i; ++j;
+      }
+    else if( i<num && (j==found->number || all[i].index<sorted[j].index) )
+      { if(all[i].dist>=0) ++bad; ++i; }
+    else ++bad, ++j;
+
+  /* Clean up and return. */
+  free(sorted);
+  return bad;
+}
+
+
+
+
+/* Build a k-d tree and do the searches around random points. */
+static size_t
+check_one(size_t ndim, size_t num, size_t grid, size_t numq,
+          size_t *ks, size_t numk, double *ap)
+{
+  double point[3];
+  gal_data_t *coords, *kdtree;
+  gal_kdtree_query_t *query;
+  gal_kdtree_found_t found;
+  struct check_point *all;
+  size_t i, d, q, root, knnbad=0, rangebad=0;
+
+  /* The k-d tree. */
+  coords=random_columns(ndim, num, grid);
+  kdtree=gal_kdtree_create(coords, &root, 1, 0);
+  query=gal_kdtree_query_prepare(coords, kdtree, root);
+  all=gal_pointer_allocate(GAL_TYPE_UINT8, num*sizeof *all, 0, __func__,
+                           "all");
+
+  /* The same 'found' is used (and grown) in all the searches. */
+  gal_kdtree_found_init(&found, 1);
+  for(q=0;q<numq;++q)
+    {
+      /* On the grid, the query points are also on integers or between
+         them (to have many equal distances). */
+      for(d=0;d<ndim;++d)
+        point[d] = ( grid
+                     ? (double)(rand()%(2*grid))/2
+                     : (double)rand()/RAND_MAX );
+      for(i=0;i<numk;++i)
+        knnbad+=check_knn(query, coords, point, ks[i], all);
+      if(ap) rangebad+=check_range(query, coords, point, ndim, ap, &found,
+                                   all);
+    }
+  if(knnbad || rangebad)
+    printf("%zuD, %zu points (grid %zu): %zu different k nearest "
+           "neighbours, %zu different range searches.\n", ndim, num, grid,
+           knnbad, rangebad);
+
+  /* Clean up and return. */
+  free(all);
+  gal_kdtree_found_free(&found);
+  gal_kdtree_query_free(query);
+  gal_list_data_free(kdtree);
+  gal_list_data_free(coords);
+  return knnbad+rangebad;
+}
+
+
+
+
+/* Check the k nearest neighbours with many equal distances (points on a
+   grid, some repeated), with 'k' larger than the number of points, and
+   the range search with circular, elliptical and ellipsoidal apertures. */
+int
+main(void)
+{
+  size_t bad=0;
+  size_t ks[]={1, 2, 7, 40};
+  size_t kbig[]={3, 5, 8, 100};
+  double circle[3]={0.1, 1, 0}, ellipse[3]={0.15, 0.4, 35};
+  double gcircle[3]={4, 1, 0}, sphere[6]={0.2, 1, 1, 0, 0, 0};
+  double ellipsoid[6]={0.25, 0.5, 0.3, 20, 70, -40};
+  double onedim[1]={0.01};
+
+  srand(1);
+  bad+=check_one(2, 2000, 0,  200, ks,   4, circle);
+  bad+=check_one(2, 2000, 0,  200, ks,   4, ellipse);
+  bad+=check_one(2, 1500, 30, 200, ks,   4, gcircle);
+  bad+=check_one(2, 5,    0,  20,  kbig, 4, NULL);
+  bad+=check_one(3, 3000, 0,  200, ks,   4, sphere);
+  bad+=check_one(3, 3000, 0,  200, ks,   4, ellipsoid);
+  bad+=check_one(3, 2000, 12, 200, ks,   4, NULL);
+  bad+=check_one(1, 1000, 0,  100, ks,   4, onedim);
+
+  /* Report the result. */
+  printf("K nearest neighbours and range search: %s.\n",
+         bad ? "FAILED" : "identical to checking all points");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*********************************************************************
+A test program for the queue and priority queue of 'size_t': the values
+should be popped in the same order as a simple (slow) implementation.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+
+
+
+
+/* Number of random operations on each queue. */
+#define NUM_OPS 200000
+
+/* A node of the simple priority queue: the order that it was added is
+   kept to pop equal values in the same order. */
+struct pnode
+{
+  size_t v;
+  float  s;
+  size_t order;
+};
+
+
+
+
+/* Do random operations (mostly additions) on the queue and on a simple
+   array that is large enough for all the operations (so it never wraps
+   around). Until 'NUM_OPS/2', the values are mostly popped from the start
+   (as a first-in-first-out queue), so the queue's values wrap around the
+   end of its space before it grows. Return the number of differences. */
+static size_t
+check_queue(size_t initsize)
+{
+  gal_list_qsizet_t q;
+  size_t i, op, v, r, num, bad=0, *ref, *arr, first=0, last=0;
+
+  ref=malloc(NUM_OPS*sizeof *ref);
+  if(ref==NULL)
+    { printf("%s: couldn't allocate the reference.\n", __func__); exit(1); }
+  gal_list_qsizet_init(&q, initsize);
+  for(i=0;i<NUM_OPS;++i)
+    {
+      op=rand()%10;
+      if(op<6)
+        {
+          v=rand();
+          gal_list_qsizet_add(&q, v);
+          ref[last++]=v;
+        }
+      else
+        {
+          if( i<NUM_OPS/2 ? op<9 : op<8 )
+            {
+              v=gal_list_qsizet_pop_first(&q);
+              r = first==last ? GAL_BLANK_SIZE_T : ref[first++];
+            }
+          else
+            {
+              v=gal_list_qsizet_pop_last(&q);
+              r = first==last ? GAL_BLANK_SIZE_T : ref[--last];
+            }
+          if(v!=r) ++bad;
+        }
+      if(q.number!=last-first) ++bad;
+    }
+
+  /* The remaining values (from the first to the last). */
+  arr=gal_list_qsizet_to_array(&q, &num);
+  if(num!=last-first) ++bad;
+  else for(i=0;i<num;++i) if(arr[i]!=ref[first+i]) ++bad;
+  if(bad)
+    printf("Queue (initial size %zu): %zu differences.\n", initsize, bad);
+
+  /* Clean up and return. */
+  free(ref);
+  free(arr);
+  gal_list_qsizet_free(&q);
+  return bad;
+}
+
+
+
+
+/* Do random additions, pops and (rarely) clears on the priority queue
+   and on a simple array (where the smallest value is found by checking
+   all the nodes). The sorting values have many equal values (that should
+   be popped in the order they were added). Return the number of
+   differences. */
+static size_t
+check_priority(size_t initsize)
+{
+  float s, rs;
+  struct pnode *ref;
+  gal_list_psizet_t q;
+  size_t i, j, op, v, rv, min, n=0, order=0, bad=0;
+
+  ref=malloc(NUM_OPS*sizeof *ref);
+  if(ref==NULL)
+    { printf("%s: couldn't allocate the reference.\n", __func__); exit(1); }
+  gal_list_psizet_init(&q, initsize);
+  for(i=0;i<NUM_OPS;++i)
+    {
+      op=rand()%1000;
+      if(op<510)
+        {
+          ref[n].v=rand();
+          ref[n].s=rand()%20/4.0f;
+          ref[n].order=order++;
+          gal_list_psizet_add(&q, ref[n].v, ref[n].s);
+          ++n;
+        }
+      else if(op<999)
+        {
+          v=gal_list_psizet_pop_smallest(&q, &s);
+          if(n)
+            {
+              for(min=0, j=1;j<n;++j)
+                if( ref[j].s<ref[min].s
+                    || (ref[j].s==ref[min].s && ref[j].order<ref[min].order) )
+                  min=j;
+              rv=ref[min].v;
+              rs=ref[min].s;
+              ref[min]=ref[--n];
+              if(v!=rv || s!=rs) ++bad;
+            }
+          else if(v!=GAL_BLANK_SIZE_T || !isnan(s)) ++bad;
+        }
+      else
+        {
+          gal_list_psizet_clear(&q);
+          n=0;
+        }
+      if(q.number!=n) ++bad;
+    }
+  if(bad)
+    printf("Priority queue (initial size %zu): %zu differences.\n",
+           initsize, bad);
+
+  /* Clean up and return. */
+  free(ref);
+  gal_list_psizet_free(&q);
+  return bad;
+}
+
+
+
+
+/* Check the queues with the default and with a non-power-of-two initial
+   size. */
+int
+main(void)
+{
+  size_t bad=0;
+
+  srand(1);
+  bad+=check_queue(0);
+  bad+=check_queue(100);
+  bad+=check_priority(0);
+  bad+=check_priority(3);
+
+  /* Report the result. */
+  printf("Queue and priority queue: %s.\n",
+         bad ? "FAILED" : "same order as a simple implementation");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
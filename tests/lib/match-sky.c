@@ -0,0 +1,214 @@
+/*********************************************************************
+A test program for matching RA and Dec on the celestial sphere.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/match.h"
+#include "gnuastro/blank.h"
+
+
+
+
+/* Regions of the sky that the random points are placed in. */
+enum check_regions
+{
+  CHECK_ALLSKY,               /* Uniform over the whole sphere.       */
+  CHECK_POLE,                 /* Declinations above 85 degrees.       */
+  CHECK_RAZERO,               /* Within 2 degrees of RA=0 (and Dec=0). */
+};
+
+
+
+
+/* Angular distance (in degrees) between two points on the sphere
+   (calculated from the chord between them, which is accurate for small
+   and large distances). */
+static double
+angular_distance(double r1, double d1, double r2, double d2)
+{
+  double a=M_PI/180.0;
+  double x=cos(d1*a)*cos(r1*a) - cos(d2*a)*cos(r2*a);
+  double y=cos(d1*a)*sin(r1*a) - cos(d2*a)*sin(r2*a);
+  double z=sin(d1*a)           - sin(d2*a);
+  return 2*asin( sqrt(x*x+y*y+z*z)/2 )/a;
+}
+
+
+
+
+/* Uniform random number between 0 and 1. */
+static double
+random_uniform(void)
+{
+  return (double)rand()/RAND_MAX;
+}
+
+
+
+
+/* Allocate 'num' random RA and Dec (two columns, in degrees). */
+static gal_data_t *
+random_coords(size_t num, int region)
+{
+  size_t i;
+  double *r, *d;
+  gal_data_t *out;
+
+  /* Allocate the two columns. */
+  out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &num, NULL, 0, -1, 1,
+                     NULL, NULL, NULL);
+  out->next=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &num, NULL, 0, -1, 1,
+                           NULL, NULL, NULL);
+
+  /* Fill them. */
+  r=out->array;
+  d=out->next->array;
+  for(i=0;i<num;++i)
+    switch(region)
+      {
+      case CHECK_ALLSKY:
+        r[i]=360*random_uniform();
+        d[i]=asin(2*random_uniform()-1)*180/M_PI;
+        break;
+      case CHECK_POLE:
+        r[i]=360*random_uniform();
+        d[i]=85+5*random_uniform();
+        break;
+      default:
+        r[i]=fmod(358+4*random_uniform(), 360);
+        d[i]=4*random_uniform()-2;
+      }
+
+  /* A blank row should not be matched. */
+  r[0]=NAN;
+  return out;
+}
+
+
+
+
+/* Match the two random catalogs with 'gal_match_sky_cells' and by
+   checking all the pairs. Like the other matching functions, for each row
+   of the second catalog, the nearest row of the first catalog within the
+   aperture is found, then each row of the first catalog keeps the nearest
+   of the second catalog rows that chose it. Return the number of
+   differences. */
+static size_t
+check_one(size_t num1, size_t num2, double aperture, int region,
+          size_t numthreads)
+{
+  double dist;
+  gal_data_t *c1, *c2, *out;
+  size_t i, j, nummatched, numref=0, bad=0, *i1, *i2, *near2, *near1;
+  double *r1, *r2, *dec1, *dec2, *mdist, *dist1, *dist2, ap[1]={aperture};
+
+  /* Random catalogs and the library's output. */
+  c1=random_coords(num1, region);
+  c2=random_coords(num2, region);
+  out=gal_match_sky_cells(c1, c2, ap, numthreads, -1, 1, &nummatched);
+
+  /* Allocate the arrays for the reference. */
+  near1=malloc(num1*sizeof *near1);
+  near2=malloc(num2*sizeof *near2);
+  dist1=malloc(num1*sizeof *dist1);
+  dist2=malloc(num2*sizeof *dist2);
+  if(near1==NULL || near2==NULL || dist1==NULL || dist2==NULL)
+    {
+      fprintf(stderr, "couldn't allocate the reference arrays.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  /* Nearest row of the first catalog to each row of the second. */
+  r1=c1->array; dec1=c1->next->array;
+  r2=c2->array; dec2=c2->next->array;
+  for(j=0;j<num2;++j)
+    {
+      near2[j]=GAL_BLANK_SIZE_T;
+      dist2[j]=aperture;
+      for(i=0;i<num1;++i)
+        if( !isnan(r1[i]) && !isnan(r2[j]) )
+          {
+            dist=angular_distance(r1[i], dec1[i], r2[j], dec2[j]);
+            if(dist<dist2[j]) { dist2[j]=dist; near2[j]=i; }
+          }
+    }
+
+  /* Nearest of the choosing rows of the second catalog to each row of the
+     first. */
+  for(i=0;i<num1;++i) { near1[i]=GAL_BLANK_SIZE_T; dist1[i]=aperture; }
+  for(j=0;j<num2;++j)
+    if( near2[j]!=GAL_BLANK_SIZE_T && dist2[j]<dist1[near2[j]] )
+      { dist1[near2[j]]=dist2[j]; near1[near2[j]]=j; }
+  for(i=0;i<num1;++i) if(near1[i]!=GAL_BLANK_SIZE_T) ++numref;
+
+  /* Compare the matched rows and their distances. Note that the final
+     arrangement of all the matching functions keeps the distances in
+     single precision. */
+  if(out)
+    {
+      i1=out->array;
+      i2=out->next->array;
+      mdist=out->next->next->array;
+      for(i=0;i<nummatched;++i)
+        if( near1[i1[i]]!=i2[i]
+            || fabs(dist1[i1[i]]-mdist[i]) > 1e-6*dist1[i1[i]] )
+          ++bad;
+    }
+  if(bad || nummatched!=numref)
+    printf("Region %d, aperture %g, %zu threads: %zu matched (expected "
+           "%zu), %zu different matches.\n", region, aperture, numthreads,
+           nummatched, numref, bad);
+
+  /* Clean up and return. */
+  free(near1); free(near2); free(dist1); free(dist2);
+  gal_list_data_free(out);
+  gal_list_data_free(c1);
+  gal_list_data_free(c2);
+  return bad + (nummatched!=numref);
+}
+
+
+
+
+/* Check the matching in the regions where the spherical geometry matters
+   most (close to the pole and around RA=0), and over the whole sky, on
+   different numbers of threads. */
+int
+main(void)
+{
+  size_t t, bad=0;
+  size_t threads[]={1, 4};
+
+  srand(1);
+  for(t=0;t<sizeof threads/sizeof *threads;++t)
+    {
+      bad+=check_one(4000, 5000, 1.0,  CHECK_ALLSKY, threads[t]);
+      bad+=check_one(3000, 3000, 0.05, CHECK_POLE,   threads[t]);
+      bad+=check_one(3000, 4000, 0.05, CHECK_RAZERO, threads[t]);
+    }
+
+  /* Report the result. */
+  printf("Matching on the sphere: %s.\n",
+         bad ? "FAILED" : "identical to checking all pairs");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
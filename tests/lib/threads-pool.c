@@ -0,0 +1,183 @@
+/*********************************************************************
+A test program for the persistent thread pool: nested jobs (with
+different numbers of threads) should run every task exactly once.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "gnuastro/threads.h"
+
+
+
+
+/* The tasks form a tree: there are 'NUM_ROOT' tasks in the first job and
+   every task (until the last level) runs a job of 'NUM_BRANCH' tasks
+   within itself. The tasks of the last level spin-off 'NUM_ACTIONS'
+   actions on many threads. */
+#define NUM_ROOT    4
+#define NUM_BRANCH  3
+#define NUM_LEVELS  4
+#define NUM_ACTIONS 50
+
+/* Number of threads of the jobs (different in each job). */
+static size_t numthreads[]={1, 2, 3, 5, 8};
+#define NUM_NUMTHREADS ( sizeof numthreads / sizeof *numthreads )
+
+/* Number of times that each task (and each action of the tasks in the
+   last level) has been run. */
+static pthread_mutex_t count_mutex=PTHREAD_MUTEX_INITIALIZER;
+static size_t *task_count, *action_count;
+static size_t level_start[NUM_LEVELS+1];
+
+/* Each task knows its level and its index within all the tasks. */
+struct task
+{
+  size_t level;
+  size_t id;
+};
+
+
+
+
+/* Add one to the given counter. */
+static void
+count(size_t *counter)
+{
+  pthread_mutex_lock(&count_mutex);
+  ++*counter;
+  pthread_mutex_unlock(&count_mutex);
+}
+
+
+
+
+/* Count the actions of one thread of a task in the last level. */
+static void *
+action_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct task *t=(struct task *)tprm->params;
+  size_t i;
+
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    count( &action_count[ (t->id-level_start[NUM_LEVELS-1])*NUM_ACTIONS
+                          + tprm->indexs[i] ] );
+
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+/* Run one task: count it, then run the job of its children (or the
+   actions in the last level). The number of threads depends on the task,
+   so the nested jobs have different numbers of threads. */
+static void *
+task_run(void *in)
+{
+  size_t k;
+  struct task *t=in, children[NUM_BRANCH];
+  size_t nt=numthreads[ (t->id+t->level) % NUM_NUMTHREADS ];
+
+  count(&task_count[t->id]);
+  usleep(100);
+  if(t->level+1<NUM_LEVELS)
+    {
+      for(k=0;k<NUM_BRANCH;++k)
+        {
+          children[k].level=t->level+1;
+          children[k].id = ( level_start[t->level+1]
+                             + (t->id-level_start[t->level])*NUM_BRANCH
+                             + k );
+        }
+      gal_threads_pool_run(task_run, children, sizeof *children,
+                           NUM_BRANCH, nt);
+    }
+  else
+    gal_threads_spin_off(action_on_thread, t, NUM_ACTIONS, nt, -1, 1);
+  return NULL;
+}
+
+
+
+
+/* Run all the tasks from a first job with the given number of threads
+   and return the number of tasks or actions that weren't run exactly
+   once. */
+static size_t
+check_one(size_t nt)
+{
+  size_t i, bad=0;
+  struct task root[NUM_ROOT];
+  size_t numtasks=level_start[NUM_LEVELS];
+  size_t numactions=(numtasks-level_start[NUM_LEVELS-1])*NUM_ACTIONS;
+
+  memset(task_count, 0, numtasks*sizeof *task_count);
+  memset(action_count, 0, numactions*sizeof *action_count);
+  for(i=0;i<NUM_ROOT;++i) { root[i].level=0; root[i].id=i; }
+  gal_threads_pool_run(task_run, root, sizeof *root, NUM_ROOT, nt);
+
+  for(i=0;i<numtasks;++i)   if(task_count[i]!=1)   ++bad;
+  for(i=0;i<numactions;++i) if(action_count[i]!=1) ++bad;
+  if(bad)
+    printf("First job on %zu threads: %zu tasks or actions were not run "
+           "exactly once.\n", nt, bad);
+  return bad;
+}
+
+
+
+
+/* Run the nested jobs starting with different numbers of threads (the
+   pool grows and is used again), then once more after freeing the
+   pool. */
+int
+main(void)
+{
+  size_t i, n, bad=0;
+
+  /* Index of the first task of each level. */
+  level_start[0]=0;
+  for(i=0, n=NUM_ROOT; i<NUM_LEVELS; ++i, n*=NUM_BRANCH)
+    level_start[i+1]=level_start[i]+n;
+  task_count=malloc(level_start[NUM_LEVELS]*sizeof *task_count);
+  action_count=malloc( (level_start[NUM_LEVELS]-level_start[NUM_LEVELS-1])
+                       *NUM_ACTIONS*sizeof *action_count );
+  if(task_count==NULL || action_count==NULL)
+    { printf("%s: couldn't allocate the counters.\n", __func__); return 1; }
+
+  /* Check the jobs. */
+  for(i=0;i<NUM_NUMTHREADS;++i) bad+=check_one(numthreads[i]);
+  gal_threads_pool_free();
+  bad+=check_one(4);
+  gal_threads_pool_free();
+
+  /* Report the result. */
+  free(task_count);
+  free(action_count);
+  printf("Nested jobs in the thread pool: %s.\n",
+         bad ? "FAILED" : "every task was run once");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+/*********************************************************************
+A test program for reading plain-text tables on many threads: every
+floating point number should be identical to parsing it with 'strtod'.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/table.h"
+
+
+
+
+/* Size of the chunks that a file is read in (on many threads) within the
+   library: some lines end exactly around the multiples of this size. */
+#define CHUNK_SIZE 1048576
+
+/* Approximate size of the file (a few chunks). */
+#define FILE_SIZE (5*CHUNK_SIZE+12345)
+
+/* Numbers that are hard to parse: around the largest exactly
+   representable integer (2^53), around the largest exact power of ten
+   (10^22), with many significant digits (19 and more), with leading and
+   trailing zeros, negative zero, rounding ties and extreme values. */
+static char *fixed_tokens[]={
+  "9007199254740992", "9007199254740993", "-9007199254740993",
+  "9007199254740991", "9007199254740994", "9007199254740995",
+  "9007199254740992e1", "9007199254740993e-1", "900719925474099.3e1",
+  "1e22", "1e23", "-1e-22", "1e-23", "1e+22", "1E-23", "123456789e22",
+  "123456789e23", "1.5e-22", "4.5e-23", "9.999999999999999e22",
+  "1234567890123456789", "12345678901234567890", "9999999999999999999",
+  "18446744073709551615", "18446744073709551616", "0.1234567890123456789",
+  "1.2345678901234567890123", "0.1000000000000000055511151231257827",
+  "1.00000000000000011102230246251565404236316680908203125",
+  "9007199254740991.5", "4503599627370497.5", "000000000000000000000123.5",
+  "0.0000000000000000000000012", "0.000000000000000000001", "00012e-3",
+  "-000.000100", "100000000000000000000000", "-0", "-0.0", "+0", "0e99999",
+  "-0e-5", "0.000", "1.", ".5", "-.5", "+.25e+2", "1e05", "1e400",
+  "1e-400", "2.2250738585072011e-308", "4.9e-324", "1.7976931348623157e308",
+  "nan", "inf", "-inf", "0x1p-3" };
+
+#define NUM_FIXED ( sizeof fixed_tokens / sizeof *fixed_tokens )
+
+
+
+
+/* Write a random number into 'token': random signs, leading zeros,
+   numbers of digits before and after the decimal point and exponents,
+   and integers around 2^53. */
+static void
+random_token(char *token)
+{
+  char *c=token;
+  int i, nint, nfrac;
+
+  /* Integers around 2^53. */
+  if(rand()%10==0)
+    {
+      sprintf(token, "%s90071992547%05d", rand()%2 ? "-" : "",
+              rand()%100000);
+      return;
+    }
+
+  /* Sign and leading zeros. */
+  if(rand()%3==0) *c++ = rand()%2 ? '-' : '+';
+  if(rand()%5==0) for(i=rand()%4; i>=0; --i) *c++='0';
+
+  /* Digits before and after the decimal point (at least one). */
+  nint=rand()%23;
+  nfrac=rand()%23;
+  if(nint==0 && nfrac==0) nint=1;
+  for(i=0;i<nint;++i) *c++ = '0' + rand()%10;
+  if(nfrac || rand()%4==0) *c++='.';
+  for(i=0;i<nfrac;++i) *c++ = '0' + rand()%10;
+
+  /* Exponent. */
+  if(rand()%2)
+    c+=sprintf(c, "%c%s%d", rand()%2 ? 'e' : 'E',
+               rand()%3 ? (rand()%2 ? "-" : "") : "+", rand()%40);
+  *c='\0';
+}
+
+
+
+
+/* Write one line of the file with the given token (in the first two
+   columns) and row index (in the third). When 'length' is non-zero, the
+   line is padded with spaces at its start to have exactly this length.
+   Return the length of the line. */
+static size_t
+write_line(FILE *fp, char *token, size_t row, size_t length)
+{
+  char line[200];
+  size_t len;
+
+  len=sprintf(line, "%s, %s %zu\n", token, token, row);
+  if(length>len) fprintf(fp, "%*s", (int)(length-len), "");
+  fputs(line, fp);
+  return length>len ? length : len;
+}
+
+
+
+
+/* Write the table (keeping the token of every row) and read it back on
+   the given number of threads. Return the number of values that are
+   different to 'strtod'. */
+static size_t
+check_one(size_t numthreads, char *filename)
+{
+  FILE *fp;
+  float *f32;
+  int64_t *ind;
+  double *f64, v;
+  gal_data_t *cols;
+  char token[100], **tokens;
+  size_t i, pos=0, row=0, allocated=200000, bad=0;
+  size_t boundary=CHUNK_SIZE, offsets[]={0, 1, 2, 30}, nb=0;
+
+  /* Write the table. */
+  fp=fopen(filename, "w");
+  tokens=malloc(allocated*sizeof *tokens);
+  if(fp==NULL || tokens==NULL)
+    { printf("%s: couldn't open %s.\n", __func__, filename); return 1; }
+  pos+=fprintf(fp, "# Column 1: F64 [,f64] Parsed as double.\n");
+  pos+=fprintf(fp, "# Column 2: F32 [,f32] Parsed as float.\n");
+  pos+=fprintf(fp, "# Column 3: ROW [,i64] Row index.\n");
+  srand(1);
+  while(pos<FILE_SIZE)
+    {
+      /* The token of this row. */
+      if(row<NUM_FIXED) strcpy(token, fixed_tokens[row]);
+      else              random_token(token);
+      if(row==allocated)
+        {
+          allocated*=2;
+          tokens=realloc(tokens, allocated*sizeof *tokens);
+          if(tokens==NULL)
+            {
+              printf("%s: couldn't allocate the tokens.\n", __func__);
+              return 1;
+            }
+        }
+      tokens[row]=strdup(token);
+
+      /* Close to a chunk boundary, the line is padded to end exactly
+         before the boundary (so the next line starts on it), or just
+         after it, or to contain the boundary. */
+      if(pos+300 > boundary)
+        {
+          pos+=write_line(fp, token, row, boundary+offsets[nb%4]-pos);
+          boundary+=CHUNK_SIZE;
+          ++nb;
+        }
+      else
+        pos+=write_line(fp, token, row, 0);
+      ++row;
+    }
+  fclose(fp);
+
+  /* Read the table and compare every value with 'strtod' (the numbers
+     are compared bit by bit, so the sign of zero is also checked). */
+  cols=gal_table_read(filename, NULL, NULL, NULL, GAL_TABLE_SEARCH_NAME,
+                      1, numthreads, -1, 1, NULL);
+  if( gal_list_data_number(cols)!=3 || cols->size!=row
+      || cols->type!=GAL_TYPE_FLOAT64
+      || cols->next->type!=GAL_TYPE_FLOAT32
+      || cols->next->next->type!=GAL_TYPE_INT64 )
+    {
+      printf("%zu threads: the read columns are not as expected.\n",
+             numthreads);
+      return 1;
+    }
+  f64=cols->array;
+  f32=cols->next->array;
+  ind=cols->next->next->array;
+  for(i=0;i<row;++i)
+    {
+      v=strtod(tokens[i], NULL);
+      if( ind[i]!=(int64_t)i
+          || ( isnan(v)
+               ? !isnan(f64[i]) || !isnan(f32[i])
+               : ( memcmp(&v, &f64[i], sizeof v)
+                   || (float)v!=f32[i]
+                   || !signbit(v)!=!signbit(f32[i]) ) ) )
+        {
+          if(bad<10)
+            printf("%zu threads, row %zu: '%s' read as %.17g and %.9g "
+                   "(strtod: %.17g).\n", numthreads, i, tokens[i], f64[i],
+                   f32[i], v);
+          ++bad;
+        }
+    }
+
+  /* Clean up and return. */
+  for(i=0;i<row;++i) free(tokens[i]);
+  free(tokens);
+  gal_list_data_free(cols);
+  return bad;
+}
+
+
+
+
+/* Read the table on one and on many threads (with more chunks than
+   threads). */
+int
+main(void)
+{
+  size_t bad=0;
+  char *filename="txt-read.txt";
+
+  bad+=check_one(1, filename);
+  bad+=check_one(4, filename);
+
+  /* Report the result. */
+  printf("Reading plain-text tables: %s.\n",
+         bad ? "FAILED" : "identical to strtod");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,295 @@
+/*********************************************************************
+A test program for writing plain-text tables: every written row should
+be identical to printing the values with 'printf'.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/txt.h"
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/table.h"
+
+
+
+
+/* Floating point values that are hard to print: rounding ties (that are
+   exact in binary and that only look like ties in decimal), signed
+   zeros, NaN and infinities, numbers around the limits of the exact
+   integers of 'double' and of the powers of ten that are exact in 'long
+   double', and extreme exponents. */
+static double fixed_values[]={
+  0.0, -0.0, NAN, INFINITY, -INFINITY, 0.5, 1.5, 2.5, -2.5, 0.125, 0.375,
+  -0.625, 1.0005, 2.675, 9.9999995, 99.5, 999999.5, 0.05, 0.15, 0.25,
+  1e15+0.5, 4503599627370495.5, 9007199254740992.0, 9007199254740994.0,
+  -9007199254740991.0, 1e22, 1e23, 1e27, 1e28, -1e-22, 1e-23, 1e-27,
+  1e-28, 0.1, 1.0/3, -2.0/3, 123456.789, 0.00012345, 1e-5, 9.5e-5,
+  99999.95, 999999.0, 1234567.0, DBL_MAX, -DBL_MAX, DBL_MIN, 5e-324,
+  1e300, -1e-300, 3.0e-310, 1.7976931348623157e308 };
+
+/* Integer values (the minimum signed value is the blank value, which is
+   also printed with the column's format). */
+static int64_t fixed_integers[]={
+  0, 1, -1, 9, -10, 99, 100, -12345, 2147483647, -2147483647,
+  9223372036854775807LL, -9223372036854775807LL-1 };
+
+/* Strings (the NULL pointers are printed like 'printf' would). */
+static char *fixed_strings[]={
+  "a", "", "n/a", NULL, "with space", "longer string", NULL };
+
+#define NUM_ROWS 400
+#define NUM_FIXED ( sizeof fixed_values / sizeof *fixed_values )
+#define NUM_FIXED_INT ( sizeof fixed_integers / sizeof *fixed_integers )
+#define NUM_FIXED_STR ( sizeof fixed_strings / sizeof *fixed_strings )
+
+
+
+
+
+/* Value of row 'i': the fixed values above, then random values with
+   random exponents and signs. */
+static double
+row_value(size_t i)
+{
+  double v;
+  if(i<NUM_FIXED) return fixed_values[i];
+  v = (double)rand()/RAND_MAX * pow(10, rand()%50-25);
+  if(rand()%5==0) v=round(v*1000)/1000;
+  return rand()%2 ? -v : v;
+}
+
+
+
+
+/* Allocated copy of a string. */
+static char *
+string_copy(char *in)
+{
+  char *out=malloc(strlen(in)+1);
+  if(out==NULL)
+    { printf("%s: couldn't allocate a string.\n", __func__); exit(1); }
+  return strcpy(out, in);
+}
+
+
+
+
+/* Allocate a column with the given display format, width and
+   precision. */
+static gal_data_t *
+column(uint8_t type, size_t ncol, int fmt, int width, int prec,
+       gal_data_t *next)
+{
+  gal_data_t *out;
+  size_t dsize[2]={NUM_ROWS, ncol};
+  out=gal_data_alloc(NULL, type, ncol>1 ? 2 : 1, dsize, NULL, 1, -1, 1,
+                     "COL", "unit", "comment");
+  out->disp_fmt=fmt;
+  out->disp_width=width;
+  out->disp_precision=prec;
+  out->next=next;
+  return out;
+}
+
+
+
+
+/* Format of one column, built in the same way as the writer: all the
+   columns except the last are left adjusted to the column's width (the
+   precision of integers is only used when it is given), with a space
+   before positive values when the column has negative values. */
+static void
+column_format(gal_data_t *col, int last, char conv, char *fmt)
+{
+  size_t i;
+  int hasneg=0;
+  char *lng = col->type==GAL_TYPE_INT64 ? "l" : "";
+
+  for(i=0;i<col->size;++i)
+    switch(col->type)
+      {
+      case GAL_TYPE_INT64:
+        hasneg |= ((int64_t *)(col->array))[i]<0; break;
+      case GAL_TYPE_FLOAT32:
+        hasneg |= ((float   *)(col->array))[i]<0; break;
+      case GAL_TYPE_FLOAT64:
+        hasneg |= ((double  *)(col->array))[i]<0; break;
+      }
+
+  if(last)
+    {
+      if(col->disp_precision==GAL_BLANK_INT)
+        sprintf(fmt, "%%%s%s%c", hasneg ? " " : "", lng, conv);
+      else
+        sprintf(fmt, "%%%s.%d%s%c", hasneg ? " " : "",
+                col->disp_precision, lng, conv);
+    }
+  else
+    {
+      if(col->disp_precision==GAL_BLANK_INT)
+        sprintf(fmt, "%%%s-%d%s%c ", hasneg ? " " : "", col->disp_width,
+                lng, conv);
+      else
+        sprintf(fmt, "%%%s-%d.%d%s%c ", hasneg ? " " : "",
+                col->disp_width, col->disp_precision, lng, conv);
+    }
+}
+
+
+
+
+/* Write the columns with the given floating point format, width and
+   precision and compare every row with 'printf'. Return the number of
+   different rows. */
+static size_t
+check_one(int dispfmt, char conv, int width, int prec, char *filename)
+{
+  FILE *fp;
+  double *d, *v;
+  size_t i, j, bad=0;
+  char *line=NULL, *s, **str;
+  size_t linesize=0, rowsize=8192;
+  char fmt[7][GAL_TXT_MAX_FMT_LENGTH];
+  int64_t *i64;
+  uint32_t *u32;
+  float *f;
+  gal_data_t *cols;
+  int intprec = prec>20 ? GAL_BLANK_INT : prec;
+
+  /* The columns: floating points (in both types), integers (with the
+     same width and precision), strings and a vector of floating points
+     (as the last column, which has a different format for its last
+     element). */
+  cols=column(GAL_TYPE_FLOAT64, 3, dispfmt, width, prec, NULL);
+  cols=column(GAL_TYPE_STRING,  1, 0,       width, GAL_BLANK_INT, cols);
+  cols=column(GAL_TYPE_UINT32,  1, GAL_TABLE_DISPLAY_FMT_UDECIMAL, width,
+              intprec, cols);
+  cols=column(GAL_TYPE_INT64,   1, 0,       width, intprec, cols);
+  cols=column(GAL_TYPE_FLOAT32, 1, dispfmt, width, prec, cols);
+  cols=column(GAL_TYPE_FLOAT64, 1, dispfmt, width, prec, cols);
+
+  /* Fill the columns. */
+  srand(prec*100+width);
+  d=cols->array;
+  f=cols->next->array;
+  i64=cols->next->next->array;
+  u32=cols->next->next->next->array;
+  str=cols->next->next->next->next->array;
+  v=cols->next->next->next->next->next->array;
+  for(i=0;i<NUM_ROWS;++i)
+    {
+      d[i]=row_value(i);
+      f[i]=d[i];
+      i64[i] = ( i<NUM_FIXED_INT
+                 ? fixed_integers[i]
+                 : (int64_t)(rand()%2000001) - 1000000 );
+      u32[i] = i64[i];
+      if(i<NUM_FIXED_STR)
+        str[i] = fixed_strings[i] ? string_copy(fixed_strings[i]) : NULL;
+      else
+        str[i]=string_copy(i%2 ? "strx" : "stryz");
+      for(j=0;j<3;++j) v[i*3+j]=row_value( (i+j*7)%NUM_ROWS );
+    }
+
+  /* Write the table (the widths may change for the blank values). */
+  remove(filename);
+  gal_txt_write(cols, NULL, NULL, filename, 0, 0);
+
+  /* The formats of all the columns (the vector's last element has the
+     format of a last column). */
+  column_format(cols,                               0, conv, fmt[0]);
+  column_format(cols->next,                         0, conv, fmt[1]);
+  column_format(cols->next->next,                   0, 'd',  fmt[2]);
+  column_format(cols->next->next->next,             0, 'u',  fmt[3]);
+  column_format(cols->next->next->next->next,       0, 's',  fmt[4]);
+  column_format(cols->next->next->next->next->next, 0, conv, fmt[5]);
+  column_format(cols->next->next->next->next->next, 1, conv, fmt[6]);
+
+  /* Compare every row with 'printf'. */
+  fp=fopen(filename, "r");
+  s=malloc(rowsize);
+  if(fp==NULL || s==NULL)
+    {
+      printf("%s: couldn't open %s.\n", __func__, filename);
+      return 1;
+    }
+  i=0;
+  while( getline(&line, &linesize, fp)!=-1 )
+    {
+      if(line[0]=='#') continue;
+      if(i>=NUM_ROWS) { ++bad; break; }
+      j =snprintf(s,   rowsize,   fmt[0], d[i]);
+      j+=snprintf(s+j, rowsize-j, fmt[1], (double)f[i]);
+      j+=snprintf(s+j, rowsize-j, fmt[2], i64[i]);
+      j+=snprintf(s+j, rowsize-j, fmt[3], u32[i]);
+      j+=snprintf(s+j, rowsize-j, fmt[4], str[i] ? str[i] : "(null)");
+      j+=snprintf(s+j, rowsize-j, fmt[5], v[i*3]);
+      j+=snprintf(s+j, rowsize-j, fmt[5], v[i*3+1]);
+      j+=snprintf(s+j, rowsize-j, fmt[6], v[i*3+2]);
+      snprintf(s+j, rowsize-j, "\n");
+      if( strcmp(s, line) )
+        {
+          if(bad==0)
+            printf("'%%%c', width %d, precision %d:\n  written:  %s"
+                   "  expected: %s", conv, width, prec, line, s);
+          ++bad;
+        }
+      ++i;
+    }
+  if(i!=NUM_ROWS) ++bad;
+  fclose(fp);
+
+  /* Clean up and return. */
+  free(s);
+  free(line);
+  gal_list_data_free(cols);
+  return bad;
+}
+
+
+
+
+/* Write the table with all the floating point formats and many
+   combinations of width and precision (the larger precisions are not
+   formatted within the library, the smaller ones are). */
+int
+main(void)
+{
+  size_t w, p, c, bad=0;
+  int widths[]={1, 8, 13, 30}, precs[]={0, 1, 2, 5, 6, 9, 15, 16, 25};
+  int fmts[]={GAL_TABLE_DISPLAY_FMT_EXP, GAL_TABLE_DISPLAY_FMT_FIXED,
+              GAL_TABLE_DISPLAY_FMT_GENERAL};
+  char convs[]={'e', 'f', 'g'};
+
+  for(c=0;c<sizeof fmts/sizeof *fmts;++c)
+    for(w=0;w<sizeof widths/sizeof *widths;++w)
+      for(p=0;p<sizeof precs/sizeof *precs;++p)
+        bad+=check_one(fmts[c], convs[c], widths[w], precs[p],
+                       "txt-write.txt");
+
+  /* Report the result. */
+  printf("Writing plain-text tables: %s.\n",
+         bad ? "FAILED" : "identical to printf");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
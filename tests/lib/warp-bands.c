@@ -0,0 +1,259 @@
+/*********************************************************************
+A test program for warping in bands of output rows (where only the
+necessary input rows are in memory for each band): the output should be
+identical to warping the full input.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/wcs.h"
+#include "gnuastro/warp.h"
+#include "gnuastro/pointer.h"
+
+
+
+
+/* Properties of the output of the warp: a slightly larger pixel scale
+   than the input around the same center. The output is larger than the
+   input, so some bands of output rows don't overlap with the input. */
+static char   *out_ctype[2]={"RA---TAN", "DEC--TAN"};
+static double  out_cdelt[2]={1.3e-4, 1.3e-4};
+static double out_center[2]={10.0, 20.0};
+
+#define COVERED_FRAC 0.5
+
+/* Number of output rows in each band: the first is the band size of the
+   Warp program ('WARP_BAND_ROWS'), the last is larger than the output. */
+static size_t bandrows[]={64, 7, 1000};
+#define NUM_BANDROWS ( sizeof bandrows / sizeof *bandrows )
+
+
+
+
+/* Allocate a random image of the given type with a rotated WCS (some
+   pixels are blank). */
+static gal_data_t *
+random_image(uint8_t type, size_t *dsize)
+{
+  size_t i;
+  gal_data_t *out;
+  double cdelt[2]={1e-4, 1e-4}, pc[4]={-0.96, 0.28, 0.28, 0.96};
+  char *cunit[2]={"deg", "deg"}, *ctype[2]={"RA---TAN", "DEC--TAN"};
+  double crpix[2]={dsize[1]/2.0, dsize[0]/2.0}, crval[2]={10.0, 20.0};
+
+  out=gal_data_alloc(NULL, type, 2, dsize, NULL, 0, -1, 1, "INPUT", NULL,
+                     NULL);
+  for(i=0;i<out->size;++i)
+    if(type==GAL_TYPE_FLOAT32)
+      ((float *)(out->array))[i] = ( rand()%30==0
+                                     ? NAN : (float)rand()/RAND_MAX );
+    else
+      ((double *)(out->array))[i] = ( rand()%30==0
+                                      ? NAN : (double)rand()/RAND_MAX );
+  out->wcs=gal_wcs_create(crpix, crval, cdelt, pc, cunit, ctype, 2,
+                          GAL_WCS_LINEAR_MATRIX_PC);
+  out->nwcs=1;
+  return out;
+}
+
+
+
+
+/* Warping parameters for the given input (the arrays of the output's
+   properties are not allocated, so they should be set to NULL before
+   freeing). */
+static gal_warp_wcsalign_t
+warp_params(gal_data_t *input, size_t *width, size_t edgesampling)
+{
+  size_t two=2;
+  gal_warp_wcsalign_t wa=gal_warp_wcsalign_template();
+
+  wa.input=input;
+  wa.numthreads=4;
+  wa.edgesampling=edgesampling;
+  wa.coveredfrac=COVERED_FRAC;
+  wa.widthinpix=gal_data_alloc(width, GAL_TYPE_SIZE_T, 1, &two, NULL, 0,
+                               -1, 1, NULL, NULL, NULL);
+  wa.ctype=gal_data_alloc(out_ctype, GAL_TYPE_STRING, 1, &two, NULL, 0,
+                          -1, 1, NULL, NULL, NULL);
+  wa.cdelt=gal_data_alloc(out_cdelt, GAL_TYPE_FLOAT64, 1, &two, NULL, 0,
+                          -1, 1, NULL, NULL, NULL);
+  wa.center=gal_data_alloc(out_center, GAL_TYPE_FLOAT64, 1, &two, NULL, 0,
+                           -1, 1, NULL, NULL, NULL);
+  return wa;
+}
+
+
+
+
+static void
+warp_params_free(gal_warp_wcsalign_t *wa)
+{
+  wa->cdelt->array=wa->center->array=wa->ctype->array=NULL;
+  wa->widthinpix->array=NULL;
+  gal_data_free(wa->cdelt);
+  gal_data_free(wa->ctype);
+  gal_data_free(wa->center);
+  gal_data_free(wa->widthinpix);
+}
+
+
+
+
+/* Number of pixels that are different in the two images (two blank
+   pixels are equal). */
+static size_t
+different_pixels(gal_data_t *a, gal_data_t *b)
+{
+  size_t i, bad=0;
+  double va, vb;
+
+  if(a->type!=b->type || a->size!=b->size
+     || a->dsize[0]!=b->dsize[0] || a->dsize[1]!=b->dsize[1])
+    return a->size ? a->size : 1;
+  for(i=0;i<a->size;++i)
+    {
+      va = ( a->type==GAL_TYPE_FLOAT32
+             ? ((float *)(a->array))[i] : ((double *)(a->array))[i] );
+      vb = ( b->type==GAL_TYPE_FLOAT32
+             ? ((float *)(b->array))[i] : ((double *)(b->array))[i] );
+      if( isnan(va) ? !isnan(vb) : va!=vb ) ++bad;
+    }
+  return bad;
+}
+
+
+
+
+/* Warp the input in bands of 'band' output rows, like the Warp program:
+   the input given to the library only has the size, type and WCS of the
+   input (no pixels) and for each band, only the necessary input rows are
+   copied into a separate dataset. */
+static gal_data_t *
+warp_in_bands(gal_data_t *input, size_t *width, size_t edgesampling,
+              size_t band)
+{
+  gal_data_t *meta, *out;
+  gal_warp_wcsalign_t wa;
+  size_t first, number, infirst, innumber, rdsize[2];
+
+  /* The input without any pixels. */
+  meta=gal_data_alloc(NULL, input->type, 2, input->dsize, input->wcs, 0,
+                      -1, 1, NULL, NULL, NULL);
+  free(meta->array);
+  meta->array=NULL;
+
+  /* Warp each band. When the band doesn't overlap with the input, only
+     the first row is given. */
+  wa=warp_params(meta, width, edgesampling);
+  gal_warp_wcsalign_init(&wa);
+  for(first=0; first<wa.output->dsize[0]; first+=band)
+    {
+      number = ( first+band<wa.output->dsize[0]
+                 ? band : wa.output->dsize[0]-first );
+      gal_warp_wcsalign_inrows(&wa, first, number, &infirst, &innumber);
+      if(innumber==0) innumber=1;
+      rdsize[0]=innumber;
+      rdsize[1]=input->dsize[1];
+      wa.inrows=gal_data_alloc(NULL, input->type, 2, rdsize, NULL, 0, -1,
+                               1, NULL, NULL, NULL);
+      memcpy(wa.inrows->array,
+             gal_pointer_increment(input->array, infirst*rdsize[1],
+                                   input->type),
+             wa.inrows->size*gal_type_sizeof(input->type));
+      wa.inrowstart=infirst;
+      gal_warp_wcsalign_rows(&wa, first, number);
+      gal_data_free(wa.inrows);
+      wa.inrows=NULL;
+    }
+
+  /* Clean up and return. */
+  out=wa.output;
+  gal_warp_wcsalign_free(&wa);
+  warp_params_free(&wa);
+  gal_data_free(meta);
+  return out;
+}
+
+
+
+
+/* Warp an input fully and in bands of different sizes. Return the number
+   of different pixels. */
+static size_t
+check_one(uint8_t type, size_t *dsize, size_t *width, size_t edgesampling)
+{
+  size_t i, b, bad=0;
+  gal_warp_wcsalign_t wa;
+  gal_data_t *input, *bands;
+
+  /* Warp the full input. */
+  input=random_image(type, dsize);
+  wa=warp_params(input, width, edgesampling);
+  gal_warp_wcsalign(&wa);
+
+  /* Warp in bands and compare with the full warp. */
+  for(i=0;i<NUM_BANDROWS;++i)
+    {
+      bands=warp_in_bands(input, width, edgesampling, bandrows[i]);
+      if( (b=different_pixels(wa.output, bands)) )
+        {
+          printf("%zux%zu %s input, %zu output rows, edge sampling %zu, "
+                 "bands of %zu rows: %zu different pixels.\n", dsize[0],
+                 dsize[1], type==GAL_TYPE_FLOAT32 ? "float32" : "float64",
+                 wa.output->dsize[0], edgesampling, bandrows[i], b);
+          bad+=b;
+        }
+      gal_data_free(bands);
+    }
+
+  /* Clean up and return. */
+  gal_data_free(input);
+  gal_data_free(wa.output);
+  warp_params_free(&wa);
+  return bad;
+}
+
+
+
+
+/* Check single and double precision inputs, with and without sampling
+   of the pixel edges. The output heights are not a multiple of the
+   bands. */
+int
+main(void)
+{
+  size_t bad=0;
+  size_t d1[2]={120, 90}, d2[2]={70, 150};
+  size_t w1[2]={131, 151}, w2[2]={67, 129};
+
+  srand(1);
+  bad+=check_one(GAL_TYPE_FLOAT64, d1, w1, 0);
+  bad+=check_one(GAL_TYPE_FLOAT32, d1, w1, 0);
+  bad+=check_one(GAL_TYPE_FLOAT32, d2, w2, 2);
+
+  /* Report the result. */
+  printf("Warping in bands of rows: %s.\n",
+         bad ? "FAILED" : "identical to warping the full input");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
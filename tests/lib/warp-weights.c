@@ -0,0 +1,216 @@
+/*********************************************************************
+A test program for warping with overlap weights: the output should be
+identical to warping the input directly.
+
+Original author:
+     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+Contributing author(s):
+Copyright (C) 2023 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gnuastro/wcs.h"
+#include "gnuastro/list.h"
+#include "gnuastro/warp.h"
+
+
+
+
+/* Properties of the output of the warp: a slightly larger pixel scale
+   than the input (so every output pixel overlaps with many input pixels)
+   around the same center. */
+static char   *out_ctype[2]={"RA---TAN", "DEC--TAN"};
+static double  out_cdelt[2]={1.3e-4, 1.3e-4};
+static double out_center[2]={10.0, 20.0};
+
+#define COVERED_FRAC 0.5
+
+
+
+
+/* Allocate a random image of the given type with a rotated WCS (some
+   pixels are blank). */
+static gal_data_t *
+random_image(uint8_t type, size_t *dsize)
+{
+  size_t i;
+  gal_data_t *out;
+  char *cunit[2]={"deg", "deg"}, *ctype[2]={"RA---TAN", "DEC--TAN"};
+  double crpix[2]={25.0, 30.0}, crval[2]={10.0, 20.0};
+  double cdelt[2]={1e-4, 1e-4}, pc[4]={-0.96, 0.28, 0.28, 0.96};
+
+  out=gal_data_alloc(NULL, type, 2, dsize, NULL, 0, -1, 1, "INPUT", NULL,
+                     NULL);
+  for(i=0;i<out->size;++i)
+    if(type==GAL_TYPE_FLOAT32)
+      ((float *)(out->array))[i] = ( rand()%30==0
+                                     ? NAN : (float)rand()/RAND_MAX );
+    else
+      ((double *)(out->array))[i] = ( rand()%30==0
+                                      ? NAN : (double)rand()/RAND_MAX );
+  out->wcs=gal_wcs_create(crpix, crval, cdelt, pc, cunit, ctype, 2,
+                          GAL_WCS_LINEAR_MATRIX_PC);
+  out->nwcs=1;
+  return out;
+}
+
+
+
+
+/* Warping parameters for the given input (the arrays of the output's
+   properties are not allocated, so they should be set to NULL before
+   freeing). */
+static gal_warp_wcsalign_t
+warp_params(gal_data_t *input, size_t numthreads)
+{
+  size_t two=2;
+  gal_warp_wcsalign_t wa=gal_warp_wcsalign_template();
+
+  wa.input=input;
+  wa.edgesampling=0;
+  wa.widthinpix=NULL;
+  wa.numthreads=numthreads;
+  wa.coveredfrac=COVERED_FRAC;
+  wa.ctype=gal_data_alloc(out_ctype, GAL_TYPE_STRING, 1, &two, NULL, 0,
+                          -1, 1, NULL, NULL, NULL);
+  wa.cdelt=gal_data_alloc(out_cdelt, GAL_TYPE_FLOAT64, 1, &two, NULL, 0,
+                          -1, 1, NULL, NULL, NULL);
+  wa.center=gal_data_alloc(out_center, GAL_TYPE_FLOAT64, 1, &two, NULL, 0,
+                           -1, 1, NULL, NULL, NULL);
+  return wa;
+}
+
+
+
+
+static void
+warp_params_free(gal_warp_wcsalign_t *wa)
+{
+  wa->cdelt->array=wa->center->array=wa->ctype->array=NULL;
+  gal_data_free(wa->cdelt);
+  gal_data_free(wa->ctype);
+  gal_data_free(wa->center);
+}
+
+
+
+
+/* Number of pixels that are different in the two images (two blank
+   pixels are equal). */
+static size_t
+different_pixels(gal_data_t *a, gal_data_t *b)
+{
+  size_t i, bad=0;
+  double va, vb;
+
+  if(a->type!=b->type || a->size!=b->size
+     || a->dsize[0]!=b->dsize[0] || a->dsize[1]!=b->dsize[1])
+    return a->size ? a->size : 1;
+  for(i=0;i<a->size;++i)
+    {
+      va = ( a->type==GAL_TYPE_FLOAT32
+             ? ((float *)(a->array))[i] : ((double *)(a->array))[i] );
+      vb = ( b->type==GAL_TYPE_FLOAT32
+             ? ((float *)(b->array))[i] : ((double *)(b->array))[i] );
+      if( isnan(va) ? !isnan(vb) : va!=vb ) ++bad;
+    }
+  return bad;
+}
+
+
+
+
+/* Warp an input directly and with the overlap weights (found on many
+   threads and applied on one and many threads, also after writing the
+   weights into a file and reading them back). Return the number of
+   different pixels. */
+static size_t
+check_one(uint8_t type, size_t *dsize, char *filename)
+{
+  size_t bad=0, b;
+  gal_warp_wcsalign_t wa, ww;
+  gal_data_t *input, *weights, *read, *one, *many, *fromfile;
+
+  /* Warp the input directly. */
+  input=random_image(type, dsize);
+  wa=warp_params(input, 4);
+  gal_warp_wcsalign(&wa);
+  if(wa.output->next)
+    { gal_data_free(wa.output->next); wa.output->next=NULL; }
+
+  /* Find the weights and apply them. */
+  ww=warp_params(input, 4);
+  gal_warp_wcsalign_weights(&ww);
+  weights=ww.output;
+  one=gal_warp_weights_apply(weights, input, COVERED_FRAC, 1);
+  many=gal_warp_weights_apply(weights, input, COVERED_FRAC, 4);
+
+  /* Write the weights and read them back. */
+  remove(filename);
+  gal_warp_weights_write(weights, filename);
+  read=gal_warp_weights_read(filename, -1, 1);
+  if(read->wcs==NULL || read->nwcs!=1) ++bad;
+  fromfile=gal_warp_weights_apply(read, input, COVERED_FRAC, 4);
+
+  /* Compare the outputs with the direct warp. */
+  if( (b=different_pixels(wa.output, one)) )
+    { bad+=b; printf("One thread: %zu different pixels.\n", b); }
+  if( (b=different_pixels(wa.output, many)) )
+    { bad+=b; printf("Four threads: %zu different pixels.\n", b); }
+  if( (b=different_pixels(wa.output, fromfile)) )
+    { bad+=b; printf("Weights from file: %zu different pixels.\n", b); }
+  if(bad)
+    printf("%zux%zu %s input: %zu differences.\n", dsize[0], dsize[1],
+           type==GAL_TYPE_FLOAT32 ? "float32" : "float64", bad);
+
+  /* Clean up and return. */
+  gal_data_free(one);
+  gal_data_free(many);
+  gal_data_free(input);
+  gal_data_free(fromfile);
+  gal_data_free(wa.output);
+  gal_list_data_free(read);
+  gal_list_data_free(weights);
+  warp_params_free(&wa);
+  warp_params_free(&ww);
+  return bad;
+}
+
+
+
+
+/* Check single and double precision inputs of different sizes (the
+   number of rows is not a multiple of the number of threads). */
+int
+main(void)
+{
+  size_t bad=0;
+  size_t d1[2]={61, 47}, d2[2]={40, 73};
+  char *filename="warp-weights.fits";
+
+  srand(1);
+  bad+=check_one(GAL_TYPE_FLOAT64, d1, filename);
+  bad+=check_one(GAL_TYPE_FLOAT32, d1, filename);
+  bad+=check_one(GAL_TYPE_FLOAT32, d2, filename);
+
+  /* Report the result. */
+  printf("Warping with overlap weights: %s.\n",
+         bad ? "FAILED" : "identical to warping directly");
+  return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+# Build profiles with the cubature and with Monte Carlo integration: the
+# two should agree within the cubature's tolerance.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2023 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=mkprof
+execname=../bin/$prog/ast$prog
+arith=../bin/arithmetic/astarithmetic
+cat=cubature.txt
+cubtol=0.01
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - Arithmetic (to compare the outputs) was not made.
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $arith    ]; then echo "$arith not created.";    exit 77; fi
+
+
+
+
+
+# Input catalog
+# =============
+#
+# One profile of each type that is integrated, with centers that are not
+# on the center of a pixel. A Sersic index of 4 has a sharp center.
+cat > $cat <<EOF
+# Column 1:  ID       [count, u32]
+# Column 2:  X        [pixel, f64]
+# Column 3:  Y        [pixel, f64]
+# Column 4:  FUNCTION [name,  str8]
+# Column 5:  WIDTH    [pixel, f64]
+# Column 6:  INDEX    [none,  f64]
+# Column 7:  PA       [deg,   f64]
+# Column 8:  Q        [frac,  f64]
+# Column 9:  MAG      [mag,   f64]
+# Column 10: TRUNC    [dist,  f64]
+1  15.3  14.8  gaussian  3  0    0   1    -10  2
+2  45.7  15.2  moffat    3  3    30  0.7  -10  2
+3  15.1  45.6  sersic    3  1    60  0.8  -10  2
+4  44.6  45.4  sersic    3  4    120 0.6  -10  2
+EOF
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# With '--tolerance=0', all the pixels of the profiles are integrated
+# (not only the central ones), and without oversampling, the profile
+# changes a lot within each pixel. The Monte Carlo integration uses many
+# random points, so its error (less than 0.2% in the worst pixels) is
+# much smaller than the tolerance of the cubature. The number of pixels
+# where the relative difference is larger than the tolerance should be
+# zero.
+options="--mergedsize=60,60 --oversample=1 --tolerance=0 --envseed"
+$check_with_program $execname $cat $options --integration=cubature \
+                              --cubtolerance=$cubtol               \
+                              --output=cubature-cubature.fits
+$check_with_program $execname $cat $options --integration=random   \
+                              --numrandom=1000000                  \
+                              --output=cubature-random.fits
+for out in cubature-cubature.fits cubature-random.fits; do
+    if [ ! -f $out ]; then echo "$out could not be built."; exit 1; fi
+done
+
+numdiff=$($arith cubature-cubature.fits cubature-random.fits - abs \
+                 cubature-random.fits $cubtol x gt sumvalue -g1 --quiet)
+if [ x"$numdiff" = x ] || [ $($AWK -v n="$numdiff" \
+                                'BEGIN{print (n!=0)}') = 1 ]; then
+    echo "cubature and random integrations differ ($numdiff pixels)."
+    exit 1
+fi
@@ -0,0 +1,137 @@
+# Build the same catalog on one and on many threads: the merged images
+# and the logs should be identical.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2023 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=mkprof
+execname=../bin/$prog/ast$prog
+arith=../bin/arithmetic/astarithmetic
+cat=numthreads.txt
+catreplace=numthreads-replace.txt
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - Arithmetic (to compare the outputs) was not made.
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $arith    ]; then echo "$arith not created.";    exit 77; fi
+
+
+
+
+
+# Input catalogs
+# ==============
+#
+# The profiles are in pairs: the two profiles of a pair overlap, but
+# don't overlap with any other profile. So every pixel of the merged
+# image is the sum of at most two values (which doesn't depend on the
+# order that they are added). The pairs are placed to cross the borders
+# of the bands of rows in the merged image (that are locked separately)
+# and the borders of the image. For '--replace' (where the order of the
+# profiles doesn't matter), large profiles that overlap with many others
+# are also added.
+$AWK 'BEGIN{ print "# Column 1:  ID       [count, u32]";
+             print "# Column 2:  X        [pixel, f64]";
+             print "# Column 3:  Y        [pixel, f64]";
+             print "# Column 4:  FUNCTION [name,  str8]";
+             print "# Column 5:  WIDTH    [pixel, f64]";
+             print "# Column 6:  INDEX    [none,  f64]";
+             print "# Column 7:  PA       [deg,   f64]";
+             print "# Column 8:  Q        [frac,  f64]";
+             print "# Column 9:  MAG      [mag,   f64]";
+             print "# Column 10: TRUNC    [dist,  f64]";
+             srand(1);
+             for(i=0;i<6;++i) for(j=0;j<5;++j) for(k=0;k<2;++k)
+               {
+                 f=(i+j+k)%3;
+                 printf "%d %.3f %.3f %s %.3f %.3f %.2f %.3f %.2f 3\n",
+                        ++id, 10+30*i+6*rand()-3, 10+30*j+6*rand()-3,
+                        f==0 ? "sersic" : (f==1 ? "moffat" : "gaussian"),
+                        2+rand(), 1+3*rand(), 180*rand(), 0.4+0.6*rand(),
+                        -10+2*rand();
+               } }' > $cat
+cp $cat $catreplace
+$AWK 'BEGIN{ srand(2);
+             for(i=61;i<=75;++i)
+               printf "%d %.3f %.3f sersic 8 %.3f %.2f %.3f %.2f 5\n",
+                      i, 160*rand(), 140*rand(), 1+3*rand(), 180*rand(),
+                      0.4+0.6*rand(), -14+2*rand();
+           }' >> $catreplace
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The height of the merged image (130 rows) is not a multiple of the
+# bands. With '--envseed', the random numbers of every profile are the
+# same in all runs. The logs are written in the running directory, so
+# they are renamed after each run (their comments contain the date, so
+# they are not compared).
+for nt in 1 4 7; do
+    for mode in sum replace; do
+        if [ $mode = sum ]; then c=$cat; opt=""
+        else                     c=$catreplace; opt="--replace"
+        fi
+        $check_with_program $execname $c --mergedsize=160,130 --envseed \
+                                      --numthreads=$nt --log $opt      \
+                                      --output=numthreads-$mode-$nt.fits
+        if [ ! -f numthreads-$mode-$nt.fits ]; then
+            echo "numthreads-$mode-$nt.fits could not be built."; exit 1
+        fi
+        grep -v '^#' astmkprof.log > numthreads-$mode-$nt.log
+    done
+done
+
+for nt in 4 7; do
+    for mode in sum replace; do
+        ref=numthreads-$mode-1
+        out=numthreads-$mode-$nt
+        numdiff=$($arith $ref.fits $out.fits ne sumvalue -g1 --quiet)
+        if [ x"$numdiff" = x ] || [ $($AWK -v n="$numdiff" \
+                                        'BEGIN{print (n!=0)}') = 1 ]; then
+            echo "$out.fits is different from $ref.fits ($numdiff)."
+            exit 1
+        fi
+        if ! cmp $ref.log $out.log; then
+            echo "$out.log is different from $ref.log."; exit 1
+        fi
+    done
+done
@@ -0,0 +1,97 @@
+# Check that selecting rows with '--range' while the FITS table is read
+# gives the same output as selecting them after the full table is read.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2023 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=table
+execname=../bin/$prog/ast$prog
+txt=range-on-read.txt
+fits=range-on-read.fits
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+
+
+
+
+
+# Input table
+# ===========
+#
+# A FITS table that is large enough to be read in many blocks of rows on
+# multiple threads, with a blank value in the column that the range is
+# checked on and a vector column.
+$AWK 'BEGIN{ print "# Column 1: ID   [counter, i32]    Row number";
+             print "# Column 2: X    [pix,     f64]    Position";
+             print "# Column 3: V    [value,   f32(3)] Vector";
+             for(i=1;i<=200000;++i)
+               {
+                 x = i%13 ? sprintf("%.6f", (i*7919)%100000/10) : "nan";
+                 printf "%d  %s  %d %d %g\n", i, x, i%7, i%11, i/3;
+               } }' > $txt
+$execname $txt --output=$fits
+if [ ! -f $fits ]; then echo "$fits could not be built."; exit 99; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like 'Valgrind' or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# When '--fromvector' is called, the full table is read and the rows are
+# selected afterwards. So the row selection is done once after reading
+# (with '--fromvector') and once while reading (with '--fromvector' in a
+# second call on the selected rows). Finally, a range that doesn't
+# select any row should give a table without any rows.
+$check_with_program $execname $fits --range=X,100,5000 --numthreads=4   \
+                              --fromvector=V,1,2,3                      \
+                              --output=range-on-read-after.txt          \
+    && $check_with_program $execname $fits --range=X,100,5000           \
+                                     --numthreads=4                     \
+                                     --output=range-on-read-while.fits  \
+    && $execname range-on-read-while.fits --fromvector=V,1,2,3          \
+                 --output=range-on-read-while.txt                       \
+    && cmp range-on-read-after.txt range-on-read-while.txt              \
+    && $check_with_program $execname $fits --range=X,-5,-1              \
+                                     --numthreads=4                     \
+                                     --output=range-on-read-empty.txt   \
+    && [ $(grep -v '^#' range-on-read-empty.txt | wc -l) = 0 ]
@@ -0,0 +1,101 @@
+# Check that writing a plain-text table that was read from a plain-text
+# table gives the same bytes, and that the rows of a large plain-text
+# table are read identically on any number of threads.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     Mohammad Akhlaghi <mohammad@akhlaghi.org>
+# Contributing author(s):
+# Copyright (C) 2023 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=table
+execname=../bin/$prog/ast$prog
+table=$topsrc/tests/$prog/table.txt
+large=txt-round-trip-large.txt
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $table    ]; then echo "$table doesn't exist.";  exit 77; fi
+
+
+
+
+
+# Large table
+# ===========
+#
+# The text tables are read in chunks of (at least) one megabyte on each
+# thread, so the table that is distributed with the tests is too small
+# for parallel reading. Here, a table of several megabytes is built with
+# integers, floating points (with and without exponents) and strings
+# (that have spaces), and some blank values.
+$AWK 'BEGIN{ print "# Column 1: ID    [counter, i32] Row number";
+             print "# Column 2: NAME  [name,  str9]  String with spaces";
+             print "# Column 3: FLUX  [flux,  f64]   Floating point";
+             print "# Column 4: SMALL [ratio, f32]   Exponent notation";
+             print "# Column 5: FLAG  [flag,  u8]    Small integer";
+             for(i=1;i<=150000;++i)
+               {
+                 flux = i%7  ? sprintf("%.10f", i*1.2345678901) : "nan";
+                 flag = i%11 ? i%200 : 255;
+                 printf "%d  obj %05d  %s  %.4e  %d\n", i, i%99991,
+                        flux, i*3.1e-7, flag;
+               } }' > $large
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like 'Valgrind' or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The first output is written from the (hand-written) distributed table,
+# the second is written from the first: they should be identical. The
+# large table is read on one and on four threads and written twice in
+# the same way.
+$check_with_program $execname $table --output=txt-round-trip-1.txt      \
+    && $check_with_program $execname txt-round-trip-1.txt               \
+                           --output=txt-round-trip-2.txt                \
+    && cmp txt-round-trip-1.txt txt-round-trip-2.txt                    \
+    && $check_with_program $execname $large --numthreads=1              \
+                           --output=txt-round-trip-large-1.txt          \
+    && $check_with_program $execname $large --numthreads=4              \
+                           --output=txt-round-trip-large-4.txt          \
+    && cmp txt-round-trip-large-1.txt txt-round-trip-large-4.txt        \
+    && $check_with_program $execname txt-round-trip-large-1.txt         \
+                           --output=txt-round-trip-large-2.txt          \
+    && cmp txt-round-trip-large-1.txt txt-round-trip-large-2.txt